@@ -74,12 +74,13 @@ conrecFaster(
         // gain and lot more complicated algorithm
         row1 = row2;
 
-        // read in the data into row2
+        // read in the data into row2, the whole row at once
         int i = 0;
-        dview.forEach([&] ( const double & val ) {
-                          row2[i++] = val;
-                      }
-                      );
+        dview.forEach( nCols, [&] ( const double * vals, int64_t count ) {
+                           std::copy( vals, vals + count, & row2[i] );
+                           i += count;
+                       }
+                       );
         CARTA_ASSERT( i == nCols );
     };
     updateRows();
@@ -0,0 +1,67 @@
+#include "BitMask.h"
+
+namespace Carta
+{
+namespace Lib
+{
+namespace NdArray
+{
+BitMask::BitMask( const VI & dims, bool valid )
+    : m_dims( dims )
+{
+    m_size = 1;
+    for ( auto d : dims ) {
+        m_size *= d;
+    }
+    int64_t nWords = ( m_size + WordBits - 1 ) / WordBits;
+    m_words.assign( nWords, valid ? ~ Word( 0 ) : Word( 0 ) );
+
+    // keep the unused bits of the last word cleared
+    int tail = m_size % WordBits;
+    if ( valid && tail != 0 ) {
+        m_words.back() = ( Word( 1 ) << tail ) - 1;
+    }
+}
+
+void
+BitMask::setFromBools( int64_t first, int64_t count, const bool * vals )
+{
+    CARTA_ASSERT( first >= 0 && first + count <= m_size );
+
+    // set single bits until we are word aligned
+    while ( count > 0 && first % WordBits != 0 ) {
+        set( first++, * vals++ );
+        count--;
+    }
+
+    // then pack whole words at a time
+    while ( count >= WordBits ) {
+        Word word = 0;
+        for ( int i = 0 ; i < WordBits ; ++i ) {
+            word |= Word( vals[i] ) << i;
+        }
+        m_words[first / WordBits] = word;
+        first += WordBits;
+        vals += WordBits;
+        count -= WordBits;
+    }
+
+    // and the rest
+    while ( count > 0 ) {
+        set( first++, * vals++ );
+        count--;
+    }
+} // setFromBools
+
+int64_t
+BitMask::countValid() const
+{
+    int64_t count = 0;
+    for ( Word word : m_words ) {
+        count += __builtin_popcountll( word );
+    }
+    return count;
+}
+}
+}
+}
@@ -0,0 +1,125 @@
+/**
+ * Packed (1 bit per pixel) mask for n-dimensional views.
+ **/
+
+#pragma once
+
+#include "CartaLib.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace NdArray
+{
+/// \brief Pixel mask stored as one bit per pixel.
+/// \details The bits follow the sequential (fortran) order of the view the mask was
+/// created for, i.e. bit i corresponds to the i-th pixel visited by a sequential
+/// traversal. A set bit means the pixel is valid (same convention as casacore masks).
+///
+/// Consumers should not test pixels one by one, but use forEachRun(), which scans the
+/// mask a word (64 pixels) at a time and reports runs of valid/masked pixels.
+class BitMask
+{
+    CLASS_BOILERPLATE( BitMask );
+
+public:
+
+    typedef std::vector < int > VI;
+    typedef uint64_t Word;
+    static constexpr int WordBits = 64;
+
+    /// create a mask with the given dimensions
+    /// \param dims dimensions of the view this mask is for
+    /// \param valid initial value of all pixels
+    BitMask( const VI & dims, bool valid = true );
+
+    /// dimensions of the mask
+    const VI &
+    dims() const { return m_dims; }
+
+    /// total number of pixels
+    int64_t
+    size() const { return m_size; }
+
+    /// is the pixel at the linear index valid?
+    bool
+    isValid( int64_t index ) const
+    {
+        return ( m_words[index / WordBits] >> ( index % WordBits ) ) & 1;
+    }
+
+    /// set the pixel at the linear index
+    void
+    set( int64_t index, bool valid )
+    {
+        Word bit = Word( 1 ) << ( index % WordBits );
+        if ( valid ) {
+            m_words[index / WordBits] |= bit;
+        }
+        else {
+            m_words[index / WordBits] &= ~ bit;
+        }
+    }
+
+    /// set count pixels starting at linear index first from an array of booleans,
+    /// e.g. the storage of a casacore mask
+    void
+    setFromBools( int64_t first, int64_t count, const bool * vals );
+
+    /// number of valid pixels
+    int64_t
+    countValid() const;
+
+    /// access to the packed words, unused bits of the last word are always 0
+    const std::vector < Word > &
+    words() const { return m_words; }
+
+    /// \brief visit pixels [first, first+count) as runs of valid/masked pixels
+    /// \param func invoked as func( int64_t start, int64_t count, bool valid ) for
+    /// each maximal run, in order
+    template < typename Func >
+    void
+    forEachRun( int64_t first, int64_t count, Func func ) const
+    {
+        int64_t end = std::min( first + count, m_size );
+        int64_t pos = std::max < int64_t > ( first, 0 );
+        while ( pos < end ) {
+            bool valid = isValid( pos );
+            int64_t runEnd = findNext( pos, ! valid, end );
+            func( pos, runEnd - pos, valid );
+            pos = runEnd;
+        }
+    }
+
+protected:
+
+    /// find the first pixel >= pos with the given value, or end if there is none
+    int64_t
+    findNext( int64_t pos, bool value, int64_t end ) const
+    {
+        int64_t w = pos / WordBits;
+        Word flip = value ? 0 : ~ Word( 0 );
+
+        // bits matching 'value' are 1, ignore the ones below pos
+        Word word = ( m_words[w] ^ flip ) & ( ~ Word( 0 ) << ( pos % WordBits ) );
+        while ( word == 0 ) {
+            ++w;
+            if ( w * WordBits >= end ) {
+                return end;
+            }
+            word = m_words[w] ^ flip;
+        }
+        return std::min( end, w * WordBits + __builtin_ctzll( word ) );
+    }
+
+    VI m_dims;
+    int64_t m_size = 0;
+    std::vector < Word > m_words;
+};
+}
+}
+}
@@ -26,6 +26,9 @@ SOURCES += \
     IImage.cpp \
     PixelType.cpp \
     Slice.cpp \
+    StridedIterator.cpp \
+    BitMask.cpp \
+    PermutedImage.cpp \
     AxisInfo.cpp \
     AxisLabelInfo.cpp \
     AxisDisplayInfo.cpp \
@@ -33,6 +36,8 @@ SOURCES += \
     IPlotLabelGenerator.cpp \
     Hooks/LoadAstroImage.cpp \
     PixelPipeline/CustomizablePixelPipeline.cpp \
+    PixelPipeline/BatchKernels.cpp \
+    TPixelPipeline/FusedPipeline.cpp \
     ProfileInfo.cpp \
     PWLinear.cpp \
     StatInfo.cpp \
@@ -67,15 +72,19 @@ HEADERS += \
     PixelType.h \
     Nullable.h \
     Slice.h \
+    StridedIterator.h \
+    BitMask.h \
+    PermutedImage.h \
     AxisInfo.h \
     AxisLabelInfo.h \
     AxisDisplayInfo.h \
     ICoordinateFormatter.h \
     IPlotLabelGenerator.h \
     Hooks/LoadAstroImage.h \
-    TPixelPipeline/IScalar2Scalar.h \
+    TPixelPipeline/FusedPipeline.h \
     PixelPipeline/IPixelPipeline.h \
     PixelPipeline/CustomizablePixelPipeline.h \
+    PixelPipeline/BatchKernels.h \
     ProfileInfo.h \
     PWLinear.h \
     StatInfo.h \
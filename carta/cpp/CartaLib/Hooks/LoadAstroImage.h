@@ -16,6 +16,8 @@ namespace Lib
 namespace Hooks
 {
 /// load an (astronomical) image and convert to an instance of Image::ImageInterface
+/// \note views open files in a background thread, so the hook is not necessarily
+/// called from the main thread
 class LoadAstroImage : public BaseHook
 {
     CARTA_HOOK_BOILER1( LoadAstroImage );
@@ -45,7 +45,7 @@ NdArray::RawViewInterface * Image::ImageInterface::getDataSlice(const SliceND &
 }
 
 
-NdArray::Byte * Image::ImageInterface::getMaskSlice(const SliceND & sliceInfo)
+NdArray::BitMask * Image::ImageInterface::getMaskSlice(const SliceND & sliceInfo)
 {
     Q_UNUSED( sliceInfo);
     qFatal( "Calling unimplemented virtual function... ");
@@ -20,15 +20,18 @@
 #pragma once
 
 #include "PixelType.h"
+#include "BitMask.h"
 #include "Nullable.h"
 #include "Slice.h"
 #include "ICoordinateFormatter.h"
 #include "IPlotLabelGenerator.h"
 #include <QObject>
+#include <algorithm>
 #include <functional>
 #include <initializer_list>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace Carta {
 namespace Lib {
@@ -69,17 +72,44 @@ public:
     enum class Traversal
     {
         Sequential, ///< sequential order (ie. row-major, or C-style)
-        Optimal ///< whatever order that is most optimal
+        Optimal ///< whatever order that is most optimal (e.g. tile order), use
+                ///< currentPos() to find out where you are
     };
 
     /// get the pixel type stored in this array accessor
     virtual PixelType
     pixelType() = 0;
 
+    /// description of view data that is directly addressable in memory, see stridedSpan()
+    struct StridedSpan
+    {
+        /// address of the first pixel of the view, i.e. pixel at [0,0,...,0]
+        const char * data = nullptr;
+
+        /// for each axis of the view, the distance in bytes between two consecutive pixels
+        /// (could be negative)
+        std::vector < int64_t > strides;
+
+        /// type of the pixels
+        PixelType pixelType = PixelType::Other;
+    };
+
     /// get the max. dimensions allowed in this accessor
     virtual const VI &
     dims() = 0;
 
+    /// \brief Zero-copy access to the data, available only if the view's backing store
+    /// is addressable (e.g. the whole image lives in memory).
+    /// \return description of where the pixels are, or null if this is not possible, in
+    /// which case one of the other accessors has to be used
+    /// \note the memory is valid for as long as this view exists
+    /// \note the default implementation reports 'not available'
+    virtual Nullable < StridedSpan >
+    stridedSpan()
+    {
+        return Nullable < StridedSpan > ();
+    }
+
 
 
     /// get the raw data for the given pixel (at coordinates 'pos')
@@ -90,9 +120,9 @@ public:
     /// visit each element via function pointer
     /// \param func function that will be invoked on each data
     /// \param traversal determines the order in which the data is traversed
-    /// \note this is faster than the get() random access method
-    /// \todo investigate whether this is faster/slower than iterator approach?
-    /// \todo investigate performance of std::function vs raw function pointer
+    /// \note this is faster than the get() random access method, but it still costs an
+    /// indirect call per element, so for bulk processing use the buffered forEach() below
+    /// (or TypedView::forEach(), which inlines the callable)
     virtual void
     forEach( std::function < void (const char *) > func,
              Traversal traversal = Traversal::Sequential ) = 0;
@@ -112,14 +142,22 @@ public:
     /// \brief create a view into this view
     /// \param sliceInfo which view to get
     /// \return a new view
-    /// \warning for efficiency reasons we are not doing shared pointers, etc... since the returned
-    /// view needs to have pointer to the instance of the image interface, the image interface
-    /// needs to remain valid while accessing the view! i.e. don't delete it
-    /// \todo the above warning I think we should treat as a bug! I think we can do this safely
-    /// with shared pointers while maintaining speed (look at qimage plugin)
+    /// \note the returned view shares ownership of the underlying image data, so the
+    /// image interface it came from can be released while the view is still in use
+    /// \note it is safe to call this concurrently from multiple threads
     virtual RawViewInterface *
     getView( const SliceND & sliceInfo ) = 0;
 
+    /// \brief create an independent copy of this view (a per-thread cursor)
+    /// \details The copy has its own traversal state (currentPos(), the buffer returned
+    /// by get(), the position for read()/seek()). Different copies can therefore be
+    /// used concurrently from different threads, e.g. each worker thread can clone
+    /// the view, or get its own sub-view via getView(), and read its own part of the data.
+    /// \return a new view, caller assumes ownership
+    /// \note it is safe to call this concurrently from multiple threads
+    virtual RawViewInterface *
+    clone() = 0;
+
     // ===-----------------------------------------------------------------------===
     // experimental APIs below, not yet finalized and definitely not yet implemented
     // Probably we'll only implement one of these, not all of them.
@@ -153,6 +191,14 @@ public:
     /// (however many fit into the buffer)
     ///
     /// I think I like this one the most.
+    ///
+    /// \param buffSize size of the buffer in bytes
+    /// \param func function invoked with a pointer to the pixels and the number
+    /// of pixels (not bytes) available, never more than buffSize / pixel size,
+    /// even when buff is nullptr
+    /// \param buff optional buffer, if nullptr the implementation is free to
+    /// supply its own (possibly internal) storage
+    /// \param traversal order of traversal
     virtual void
     forEach( int64_t buffSize,
              std::function < void (const char *, int64_t count) > func,
@@ -177,10 +223,14 @@ public:
     {
         Q_ASSERT( rawView != nullptr );
 
-        // figure out which converter to use
+        // figure out which converters to use
         m_converterFunc = getConverter < Type > ( rawView->pixelType() );
+        m_blockConverterFunc = getBlockConverter < Type > ( rawView->pixelType() );
     }
 
+    /// default number of elements converted at once by forEach()
+    static constexpr int64_t DefaultBlockSize = 4096;
+
     /// get the max. dimensions allowed in this accessor
     const VI &
     dims() {
@@ -196,19 +246,71 @@ public:
         return m_converterFunc( m_rawView->get( pos ) );
     }
 
-    /// equivalent to RawViewInterface::forEach but with a typed parameter
-    /// \param func function to invoke on each element
+    /// similar to RawViewInterface::forEach but with a typed parameter
+    /// \param func function (or any callable) to invoke on each element, as func( const Type & )
+    /// \param traversal order of traversal
+    /// \note This is implemented on top of the bulk forEach() below, so the callable is
+    /// inlined into the loop and the values are converted a block at a time. As a consequence
+    /// RawViewInterface::currentPos() is not updated, use the raw view if you need it.
+    template < typename Func >
+    void
+    forEach(
+        Func func,
+        RawViewInterface::Traversal traversal = RawViewInterface::Traversal::Sequential )
+    {
+        auto wrapper = [& func] ( const Type * vals, int64_t count )->void
+        {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                func( vals[i] );
+            }
+        };
+        forEach( DefaultBlockSize, wrapper, traversal );
+    }
+
+    /// bulk version of forEach(), the function is invoked with a block of
+    /// (at most blockSize) converted values at a time
+    /// \param blockSize maximum number of elements per invocation
+    /// \param func function (or any callable) to invoke on each block, as
+    /// func( const Type * values, int64_t count )
     /// \param traversal order of traversal
+    template < typename Func >
     void
     forEach(
-        std::function < void (const Type &) > func,
+        int64_t blockSize,
+        Func func,
         RawViewInterface::Traversal traversal = RawViewInterface::Traversal::Sequential )
     {
-        auto wrapper = [this, & func] ( const char * ptr )->void
+        blockSize = std::max < int64_t > ( blockSize, 1 );
+        auto srcType = m_rawView-> pixelType();
+        int64_t srcSize = Carta::Lib::Image::pixelType2size( srcType );
+
+        // no conversion needed, hand over the raw blocks directly
+        if ( srcType == Carta::Lib::Image::CType2PixelType < Type >::type ) {
+            auto wrapper = [& func, blockSize, srcSize] ( const char * ptr, int64_t count )->void {
+                // a raw view may serve more than blockSize pixels at a time (e.g. a whole
+                // tile), func still gets at most blockSize of them
+                for ( int64_t off = 0 ; off < count ; off += blockSize ) {
+                    func( reinterpret_cast < const Type * > ( ptr + off * srcSize ),
+                          std::min( blockSize, count - off ) );
+                }
+            };
+            m_rawView-> forEach( blockSize * srcSize, wrapper, nullptr, traversal );
+            return;
+        }
+
+        // otherwise convert each block in one go
+        std::vector < Type > typedBuff( blockSize );
+        auto cvt = m_blockConverterFunc;
+        auto wrapper = [cvt, & func, & typedBuff, blockSize, srcSize] ( const char * ptr, int64_t count )->void
         {
-            func( m_converterFunc( ptr ) );
+            // same here, and typedBuff only holds blockSize pixels
+            for ( int64_t off = 0 ; off < count ; off += blockSize ) {
+                int64_t n = std::min( blockSize, count - off );
+                cvt( ptr + off * srcSize, n, typedBuff.data() );
+                func( const_cast < const Type * > ( typedBuff.data() ), n );
+            }
         };
-        m_rawView->forEach( wrapper, traversal );
+        m_rawView-> forEach( blockSize * srcSize, wrapper, nullptr, traversal );
     }
 
     ~TypedView()
@@ -231,9 +333,12 @@ protected:
     /// are we keeping ownership of m_rawView
     bool m_keepOwnership;
 
-    /// classic c-style function pointer to the converter
-    /// \todo is this faster than std::function?
+    /// classic c-style function pointer to the converter, only used for get(), the
+    /// iteration goes through m_blockConverterFunc
     const Type & ( * m_converterFunc )(const char *);
+
+    /// converter for a whole block of elements
+    typename Type2BlockCvtFunc < Type >::Type m_blockConverterFunc;
 };
 
 /// convenience types
@@ -361,16 +466,19 @@ public:
     /// \brief get slice of data (a view into the data, to be precise)
     /// \param sliceInfo which slice to get
     /// \return a new view
-    /// \warning for efficiency reasons we are not doing shared pointers, etc... since the returned
-    /// view needs to have pointer to the instance of the image interface, the image interface
-    /// needs to remain valid while accessing the view! i.e. don't delete it
+    /// \note the returned view shares ownership of the image data, i.e. it remains
+    /// valid even if the image interface is deleted
+    /// \note views returned by this method can be used concurrently, as long as each
+    /// thread uses its own view (see RawViewInterface::clone())
     virtual NdArray::RawViewInterface *
     getDataSlice( const SliceND & sliceInfo ) = 0;
 
-    /// get the mask
-    /// \todo booleans as bytes is wasting resources, we should specialize
-    /// the NdArray::TypedView for bools
-    virtual NdArray::Byte *
+    /// get the mask for a slice of the data
+    /// \param sliceInfo which slice to get, same as for getDataSlice()
+    /// \return packed mask with the same dimensions (and order) as the view returned by
+    /// getDataSlice() for the same slice, or nullptr if the image has no mask.
+    /// Caller assumes ownership.
+    virtual NdArray::BitMask *
     getMaskSlice( const SliceND & sliceInfo) = 0;
 
     /// get the errors
@@ -382,6 +490,15 @@ public:
     /// the image
     virtual Image::MetaDataInterface::SharedPtr
     metaData() = 0;
+
+    /// name of the file holding exactly this image (same axes, same order), so that
+    /// plugins needing an image of their own library can open it themselves
+    /// \return empty string if there is no such file, e.g. for permuted images
+    virtual QString
+    fileName() const
+    {
+        return QString();
+    }
 };
 } // namespace Image
 
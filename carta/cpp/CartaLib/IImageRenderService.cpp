@@ -9,5 +9,29 @@ IImageRenderService::IImageRenderService( QObject * parent )
 { }
 
 IImageRenderService::~IImageRenderService() { }
+
+void
+IImageRenderService::setInputMask( NdArray::BitMask::SharedPtr mask )
+{
+    Q_UNUSED( mask );
+}
+
+void
+IImageRenderService::setNanColor( QColor color )
+{
+    Q_UNUSED( color );
+}
+
+QColor
+IImageRenderService::getNanColor() const
+{
+    return QColor( 255, 0, 0 );
+}
+
+void
+IImageRenderService::setDefaultNan( bool useDefaultNan )
+{
+    Q_UNUSED( useDefaultNan );
+}
 }
 }
@@ -5,6 +5,7 @@
 #include "CartaLib/PixelPipeline/IPixelPipeline.h"
 #include <QObject>
 #include <QImage>
+#include <QColor>
 
 namespace Carta
 {
@@ -27,7 +28,8 @@ public:
         /// size of the cache (in entries, must be >= 2
         int size = 1000;
 
-        /// whether caching is enabled or not
+        /// whether caching is enabled or not, without the cache the colors are exact,
+        /// i.e. the colormap is used for every pixel
         bool enabled = true;
 
         /// whether interpolation is enabled or not
@@ -67,6 +69,28 @@ public:
     QSize
     outputSize() const = 0;
 
+    /// \brief set the mask for the current input view, masked pixels are rendered
+    /// with the nan color
+    /// \param mask packed mask with the dimensions of the input view, or nullptr for no mask
+    /// \note setInputView() clears the mask, so this needs to be called after it; the
+    /// default implementation ignores the mask
+    virtual void
+    setInputMask( NdArray::BitMask::SharedPtr mask );
+
+    /// \brief set the color to use for nan (and masked) values
+    /// \note the color is ignored if the default nan color is used, see setDefaultNan();
+    /// the default implementation ignores the color
+    virtual void
+    setNanColor( QColor color );
+
+    /// return the color that will be used to draw nan values
+    virtual QColor
+    getNanColor() const;
+
+    /// set whether or not to use the default nan color (bottom of the color map)
+    virtual void
+    setDefaultNan( bool useDefaultNan );
+
     /// set coordinates of the data pixel to be centered in the generated
     /// image, in zero-based image coordinates, e.g. (0,0) is bottom left corner of pixel
     /// (0,0), while (1,1) is it's right-top corner, and (1/2,1/2) is it's center
@@ -93,7 +93,7 @@ qint64
 LayeredRemoteVGView::scheduleRepaint( qint64 id )
 {
     if ( id == - 1 ) {
-        id = m_repaintId++;
+        id = m_repaintId + 1;
     }
     m_repaintId = id;
     if ( ! m_timer-> isActive() ) {
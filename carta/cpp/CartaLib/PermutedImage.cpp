@@ -0,0 +1,752 @@
+#include "PermutedImage.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace Image
+{
+typedef std::vector < int64_t > VI64;
+
+/// number of pixels handed out at once by the pointwise forEach()
+static const int64_t BlockPixels = 4096;
+
+/// size of the chunks in which the original view is read when it has to be reordered
+static const int64_t ReorderChunkBytes = 4 * 1024 * 1024;
+
+/// max. size of a band of the original view held in memory for reordering (a single
+/// row that is larger than this is still read as a whole)
+static const int64_t MaxBandBytes = 256 * 1024 * 1024;
+
+/// translate a slice of the permuted array to a slice of the original array
+static SliceND
+toOriginalSlice( const SliceND & sliceInfo, const std::vector < int > & indices )
+{
+    // slice() is not const, it pads missing slices with [:], which is what we want
+    SliceND permuted = sliceInfo;
+    SliceND res;
+    for ( size_t i = 0 ; i < indices.size() ; ++i ) {
+        res.slice( indices[i] ) = permuted.slice( i );
+    }
+    return res;
+}
+
+/// strides (in elements) of a dense fortran-order array with the given dimensions
+static VI64
+denseStrides( const std::vector < int > & dims )
+{
+    VI64 res( dims.size() );
+    int64_t stride = 1;
+    for ( size_t i = 0 ; i < dims.size() ; ++i ) {
+        res[i] = stride;
+        stride *= std::max( dims[i], 1 );
+    }
+    return res;
+}
+
+/// gather pixels of the given size, they only need to be moved, not interpreted
+template < typename T >
+static void
+gatherPixels( const char * base, const NdArray::StridedLayout & layout,
+              int64_t first, int64_t count, char * dst )
+{
+    NdArray::gather( reinterpret_cast < const T * > ( base ), layout, first, count,
+                     reinterpret_cast < T * > ( dst ) );
+}
+
+/// copy pixels [first, first+count) of the layout (relative to src) into dst
+static void
+gatherRange( const char * src, const NdArray::StridedLayout & layout, int pixelSize,
+             int64_t first, int64_t count, char * dst )
+{
+    switch ( pixelSize )
+    {
+    case 1 :
+        return gatherPixels < uint8_t > ( src, layout, first, count, dst );
+    case 2 :
+        return gatherPixels < uint16_t > ( src, layout, first, count, dst );
+    case 4 :
+        return gatherPixels < uint32_t > ( src, layout, first, count, dst );
+    case 8 :
+        return gatherPixels < uint64_t > ( src, layout, first, count, dst );
+    default :
+        break;
+    }
+    NdArray::forEachRun( layout, first, count, [&] ( int64_t off, int64_t n, int64_t stride ) {
+                             for ( int64_t i = 0 ; i < n ; ++i ) {
+                                 std::memcpy( dst, src + ( off + i * stride ) * pixelSize,
+                                              pixelSize );
+                                 dst += pixelSize;
+                             }
+                         }
+                         );
+} // gatherRange
+
+// ===-----------------------------------------------------------------------===
+// PermutedCoordinateFormatter
+// ===-----------------------------------------------------------------------===
+
+PermutedCoordinateFormatter::PermutedCoordinateFormatter(
+    CoordinateFormatterInterface::SharedPtr cf,
+    const std::vector < int > & indices )
+{
+    m_cf = cf;
+    m_indices = indices;
+}
+
+template < typename V >
+V
+PermutedCoordinateFormatter::toOriginal( const V & vals ) const
+{
+    if ( vals.size() != m_indices.size() ) {
+        return vals;
+    }
+    V res( vals.size() );
+    for ( size_t i = 0 ; i < m_indices.size() ; ++i ) {
+        res[m_indices[i]] = vals[i];
+    }
+    return res;
+}
+
+template < typename V >
+V
+PermutedCoordinateFormatter::fromOriginal( const V & vals ) const
+{
+    if ( vals.size() != m_indices.size() ) {
+        return vals;
+    }
+    V res( vals.size() );
+    for ( size_t i = 0 ; i < m_indices.size() ; ++i ) {
+        res[i] = vals[m_indices[i]];
+    }
+    return res;
+}
+
+CoordinateFormatterInterface *
+PermutedCoordinateFormatter::clone() const
+{
+    return new PermutedCoordinateFormatter(
+               CoordinateFormatterInterface::SharedPtr( m_cf-> clone() ), m_indices );
+}
+
+int
+PermutedCoordinateFormatter::nAxes() const
+{
+    return m_cf-> nAxes();
+}
+
+QStringList
+PermutedCoordinateFormatter::formatFromPixelCoordinate( const VD & pix )
+{
+    QStringList list = m_cf-> formatFromPixelCoordinate( toOriginal( pix ) );
+    if ( list.size() != int ( m_indices.size() ) ) {
+        return list;
+    }
+    QStringList res;
+    for ( int ind : m_indices ) {
+        res.append( list[ind] );
+    }
+    return res;
+}
+
+QString
+PermutedCoordinateFormatter::calculateFormatDistance( const VD & p1, const VD & p2 )
+{
+    return m_cf-> calculateFormatDistance( toOriginal( p1 ), toOriginal( p2 ) );
+}
+
+void
+PermutedCoordinateFormatter::setTextOutputFormat( TextFormat fmt )
+{
+    m_cf-> setTextOutputFormat( fmt );
+}
+
+const AxisInfo &
+PermutedCoordinateFormatter::axisInfo( int ind ) const
+{
+    CARTA_ASSERT( ind >= 0 && ind < int ( m_indices.size() ) );
+    return m_cf-> axisInfo( m_indices[ind] );
+}
+
+PermutedCoordinateFormatter::Me &
+PermutedCoordinateFormatter::disableAxis( int ind )
+{
+    CARTA_ASSERT( ind >= 0 && ind < int ( m_indices.size() ) );
+    m_cf-> disableAxis( m_indices[ind] );
+    return * this;
+}
+
+PermutedCoordinateFormatter::Me &
+PermutedCoordinateFormatter::enableAxis( int ind )
+{
+    CARTA_ASSERT( ind >= 0 && ind < int ( m_indices.size() ) );
+    m_cf-> enableAxis( m_indices[ind] );
+    return * this;
+}
+
+KnownSkyCS
+PermutedCoordinateFormatter::skyCS()
+{
+    return m_cf-> skyCS();
+}
+
+PermutedCoordinateFormatter::Me &
+PermutedCoordinateFormatter::setSkyCS( const KnownSkyCS & scs )
+{
+    m_cf-> setSkyCS( scs );
+    return * this;
+}
+
+SkyFormatting
+PermutedCoordinateFormatter::skyFormatting()
+{
+    return m_cf-> skyFormatting();
+}
+
+PermutedCoordinateFormatter::Me &
+PermutedCoordinateFormatter::setSkyFormatting( SkyFormatting format )
+{
+    m_cf-> setSkyFormatting( format );
+    return * this;
+}
+
+int
+PermutedCoordinateFormatter::axisPrecision( int axis )
+{
+    CARTA_ASSERT( axis >= 0 && axis < int ( m_indices.size() ) );
+    return m_cf-> axisPrecision( m_indices[axis] );
+}
+
+PermutedCoordinateFormatter::Me &
+PermutedCoordinateFormatter::setAxisPrecision( int precision, int axis )
+{
+    if ( axis < 0 ) {
+        m_cf-> setAxisPrecision( precision, axis );
+    }
+    else {
+        CARTA_ASSERT( axis < int ( m_indices.size() ) );
+        m_cf-> setAxisPrecision( precision, m_indices[axis] );
+    }
+    return * this;
+}
+
+bool
+PermutedCoordinateFormatter::toWorld( const VD & pixel, VD & world ) const
+{
+    VD origWorld;
+    bool ok = m_cf-> toWorld( toOriginal( pixel ), origWorld );
+    world = fromOriginal( origWorld );
+    return ok;
+}
+
+bool
+PermutedCoordinateFormatter::toPixel( const VD & world, VD & pixel ) const
+{
+    VD origPixel;
+    bool ok = m_cf-> toPixel( toOriginal( world ), origPixel );
+    pixel = fromOriginal( origPixel );
+    return ok;
+}
+
+// ===-----------------------------------------------------------------------===
+// PermutedMetaData
+// ===-----------------------------------------------------------------------===
+
+PermutedMetaData::PermutedMetaData( MetaDataInterface::SharedPtr meta,
+                                    const std::vector < int > & indices )
+{
+    m_meta = meta;
+    m_indices = indices;
+    m_cf = std::make_shared < PermutedCoordinateFormatter > (
+        m_meta-> coordinateFormatter(), m_indices );
+}
+
+MetaDataInterface *
+PermutedMetaData::clone()
+{
+    return new PermutedMetaData( MetaDataInterface::SharedPtr( m_meta-> clone() ), m_indices );
+}
+
+CoordinateFormatterInterface::SharedPtr
+PermutedMetaData::coordinateFormatter()
+{
+    return m_cf;
+}
+
+PlotLabelGeneratorInterface::SharedPtr
+PermutedMetaData::plotLabelGenerator()
+{
+    return m_meta-> plotLabelGenerator();
+}
+
+QString
+PermutedMetaData::title( TextFormat format )
+{
+    return m_meta-> title( format );
+}
+
+QStringList
+PermutedMetaData::otherInfo( TextFormat format )
+{
+    return m_meta-> otherInfo( format );
+}
+
+// ===-----------------------------------------------------------------------===
+// PermutedRawView
+// ===-----------------------------------------------------------------------===
+
+PermutedRawView::PermutedRawView( NdArray::RawViewInterface * view,
+                                  const std::vector < int > & indices )
+    : PermutedRawView( view, indices, std::make_shared < Band > () )
+{ }
+
+PermutedRawView::PermutedRawView( NdArray::RawViewInterface * view,
+                                  const std::vector < int > & indices,
+                                  std::shared_ptr < Band > band )
+{
+    m_view.reset( view );
+    m_indices = indices;
+    m_band = band;
+    m_pixelSize = pixelType2size( m_view-> pixelType() );
+
+    const VI & origDims = m_view-> dims();
+    CARTA_ASSERT( origDims.size() == m_indices.size() );
+    size_t ndim = m_indices.size();
+    m_dims.resize( ndim );
+    m_currPos.resize( ndim, 0 );
+    m_origPos.resize( ndim, 0 );
+
+    // where our pixels are in the sequential order of the original view
+    VI64 origStrides = denseStrides( origDims );
+    VI64 layoutDims( ndim ), layoutStrides( ndim );
+    for ( size_t i = 0 ; i < ndim ; ++i ) {
+        m_dims[i] = origDims[m_indices[i]];
+        layoutDims[i] = std::max( m_dims[i], 1 );
+        layoutStrides[i] = origStrides[m_indices[i]];
+    }
+    m_layout = NdArray::StridedLayout( layoutDims, layoutStrides );
+
+    // if the axes that actually have more than one pixel kept their order, the pixels
+    // come out of the original view in our order already
+    m_passThrough = m_layout.isContiguous();
+    if ( m_passThrough ) {
+        return;
+    }
+
+    // if the original view is addressable, we can permute its strides instead
+    m_span = m_view-> stridedSpan();
+    if ( m_span.isSet() ) {
+        const auto & spanStrides = m_span.val().strides;
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            layoutStrides[i] = spanStrides[m_indices[i]] / m_pixelSize;
+        }
+        m_layout = NdArray::StridedLayout( layoutDims, layoutStrides );
+        return;
+    }
+
+    // otherwise we read it in bands along our slowest axis, all axes after it have
+    // a single pixel, so each band is a contiguous range of our pixels
+    m_rowAxis = ndim - 1;
+    while ( m_rowAxis > 0 && layoutDims[m_rowAxis] == 1 ) {
+        m_rowAxis--;
+    }
+    m_rowPixels = 1;
+    for ( int i = 0 ; i < m_rowAxis ; ++i ) {
+        m_rowPixels *= layoutDims[i];
+    }
+    m_nRows = layoutDims[m_rowAxis];
+    m_bandRows = Carta::Lib::clamp < int64_t > ( MaxBandBytes / ( m_rowPixels * m_pixelSize ),
+                                                 1, m_nRows );
+}
+
+PermutedRawView::PixelType
+PermutedRawView::pixelType()
+{
+    return m_view-> pixelType();
+}
+
+const PermutedRawView::VI &
+PermutedRawView::dims()
+{
+    return m_dims;
+}
+
+Nullable < PermutedRawView::StridedSpan >
+PermutedRawView::stridedSpan()
+{
+    Nullable < StridedSpan > origSpan = m_view-> stridedSpan();
+    if ( origSpan.isNull() ) {
+        return origSpan;
+    }
+    StridedSpan span = origSpan.val();
+    for ( size_t i = 0 ; i < m_indices.size() ; ++i ) {
+        span.strides[i] = origSpan.val().strides[m_indices[i]];
+    }
+    return span;
+}
+
+const char *
+PermutedRawView::get( const VI & pos )
+{
+    for ( size_t i = 0 ; i < m_indices.size() && i < pos.size() ; ++i ) {
+        m_origPos[m_indices[i]] = pos[i];
+    }
+    return m_view-> get( m_origPos );
+}
+
+void
+PermutedRawView::forEach( std::function < void (const char *) > func, Traversal traversal )
+{
+    // hand out blocks of pixels one by one, keeping track of the position
+    std::fill( m_currPos.begin(), m_currPos.end(), 0 );
+    forEach(
+        BlockPixels * m_pixelSize,
+        [&] ( const char * data, int64_t count ) {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                func( data + i * m_pixelSize );
+                for ( size_t d = 0 ; d < m_currPos.size() ; ++d ) {
+                    if ( ++m_currPos[d] < m_dims[d] ) {
+                        break;
+                    }
+                    m_currPos[d] = 0;
+                }
+            }
+        },
+        nullptr,
+        traversal );
+}
+
+const PermutedRawView::VI &
+PermutedRawView::currentPos()
+{
+    return m_currPos;
+}
+
+NdArray::RawViewInterface *
+PermutedRawView::getView( const SliceND & sliceInfo )
+{
+    return new PermutedRawView( m_view-> getView( toOriginalSlice( sliceInfo, m_indices ) ),
+                                m_indices );
+}
+
+NdArray::RawViewInterface *
+PermutedRawView::clone()
+{
+    // a band holding the whole view never changes, so it can be shared, but clones
+    // reading in several bands would only keep evicting each other's
+    if ( m_bandRows >= m_nRows ) {
+        return new PermutedRawView( m_view-> clone(), m_indices, m_band );
+    }
+    return new PermutedRawView( m_view-> clone(), m_indices );
+}
+
+int64_t
+PermutedRawView::read( int64_t buffSize, char * buff, Traversal traversal )
+{
+    if ( m_passThrough ) {
+        return m_view-> read( buffSize, buff, Traversal::Sequential );
+    }
+    Q_UNUSED( traversal );
+    int64_t count = std::min < int64_t > ( buffSize / m_pixelSize, nPixels() - m_readPos );
+    if ( count <= 0 ) {
+        return 0;
+    }
+    readRange( m_readPos, count, buff );
+    m_readPos += count;
+    return count * m_pixelSize;
+}
+
+void
+PermutedRawView::seek( int64_t ind )
+{
+    if ( m_passThrough ) {
+        m_view-> seek( ind );
+        return;
+    }
+    m_readPos = Carta::Lib::clamp < int64_t > ( ind / m_pixelSize, 0, nPixels() );
+}
+
+int64_t
+PermutedRawView::read( int64_t chunk, int64_t buffSize, char * buff, Traversal traversal )
+{
+    if ( m_passThrough ) {
+        return m_view-> read( chunk, buffSize, buff, Traversal::Sequential );
+    }
+    Q_UNUSED( traversal );
+    int64_t chunkPixels = buffSize / m_pixelSize;
+    if ( chunkPixels <= 0 || chunk < 0 ) {
+        return 0;
+    }
+    int64_t first = chunk * chunkPixels;
+    int64_t count = std::min < int64_t > ( chunkPixels, nPixels() - first );
+    if ( count <= 0 ) {
+        return 0;
+    }
+    readRange( first, count, buff );
+    return count * m_pixelSize;
+}
+
+void
+PermutedRawView::forEach( int64_t buffSize,
+                          std::function < void (const char *, int64_t) > func,
+                          char * buff,
+                          Traversal traversal )
+{
+    // our sequential order has to be preserved, so the original view is always
+    // traversed sequentially
+    Q_UNUSED( traversal );
+    if ( m_passThrough ) {
+        m_view-> forEach( buffSize, func, buff, Traversal::Sequential );
+        return;
+    }
+    int64_t chunkPixels = std::max < int64_t > ( 1, buffSize / m_pixelSize );
+    std::vector < char > ownBuff;
+    if ( ! buff ) {
+        ownBuff.resize( chunkPixels * m_pixelSize );
+        buff = ownBuff.data();
+    }
+    int64_t total = nPixels();
+    for ( int64_t first = 0 ; first < total ; first += chunkPixels ) {
+        int64_t count = std::min( chunkPixels, total - first );
+        readRange( first, count, buff );
+        func( buff, count );
+    }
+} // forEach
+
+const char *
+PermutedRawView::band( int64_t row, int64_t & firstRow, int64_t & rows )
+{
+    std::lock_guard < std::mutex > lock( m_band-> mutex );
+    Band & band = * m_band;
+    if ( band.rows == 0 || row < band.firstRow || row >= band.firstRow + band.rows ) {
+        band.firstRow = row / m_bandRows * m_bandRows;
+        band.rows = std::min( m_bandRows, m_nRows - band.firstRow );
+
+        // read the band through a view of the original, in large chunks, so that the
+        // original image can serve it in whatever way is efficient for it (e.g. tile by tile)
+        std::unique_ptr < NdArray::RawViewInterface > bandView;
+        NdArray::RawViewInterface * src = m_view.get();
+        if ( band.rows < m_nRows ) {
+            SliceND slice;
+            for ( size_t i = 0 ; i < m_indices.size() ; ++i ) {
+                slice.slice( i ) = Slice1D();
+            }
+            slice.slice( m_indices[m_rowAxis] ) =
+                Slice1D().start( band.firstRow ).end( band.firstRow + band.rows );
+            bandView.reset( m_view-> getView( slice ) );
+            CARTA_ASSERT( bandView );
+            src = bandView.get();
+        }
+        band.data.resize( band.rows * m_rowPixels * m_pixelSize );
+        char * dst = band.data.data();
+        src-> forEach(
+            ReorderChunkBytes,
+            [&dst, this] ( const char * ptr, int64_t count ) {
+                std::memcpy( dst, ptr, count * m_pixelSize );
+                dst += count * m_pixelSize;
+            },
+            nullptr,
+            Traversal::Sequential );
+        CARTA_ASSERT( dst == band.data.data() + band.data.size() );
+    }
+    firstRow = band.firstRow;
+    rows = band.rows;
+    return band.data.data();
+} // band
+
+NdArray::StridedLayout
+PermutedRawView::bandLayout( int64_t rows ) const
+{
+    // the band is the original view with fewer pixels along our row axis
+    VI origDims = m_view-> dims();
+    origDims[m_indices[m_rowAxis]] = rows;
+    VI64 origStrides = denseStrides( origDims );
+    size_t ndim = m_indices.size();
+    VI64 layoutDims( ndim ), layoutStrides( ndim );
+    for ( size_t i = 0 ; i < ndim ; ++i ) {
+        layoutDims[i] = std::max( origDims[m_indices[i]], 1 );
+        layoutStrides[i] = origStrides[m_indices[i]];
+    }
+    return NdArray::StridedLayout( layoutDims, layoutStrides );
+}
+
+void
+PermutedRawView::readRange( int64_t first, int64_t count, char * dst )
+{
+    if ( m_span.isSet() ) {
+        gatherRange( m_span.val().data, m_layout, m_pixelSize, first, count, dst );
+        return;
+    }
+    while ( count > 0 ) {
+        int64_t firstRow, rows;
+        const char * src = band( first / m_rowPixels, firstRow, rows );
+        int64_t bandFirst = firstRow * m_rowPixels;
+        int64_t n = std::min( count, bandFirst + rows * m_rowPixels - first );
+        gatherRange( src, bandLayout( rows ), m_pixelSize, first - bandFirst, n, dst );
+        first += n;
+        count -= n;
+        dst += n * m_pixelSize;
+    }
+} // readRange
+
+// ===-----------------------------------------------------------------------===
+// PermutedImage
+// ===-----------------------------------------------------------------------===
+
+ImageInterface::SharedPtr
+PermutedImage::permute( ImageInterface::SharedPtr image, const std::vector < int > & indices )
+{
+    // make sure the indices are a permutation of the image axes
+    int ndim = image-> dims().size();
+    CARTA_ASSERT( int ( indices.size() ) == ndim );
+    std::vector < bool > used( ndim, false );
+    for ( int ind : indices ) {
+        CARTA_ASSERT( ind >= 0 && ind < ndim && ! used[ind] );
+        used[ind] = true;
+    }
+
+    // compose with an existing permutation, so that we never stack wrappers
+    std::vector < int > newIndices = indices;
+    PermutedImage::SharedPtr permuted = std::dynamic_pointer_cast < PermutedImage > ( image );
+    if ( permuted ) {
+        for ( int i = 0 ; i < ndim ; ++i ) {
+            newIndices[i] = permuted-> m_indices[indices[i]];
+        }
+        image = permuted-> m_image;
+    }
+
+    bool identity = true;
+    for ( int i = 0 ; i < ndim ; ++i ) {
+        identity = identity && newIndices[i] == i;
+    }
+    if ( identity ) {
+        return image;
+    }
+    return std::make_shared < PermutedImage > ( image, newIndices );
+} // permute
+
+PermutedImage::PermutedImage( ImageInterface::SharedPtr image,
+                              const std::vector < int > & indices )
+{
+    m_image = image;
+    m_indices = indices;
+    for ( int ind : m_indices ) {
+        m_dims.push_back( m_image-> dims()[ind] );
+    }
+    MetaDataInterface::SharedPtr meta = m_image-> metaData();
+    if ( meta ) {
+        m_meta = std::make_shared < PermutedMetaData > ( meta, m_indices );
+    }
+}
+
+const Unit &
+PermutedImage::getPixelUnit() const
+{
+    return m_image-> getPixelUnit();
+}
+
+std::shared_ptr < ImageInterface >
+PermutedImage::getPermuted( const std::vector < int > & indices )
+{
+    return permute( shared_from_this(), indices );
+}
+
+const PermutedImage::VI &
+PermutedImage::dims() const
+{
+    return m_dims;
+}
+
+bool
+PermutedImage::hasMask() const
+{
+    return m_image-> hasMask();
+}
+
+bool
+PermutedImage::hasErrorsInfo() const
+{
+    return m_image-> hasErrorsInfo();
+}
+
+PermutedImage::PixelType
+PermutedImage::pixelType() const
+{
+    return m_image-> pixelType();
+}
+
+PermutedImage::PixelType
+PermutedImage::errorType() const
+{
+    return m_image-> errorType();
+}
+
+NdArray::RawViewInterface *
+PermutedImage::getDataSlice( const SliceND & sliceInfo )
+{
+    NdArray::RawViewInterface * view = m_image-> getDataSlice( toOriginal( sliceInfo ) );
+    if ( ! view ) {
+        return nullptr;
+    }
+    return new PermutedRawView( view, m_indices );
+}
+
+NdArray::BitMask *
+PermutedImage::getMaskSlice( const SliceND & sliceInfo )
+{
+    std::unique_ptr < NdArray::BitMask > origMask(
+        m_image-> getMaskSlice( toOriginal( sliceInfo ) ) );
+    if ( ! origMask ) {
+        return nullptr;
+    }
+
+    // the mask is only as large as the view, so it's simply reordered bit by bit
+    const VI & origDims = origMask-> dims();
+    VI64 origStrides = denseStrides( origDims );
+    VI dims( m_indices.size() );
+    VI64 layoutDims( m_indices.size() ), layoutStrides( m_indices.size() );
+    for ( size_t i = 0 ; i < m_indices.size() ; ++i ) {
+        dims[i] = origDims[m_indices[i]];
+        layoutDims[i] = std::max( dims[i], 1 );
+        layoutStrides[i] = origStrides[m_indices[i]];
+    }
+    NdArray::StridedLayout layout( layoutDims, layoutStrides );
+    auto mask = new NdArray::BitMask( dims, false );
+    int64_t dst = 0;
+    NdArray::forEachRun( layout, [&] ( int64_t off, int64_t n, int64_t stride ) {
+                             for ( int64_t i = 0 ; i < n ; ++i, ++dst ) {
+                                 if ( origMask-> isValid( off + i * stride ) ) {
+                                     mask-> set( dst, true );
+                                 }
+                             }
+                         }
+                         );
+    return mask;
+} // getMaskSlice
+
+NdArray::RawViewInterface *
+PermutedImage::getErrorSlice( const SliceND & sliceInfo )
+{
+    NdArray::RawViewInterface * view = m_image-> getErrorSlice( toOriginal( sliceInfo ) );
+    if ( ! view ) {
+        return nullptr;
+    }
+    return new PermutedRawView( view, m_indices );
+}
+
+MetaDataInterface::SharedPtr
+PermutedImage::metaData()
+{
+    return m_meta;
+}
+
+SliceND
+PermutedImage::toOriginal( const SliceND & sliceInfo ) const
+{
+    return toOriginalSlice( sliceInfo, m_indices );
+}
+}
+}
+}
@@ -0,0 +1,326 @@
+/**
+ * Lazy axis permutation of images.
+ *
+ * PermutedImage presents another image with its axes reordered, without making a
+ * permuted copy of the image. Slices requested from the permuted image are translated to
+ * slices of the original image, and the views returned by the original image are wrapped
+ * so that they report their pixels in the permuted order:
+ *
+ *   - if the permutation does not change the order of the pixels in the view (e.g. the
+ *     view is a single plane and its two axes keep their relative order), all reads are
+ *     simply forwarded to the original view
+ *   - if the original view is directly addressable (stridedSpan()), its strides are
+ *     permuted, so the data is still served zero-copy
+ *   - otherwise the view (not the image!) is read in bands, i.e. ranges along its slowest
+ *     axis, of at most MaxBandBytes. Each band is read through the original view's bulk
+ *     accessors (i.e. in whatever order is fast for the image), into a buffer the pixels
+ *     are then gathered from in the permuted order. Views that fit into a single band are
+ *     read only once, and the band is shared by their clones.
+ *
+ * Coordinates are remapped the same way, by wrapping the coordinate formatter.
+ **/
+
+#pragma once
+
+#include "CartaLib/IImage.h"
+#include "CartaLib/StridedIterator.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace Image
+{
+/// coordinate formatter for an image with permuted axes
+class PermutedCoordinateFormatter : public CoordinateFormatterInterface
+{
+    CLASS_BOILERPLATE( PermutedCoordinateFormatter );
+
+public:
+
+    /// \param cf formatter of the original image
+    /// \param indices axis i of the permuted image is axis indices[i] of the original
+    PermutedCoordinateFormatter( CoordinateFormatterInterface::SharedPtr cf,
+                                 const std::vector < int > & indices );
+
+    virtual CoordinateFormatterInterface *
+    clone() const override;
+
+    virtual int
+    nAxes() const override;
+
+    virtual QStringList
+    formatFromPixelCoordinate( const VD & pix ) override;
+
+    virtual QString
+    calculateFormatDistance( const VD & p1, const VD & p2 ) override;
+
+    virtual void
+    setTextOutputFormat( TextFormat fmt ) override;
+
+    virtual const AxisInfo &
+    axisInfo( int ind ) const override;
+
+    virtual Me &
+    disableAxis( int ind ) override;
+
+    virtual Me &
+    enableAxis( int ind ) override;
+
+    virtual KnownSkyCS
+    skyCS() override;
+
+    virtual Me &
+    setSkyCS( const KnownSkyCS & scs ) override;
+
+    virtual SkyFormatting
+    skyFormatting() override;
+
+    virtual Me &
+    setSkyFormatting( SkyFormatting format ) override;
+
+    virtual int
+    axisPrecision( int axis ) override;
+
+    virtual Me &
+    setAxisPrecision( int precision, int axis = - 1 ) override;
+
+    virtual bool
+    toWorld( const VD & pixel, VD & world ) const override;
+
+    virtual bool
+    toPixel( const VD & world, VD & pixel ) const override;
+
+private:
+
+    /// permuted -> original order (vectors of other lengths are passed through)
+    template < typename V >
+    V
+    toOriginal( const V & vals ) const;
+
+    /// original -> permuted order (vectors of other lengths are passed through)
+    template < typename V >
+    V
+    fromOriginal( const V & vals ) const;
+
+    CoordinateFormatterInterface::SharedPtr m_cf;
+    std::vector < int > m_indices;
+};
+
+/// meta data for an image with permuted axes
+class PermutedMetaData : public MetaDataInterface
+{
+    CLASS_BOILERPLATE( PermutedMetaData );
+
+public:
+
+    PermutedMetaData( MetaDataInterface::SharedPtr meta, const std::vector < int > & indices );
+
+    virtual MetaDataInterface *
+    clone() override;
+
+    virtual CoordinateFormatterInterface::SharedPtr
+    coordinateFormatter() override;
+
+    virtual PlotLabelGeneratorInterface::SharedPtr
+    plotLabelGenerator() override;
+
+    virtual QString
+    title( TextFormat format = TextFormat::Plain ) override;
+
+    virtual QStringList
+    otherInfo( TextFormat format = TextFormat::Plain ) override;
+
+private:
+
+    MetaDataInterface::SharedPtr m_meta;
+    std::vector < int > m_indices;
+    CoordinateFormatterInterface::SharedPtr m_cf;
+};
+
+/// view with permuted axes, wrapping a view of the original image
+class PermutedRawView : public NdArray::RawViewInterface
+{
+    CLASS_BOILERPLATE( PermutedRawView );
+
+public:
+
+    /// \param view view of the original image, we assume ownership
+    /// \param indices axis i of this view is axis indices[i] of the original view
+    PermutedRawView( NdArray::RawViewInterface * view, const std::vector < int > & indices );
+
+    virtual PixelType
+    pixelType() override;
+
+    virtual const VI &
+    dims() override;
+
+    virtual Nullable < StridedSpan >
+    stridedSpan() override;
+
+    virtual const char *
+    get( const VI & pos ) override;
+
+    virtual void
+    forEach( std::function < void (const char *) > func,
+             Traversal traversal = Traversal::Sequential ) override;
+
+    virtual const VI &
+    currentPos() override;
+
+    virtual NdArray::RawViewInterface *
+    getView( const SliceND & sliceInfo ) override;
+
+    virtual NdArray::RawViewInterface *
+    clone() override;
+
+    virtual int64_t
+    read( int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    virtual void
+    seek( int64_t ind = 0 ) override;
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    virtual void
+    forEach( int64_t buffSize,
+             std::function < void (const char *, int64_t count) > func,
+             char * buff = nullptr,
+             Traversal traversal = Traversal::Sequential ) override;
+
+private:
+
+    /// pixels of a band of rows [firstRow, firstRow + rows) of the original view, in its
+    /// sequential order, read on demand
+    struct Band
+    {
+        std::mutex mutex;
+        int64_t firstRow = 0;
+        int64_t rows = 0;
+        std::vector < char > data;
+    };
+
+    PermutedRawView( NdArray::RawViewInterface * view,
+                     const std::vector < int > & indices,
+                     std::shared_ptr < Band > band );
+
+    /// \brief make sure the band containing the given row is read in
+    /// \param row index along our slowest axis
+    /// \param firstRow set to the first row of the band
+    /// \param rows set to the number of rows in the band
+    /// \return address of the band's pixels
+    const char *
+    band( int64_t row, int64_t & firstRow, int64_t & rows );
+
+    /// layout of our pixels in a band with the given number of rows, relative to the band
+    NdArray::StridedLayout
+    bandLayout( int64_t rows ) const;
+
+    /// total number of pixels
+    int64_t
+    nPixels() const { return m_layout.size(); }
+
+    /// copy pixels [first, first+count) (in our sequential order) into dst
+    void
+    readRange( int64_t first, int64_t count, char * dst );
+
+    std::unique_ptr < NdArray::RawViewInterface > m_view;
+    std::vector < int > m_indices;
+    VI m_dims;
+
+    /// if true, the permutation does not change the order of pixels, and everything
+    /// is forwarded to m_view
+    bool m_passThrough = false;
+
+    /// zero-copy access to the original view, if it supports it
+    Nullable < StridedSpan > m_span;
+
+    /// our pixels, relative to the original view's span (in pixels)
+    NdArray::StridedLayout m_layout;
+    int m_pixelSize = 0;
+
+    /// our slowest axis with more than one pixel, the view is read in bands along it
+    int m_rowAxis = 0;
+
+    /// number of pixels in one row, i.e. in one step along m_rowAxis
+    int64_t m_rowPixels = 1;
+
+    /// total number of rows, and max. number of rows in a band
+    int64_t m_nRows = 1, m_bandRows = 1;
+
+    std::shared_ptr < Band > m_band;
+    VI m_currPos, m_origPos;
+    int64_t m_readPos = 0;
+};
+
+/// Image with permuted axes, see the description at the top of this file.
+class PermutedImage
+    : public ImageInterface
+      , public std::enable_shared_from_this < PermutedImage >
+{
+    CLASS_BOILERPLATE( PermutedImage );
+
+public:
+
+    /// \brief permute the axes of an image, see ImageInterface::getPermuted()
+    /// \details Permutations of permuted images are composed, so the result always
+    /// wraps the original image directly. The identity permutation returns the image.
+    static ImageInterface::SharedPtr
+    permute( ImageInterface::SharedPtr image, const std::vector < int > & indices );
+
+    virtual const Unit &
+    getPixelUnit() const override;
+
+    virtual std::shared_ptr < ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override;
+
+    virtual bool
+    hasMask() const override;
+
+    virtual bool
+    hasErrorsInfo() const override;
+
+    virtual PixelType
+    pixelType() const override;
+
+    virtual PixelType
+    errorType() const override;
+
+    virtual NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    virtual NdArray::BitMask *
+    getMaskSlice( const SliceND & sliceInfo ) override;
+
+    virtual NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override;
+
+    virtual MetaDataInterface::SharedPtr
+    metaData() override;
+
+    /// do not use this, use permute() instead
+    PermutedImage( ImageInterface::SharedPtr image, const std::vector < int > & indices );
+
+private:
+
+    /// translate a slice of this image to a slice of the original image
+    SliceND
+    toOriginal( const SliceND & sliceInfo ) const;
+
+    ImageInterface::SharedPtr m_image;
+    std::vector < int > m_indices;
+    VI m_dims;
+    MetaDataInterface::SharedPtr m_meta;
+};
+}
+}
+}
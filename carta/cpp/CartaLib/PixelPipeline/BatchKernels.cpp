@@ -0,0 +1,312 @@
+/**
+ *
+ **/
+
+#include "BatchKernels.h"
+#include <algorithm>
+#include <cmath>
+
+// the SIMD versions are compiled for their instruction sets regardless of the compiler
+// flags, and only used if the CPU has them
+#if defined( __GNUC__ ) && defined( __x86_64__ )
+#define CARTA_BATCH_X86 1
+#include <immintrin.h>
+#else
+#define CARTA_BATCH_X86 0
+#endif
+
+namespace Carta
+{
+namespace Lib
+{
+namespace PixelPipeline
+{
+namespace Batch
+{
+/// instruction sets we have kernels for
+enum class Isa
+{
+    Scalar,
+    Sse41,
+    Avx2
+};
+
+static Isa
+detectIsa()
+{
+#if CARTA_BATCH_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        return Isa::Avx2;
+    }
+    if ( __builtin_cpu_supports( "sse4.1" ) ) {
+        return Isa::Sse41;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+static Isa
+isa()
+{
+    static const Isa result = detectIsa();
+    return result;
+}
+
+// ===-------------------------------------------------------------------------===
+// scalar kernels, also used for the tails of the SIMD ones
+// ===-------------------------------------------------------------------------===
+
+template < typename T >
+static void
+nearestScalar( const T * vals, int64_t count, double min, double scale, int32_t n,
+               int32_t * indices )
+{
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        double val = vals[i];
+
+        // the order of min/max makes NaNs end up as 0, so that the conversion is safe
+        double d = std::floor( ( val - min ) * scale + 0.5 );
+        d = std::max( 0.0, std::min( d, double ( n ) ) );
+        indices[i] = std::isnan( val ) ? - 1 : int32_t( d );
+    }
+}
+
+template < typename T >
+static void
+linearScalar( const T * vals, int64_t count, double min, double scale, int32_t n,
+              int32_t * indices, double * fracs )
+{
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        double val = vals[i];
+        double d = std::max( 0.0, std::min( ( val - min ) * scale, double ( n ) ) );
+        double fl = std::min( std::floor( d ), double ( n - 1 ) );
+        indices[i] = std::isnan( val ) ? - 1 : int32_t( fl );
+        fracs[i] = d - fl;
+    }
+}
+
+#if CARTA_BATCH_X86
+
+// ===-------------------------------------------------------------------------===
+// SSE4.1 kernels, 2 values at a time
+// ===-------------------------------------------------------------------------===
+
+static inline __m128d
+load2( const double * p ) { return _mm_loadu_pd( p ); }
+
+static inline __m128d
+load2( const float * p )
+{
+    return _mm_cvtps_pd( _mm_castpd_ps( _mm_load_sd( reinterpret_cast < const double * > ( p ) ) ) );
+}
+
+/// 32 bit masks of the NaN lanes, to be or-ed with the indices
+static inline __m128i
+nanMask2( __m128d v )
+{
+    return _mm_shuffle_epi32( _mm_castpd_si128( _mm_cmpunord_pd( v, v ) ), _MM_SHUFFLE( 3, 3, 2, 0 ) );
+}
+
+template < typename T >
+__attribute__ ( ( target( "sse4.1" ) ) )
+static void
+nearestSse41( const T * vals, int64_t count, double min, double scale, int32_t n,
+              int32_t * indices )
+{
+    const __m128d vmin = _mm_set1_pd( min );
+    const __m128d vscale = _mm_set1_pd( scale );
+    const __m128d half = _mm_set1_pd( 0.5 );
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d vn = _mm_set1_pd( n );
+    int64_t i = 0;
+    for ( ; i + 2 <= count ; i += 2 ) {
+        __m128d v = load2( vals + i );
+        __m128d d = _mm_floor_pd( _mm_add_pd( _mm_mul_pd( _mm_sub_pd( v, vmin ), vscale ), half ) );
+        d = _mm_max_pd( _mm_min_pd( d, vn ), zero );
+        __m128i ind = _mm_or_si128( _mm_cvttpd_epi32( d ), nanMask2( v ) );
+        _mm_storel_epi64( reinterpret_cast < __m128i * > ( indices + i ), ind );
+    }
+    nearestScalar( vals + i, count - i, min, scale, n, indices + i );
+}
+
+template < typename T >
+__attribute__ ( ( target( "sse4.1" ) ) )
+static void
+linearSse41( const T * vals, int64_t count, double min, double scale, int32_t n,
+             int32_t * indices, double * fracs )
+{
+    const __m128d vmin = _mm_set1_pd( min );
+    const __m128d vscale = _mm_set1_pd( scale );
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d vn = _mm_set1_pd( n );
+    const __m128d vn1 = _mm_set1_pd( n - 1 );
+    int64_t i = 0;
+    for ( ; i + 2 <= count ; i += 2 ) {
+        __m128d v = load2( vals + i );
+        __m128d d = _mm_mul_pd( _mm_sub_pd( v, vmin ), vscale );
+        d = _mm_max_pd( _mm_min_pd( d, vn ), zero );
+        __m128d fl = _mm_min_pd( _mm_floor_pd( d ), vn1 );
+        __m128i ind = _mm_or_si128( _mm_cvttpd_epi32( fl ), nanMask2( v ) );
+        _mm_storel_epi64( reinterpret_cast < __m128i * > ( indices + i ), ind );
+        _mm_storeu_pd( fracs + i, _mm_sub_pd( d, fl ) );
+    }
+    linearScalar( vals + i, count - i, min, scale, n, indices + i, fracs + i );
+}
+
+// ===-------------------------------------------------------------------------===
+// AVX2 kernels, 4 values at a time
+// ===-------------------------------------------------------------------------===
+
+__attribute__ ( ( target( "avx2" ) ) )
+static inline __m256d
+load4( const double * p ) { return _mm256_loadu_pd( p ); }
+
+__attribute__ ( ( target( "avx2" ) ) )
+static inline __m256d
+load4( const float * p ) { return _mm256_cvtps_pd( _mm_loadu_ps( p ) ); }
+
+__attribute__ ( ( target( "avx2" ) ) )
+static inline __m128i
+nanMask4( __m256d v )
+{
+    __m256i mask = _mm256_castpd_si256( _mm256_cmp_pd( v, v, _CMP_UNORD_Q ) );
+    mask = _mm256_permutevar8x32_epi32( mask, _mm256_setr_epi32( 0, 2, 4, 6, 0, 2, 4, 6 ) );
+    return _mm256_castsi256_si128( mask );
+}
+
+template < typename T >
+__attribute__ ( ( target( "avx2" ) ) )
+static void
+nearestAvx2( const T * vals, int64_t count, double min, double scale, int32_t n,
+             int32_t * indices )
+{
+    const __m256d vmin = _mm256_set1_pd( min );
+    const __m256d vscale = _mm256_set1_pd( scale );
+    const __m256d half = _mm256_set1_pd( 0.5 );
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d vn = _mm256_set1_pd( n );
+    int64_t i = 0;
+    for ( ; i + 4 <= count ; i += 4 ) {
+        __m256d v = load4( vals + i );
+        __m256d d = _mm256_floor_pd(
+            _mm256_add_pd( _mm256_mul_pd( _mm256_sub_pd( v, vmin ), vscale ), half ) );
+        d = _mm256_max_pd( _mm256_min_pd( d, vn ), zero );
+        __m128i ind = _mm_or_si128( _mm256_cvttpd_epi32( d ), nanMask4( v ) );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( indices + i ), ind );
+    }
+    nearestScalar( vals + i, count - i, min, scale, n, indices + i );
+}
+
+template < typename T >
+__attribute__ ( ( target( "avx2" ) ) )
+static void
+linearAvx2( const T * vals, int64_t count, double min, double scale, int32_t n,
+            int32_t * indices, double * fracs )
+{
+    const __m256d vmin = _mm256_set1_pd( min );
+    const __m256d vscale = _mm256_set1_pd( scale );
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d vn = _mm256_set1_pd( n );
+    const __m256d vn1 = _mm256_set1_pd( n - 1 );
+    int64_t i = 0;
+    for ( ; i + 4 <= count ; i += 4 ) {
+        __m256d v = load4( vals + i );
+        __m256d d = _mm256_mul_pd( _mm256_sub_pd( v, vmin ), vscale );
+        d = _mm256_max_pd( _mm256_min_pd( d, vn ), zero );
+        __m256d fl = _mm256_min_pd( _mm256_floor_pd( d ), vn1 );
+        __m128i ind = _mm_or_si128( _mm256_cvttpd_epi32( fl ), nanMask4( v ) );
+        _mm_storeu_si128( reinterpret_cast < __m128i * > ( indices + i ), ind );
+        _mm256_storeu_pd( fracs + i, _mm256_sub_pd( d, fl ) );
+    }
+    linearScalar( vals + i, count - i, min, scale, n, indices + i, fracs + i );
+}
+
+#endif // CARTA_BATCH_X86
+
+// ===-------------------------------------------------------------------------===
+// dispatch
+// ===-------------------------------------------------------------------------===
+
+template < typename T >
+static void
+nearest( const T * vals, int64_t count, double min, double scale, int32_t n,
+         int32_t * indices )
+{
+    switch ( isa() ) {
+#if CARTA_BATCH_X86
+    case Isa::Avx2:
+        nearestAvx2( vals, count, min, scale, n, indices );
+        break;
+    case Isa::Sse41:
+        nearestSse41( vals, count, min, scale, n, indices );
+        break;
+#endif
+    default:
+        nearestScalar( vals, count, min, scale, n, indices );
+    }
+}
+
+template < typename T >
+static void
+linear( const T * vals, int64_t count, double min, double scale, int32_t n,
+        int32_t * indices, double * fracs )
+{
+    switch ( isa() ) {
+#if CARTA_BATCH_X86
+    case Isa::Avx2:
+        linearAvx2( vals, count, min, scale, n, indices, fracs );
+        break;
+    case Isa::Sse41:
+        linearSse41( vals, count, min, scale, n, indices, fracs );
+        break;
+#endif
+    default:
+        linearScalar( vals, count, min, scale, n, indices, fracs );
+    }
+}
+
+void
+nearestIndices( const double * vals, int64_t count, double min, double scale, int32_t n,
+                int32_t * indices )
+{
+    nearest( vals, count, min, scale, n, indices );
+}
+
+void
+nearestIndices( const float * vals, int64_t count, double min, double scale, int32_t n,
+                int32_t * indices )
+{
+    nearest( vals, count, min, scale, n, indices );
+}
+
+void
+linearPositions( const double * vals, int64_t count, double min, double scale, int32_t n,
+                 int32_t * indices, double * fracs )
+{
+    linear( vals, count, min, scale, n, indices, fracs );
+}
+
+void
+linearPositions( const float * vals, int64_t count, double min, double scale, int32_t n,
+                 int32_t * indices, double * fracs )
+{
+    linear( vals, count, min, scale, n, indices, fracs );
+}
+
+const char *
+instructionSet()
+{
+    switch ( isa() ) {
+    case Isa::Avx2:
+        return "avx2";
+    case Isa::Sse41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+}
+}
+}
+}
@@ -0,0 +1,55 @@
+/**
+ * Kernels for converting whole batches of pixels with lookup tables.
+ *
+ * Cached pipelines spend most of their time figuring out where each value falls in
+ * their table. These kernels do that for a batch of values at a time, using AVX2 or
+ * SSE4.1 when the CPU supports them (detected at runtime), with a scalar fallback.
+ * NaNs are handled without branches: they get the index -1.
+ **/
+
+#pragma once
+
+#include <cstdint>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace PixelPipeline
+{
+namespace Batch
+{
+/// max. number of values the callers of the kernels process at a time, i.e. how big
+/// their index buffers need to be
+static constexpr int64_t BlockSize = 1024;
+
+/// \brief nearest entries in a table of n+1 entries
+/// \details indices[i] = clamp( round( ( vals[i] - min ) * scale ), 0, n ), or -1 for NaNs
+/// (halves are rounded up)
+void
+nearestIndices( const double * vals, int64_t count, double min, double scale, int32_t n,
+                int32_t * indices );
+
+void
+nearestIndices( const float * vals, int64_t count, double min, double scale, int32_t n,
+                int32_t * indices );
+
+/// \brief positions between the entries of a table of n+1 entries, for interpolation
+/// \details with d = clamp( ( vals[i] - min ) * scale, 0, n ), indices[i] =
+/// min( floor( d ), n-1 ) and fracs[i] = d - indices[i], i.e. the value is
+/// table[ind] * (1 - frac) + table[ind+1] * frac; the index is -1 for NaNs
+void
+linearPositions( const double * vals, int64_t count, double min, double scale, int32_t n,
+                 int32_t * indices, double * fracs );
+
+void
+linearPositions( const float * vals, int64_t count, double min, double scale, int32_t n,
+                 int32_t * indices, double * fracs );
+
+/// name of the instruction set used by the kernels, e.g. "avx2"
+const char *
+instructionSet();
+}
+}
+}
+}
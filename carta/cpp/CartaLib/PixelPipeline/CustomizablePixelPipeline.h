@@ -132,6 +132,12 @@ public:
         if( m_gamma < 0) { m_gamma = 0; }
     }
 
+    double
+    gamma()
+    {
+        return m_gamma;
+    }
+
     virtual void
     convert( double & val ) override
     {
@@ -157,6 +163,12 @@ public:
         return m_a;
     }
 
+    ScaleType
+    type()
+    {
+        return m_scaleType;
+    }
+
     void
     setType( ScaleType stype )
     {
@@ -247,6 +259,13 @@ public:
         m_scaleStage-> setGamma( gamma);
     }
 
+    /// get the gamma correction factor
+    double
+    gamma()
+    {
+        return m_scaleStage-> gamma();
+    }
+
     /// set max values for rgb (values will be interpolated up to this value)
     /// for example, setting red=0 means there will be no red in the image
     void
@@ -254,6 +273,13 @@ public:
         m_maxRgb = rgb;
     }
 
+    /// get the max values for rgb
+    NormRgb
+    rgbMax()
+    {
+        return m_maxRgb;
+    }
+
     /// some scales require a parameter
     void
     setScaleParam( double a )
@@ -277,6 +303,13 @@ public:
         m_scaleStage-> setType( scale );
     }
 
+    /// get the scale in use
+    ScaleType
+    scale()
+    {
+        return m_scaleStage-> type();
+    }
+
     void
     setInvert( bool flag )
     {
@@ -291,13 +324,33 @@ public:
         m_reversible-> setReversed( flag );
     }
 
+    bool
+    isInverted()
+    {
+        return m_invertFlag;
+    }
+
+    bool
+    isReversed()
+    {
+        return m_reverseFlag;
+    }
+
     void
     setColormap( IColormapNamed::SharedPtr colormap )
     {
         m_cmapName = colormap-> name();
+        m_colormap = colormap;
         m_pipe-> setStage3( colormap );
     }
 
+    /// get the colormap, nullptr means the default gray colormap
+    IColormapNamed::SharedPtr
+    colormap()
+    {
+        return m_colormap;
+    }
+
     /*virtual*/ void
     setMinMax( double min, double max )
     {
@@ -325,6 +378,8 @@ public:
         result = qRgb( red, green, blue);
     }
 
+    using IClippedPixelPipeline::convertq;
+
     virtual void
     getClips( double & min, double & max ) override
     {
@@ -334,14 +389,22 @@ public:
 
     QString
     cacheId()
+    {
+        return cacheId( m_clipMin, m_clipMax );
+    }
+
+    /// cache id the pipeline would have with the given clips, e.g. for rendering a
+    /// frame that has its own clips
+    QString
+    cacheId( double clipMin, double clipMax )
     {
         return QString( "%1/%2/%3/%4/%5/%6/%7/" )
                    .arg( m_cmapName )
                    .arg( m_invertFlag )
                    .arg( m_reverseFlag )
                    .arg( m_scaleStage-> cacheId() )
-                   .arg( double2base64( m_clipMin ) )
-                   .arg( double2base64( m_clipMax ) )
+                   .arg( double2base64( clipMin ) )
+                   .arg( double2base64( clipMax ) )
                    .arg( QString::number(m_maxRgb[0])+QString::number(m_maxRgb[1])+QString::number(m_maxRgb[2]));
     }
 
@@ -351,6 +414,7 @@ private:
     ScaleStage::SharedPtr m_scaleStage = nullptr;
     ReversableStage1::SharedPtr m_reversible = nullptr;
     InvertibleStage4::SharedPtr m_invertible = nullptr;
+    IColormapNamed::SharedPtr m_colormap = nullptr;
     double m_clipMin = 0, m_clipMax = 1;
     NormRgb m_maxRgb {{ 1.0, 1.0, 1.0}};
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CartaLib/CartaLib.h"
+#include "BatchKernels.h"
 #include <QRgb>
 #include <stdexcept>
 #include <cmath>
@@ -107,6 +108,9 @@ public:
 ///
 /// This is the interface that plugins have to implement to add a new colormap for
 /// scalcar-type pixels.
+///
+/// \note without the pixel pipeline cache, the render threads call convert() for every
+/// pixel, several at a time, so it must not change any state
 class IColormapNamed : public PixelPipeline::IColormap
 {
     CLASS_BOILERPLATE( IColormapNamed );
@@ -166,6 +170,21 @@ public:
     virtual void
     convertq( double val, QRgb & result ) = 0;
 
+    /// \brief batch version of convertq(), NaNs are converted to nanColor
+    /// \details the default implementation converts one value at a time, pipelines that
+    /// can do better should override it
+    virtual void
+    convertq( const double * vals, int64_t count, QRgb * out, QRgb nanColor )
+    {
+        convertqBatch( vals, count, out, nanColor );
+    }
+
+    virtual void
+    convertq( const float * vals, int64_t count, QRgb * out, QRgb nanColor )
+    {
+        convertqBatch( vals, count, out, nanColor );
+    }
+
     /// returns the input clip range
     /// \note this is not strictly necessary for minimalist interface, but we do use
     /// this just about everywhere where we need IPixelPipeline for caching, so I stuck
@@ -174,6 +193,22 @@ public:
 
     virtual
     ~IPixelPipeline() { }
+
+private:
+
+    template < typename T >
+    void
+    convertqBatch( const T * vals, int64_t count, QRgb * out, QRgb nanColor )
+    {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            if ( Q_LIKELY( ! std::isnan( vals[i] ) ) ) {
+                convertq( double ( vals[i] ), out[i] );
+            }
+            else {
+                out[i] = nanColor;
+            }
+        }
+    }
 };
 
 class IClippedPixelPipeline : public IPixelPipeline
@@ -261,6 +296,8 @@ public:
         result = qRgb( round( drgb[0] * 255 ), round( drgb[1] * 255 ), round( drgb[2] * 255 ) );
     } // convert
 
+    using IPixelPipeline::convertq;
+
 protected:
 
 //    typedef Id2d Stage1;
@@ -347,6 +384,10 @@ public:
         m_n1 = m_cache.size() - 1;
         m_d = ( m_max - m_min ) / m_n1;
         m_dInvN1 = 1 / m_d;
+        m_cacheq.resize( nSegments );
+        for ( int64_t i = 0 ; i < nSegments ; i++ ) {
+            normRgb2QRgb( m_cache[i], m_cacheq[i] );
+        }
     }
 
     void
@@ -360,9 +401,31 @@ public:
         normRgb2QRgb( drgb, result );
     }
 
+    /// \brief batch version of convertq(), gives the same results for non-NaNs, NaNs
+    /// are converted to nanColor
+    /// \details the positions in the cache are computed by the SIMD kernels, a block at
+    /// a time
+    template < typename T >
+    void
+    convertq( const T * vals, int64_t count, QRgb * out, QRgb nanColor )
+    {
+        int32_t indices[Batch::BlockSize];
+        for ( int64_t i = 0 ; i < count ; i += Batch::BlockSize ) {
+            int64_t n = std::min( count - i, Batch::BlockSize );
+            convertBlock( vals + i, n, out + i, nanColor, indices );
+        }
+    }
+
 private:
 
+    template < typename T >
+    void
+    convertBlock( const T * vals, int64_t count, QRgb * out, QRgb nanColor, int32_t * indices );
+
     std::vector < NormRgb > m_cache;
+
+    /// m_cache converted to QRgb, for the non-interpolated batch conversion
+    std::vector < QRgb > m_cacheq;
 //    NormRgb m_nanColor { { 1.0, 0.0, 0.0 } };
     double m_min = 0, m_max = 1;
     double m_d, m_dInvN1, m_n1;
@@ -415,6 +478,42 @@ inline void CachedPipeline<true>::convert(double x, NormRgb & result) /*override
     result[2] = m_cache[ind][2] * (1-frac) + m_cache[ind+1][2] * frac;
 }
 
+template <>
+template < typename T >
+inline void CachedPipeline<false>::convertBlock( const T * vals, int64_t count, QRgb * out,
+                                                 QRgb nanColor, int32_t * indices )
+{
+    Batch::nearestIndices( vals, count, m_min, m_dInvN1, int32_t( m_n1 ), indices );
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        // NaNs have index -1, look up something valid and select the nan color instead
+        int32_t ind = indices[i];
+        QRgb color = m_cacheq[std::max( ind, 0 )];
+        out[i] = ind < 0 ? nanColor : color;
+    }
+}
+
+template <>
+template < typename T >
+inline void CachedPipeline<true>::convertBlock( const T * vals, int64_t count, QRgb * out,
+                                                QRgb nanColor, int32_t * indices )
+{
+    double fracs[Batch::BlockSize];
+    Batch::linearPositions( vals, count, m_min, m_dInvN1, int32_t( m_n1 ), indices, fracs );
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        int32_t ind = std::max( indices[i], 0 );
+        double frac = fracs[i];
+        const NormRgb & c1 = m_cache[ind];
+        const NormRgb & c2 = m_cache[ind + 1];
+        NormRgb drgb;
+        drgb[0] = c1[0] * (1-frac) + c2[0] * frac;
+        drgb[1] = c1[1] * (1-frac) + c2[1] * frac;
+        drgb[2] = c1[2] * (1-frac) + c2[2] * frac;
+        QRgb color;
+        normRgb2QRgb( drgb, color );
+        out[i] = indices[i] < 0 ? nanColor : color;
+    }
+}
+
 
 } // namespace PixelPipeline
 } // namespace Lib
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <QString>
+#include <algorithm>
 #include <cstdint>
 #include <type_traits>
 
@@ -130,16 +131,28 @@ struct TypedConverters < SrcType, SrcType > {
     static const SrcType & cvt( const char * ptr) {
         return * reinterpret_cast<const SrcType *>( ptr);
     }
+    static void cvtBlock( const char * ptr, int64_t count, SrcType * dst) {
+        const SrcType * src = reinterpret_cast<const SrcType *>( ptr);
+        std::copy( src, src + count, dst);
+    }
 };
 
 /// general case
+/// \note the buffer is per thread, so that typed views can be used from multiple threads
 template <typename SrcType, typename DstType>
 struct TypedConverters {
     static const DstType & cvt( const char * ptr) {
-        static DstType buffer;
+        static thread_local DstType buffer;
         buffer = static_cast<DstType>(* reinterpret_cast<const SrcType *>( ptr));
         return buffer;
     }
+    /// convert a whole block at once, this is a simple loop that the compiler can vectorize
+    static void cvtBlock( const char * ptr, int64_t count, DstType * dst) {
+        const SrcType * src = reinterpret_cast<const SrcType *>( ptr);
+        for( int64_t i = 0 ; i < count ; ++ i) {
+            dst[i] = static_cast<DstType>( src[i]);
+        }
+    }
 };
 
 
@@ -148,6 +161,11 @@ struct Type2CvtFunc{
     typedef const DstType & ( * Type)( const char *);
 };
 
+template < typename DstType>
+struct Type2BlockCvtFunc{
+    typedef void ( * Type)( const char *, int64_t, DstType *);
+};
+
 template < typename DstType>
 typename Type2CvtFunc<DstType>::Type getConverter( Carta::Lib::Image::PixelType srcType)
 {
@@ -173,6 +191,26 @@ typename Type2CvtFunc<DstType>::Type getConverter( Carta::Lib::Image::PixelType
     }
 }
 
+/// same as getConverter(), but returns a function converting count elements at a time
+template < typename DstType>
+typename Type2BlockCvtFunc<DstType>::Type getBlockConverter( Carta::Lib::Image::PixelType srcType)
+{
+    switch (srcType) {
+    case Image::PixelType::Byte:
+        return & TypedConverters< uint8_t, DstType>::cvtBlock;
+    case Image::PixelType::Int16:
+        return & TypedConverters< int16_t, DstType>::cvtBlock;
+    case Image::PixelType::Int32:
+        return & TypedConverters< int32_t, DstType>::cvtBlock;
+    case Image::PixelType::Real32:
+        return & TypedConverters< float, DstType>::cvtBlock;
+    case Image::PixelType::Real64:
+        return & TypedConverters< double, DstType>::cvtBlock;
+    default:
+        return nullptr;
+    }
+}
+
 /// convenience function to convert a type to a string
 QString toStr( Image::PixelType t);
 
@@ -0,0 +1,72 @@
+/**
+ *
+ **/
+
+#include "StridedIterator.h"
+
+namespace Carta
+{
+namespace Lib
+{
+namespace NdArray
+{
+StridedLayout::StridedLayout( const SliceND::ApplyResult & appliedSlice,
+                              const std::vector < int > & arrayDims )
+{
+    const auto & slices = appliedSlice.dims();
+    VI64 dims( slices.size() ), strides( slices.size() );
+    int64_t fstride = 1;
+    m_offset = 0;
+    for ( size_t i = 0 ; i < slices.size() ; ++i ) {
+        // single index slices contribute one element
+        dims[i] = slices[i].isSingle() ? 1 : slices[i].count;
+        strides[i] = slices[i].step * fstride;
+        m_offset += slices[i].start * fstride;
+        if ( i < arrayDims.size() ) {
+            fstride *= arrayDims[i];
+        }
+    }
+    collapse( dims, strides );
+}
+
+StridedLayout::StridedLayout( const VI64 & dims, const VI64 & strides, int64_t offset )
+{
+    m_offset = offset;
+    collapse( dims, strides );
+}
+
+void
+StridedLayout::collapse( const VI64 & dims, const VI64 & strides )
+{
+    m_dims.clear();
+    m_strides.clear();
+    m_size = 1;
+    for ( size_t i = 0 ; i < dims.size() ; ++i ) {
+        m_size *= dims[i];
+
+        // axes with a single element don't need to be walked
+        if ( dims[i] == 1 ) {
+            continue;
+        }
+
+        // merge with the previous axis if they form one contiguous run
+        if ( ! m_dims.empty() && m_strides.back() * m_dims.back() == strides[i] ) {
+            m_dims.back() *= dims[i];
+            continue;
+        }
+        m_dims.push_back( dims[i] );
+        m_strides.push_back( strides[i] );
+    }
+
+    // we always report at least one axis
+    if ( m_dims.empty() ) {
+        m_dims.push_back( 1 );
+        m_strides.push_back( 1 );
+    }
+    if ( m_size <= 0 ) {
+        m_size = 0;
+    }
+} // collapse
+}
+}
+}
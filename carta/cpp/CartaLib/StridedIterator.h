@@ -0,0 +1,320 @@
+/**
+ * Generic engine for iterating over n-dimensional strided arrays, e.g. a slice of an
+ * image stored in memory in fortran order (first axis fastest).
+ *
+ * The idea is that all index arithmetic is done once, up front:
+ *
+ *   - strides are precomputed from the slice (SliceND::ApplyResult) and array dimensions
+ *   - axes with a single element are dropped
+ *   - neighbouring axes that are contiguous with respect to each other are collapsed
+ *     into a single axis (e.g. the full-width rows of an image become one long run)
+ *
+ * The caller is then handed the innermost runs: (offset, count, stride), and is free
+ * to process them with a tight (vectorizable) loop. Ranks 1-4 (after collapsing) are
+ * walked with plain nested loops, higher ranks with a generic odometer.
+ *
+ * All offsets and strides are in the same units as the strides supplied to the layout,
+ * i.e. elements if constructed from a slice. The gather()/forEachBlock() helpers at the
+ * bottom expect element units, and are meant to make implementing the bulk accessors of
+ * RawViewInterface trivial for in-memory data.
+ **/
+
+#pragma once
+
+#include "Slice.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace NdArray
+{
+/// precomputed (collapsed) description of a strided n-dimensional array
+class StridedLayout
+{
+public:
+
+    typedef std::vector < int64_t > VI64;
+
+    /// empty layout (no elements)
+    StridedLayout()
+        : m_dims( 1, 0 )
+        , m_strides( 1, 1 )
+    { }
+
+    /// layout of a slice applied to a dense fortran-order array
+    /// \param appliedSlice the slice applied to arrayDims
+    /// \param arrayDims dimensions of the underlying array
+    StridedLayout( const SliceND::ApplyResult & appliedSlice,
+                   const std::vector < int > & arrayDims );
+
+    /// layout from explicit dimensions, strides and offset of the first element
+    StridedLayout( const VI64 & dims, const VI64 & strides, int64_t offset = 0 );
+
+    /// offset of the first element
+    int64_t
+    offset() const { return m_offset; }
+
+    /// number of (collapsed) axes, at least 1
+    int
+    rank() const { return static_cast < int > ( m_dims.size() ); }
+
+    /// collapsed dimensions, m_dims[0] is the length of the innermost runs
+    const VI64 &
+    dims() const { return m_dims; }
+
+    /// collapsed strides
+    const VI64 &
+    strides() const { return m_strides; }
+
+    /// total number of elements
+    int64_t
+    size() const { return m_size; }
+
+    /// is the whole array one contiguous run with the given element stride?
+    bool
+    isContiguous( int64_t elementStride = 1 ) const
+    {
+        return rank() == 1 && ( m_strides[0] == elementStride || m_size <= 1 );
+    }
+
+protected:
+
+    /// drop single element axes and merge contiguous neighbours
+    void
+    collapse( const VI64 & dims, const VI64 & strides );
+
+    VI64 m_dims, m_strides;
+    int64_t m_offset = 0;
+    int64_t m_size = 0;
+};
+
+namespace Impl
+{
+/// nested loop walkers, specialized for small ranks
+template < int Rank >
+struct RunWalker;
+
+template < >
+struct RunWalker < 1 >
+{
+    template < typename Func >
+    static void
+    walk( const int64_t * dims, const int64_t * strides, int64_t off, Func & func )
+    {
+        func( off, dims[0], strides[0] );
+    }
+};
+
+template < >
+struct RunWalker < 2 >
+{
+    template < typename Func >
+    static void
+    walk( const int64_t * dims, const int64_t * strides, int64_t off, Func & func )
+    {
+        const int64_t n0 = dims[0], s0 = strides[0];
+        const int64_t n1 = dims[1], s1 = strides[1];
+        for ( int64_t i1 = 0 ; i1 < n1 ; ++i1, off += s1 ) {
+            func( off, n0, s0 );
+        }
+    }
+};
+
+template < >
+struct RunWalker < 3 >
+{
+    template < typename Func >
+    static void
+    walk( const int64_t * dims, const int64_t * strides, int64_t off, Func & func )
+    {
+        const int64_t n2 = dims[2], s2 = strides[2];
+        for ( int64_t i2 = 0 ; i2 < n2 ; ++i2, off += s2 ) {
+            RunWalker < 2 >::walk( dims, strides, off, func );
+        }
+    }
+};
+
+template < >
+struct RunWalker < 4 >
+{
+    template < typename Func >
+    static void
+    walk( const int64_t * dims, const int64_t * strides, int64_t off, Func & func )
+    {
+        const int64_t n3 = dims[3], s3 = strides[3];
+        for ( int64_t i3 = 0 ; i3 < n3 ; ++i3, off += s3 ) {
+            RunWalker < 3 >::walk( dims, strides, off, func );
+        }
+    }
+};
+}
+
+/// Invoke func( offset, count, stride ) for every innermost run of the layout, in
+/// sequential (fortran) order.
+template < typename Func >
+void
+forEachRun( const StridedLayout & layout, Func func )
+{
+    if ( layout.size() <= 0 ) {
+        return;
+    }
+    const int64_t * dims = layout.dims().data();
+    const int64_t * strides = layout.strides().data();
+    int64_t off = layout.offset();
+
+    switch ( layout.rank() )
+    {
+    case 1 :
+        return Impl::RunWalker < 1 >::walk( dims, strides, off, func );
+    case 2 :
+        return Impl::RunWalker < 2 >::walk( dims, strides, off, func );
+    case 3 :
+        return Impl::RunWalker < 3 >::walk( dims, strides, off, func );
+    case 4 :
+        return Impl::RunWalker < 4 >::walk( dims, strides, off, func );
+    default :
+        break;
+    }
+
+    // generic case: odometer over the outer axes, rank-2 walker for the inner two
+    const int rank = layout.rank();
+    std::vector < int64_t > pos( rank, 0 );
+    while ( true ) {
+        Impl::RunWalker < 2 >::walk( dims, strides, off, func );
+        int i = 2;
+        for ( ; i < rank ; ++i ) {
+            off += strides[i];
+            if ( ++pos[i] < dims[i] ) {
+                break;
+            }
+            off -= strides[i] * dims[i];
+            pos[i] = 0;
+        }
+        if ( i == rank ) {
+            return;
+        }
+    }
+} // forEachRun
+
+/// Same as forEachRun(), but only for elements [first, first+count) of the sequential
+/// order. Runs are split as needed at both ends of the range.
+template < typename Func >
+void
+forEachRun( const StridedLayout & layout, int64_t first, int64_t count, Func func )
+{
+    if ( first < 0 ) {
+        count += first;
+        first = 0;
+    }
+    if ( count > layout.size() - first ) {
+        count = layout.size() - first;
+    }
+    if ( count <= 0 ) {
+        return;
+    }
+    const int rank = layout.rank();
+    const auto & dims = layout.dims();
+    const auto & strides = layout.strides();
+
+    // convert the linear index to a position and an offset
+    std::vector < int64_t > pos( rank, 0 );
+    int64_t off = layout.offset();
+    int64_t rest = first;
+    for ( int i = 0 ; i < rank ; ++i ) {
+        pos[i] = rest % dims[i];
+        rest /= dims[i];
+        off += pos[i] * strides[i];
+    }
+
+    while ( count > 0 ) {
+        int64_t n = std::min( dims[0] - pos[0], count );
+        func( off, n, strides[0] );
+        count -= n;
+
+        // move to the beginning of the next run
+        off -= pos[0] * strides[0];
+        pos[0] = 0;
+        for ( int i = 1 ; i < rank ; ++i ) {
+            off += strides[i];
+            if ( ++pos[i] < dims[i] ) {
+                break;
+            }
+            off -= strides[i] * dims[i];
+            pos[i] = 0;
+        }
+    }
+} // forEachRun
+
+/// copy elements [first, first+count) (in sequential order) of the array described by
+/// layout into dst
+/// \param base pointer to the element at offset 0 of the layout
+template < typename T >
+void
+gather( const T * base, const StridedLayout & layout, int64_t first, int64_t count, T * dst )
+{
+    forEachRun( layout, first, count, [&] ( int64_t off, int64_t n, int64_t stride ) {
+                    const T * src = base + off;
+                    if ( stride == 1 ) {
+                        std::copy( src, src + n, dst );
+                    }
+                    else {
+                        for ( int64_t i = 0 ; i < n ; ++i ) {
+                            dst[i] = src[i * stride];
+                        }
+                    }
+                    dst += n;
+                }
+                );
+}
+
+/// Visit the whole array described by layout in blocks of at most maxElements, in
+/// sequential order, by calling func( const T * data, int64_t count ).
+/// If buff is nullptr, contiguous runs are handed to func directly from the array (no
+/// copy), and only strided runs are gathered into a temporary buffer. Otherwise everything
+/// goes through buff, which must hold maxElements.
+template < typename T, typename Func >
+void
+forEachBlock( const T * base, const StridedLayout & layout, int64_t maxElements,
+              T * buff, Func func )
+{
+    maxElements = std::max < int64_t > ( maxElements, 1 );
+    bool passThrough = buff == nullptr;
+    std::unique_ptr < T[] > ownBuff;
+    int64_t filled = 0;
+    auto flush = [&] () {
+        if ( filled > 0 ) {
+            func( const_cast < const T * > ( buff ), filled );
+            filled = 0;
+        }
+    };
+    forEachRun( layout, [&] ( int64_t off, int64_t n, int64_t stride ) {
+                    const T * src = base + off;
+                    if ( passThrough && stride == 1 ) {
+                        flush();
+                        for ( int64_t k = 0 ; k < n ; k += maxElements ) {
+                            func( src + k, std::min( maxElements, n - k ) );
+                        }
+                        return;
+                    }
+                    if ( ! buff ) {
+                        ownBuff.reset( new T[maxElements] );
+                        buff = ownBuff.get();
+                    }
+                    for ( int64_t i = 0 ; i < n ; ++i ) {
+                        buff[filled] = src[i * stride];
+                        if ( ++filled == maxElements ) {
+                            flush();
+                        }
+                    }
+                }
+                );
+    flush();
+} // forEachBlock
+}
+}
+}
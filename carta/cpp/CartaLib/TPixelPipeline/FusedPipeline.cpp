@@ -0,0 +1,274 @@
+/**
+ *
+ **/
+
+#include "FusedPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace Carta
+{
+namespace Lib
+{
+namespace TemplatedPixelPipeline
+{
+constexpr int FusedPipeline::DefaultTableSize;
+
+/// scale function of the normalized value, Scale is known at compile time, so this
+/// boils down to a single case
+template < PixelPipeline::ScaleType Scale, typename C >
+static inline C
+applyScale( C n, C a, C logA1 )
+{
+    switch ( Scale )
+    {
+    case PixelPipeline::ScaleType::Linear :
+        return n;
+
+    case PixelPipeline::ScaleType::Sqr :
+        return n * n;
+
+    case PixelPipeline::ScaleType::Sqrt :
+        return std::sqrt( n );
+
+    case PixelPipeline::ScaleType::Log :
+        return std::log( a * n + 1 ) / logA1;
+
+    case PixelPipeline::ScaleType::Polynomial :
+        return std::pow( n, a );
+    }
+    return n;
+}
+
+/// linear interpolation between two colors
+template < typename C >
+static inline QRgb
+mixColors( QRgb c1, QRgb c2, C f )
+{
+    auto mix = [f] ( int v1, int v2 ) {
+        return int ( v1 + ( v2 - v1 ) * f + C( 0.5 ) );
+    };
+    return qRgb( mix( qRed( c1 ), qRed( c2 ) ),
+                 mix( qGreen( c1 ), qGreen( c2 ) ),
+                 mix( qBlue( c1 ), qBlue( c2 ) ) );
+}
+
+template < typename Scalar, PixelPipeline::ScaleType Scale, bool Gamma,
+           FusedPipeline::Colors Mode >
+void
+FusedPipeline::kernel( const FusedPipeline & pipe, const Scalar * vals, int64_t count,
+                       QRgb * out, QRgb nanColor )
+{
+    // exact colors need the same arithmetic as the source, i.e. doubles
+    typedef typename std::conditional < Mode == Colors::Exact, double,
+                                        typename ComputeType < Scalar >::type >::type C;
+    const C min = pipe.m_clipMin;
+    const C max = pipe.m_clipMax;
+    const C invRange = pipe.m_clipMax > pipe.m_clipMin
+                       ? 1 / ( pipe.m_clipMax - pipe.m_clipMin ) : 0;
+    const C a = pipe.m_scaleParam;
+    const C logA1 = std::log( pipe.m_scaleParam + 1 );
+    const C gamma = pipe.m_gamma;
+    const int tableSize = pipe.m_table.size();
+    const C tableScale = tableSize - 1;
+    const QRgb * table = pipe.m_table.data();
+
+    for ( int64_t i = 0 ; i < count ; ++i ) {
+        const Scalar val = vals[i];
+
+        // the stages of the source, step by step, see Composite::convert()
+        if ( Mode == Colors::Exact ) {
+            if ( std::isnan( val ) ) {
+                out[i] = nanColor;
+                continue;
+            }
+            C v = Carta::Lib::clamp < C > ( val, min, max );
+            C n = ( v - min ) / ( max - min );
+            n = applyScale < Scale > ( n, a, logA1 );
+            if ( Gamma ) {
+                n = std::pow( n, gamma );
+            }
+            v = n * ( max - min ) + min;
+            if ( pipe.m_reversed ) {
+                v = ( min + max ) - v;
+            }
+            out[i] = pipe.exactColor( ( v - min ) / ( max - min ) );
+            continue;
+        }
+
+        // stage 0 & 2: clamp and normalize, the order of min/max makes NaNs end up
+        // as min, so that everything below is safe for them
+        C n = ( std::max( min, std::min( C( val ), max ) ) - min ) * invRange;
+
+        // stage 1: scale and gamma
+        n = applyScale < Scale > ( n, a, logA1 );
+        if ( Gamma ) {
+            n = std::pow( n, gamma );
+        }
+
+        // the rest is in the table, bad scale parameters may have taken us out of [0,1]
+        n = std::max( C( 0 ), std::min( n, C( 1 ) ) );
+        QRgb color;
+        if ( Mode == Colors::InterpolatedTable ) {
+            C pos = n * tableScale;
+            int index = std::min( int ( pos ), tableSize - 2 );
+            color = mixColors( table[index], table[index + 1], pos - index );
+        }
+        else {
+            color = table[int ( n * tableScale + C( 0.5 ) )];
+        }
+        out[i] = std::isnan( val ) ? nanColor : color;
+    }
+} // kernel
+
+QRgb
+FusedPipeline::exactColor( double val ) const
+{
+    PixelPipeline::NormRgb drgb;
+    m_colormap-> convert( val, drgb );
+    if ( m_inverted ) {
+        drgb[0] = 1.0 - drgb[0];
+        drgb[1] = 1.0 - drgb[1];
+        drgb[2] = 1.0 - drgb[2];
+    }
+    QRgb rgb;
+    PixelPipeline::normRgb2QRgb( drgb, rgb );
+    return qRgb( std::round( qRed( rgb ) * m_rgbMax[0] ),
+                 std::round( qGreen( rgb ) * m_rgbMax[1] ),
+                 std::round( qBlue( rgb ) * m_rgbMax[2] ) );
+}
+
+template < typename Scalar, PixelPipeline::ScaleType Scale, bool Gamma >
+FusedPipeline::Kernel < Scalar >
+FusedPipeline::pickKernel() const
+{
+    switch ( m_colors )
+    {
+    case Colors::Table :
+        return & kernel < Scalar, Scale, Gamma, Colors::Table >;
+
+    case Colors::InterpolatedTable :
+        return & kernel < Scalar, Scale, Gamma, Colors::InterpolatedTable >;
+
+    case Colors::Exact :
+        return & kernel < Scalar, Scale, Gamma, Colors::Exact >;
+    }
+    CARTA_ASSERT_X( false, "Invalid colors" );
+    return & kernel < Scalar, Scale, Gamma, Colors::Table >;
+}
+
+template < typename Scalar, PixelPipeline::ScaleType Scale >
+FusedPipeline::Kernel < Scalar >
+FusedPipeline::pickKernel() const
+{
+    if ( m_gamma != 1 ) {
+        return pickKernel < Scalar, Scale, true > ();
+    }
+    return pickKernel < Scalar, Scale, false > ();
+}
+
+template < typename Scalar >
+FusedPipeline::Kernel < Scalar >
+FusedPipeline::pickKernel() const
+{
+    switch ( m_scale )
+    {
+    case ScaleType::Linear :
+        return pickKernel < Scalar, ScaleType::Linear > ();
+
+    case ScaleType::Sqr :
+        return pickKernel < Scalar, ScaleType::Sqr > ();
+
+    case ScaleType::Sqrt :
+        return pickKernel < Scalar, ScaleType::Sqrt > ();
+
+    case ScaleType::Log :
+        return pickKernel < Scalar, ScaleType::Log > ();
+
+    case ScaleType::Polynomial :
+        return pickKernel < Scalar, ScaleType::Polynomial > ();
+    }
+    CARTA_ASSERT_X( false, "Invalid scale type" );
+    return pickKernel < Scalar, ScaleType::Linear > ();
+}
+
+void
+FusedPipeline::pickKernels()
+{
+    m_floatKernel = pickKernel < float > ();
+    m_doubleKernel = pickKernel < double > ();
+    m_int16Kernel = pickKernel < int16_t > ();
+}
+
+FusedPipeline::FusedPipeline()
+{
+    m_table.resize( DefaultTableSize );
+    for ( int i = 0 ; i < DefaultTableSize ; ++i ) {
+        int gray = std::round( 255.0 * i / ( DefaultTableSize - 1 ) );
+        m_table[i] = qRgb( gray, gray, gray );
+    }
+    m_colormap = std::make_shared < PixelPipeline::GrayCMap > ();
+    pickKernels();
+}
+
+void
+FusedPipeline::setup( Source & source, Colors colors, int tableSize )
+{
+    source.getClips( m_clipMin, m_clipMax );
+    m_scale = source.scale();
+    m_scaleParam = source.scaleParam();
+    m_gamma = source.gamma();
+    m_colors = colors;
+
+    // stages 3 to 5 of the source, applied to the normalized value
+    m_colormap = source.colormap();
+    if ( ! m_colormap ) {
+        m_colormap = std::make_shared < PixelPipeline::GrayCMap > ();
+    }
+    m_reversed = source.isReversed();
+    m_inverted = source.isInverted();
+    m_rgbMax = source.rgbMax();
+    if ( colors == Colors::Exact ) {
+        m_table.clear();
+    }
+    else {
+        // the table is sampled the same way the exact colors are made
+        m_table.resize( std::max( 2, tableSize ) );
+        int last = m_table.size() - 1;
+        for ( int i = 0 ; i <= last ; ++i ) {
+            double val = double ( i ) / last;
+            m_table[i] = exactColor( m_reversed ? 1 - val : val );
+        }
+    }
+
+    pickKernels();
+} // setup
+
+void
+FusedPipeline::setup( PixelPipeline::IClippedPixelPipeline & source, Colors colors,
+                      int tableSize )
+{
+    auto custom = dynamic_cast < Source * > ( & source );
+    if ( custom ) {
+        setup( * custom, colors, tableSize );
+        return;
+    }
+
+    // nothing is known about the stages of the source, so the whole of it goes into the
+    // table, which makes exact colors impossible
+    source.getClips( m_clipMin, m_clipMax );
+    m_scale = ScaleType::Linear;
+    m_scaleParam = 1;
+    m_gamma = 1;
+    m_colors = colors == Colors::Exact ? Colors::Table : colors;
+    m_table.resize( std::max( 2, tableSize ) );
+    int last = m_table.size() - 1;
+    for ( int i = 0 ; i <= last ; ++i ) {
+        source.convertq( m_clipMin + ( m_clipMax - m_clipMin ) * i / last, m_table[i] );
+    }
+    pickKernels();
+} // setup
+}
+}
+}
@@ -0,0 +1,179 @@
+/**
+ * Templated version of the pixel pipeline, with the stages fused at compile time.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
+#include <QRgb>
+#include <cstdint>
+#include <vector>
+
+namespace Carta
+{
+namespace Lib
+{
+/// same as PixelPipeline but templated
+///
+/// Instead of going through a chain of virtual stages for every pixel, each combination
+/// of input type and stages gets its own kernel, and the input is kept in its own type
+/// instead of being converted to double.
+namespace TemplatedPixelPipeline
+{
+/// the type the kernels compute in, float is plenty for 8 bit colors, unless the input
+/// is double already
+template < typename Scalar >
+struct ComputeType
+{
+    typedef float type;
+};
+
+template <>
+struct ComputeType < double >
+{
+    typedef double type;
+};
+
+/// fused version of PixelPipeline::CustomizablePixelPipeline
+///
+/// Everything after the scale stage (reverse, colormap, invert and rgb max) only depends
+/// on the normalized value, so unless the colors have to be exact, setup() samples it
+/// into a table of final colors. What is left per pixel (clamping, normalization, scaling
+/// and gamma) is done by a kernel specialized for the input type, scale type, gamma
+/// correction and how the colors are made. setup() picks the kernels, so there is no
+/// per-pixel dispatch.
+///
+/// \note the pipeline keeps no state while converting, so it can be used from multiple
+/// threads at once, in which case so is the colormap of an exact pipeline
+class FusedPipeline
+{
+    CLASS_BOILERPLATE( FusedPipeline );
+
+public:
+
+    typedef PixelPipeline::CustomizablePixelPipeline Source;
+    typedef PixelPipeline::ScaleType ScaleType;
+
+    /// how the scaled values are turned into colors
+    enum class Colors
+    {
+        /// nearest entry of the table
+        Table,
+
+        /// linear interpolation between the entries of the table
+        InterpolatedTable,
+
+        /// the colormap itself, the colors are the same as those of the source's convertq()
+        Exact
+    };
+
+    /// default number of entries in the table of colors
+    static constexpr int DefaultTableSize = 4096;
+
+    /// creates a linear gray pipeline for [0,1]
+    FusedPipeline();
+
+    /// take over the settings of the source pipeline and pick the kernels
+    /// \param colors how the colors are made
+    /// \param tableSize number of entries in the table of colors (at least 2), not used
+    /// for exact colors
+    void
+    setup( Source & source, Colors colors = Colors::Table, int tableSize = DefaultTableSize );
+
+    /// sample any other pipeline into the table, as a linear scale of its clips
+    void
+    setup( PixelPipeline::IClippedPixelPipeline & source, Colors colors = Colors::Table,
+           int tableSize = DefaultTableSize );
+
+    /// use different clips, everything else stays as set up (the colors only depend on
+    /// where the values are between the clips)
+    void
+    setClips( double clipMin, double clipMax )
+    {
+        m_clipMin = clipMin;
+        m_clipMax = clipMax;
+    }
+
+    void
+    getClips( double & clipMin, double & clipMax ) const
+    {
+        clipMin = m_clipMin;
+        clipMax = m_clipMax;
+    }
+
+    /// how the colors are made
+    Colors
+    colors() const
+    {
+        return m_colors;
+    }
+
+    /// convert count values to colors, NaNs to nanColor
+    void
+    convertq( const float * vals, int64_t count, QRgb * out, QRgb nanColor ) const
+    {
+        m_floatKernel( * this, vals, count, out, nanColor );
+    }
+
+    void
+    convertq( const double * vals, int64_t count, QRgb * out, QRgb nanColor ) const
+    {
+        m_doubleKernel( * this, vals, count, out, nanColor );
+    }
+
+    void
+    convertq( const int16_t * vals, int64_t count, QRgb * out, QRgb nanColor ) const
+    {
+        m_int16Kernel( * this, vals, count, out, nanColor );
+    }
+
+private:
+
+    template < typename Scalar >
+    using Kernel = void (*)( const FusedPipeline &, const Scalar *, int64_t, QRgb *, QRgb );
+
+    template < typename Scalar, ScaleType Scale, bool Gamma, Colors Mode >
+    static void
+    kernel( const FusedPipeline & pipe, const Scalar * vals, int64_t count, QRgb * out,
+            QRgb nanColor );
+
+    template < typename Scalar, ScaleType Scale, bool Gamma >
+    Kernel < Scalar >
+    pickKernel() const;
+
+    template < typename Scalar, ScaleType Scale >
+    Kernel < Scalar >
+    pickKernel() const;
+
+    template < typename Scalar >
+    Kernel < Scalar >
+    pickKernel() const;
+
+    void
+    pickKernels();
+
+    /// final color of a normalized (and scaled) value, for exact colors
+    QRgb
+    exactColor( double val ) const;
+
+    /// final colors of normalized (and scaled) values in [0,1]
+    std::vector < QRgb > m_table;
+
+    /// the stages after scaling, for exact colors
+    PixelPipeline::IColormap::SharedPtr m_colormap = nullptr;
+    bool m_reversed = false, m_inverted = false;
+    PixelPipeline::NormRgb m_rgbMax {{ 1.0, 1.0, 1.0 }};
+
+    Colors m_colors = Colors::Table;
+    ScaleType m_scale = ScaleType::Linear;
+    double m_clipMin = 0, m_clipMax = 1;
+    double m_scaleParam = 1, m_gamma = 1;
+
+    Kernel < float > m_floatKernel = nullptr;
+    Kernel < double > m_doubleKernel = nullptr;
+    Kernel < int16_t > m_int16Kernel = nullptr;
+};
+}
+}
+}
@@ -0,0 +1,64 @@
+#include "catch.h"
+#include "CartaLib/BitMask.h"
+#include <vector>
+
+using namespace Carta::Lib::NdArray;
+
+TEST_CASE( "Packed bit mask", "[mask]" ) {
+
+    // 13x11 mask with a few patterns crossing word boundaries
+    BitMask mask( { 13, 11 }, true );
+    std::vector < bool > expected( mask.size(), true );
+    for ( int64_t i = 0 ; i < mask.size() ; ++i ) {
+        if ( ( i >= 60 && i < 70 ) || i % 37 == 0 || ( i >= 100 && i < 130 ) ) {
+            mask.set( i, false );
+            expected[i] = false;
+        }
+    }
+
+    SECTION( "basics") {
+        REQUIRE( mask.size() == 143 );
+        REQUIRE( mask.words().size() == 3 );
+        int64_t valid = 0;
+        for ( int64_t i = 0 ; i < mask.size() ; ++i ) {
+            REQUIRE( mask.isValid( i ) == expected[i] );
+            valid += expected[i];
+        }
+        REQUIRE( mask.countValid() == valid );
+    }
+
+    SECTION( "runs") {
+        for ( int64_t first = 0 ; first < mask.size() ; first += 7 ) {
+            for ( int64_t count = 0 ; first + count <= mask.size() ; count += 11 ) {
+                std::vector < bool > got;
+                int64_t next = first;
+                bool lastValid = false;
+                mask.forEachRun( first, count, [&] ( int64_t start, int64_t n, bool valid ) {
+                                     // runs are contiguous, non-empty and maximal
+                                     REQUIRE( start == next );
+                                     REQUIRE( n > 0 );
+                                     if ( start != first ) {
+                                         REQUIRE( valid != lastValid );
+                                     }
+                                     got.insert( got.end(), n, valid );
+                                     next = start + n;
+                                     lastValid = valid;
+                                 }
+                                 );
+                REQUIRE( got == std::vector < bool > ( expected.begin() + first,
+                                                       expected.begin() + first + count ) );
+            }
+        }
+    }
+
+    SECTION( "packing booleans") {
+        std::vector < char > bools( mask.size() );
+        for ( int64_t i = 0 ; i < mask.size() ; ++i ) {
+            bools[i] = expected[i];
+        }
+        BitMask packed( mask.dims(), false );
+        packed.setFromBools( 0, 5, reinterpret_cast < const bool * > ( & bools[0] ) );
+        packed.setFromBools( 5, mask.size() - 5, reinterpret_cast < const bool * > ( & bools[5] ) );
+        REQUIRE( packed.words() == mask.words() );
+    }
+}
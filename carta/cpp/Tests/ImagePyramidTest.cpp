@@ -0,0 +1,55 @@
+#include "catch.h"
+#include "core/ImagePyramid.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using Carta::Core::ImagePyramid;
+
+static ImagePyramid::Level
+makeLevel( int width, int height, const std::vector < float > & data )
+{
+    ImagePyramid::Level level;
+    level.width = width;
+    level.height = height;
+    level.factor = 4;
+    level.data = data;
+    return level;
+}
+
+TEST_CASE( "Image pyramid reduction", "[pyramid]" ) {
+
+    const float nan = std::numeric_limits < float >::quiet_NaN();
+
+    // 3x3 level, so that the last row and column of the blocks are incomplete
+    ImagePyramid::Level level = makeLevel( 3, 3, {
+                                               1, 2, 3,
+                                               4, nan, 5,
+                                               nan, nan, 6
+                                           } );
+
+    SECTION( "mean") {
+        ImagePyramid::Level reduced = ImagePyramid::reduce( level, ImagePyramid::Reduction::Mean );
+        REQUIRE( reduced.width == 2 );
+        REQUIRE( reduced.height == 2 );
+        REQUIRE( reduced.factor == 8 );
+        REQUIRE( reduced.data[0] == Approx( 7.0 / 3 ) );
+        REQUIRE( reduced.data[1] == Approx( 4 ) );
+        REQUIRE( std::isnan( reduced.data[2] ) );
+        REQUIRE( reduced.data[3] == Approx( 6 ) );
+    }
+
+    SECTION( "max") {
+        ImagePyramid::Level reduced = ImagePyramid::reduce( level, ImagePyramid::Reduction::Max );
+        REQUIRE( reduced.data[0] == 4 );
+        REQUIRE( reduced.data[1] == 5 );
+        REQUIRE( std::isnan( reduced.data[2] ) );
+        REQUIRE( reduced.data[3] == 6 );
+    }
+
+    SECTION( "level selection") {
+        ImagePyramid pyramid;
+        REQUIRE( pyramid.levelCount() == 0 );
+        REQUIRE( pyramid.levelForStep( 16 ) == - 1 );
+    }
+}
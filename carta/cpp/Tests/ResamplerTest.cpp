@@ -0,0 +1,73 @@
+#include "catch.h"
+#include "core/Resampler.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using Carta::Core::Resampler;
+
+TEST_CASE( "Resampling of a grid", "[resampler]" ) {
+
+    const float nan = std::numeric_limits < float >::quiet_NaN();
+
+    // 4x4 grid, row 0 at the bottom
+    std::vector < float > grid = {
+        1, 2, 3, 4,
+        5, nan, 7, 8,
+        nan, nan, 11, 12,
+        nan, nan, 15, 16
+    };
+    std::vector < float > out( 4 );
+
+    SECTION( "nearest") {
+        // output pixels of the size of the grid pixels, shifted by a quarter of a pixel
+        Resampler resampler( Resampler::Kernel::Nearest, grid.data(), 4, 4, 0.25, 1, 4 );
+        resampler.row( 1.25, 1, out.data() );
+        REQUIRE( out[0] == 5 );
+        REQUIRE( std::isnan( out[1] ) );
+        REQUIRE( out[2] == 7 );
+        REQUIRE( out[3] == 8 );
+    }
+
+    SECTION( "block average") {
+        // 2x2 blocks, NaNs are left out
+        Resampler resampler( Resampler::Kernel::BlockAverage, grid.data(), 4, 4, 0.5, 2, 2 );
+        resampler.row( 0.5, 2, out.data() );
+        REQUIRE( out[0] == Approx( 8.0 / 3 ) );
+        REQUIRE( out[1] == Approx( 5.5 ) );
+        resampler.row( 2.5, 2, out.data() );
+        REQUIRE( std::isnan( out[0] ) );
+        REQUIRE( out[1] == Approx( 13.5 ) );
+
+        // when zoomed in, each output pixel gets the grid pixel it is in
+        Resampler zoomedIn( Resampler::Kernel::BlockAverage, grid.data(), 4, 4, 0.25, 0.5, 4 );
+        zoomedIn.row( 0.25, 0.5, out.data() );
+        REQUIRE( out[0] == 1 );
+        REQUIRE( out[1] == 2 );
+        REQUIRE( out[2] == 2 );
+        REQUIRE( out[3] == 3 );
+    }
+
+    SECTION( "bilinear") {
+        Resampler resampler( Resampler::Kernel::Bilinear, grid.data(), 4, 4, 2.5, 0.5, 2 );
+
+        // between 3, 4, 7 and 8, and then on the line between 3 and 4
+        resampler.row( 0.5, 0.5, out.data() );
+        REQUIRE( out[0] == Approx( 5.5 ) );
+        REQUIRE( out[1] == Approx( 6 ) );
+        resampler.row( 0, 0.5, out.data() );
+        REQUIRE( out[0] == Approx( 3.5 ) );
+
+        // NaNs don't count, the remaining pixels are weighted as if they were not there
+        Resampler nans( Resampler::Kernel::Bilinear, grid.data(), 4, 4, 0.25, 0.5, 1 );
+        nans.row( 1, 0.5, out.data() );
+        REQUIRE( out[0] == Approx( 5 ) );
+        nans.row( 2.5, 0.5, out.data() );
+        REQUIRE( std::isnan( out[0] ) );
+
+        // zoomed out, the pixels are averaged
+        Resampler zoomedOut( Resampler::Kernel::Bilinear, grid.data(), 4, 4, 0.5, 2, 2 );
+        zoomedOut.row( 2.5, 2, out.data() );
+        REQUIRE( out[1] == Approx( 13.5 ) );
+    }
+}
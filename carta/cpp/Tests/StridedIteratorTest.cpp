@@ -0,0 +1,94 @@
+#include "catch.h"
+#include "CartaLib/StridedIterator.h"
+#include <vector>
+
+using namespace Carta::Lib::NdArray;
+
+typedef std::vector < int64_t > VI64;
+
+// expand all runs of a layout into a list of offsets
+static VI64
+offsets( const StridedLayout & layout )
+{
+    VI64 res;
+    forEachRun( layout, [&] ( int64_t off, int64_t n, int64_t stride ) {
+                    for ( int64_t i = 0 ; i < n ; ++i ) {
+                        res.push_back( off + i * stride );
+                    }
+                }
+                );
+    return res;
+}
+
+TEST_CASE( "Strided iteration engine", "[strided]" ) {
+
+    // slice [1:4:2, :, 1:3] of a 5x4x3 fortran order array
+    StridedLayout layout( { 2, 4, 2 }, { 2, 5, 20 }, 1 + 20 );
+    VI64 expected;
+    for ( int k = 1 ; k < 3 ; ++k ) {
+        for ( int j = 0 ; j < 4 ; ++j ) {
+            for ( int i = 1 ; i < 4 ; i += 2 ) {
+                expected.push_back( i + 5 * j + 20 * k );
+            }
+        }
+    }
+
+    SECTION( "full traversal") {
+        REQUIRE( layout.size() == 16 );
+        REQUIRE( offsets( layout ) == expected );
+    }
+
+    SECTION( "contiguous axes are collapsed") {
+        // axes 1 and 2 are contiguous with respect to each other
+        REQUIRE( layout.rank() == 2 );
+        StridedLayout dense( { 5, 4, 3 }, { 1, 5, 20 } );
+        REQUIRE( dense.rank() == 1 );
+        REQUIRE( dense.dims()[0] == 60 );
+        REQUIRE( dense.isContiguous() );
+    }
+
+    SECTION( "sub-ranges") {
+        for ( int64_t first = 0 ; first < 16 ; ++first ) {
+            for ( int64_t count = 0 ; count <= 16 ; ++count ) {
+                VI64 part;
+                forEachRun( layout, first, count, [&] ( int64_t off, int64_t n, int64_t s ) {
+                                for ( int64_t i = 0 ; i < n ; ++i ) {
+                                    part.push_back( off + i * s );
+                                }
+                            }
+                            );
+                VI64 ref( expected.begin() + first,
+                          expected.begin() + std::min < int64_t > ( 16, first + count ) );
+                REQUIRE( part == ref );
+            }
+        }
+    }
+
+    SECTION( "high rank") {
+        StridedLayout layout6( { 2, 2, 2, 2, 2, 2 }, { 1, 4, 16, 64, 256, 1024 } );
+        REQUIRE( offsets( layout6 ).size() == 64 );
+        REQUIRE( offsets( layout6 ).back() == 1 + 4 + 16 + 64 + 256 + 1024 );
+    }
+
+    SECTION( "blocks and gather") {
+        std::vector < float > data( 60 );
+        for ( size_t i = 0 ; i < data.size() ; ++i ) {
+            data[i] = i;
+        }
+        std::vector < float > blocks;
+        forEachBlock( data.data(), layout, 3, (float *) nullptr,
+                      [&] ( const float * vals, int64_t n ) {
+                          REQUIRE( n <= 3 );
+                          blocks.insert( blocks.end(), vals, vals + n );
+                      }
+                      );
+        std::vector < float > gathered( 5 );
+        gather( data.data(), layout, 7, 5, gathered.data() );
+        for ( size_t i = 0 ; i < expected.size() ; ++i ) {
+            REQUIRE( blocks[i] == expected[i] );
+        }
+        for ( size_t i = 0 ; i < gathered.size() ; ++i ) {
+            REQUIRE( gathered[i] == expected[i + 7] );
+        }
+    }
+}
@@ -11,7 +11,12 @@ SOURCES += \
     SliceTester.cpp \
     StateTester.cpp \
     pixelPipelineTest.cpp \
-    LineCombinerTest.cpp
+    StridedIteratorTest.cpp \
+    BitMaskTest.cpp \
+    LineCombinerTest.cpp \
+    ImagePyramidTest.cpp \
+    ResamplerTest.cpp \
+    TypedViewTest.cpp
 
 #CONFIG += precompile_header
 #PRECOMPILED_HEADER = catch.h
@@ -0,0 +1,258 @@
+#include "catch.h"
+#include "CartaLib/IImage.h"
+#include "core/Algorithms/quantileAlgorithms.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace Carta::Lib::NdArray;
+
+/// 2D float view that serves optimal traversals tile by tile, like the casa images do,
+/// so that the tiles are larger than the blocks requested by the tests
+class TiledRawView : public RawViewInterface
+{
+public:
+
+    TiledRawView( int width, int height, int tileWidth, int tileHeight )
+        : m_dims( { width, height } ), m_tileWidth( tileWidth ), m_tileHeight( tileHeight ),
+        m_pos( 2, 0 )
+    {
+        for ( int i = 0 ; i < width * height ; ++i ) {
+            m_data.push_back( i );
+        }
+    }
+
+    virtual PixelType
+    pixelType() override
+    {
+        return Carta::Lib::Image::PixelType::Real32;
+    }
+
+    virtual const VI &
+    dims() override
+    {
+        return m_dims;
+    }
+
+    virtual const char *
+    get( const VI & pos ) override
+    {
+        return reinterpret_cast < const char * > ( & m_data[pos[1] * m_dims[0] + pos[0]] );
+    }
+
+    virtual void
+    forEach( std::function < void (const char *) > func, Traversal traversal ) override
+    {
+        forEach( 1024, [&] ( const char * ptr, int64_t count ) {
+                     for ( int64_t i = 0 ; i < count ; ++i ) {
+                         func( ptr + i * sizeof( float ) );
+                     }
+                 }, nullptr, traversal );
+    }
+
+    virtual const VI &
+    currentPos() override
+    {
+        return m_pos;
+    }
+
+    virtual RawViewInterface *
+    getView( const SliceND & ) override
+    {
+        return nullptr;
+    }
+
+    virtual RawViewInterface *
+    clone() override
+    {
+        return nullptr;
+    }
+
+    virtual int64_t
+    read( int64_t, char *, Traversal ) override
+    {
+        return 0;
+    }
+
+    virtual void
+    seek( int64_t ) override { }
+
+    virtual int64_t
+    read( int64_t, int64_t, char *, Traversal ) override
+    {
+        return 0;
+    }
+
+    virtual void
+    forEach( int64_t buffSize,
+             std::function < void (const char *, int64_t) > func,
+             char * buff,
+             Traversal traversal ) override
+    {
+        m_lastTraversal = traversal;
+        int64_t maxPixels = std::max < int64_t > ( 1, buffSize / sizeof( float ) );
+        if ( m_wholeTiles ) {
+            maxPixels = std::numeric_limits < int64_t >::max();
+        }
+        auto serve = [&] ( const float * src, int64_t n ) {
+            for ( int64_t off = 0 ; off < n ; off += maxPixels ) {
+                int64_t count = std::min( maxPixels, n - off );
+                if ( buff ) {
+                    std::copy( src + off, src + off + count, reinterpret_cast < float * > ( buff ) );
+                    func( buff, count );
+                }
+                else {
+                    func( reinterpret_cast < const char * > ( src + off ), count );
+                }
+            }
+        };
+        if ( traversal == Traversal::Sequential ) {
+            serve( m_data.data(), m_data.size() );
+            return;
+        }
+
+        // gather each tile into a cursor, the last row/column of tiles can be partial
+        std::vector < float > cursor;
+        for ( int ty = 0 ; ty < m_dims[1] ; ty += m_tileHeight ) {
+            for ( int tx = 0 ; tx < m_dims[0] ; tx += m_tileWidth ) {
+                cursor.clear();
+                for ( int y = ty ; y < std::min( ty + m_tileHeight, m_dims[1] ) ; ++y ) {
+                    for ( int x = tx ; x < std::min( tx + m_tileWidth, m_dims[0] ) ; ++x ) {
+                        cursor.push_back( m_data[y * m_dims[0] + x] );
+                    }
+                }
+                serve( cursor.data(), cursor.size() );
+            }
+        }
+    } // forEach
+
+    /// serve whole tiles (or the whole view), regardless of the buffer size, like a
+    /// badly behaved view would
+    void
+    serveWholeTiles()
+    {
+        m_wholeTiles = true;
+    }
+
+    /// traversal asked for by the last bulk forEach
+    Traversal
+    lastTraversal() const
+    {
+        return m_lastTraversal;
+    }
+
+private:
+
+    VI m_dims;
+    int m_tileWidth, m_tileHeight;
+    VI m_pos;
+    std::vector < float > m_data;
+    Traversal m_lastTraversal = Traversal::Sequential;
+    bool m_wholeTiles = false;
+};
+
+TEST_CASE( "Typed view bulk forEach on a tiled view", "[typedview]" ) {
+
+    // 16x16 tiles hold 256 pixels, much more than the blocks below
+    TiledRawView raw( 37, 29, 16, 16 );
+    const int64_t total = 37 * 29;
+    const int64_t blockSize = 7;
+
+    SECTION( "optimal traversal, no conversion") {
+        TypedView < float > view( & raw, false );
+        std::vector < float > values;
+        int64_t maxCount = 0;
+        view.forEach( blockSize, [&] ( const float * vals, int64_t count ) {
+                          maxCount = std::max( maxCount, count );
+                          values.insert( values.end(), vals, vals + count );
+                      }, RawViewInterface::Traversal::Optimal );
+        REQUIRE( maxCount <= blockSize );
+        REQUIRE( int64_t( values.size() ) == total );
+        std::sort( values.begin(), values.end() );
+        for ( int64_t i = 0 ; i < total ; ++i ) {
+            REQUIRE( values[i] == i );
+        }
+    }
+
+    SECTION( "optimal traversal, with conversion") {
+        TypedView < double > view( & raw, false );
+        std::vector < double > values;
+        int64_t maxCount = 0;
+        view.forEach( blockSize, [&] ( const double * vals, int64_t count ) {
+                          maxCount = std::max( maxCount, count );
+                          values.insert( values.end(), vals, vals + count );
+                      }, RawViewInterface::Traversal::Optimal );
+        REQUIRE( maxCount <= blockSize );
+        REQUIRE( int64_t( values.size() ) == total );
+        std::sort( values.begin(), values.end() );
+        for ( int64_t i = 0 ; i < total ; ++i ) {
+            REQUIRE( values[i] == i );
+        }
+    }
+
+    SECTION( "oversized raw blocks are split") {
+        raw.serveWholeTiles();
+        for ( auto traversal : { RawViewInterface::Traversal::Sequential,
+                                 RawViewInterface::Traversal::Optimal } ) {
+            TypedView < float > view( & raw, false );
+            TypedView < double > converted( & raw, false );
+            std::vector < float > values;
+            std::vector < double > convertedValues;
+            int64_t maxCount = 0;
+            view.forEach( blockSize, [&] ( const float * vals, int64_t count ) {
+                              maxCount = std::max( maxCount, count );
+                              values.insert( values.end(), vals, vals + count );
+                          }, traversal );
+            converted.forEach( blockSize, [&] ( const double * vals, int64_t count ) {
+                                   maxCount = std::max( maxCount, count );
+                                   convertedValues.insert( convertedValues.end(), vals, vals + count );
+                               }, traversal );
+            REQUIRE( maxCount <= blockSize );
+            REQUIRE( int64_t( values.size() ) == total );
+            REQUIRE( std::equal( values.begin(), values.end(), convertedValues.begin() ) );
+        }
+    }
+
+    SECTION( "without a mask the view picks the order") {
+        TypedView < double > view( & raw, false );
+        std::vector < double > values;
+        Carta::Core::Algorithms::forEachUnmasked(
+            view, nullptr, [&] ( const double * vals, int64_t count ) {
+                values.insert( values.end(), vals, vals + count );
+            }
+            );
+        REQUIRE( raw.lastTraversal() == RawViewInterface::Traversal::Optimal );
+
+        // the first tile comes first
+        REQUIRE( int64_t( values.size() ) == total );
+        for ( int i = 0 ; i < 16 * 16 ; ++i ) {
+            REQUIRE( values[i] == ( i / 16 ) * 37 + i % 16 );
+        }
+        std::sort( values.begin(), values.end() );
+        for ( int64_t i = 0 ; i < total ; ++i ) {
+            REQUIRE( values[i] == i );
+        }
+    }
+
+    SECTION( "unmasked pixels are visited in sequential order") {
+        TypedView < double > view( & raw, false );
+        BitMask mask( { 37, 29 }, true );
+        for ( int64_t i = 0 ; i < total ; i += 3 ) {
+            mask.set( i, false );
+        }
+        std::vector < double > values;
+        Carta::Core::Algorithms::forEachUnmasked(
+            view, & mask, [&] ( const double * vals, int64_t count ) {
+                values.insert( values.end(), vals, vals + count );
+            }
+            );
+        REQUIRE( raw.lastTraversal() == RawViewInterface::Traversal::Sequential );
+        std::vector < double > expected;
+        for ( int64_t i = 0 ; i < total ; ++i ) {
+            if ( mask.isValid( i ) ) {
+                expected.push_back( i );
+            }
+        }
+        REQUIRE( values == expected );
+    }
+}
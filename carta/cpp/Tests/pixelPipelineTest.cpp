@@ -1,7 +1,13 @@
 #include "catch.h"
 #include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
+#include "CartaLib/TPixelPipeline/FusedPipeline.h"
 #include "core/GrayColormap.h"
 #include <QColor>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <vector>
 
 using namespace Carta;
 
@@ -32,3 +38,140 @@ TEST_CASE( "Cached Pixel Pipeline testing", "[pp]" ) {
     }
 
 }
+
+TEST_CASE( "Batch pixel pipeline conversion", "[pp]" ) {
+
+    Core::GrayColormap::SharedPtr grayCmap = std::make_shared<Core::GrayColormap>();
+    Lib::PixelPipeline::CustomizablePixelPipeline pp;
+    pp.setColormap( grayCmap);
+    pp.setMinMax( -2, 2);
+
+    // values outside the clips, NaNs, and more than a block of them
+    const QRgb nanColor = qRgb( 255, 0, 0 );
+    std::vector<double> vals;
+    for( double x = -3 ; x < 3 ; x += 0.001) {
+        vals.push_back( x);
+        if( vals.size() % 17 == 0) {
+            vals.push_back( std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+    std::vector<float> fvals( vals.begin(), vals.end());
+    std::vector<QRgb> out( vals.size());
+
+    auto check = [&] ( const std::function<void(double, QRgb &)> & scalar) {
+        for( size_t i = 0 ; i < vals.size() ; i++) {
+            QRgb expected = nanColor;
+            if( ! std::isnan( vals[i])) {
+                scalar( vals[i], expected);
+            }
+            INFO( "value " << vals[i]);
+            REQUIRE( out[i] == expected);
+        }
+    };
+
+    SECTION( "Pipeline") {
+        pp.convertq( vals.data(), vals.size(), out.data(), nanColor);
+        check( [&] ( double x, QRgb & c) { pp.convertq( x, c); });
+    }
+
+    SECTION( "Cached") {
+        Lib::PixelPipeline::CachedPipeline<false> cpp;
+        cpp.cache( pp, 1000, -2, 2);
+        cpp.convertq( vals.data(), vals.size(), out.data(), nanColor);
+        check( [&] ( double x, QRgb & c) { cpp.convertq( x, c); });
+    }
+
+    SECTION( "Cached interpolated") {
+        Lib::PixelPipeline::CachedPipeline<true> cppi;
+        cppi.cache( pp, 10, -2, 2);
+        cppi.convertq( vals.data(), vals.size(), out.data(), nanColor);
+        check( [&] ( double x, QRgb & c) { cppi.convertq( x, c); });
+
+        // floats are converted exactly like the doubles they convert to
+        cppi.convertq( fvals.data(), fvals.size(), out.data(), nanColor);
+        for( size_t i = 0 ; i < vals.size() ; i++) {
+            QRgb expected = nanColor;
+            if( ! std::isnan( fvals[i])) {
+                cppi.convertq( double( fvals[i]), expected);
+            }
+            REQUIRE( out[i] == expected);
+        }
+    }
+}
+
+TEST_CASE( "Fused pixel pipeline", "[pp]" ) {
+
+    using Lib::PixelPipeline::ScaleType;
+    Core::GrayColormap::SharedPtr grayCmap = std::make_shared<Core::GrayColormap>();
+    Lib::PixelPipeline::CustomizablePixelPipeline pp;
+    pp.setColormap( grayCmap);
+    pp.setMinMax( -200, 200);
+    pp.setRgbMax( {{ 1.0, 0.5, 1.0 }});
+
+    const QRgb nanColor = qRgb( 255, 0, 0 );
+    std::vector<double> vals;
+    for( int x = -300 ; x <= 300 ; x++) {
+        vals.push_back( x);
+    }
+    vals.push_back( std::numeric_limits<double>::quiet_NaN());
+    std::vector<float> fvals( vals.begin(), vals.end());
+    std::vector<int16_t> ivals( vals.begin(), vals.end() - 1);
+    std::vector<QRgb> out( vals.size()), fout( vals.size()), iout( vals.size());
+
+    // the colormap is sampled into a table, so we allow for off-by-one colors, unless
+    // the colors are exact
+    typedef Lib::TemplatedPixelPipeline::FusedPipeline FusedPipeline;
+    auto close = [] ( QRgb c1, QRgb c2, FusedPipeline::Colors colors) {
+        if( colors == FusedPipeline::Colors::Exact) {
+            return c1 == c2;
+        }
+        return std::abs( qRed( c1) - qRed( c2)) <= 1 &&
+               std::abs( qGreen( c1) - qGreen( c2)) <= 1 &&
+               std::abs( qBlue( c1) - qBlue( c2)) <= 1;
+    };
+
+    for( FusedPipeline::Colors colors : { FusedPipeline::Colors::Table,
+                                          FusedPipeline::Colors::InterpolatedTable,
+                                          FusedPipeline::Colors::Exact }) {
+        for( ScaleType scale : { ScaleType::Linear, ScaleType::Sqr, ScaleType::Sqrt,
+                                 ScaleType::Log, ScaleType::Polynomial }) {
+            for( double gamma : { 1.0, 0.5 }) {
+                for( bool flip : { false, true }) {
+                    pp.setScale( scale);
+                    pp.setGamma( gamma);
+                    pp.setReverse( flip);
+                    pp.setInvert( ! flip);
+                    FusedPipeline fused;
+                    fused.setup( pp, colors, 1000);
+                    fused.convertq( vals.data(), vals.size(), out.data(), nanColor);
+                    fused.convertq( fvals.data(), fvals.size(), fout.data(), nanColor);
+                    fused.convertq( ivals.data(), ivals.size(), iout.data(), nanColor);
+                    for( size_t i = 0 ; i < ivals.size() ; i++) {
+                        QRgb expected;
+                        pp.convertq( vals[i], expected);
+                        INFO( "colors " << int( colors) << " scale " << int( scale)
+                              << " gamma " << gamma << " flip " << flip << " value " << vals[i]);
+                        REQUIRE( close( out[i], expected, colors));
+                        REQUIRE( close( fout[i], expected, colors));
+                        REQUIRE( close( iout[i], expected, colors));
+                    }
+                    REQUIRE( out.back() == nanColor);
+                    REQUIRE( fout.back() == nanColor);
+                }
+            }
+        }
+    }
+
+    // other clips keep the colors of the positions between them
+    pp.setScale( ScaleType::Linear);
+    pp.setGamma( 1);
+    FusedPipeline fused;
+    fused.setup( pp, FusedPipeline::Colors::Exact);
+    fused.setClips( -400, 400);
+    fused.convertq( vals.data(), vals.size(), out.data(), nanColor);
+    for( size_t i = 0 ; i < ivals.size() ; i++) {
+        QRgb expected;
+        pp.convertq( vals[i] / 2, expected);
+        REQUIRE( out[i] == expected);
+    }
+}
@@ -18,52 +18,57 @@ namespace Core
 {
 namespace Algorithms
 {
-/// compute requested quantiles
+/// number of pixels requested from views at a time
+static constexpr int64_t BulkBlockSize = 4096;
+
+/// visit all pixels of the view that are not masked, in blocks
 /// \param view the input dataset
-/// \param quant which quantiles to compute
-/// \return the computed quantiles. If all inputs are nans, the result will also be nans.
-///
-/// Example: [0.1] will compute a value such that 10% of all values are smaller than the returned
-/// value.
-///
-/// \note this is a dumb algorithm using quickselect. It really only works on datasets that
-/// are small enough to store in memory. For really big datasets we need a lot more sophisticated
-/// algorithm.
-///
-/// \note NANs are treated as if they did not exist
+/// \param mask optional mask for the view (nullptr means all pixels are valid)
+/// \param func invoked as func( const Scalar * values, int64_t count )
+/// \param maskOffset index of the view's first pixel in the mask, for views that cover
+/// only a part of what the mask describes (e.g. a band of rows of a frame)
 ///
-/// \note for best performance, the supplied list of quantiles should be sorted small->large
-template < typename Scalar >
-static
-typename std::vector < Scalar >
-quantiles2pixels(
+/// \note without a mask the view picks the fastest traversal (e.g. tile by tile), so the
+/// pixels come in no particular order. With a mask the view is traversed sequentially,
+/// so that the pixels line up with the bits of the mask, which is then scanned a word at
+/// a time.
+template < typename Scalar, typename Func >
+static void
+forEachUnmasked(
     Carta::Lib::NdArray::TypedView < Scalar > & view,
-    std::vector < double > quant
-    )
+    const Carta::Lib::NdArray::BitMask * mask,
+    Func func,
+    int64_t maskOffset = 0 )
 {
-    qDebug() << "computeClips" << view.dims();
-
-    // basic preconditions
-    if ( CARTA_RUNTIME_CHECKS ) {
-        for ( auto q : quant ) {
-            CARTA_ASSERT( 0.0 <= q && q <= 1.0 );
-            Q_UNUSED(q);
-        }
+    typedef Carta::Lib::NdArray::RawViewInterface::Traversal Traversal;
+    if ( ! mask ) {
+        view.forEach( BulkBlockSize, func, Traversal::Optimal );
+        return;
     }
-
-    // read in all values from the view into memory so that we can do quickselect on it
-    std::vector < Scalar > allValues;
-    view.forEach(
-        [& allValues] ( const Scalar & val ) {
-            if ( ! std::isnan( val ) ) {
-                allValues.push_back( val );
+    int64_t index = maskOffset;
+    auto lambda = [&] ( const Scalar * vals, int64_t count ) {
+        mask-> forEachRun( index, count, [&] ( int64_t first, int64_t n, bool valid ) {
+            if ( valid ) {
+                func( vals + ( first - index ), n );
             }
-        }
-        );
+        } );
+        index += count;
+    };
+    view.forEach( BulkBlockSize, lambda, Traversal::Sequential );
+}
 
+/// compute requested quantiles of values that are already in memory
+/// \param allValues the values (no nans), they will be reordered
+/// \param quant which quantiles to compute
+/// \return the computed quantiles, nans if there were no values
+template < typename Scalar >
+static
+typename std::vector < Scalar >
+selectQuantiles( std::vector < Scalar > & allValues, const std::vector < double > & quant )
+{
     // indicate bad clip if no finite numbers were found
     if ( allValues.size() == 0 ) {
-        return std::vector < Scalar > ( std::numeric_limits < Scalar >::quiet_NaN(), quant.size() );
+        return std::vector < Scalar > ( quant.size(), std::numeric_limits < Scalar >::quiet_NaN() );
     }
 
     // for every input quantile, do quickselect and store the result
@@ -94,20 +99,88 @@ quantiles2pixels(
     }
 
     return result;
+} // selectQuantiles
+
+/// compute requested quantiles
+/// \param view the input dataset
+/// \param quant which quantiles to compute
+/// \param mask optional mask, masked pixels are ignored
+/// \return the computed quantiles. If all inputs are nans, the result will also be nans.
+///
+/// Example: [0.1] will compute a value such that 10% of all values are smaller than the returned
+/// value.
+///
+/// \note this is a dumb algorithm using quickselect. It really only works on datasets that
+/// are small enough to store in memory. For really big datasets we need a lot more sophisticated
+/// algorithm.
+///
+/// \note NANs (and masked pixels) are treated as if they did not exist
+///
+/// \note for best performance, the supplied list of quantiles should be sorted small->large
+///
+/// \note the order does not matter for quantiles, so without a mask the pixels are visited
+/// in the view's optimal (e.g. tile) order, see forEachUnmasked()
+template < typename Scalar >
+static
+typename std::vector < Scalar >
+quantiles2pixels(
+    Carta::Lib::NdArray::TypedView < Scalar > & view,
+    std::vector < double > quant,
+    const Carta::Lib::NdArray::BitMask * mask = nullptr
+    )
+{
+    qDebug() << "computeClips" << view.dims();
+
+    // basic preconditions
+    if ( CARTA_RUNTIME_CHECKS ) {
+        for ( auto q : quant ) {
+            CARTA_ASSERT( 0.0 <= q && q <= 1.0 );
+            Q_UNUSED(q);
+        }
+    }
+
+    // read in all values from the view into memory so that we can do quickselect on it
+    std::vector < Scalar > allValues;
+    size_t nPixels = 1;
+    for ( auto d : view.dims() ) {
+        nPixels *= d;
+    }
+    if ( mask ) {
+        nPixels = mask-> countValid();
+    }
+    allValues.reserve( nPixels );
+    forEachUnmasked(
+        view, mask,
+        [& allValues] ( const Scalar * vals, int64_t count ) {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( ! std::isnan( vals[i] ) ) {
+                    allValues.push_back( vals[i] );
+                }
+            }
+        }
+        );
+
+    return selectQuantiles( allValues, quant );
 } // computeClips
 
 /// algorithm for finding quantile from pixel value
+/// \param mask optional mask, masked pixels are ignored
 template < typename Scalar >
 static
-double pixel2quantile ( Carta::Lib::NdArray::TypedView < Scalar > & view, Scalar pixel)
+double pixel2quantile ( Carta::Lib::NdArray::TypedView < Scalar > & view, Scalar pixel,
+                        const Carta::Lib::NdArray::BitMask * mask = nullptr )
 {
     u_int64_t totalCount = 0;
     u_int64_t countBelow = 0;
-    view.forEach([&](const Scalar & val) {
-        if( Q_UNLIKELY( std::isnan(val))) return;
-        totalCount ++;
-        if( val <= pixel) countBelow++;
-    });
+    // order does not matter here, so without a mask the view picks the fastest traversal
+    forEachUnmasked( view, mask, [&] ( const Scalar * vals, int64_t count ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            const Scalar & val = vals[i];
+            if( Q_UNLIKELY( std::isnan(val))) continue;
+            totalCount ++;
+            if( val <= pixel) countBelow++;
+        }
+    } );
     return double(countBelow) / totalCount;
 }
 
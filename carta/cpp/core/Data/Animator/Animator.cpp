@@ -55,6 +55,8 @@ QString Animator::addLink( CartaObject* cartaObject ){
                     this, SLOT(_axesChanged()));
             connect( controller, SIGNAL(frameChanged(Controller*, Carta::Lib::AxisInfo::KnownType)),
                     this, SLOT(_updateFrame(Controller*, Carta::Lib::AxisInfo::KnownType)));
+            connect( controller, SIGNAL(frameRepainted(Controller*, const std::vector<int>&)),
+                    this, SLOT(_frameRepainted(Controller*, const std::vector<int>&)));
         }
     }
     else {
@@ -207,6 +209,21 @@ void Animator::clear(){
 
 void Animator::_frameChanged( int index, const QString& axisName ){
     changeFrame( index, axisName );
+    _renderAhead( axisName );
+}
+
+void Animator::_frameRepainted( Controller* /*controller*/, const std::vector<int>& frames ){
+    //Each axis animator finds its frame among the ones shown; with several linked
+    //images, the first one to show a frame counts.
+    QList<QString> keys = m_animators.keys();
+    for ( const QString& key : keys ){
+        AxisInfo::KnownType axisType = AxisMapper::getType( key );
+        int axisIndex = static_cast<int>( axisType );
+        if ( key != Selection::IMAGE && axisType != AxisInfo::KnownType::OTHER &&
+                axisIndex < static_cast<int>( frames.size() ) ){
+            m_animators[key]->_frameRepainted( frames[axisIndex] );
+        }
+    }
 }
 
 AnimatorType* Animator::getAnimator( const QString& type ){
@@ -472,6 +489,24 @@ QString Animator::removeLink( CartaObject* cartaObject ){
 }
 
 
+void Animator::_renderAhead( const QString& animName ){
+    //Different images are different layers, so only the frames along an axis of
+    //the images are rendered ahead.
+    AxisInfo::KnownType axisType = AxisMapper::getType( animName );
+    if ( animName == Selection::IMAGE || axisType == AxisInfo::KnownType::OTHER ||
+            !m_animators.contains( animName ) ){
+        return;
+    }
+    std::vector<int> frames = m_animators[animName]->getFramesAhead();
+    int linkCount = m_linkImpl->getLinkCount();
+    for( int i = 0; i < linkCount; i++ ){
+        Controller* controller = dynamic_cast<Controller*>( m_linkImpl->getLink(i));
+        if ( controller != nullptr ){
+            controller->_renderAhead( frames, axisType );
+        }
+    }
+}
+
 void Animator::_resetAnimationParameters( int selectedImage ){
     _addRemoveImageAnimator();
     if ( m_animators.contains( Selection::IMAGE) ){
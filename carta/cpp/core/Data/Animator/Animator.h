@@ -143,6 +143,7 @@ private slots:
     void _adjustStateController( Controller* controller);
     void _axesChanged();
     void _frameChanged( int index, const QString& axisName );
+    void _frameRepainted( Controller* controller, const std::vector<int>& frames );
     void _updateFrame( Controller* controller, Carta::Lib::AxisInfo::KnownType type );
 
 private:
@@ -165,6 +166,9 @@ private:
     void _initializeCallbacks();
     QString _initAnimator( const QString& type, bool* newAnimator );
 
+    //Render the frames the animator is expected to show next.
+    void _renderAhead( const QString& animName );
+
     void _resetAnimationParameters( int selectedImage );
 
     //Reset the preferences state of an individual animator.
@@ -3,6 +3,7 @@
 #include "Data/Util.h"
 #include "State/UtilState.h"
 
+#include <algorithm>
 #include <set>
 
 #include <QDebug>
@@ -23,6 +24,7 @@ public:
 
 
 const QString AnimatorType::COMMAND_SET_FRAME = "setFrame";
+const QString AnimatorType::COMMAND_PLAY_FRAME = "playFrame";
 const QString AnimatorType::END_BEHAVIOR = "endBehavior";
 const QString AnimatorType::END_BEHAVIOR_WRAP = "Wrap";
 const QString AnimatorType::END_BEHAVIOR_JUMP = "Jump";
@@ -30,19 +32,54 @@ const QString AnimatorType::END_BEHAVIOR_REVERSE = "Reverse";
 const QString AnimatorType::RATE = "frameRate";
 const QString AnimatorType::SETTINGS_VISIBLE = "showSettings";
 const QString AnimatorType::STEP = "frameStep";
+const QString AnimatorType::STATISTICS = "statistics";
+const QString AnimatorType::FPS_ACHIEVED = "fpsAchieved";
+const QString AnimatorType::FRAMES_DROPPED = "framesDropped";
+const QString AnimatorType::FRAME_LATENCY = "frameLatency";
 
 const QString AnimatorType::CLASS_NAME = "AnimatorType";
 const QString AnimatorType::ANIMATIONS = "animators";
 
+//How far ahead (in milliseconds of playing) frames are rendered, and at most how
+//many of them.
+const int AnimatorType::RENDER_AHEAD_TIME = 2000;
+const int AnimatorType::RENDER_AHEAD_FRAMES_MAX = 64;
+
+//A step that comes this much later (in milliseconds) than the frame interval
+//starts the animation anew instead of skipping frames to catch up.
+const int AnimatorType::PLAY_GAP_MAX = 1000;
+
+//How many of the frames played last are kept, to recognize the steps of a client
+//that is behind and to tell when the frames are shown.
+const int AnimatorType::PLAY_LOG_MAX = 256;
+
+//How often (in milliseconds) the playback statistics are published, and over how
+//long a time the achieved frame rate is measured.
+const int AnimatorType::STATISTICS_INTERVAL = 500;
+const int AnimatorType::FPS_TIME = 2000;
+
 bool AnimatorType::m_registered =
         Carta::State::ObjectManager::objectManager()->registerClass (CLASS_NAME,
                                                    new AnimatorType::Factory());
 
 AnimatorType::AnimatorType(const QString& path, const QString& id ):
-	CartaObject( CLASS_NAME, path, id ){
+	CartaObject( CLASS_NAME, path, id ),
+	m_stateStatistics( Carta::State::UtilState::getLookup( path, STATISTICS ) ){
         m_select = nullptr;
         m_removed = false;
         m_visible = true;
+        m_frameLast = 0;
+        m_direction = 0;
+        m_playClock.start();
+        m_playTime = -1;
+        m_playCredit = 0;
+        m_playDirectionRequested = 0;
+        m_playFrame = -1;
+        m_playDirection = 0;
+        m_playShownCount = 0;
+        m_latency = -1;
+        m_framesDropped = 0;
+        m_statisticsTime = 0;
         _initializeState();
         _makeSelection();
 
@@ -56,6 +93,83 @@ int AnimatorType::getFrame() const {
     return m_select->getIndex();
 }
 
+std::vector<int> AnimatorType::getFramesAhead() const {
+    std::vector<int> frames;
+    if ( m_direction == 0 ){
+        return frames;
+    }
+    //Enough frames to keep playing for a while.
+    int interval = getFrameInterval();
+    int count = ( RENDER_AHEAD_TIME + interval - 1 ) / interval;
+    count = qBound( 1, count, RENDER_AHEAD_FRAMES_MAX );
+    int current = m_select->getIndex();
+    int frame = current;
+    int direction = m_direction;
+    for ( int i = 0; i < count; i++ ){
+        frame = _getFrameNext( frame, direction );
+        //A short animation comes around again.
+        if ( frame == current || std::find( frames.begin(), frames.end(), frame ) != frames.end() ){
+            break;
+        }
+        frames.push_back( frame );
+    }
+    return frames;
+}
+
+int AnimatorType::getFrameInterval() const {
+    //Same as the client, the rate goes from 1 (slowest) to 100 (fastest).
+    const int RATE_MAX = 100;
+    const int INTERVAL_MIN = 10;
+    const int INTERVAL_MAX = 2000;
+    int rate = m_state.getValue<int>( RATE );
+    int interval = qRound( ( 1 - double( rate ) / RATE_MAX ) * INTERVAL_MAX );
+    return qMax( interval, INTERVAL_MIN );
+}
+
+int AnimatorType::_getStepDirection( int frameFrom, int frameTo ) const {
+    //Try the way the animation was going first.
+    int first = m_direction < 0 ? -1 : 1;
+    int stepDirection = 0;
+    for ( int direction : { first, -first } ){
+        int nextDirection = direction;
+        if ( frameFrom != frameTo && _getFrameNext( frameFrom, nextDirection ) == frameTo ){
+            stepDirection = direction;
+            break;
+        }
+    }
+    return stepDirection;
+}
+
+int AnimatorType::_getFrameNext( int frame, int& direction ) const {
+    int lowerBound = m_select->getLowerBoundUser();
+    int upperBound = m_select->getUpperBoundUser();
+    QString endBehavior = m_state.getValue<QString>( END_BEHAVIOR );
+    int next = frame;
+    if ( endBehavior == END_BEHAVIOR_JUMP ){
+        //Back and forth between the bounds.
+        if ( direction > 0 ){
+            next = frame < upperBound ? upperBound : lowerBound;
+        }
+        else {
+            next = frame > lowerBound ? lowerBound : upperBound;
+        }
+    }
+    else {
+        int step = m_state.getValue<int>( STEP );
+        next = frame + direction * step;
+        if ( next < lowerBound || upperBound < next ){
+            if ( endBehavior == END_BEHAVIOR_REVERSE ){
+                direction = -direction;
+                next = qBound( lowerBound, frame + direction * step, upperBound );
+            }
+            else {
+                next = direction > 0 ? lowerBound : upperBound;
+            }
+        }
+    }
+    return next;
+}
+
 QString AnimatorType::getStateData() const {
     QString result = m_select->getStateString();
     return result;
@@ -77,6 +191,11 @@ void AnimatorType::_initializeState( ){
     m_state.insertValue<QString>( END_BEHAVIOR, "Wrap");
     //m_state.insertValue<bool>( VISIBLE, true);
     m_state.flushState();
+
+    m_stateStatistics.insertValue<double>( FPS_ACHIEVED, 0 );
+    m_stateStatistics.insertValue<int>( FRAMES_DROPPED, 0 );
+    m_stateStatistics.insertValue<int>( FRAME_LATENCY, 0 );
+    m_stateStatistics.flushState();
 }
 
 void AnimatorType::_initializeCommands(){
@@ -97,6 +216,22 @@ void AnimatorType::_initializeCommands(){
 	    return result;
 	});
 
+	//The next frame of a playing animation.
+	addCommandCallback( COMMAND_PLAY_FRAME, [=] (const QString & /*cmd*/,
+	                 const QString & params, const QString & /*sessionId*/) -> QString {
+	    QString result;
+	    bool validInt = false;
+	    int index = params.toInt( &validInt );
+	    if ( validInt ){
+	        result = playFrame( index );
+	    }
+	    else {
+	        result = "Animator index must be a valid integer "+params;
+	    }
+	    Util::commandPostProcess( result );
+	    return result;
+	});
+
 	addCommandCallback( "setUpperBoundUser", [=] (const QString & /*cmd*/,
 	                     const QString & params, const QString & /*sessionId*/) -> QString {
 	        QString result;
@@ -232,8 +367,67 @@ void AnimatorType::resetStateData( const QString& state ){
     }
 }
 
+void AnimatorType::_frameRepainted( int frame ){
+    //Frames played before the one shown never made it to the view.
+    const double LATENCY_WEIGHT = 0.2;
+    int playCount = m_playLog.size();
+    for ( int i = m_playShownCount; i < playCount; i++ ){
+        if ( m_playLog[i].first == frame ){
+            qint64 now = m_playClock.elapsed();
+            double latency = now - m_playLog[i].second;
+            if ( m_latency < 0 ){
+                m_latency = latency;
+            }
+            else {
+                m_latency = m_latency + LATENCY_WEIGHT * ( latency - m_latency );
+            }
+            m_framesDropped = m_framesDropped + i - m_playShownCount;
+            m_playShownCount = i + 1;
+            m_repaintTimes.push_back( now );
+            while ( m_repaintTimes.front() < now - FPS_TIME ){
+                m_repaintTimes.pop_front();
+            }
+            if ( now - m_statisticsTime >= STATISTICS_INTERVAL ){
+                _saveStatistics();
+            }
+            break;
+        }
+    }
+}
+
+void AnimatorType::_saveStatistics(){
+    double fps = 0;
+    if ( m_repaintTimes.size() >= 2 ){
+        qint64 span = m_repaintTimes.back() - m_repaintTimes.front();
+        if ( span > 0 ){
+            fps = ( m_repaintTimes.size() - 1 ) * 1000.0 / span;
+        }
+    }
+    m_stateStatistics.setValue<double>( FPS_ACHIEVED, qRound( fps * 10 ) / 10.0 );
+    m_stateStatistics.setValue<int>( FRAMES_DROPPED, m_framesDropped );
+    m_stateStatistics.setValue<int>( FRAME_LATENCY, m_latency < 0 ? 0 : qRound( m_latency ) );
+    m_stateStatistics.flushState();
+    m_statisticsTime = m_playClock.elapsed();
+}
+
 void AnimatorType::_selectionChanged(){
-    emit indexChanged( m_select->getIndex(), m_type );
+    //Figure out whether the animation took a step, and which way.
+    int frame = m_select->getIndex();
+    int direction = 0;
+    if ( frame == m_playFrame ){
+        //A step of a playing animation, which may have skipped frames.
+        direction = m_playDirection;
+    }
+    else {
+        direction = _getStepDirection( m_frameLast, frame );
+        if ( direction != 0 ){
+            //Turning around at the end changes the direction of the next step.
+            _getFrameNext( m_frameLast, direction );
+        }
+    }
+    m_direction = direction;
+    m_frameLast = frame;
+    emit indexChanged( frame, m_type );
 }
 
 void AnimatorType::_setType( const QString& type ){
@@ -297,6 +491,77 @@ QString AnimatorType::setFrame( int frameIndex ){
     return result;
 }
 
+QString AnimatorType::playFrame( int frameIndex ){
+    if ( frameIndex < 0 ){
+        return setFrame( frameIndex );
+    }
+    qint64 now = m_playClock.elapsed();
+    int interval = getFrameInterval();
+    int current = m_select->getIndex();
+
+    //Find the frame the client took the step from, newest first.
+    int base = current;
+    int requestDirection = _getStepDirection( current, frameIndex );
+    for ( auto it = m_playLog.rbegin(); requestDirection == 0 && it != m_playLog.rend(); ++it ){
+        base = it->first;
+        requestDirection = _getStepDirection( base, frameIndex );
+    }
+    if ( requestDirection == 0 ){
+        //Not a step, the client went somewhere else.
+        m_playTime = -1;
+        return setFrame( frameIndex );
+    }
+
+    int frame = frameIndex;
+    int direction = requestDirection;
+    if ( m_playTime >= 0 && now - m_playTime <= interval + PLAY_GAP_MAX ){
+        //Carry on from the current frame; a client that is behind does not know
+        //where the animation turned around, but it can ask to go the other way.
+        if ( base != current && requestDirection == m_playDirectionRequested && m_direction != 0 ){
+            direction = m_direction;
+        }
+        double due = m_playCredit + double( now - m_playTime ) / interval;
+        int steps = qMax( 1, int( due ) );
+        m_playCredit = qBound( 0.0, due - steps, 1.0 );
+        frame = current;
+        for ( int i = 0; i < steps; i++ ){
+            frame = _getFrameNext( frame, direction );
+        }
+        m_framesDropped = m_framesDropped + steps - 1;
+    }
+    else {
+        //Starting to play.
+        _getFrameNext( base, direction );
+        m_playCredit = 0;
+        m_playLog.clear();
+        m_playShownCount = 0;
+        m_repaintTimes.clear();
+        m_latency = -1;
+        m_framesDropped = 0;
+        m_statisticsTime = now - STATISTICS_INTERVAL;
+    }
+    m_playTime = now;
+    m_playDirectionRequested = requestDirection;
+
+    m_playLog.push_back( std::make_pair( frame, now ) );
+    if ( static_cast<int>( m_playLog.size() ) > PLAY_LOG_MAX ){
+        //A frame that has not been shown by now never will be.
+        if ( m_playShownCount > 0 ){
+            m_playShownCount--;
+        }
+        else {
+            m_framesDropped++;
+        }
+        m_playLog.pop_front();
+    }
+
+    m_playFrame = frame;
+    m_playDirection = direction;
+    QString result = setFrame( frame );
+    m_playFrame = -1;
+    return result;
+}
+
 QString AnimatorType::setLowerBoundUser( int lowerBound ){
     QString result = m_select->setLowerBoundUser( lowerBound );
     return result;
@@ -5,7 +5,11 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
+#include <utility>
+#include <vector>
+#include <QElapsedTimer>
 #include <QObject>
 #include <State/StateInterface.h>
 #include <State/ObjectManager.h>
@@ -30,6 +34,21 @@ public:
      */
     int getFrame() const;
 
+    /**
+     * Return the frames the animation is expected to show next, following the
+     * direction of the last frame change, the frame step and the end behavior.
+     * @return the upcoming frame indices, in order, for about as long as the frames
+     *      can be kept; an empty list if the last frame change was not a step of the
+     *      animation (for example, the user jumped to a frame).
+     */
+    std::vector<int> getFramesAhead() const;
+
+    /**
+     * Return the time between frames when the animation is playing.
+     * @return the frame interval in milliseconds.
+     */
+    int getFrameInterval() const;
+
     /**
      * Returns a json string representing the user preferences.
      * @return a Json string representing user preferences.
@@ -71,6 +90,18 @@ public:
      */
     QString setFrame( int frameIndex );
 
+    /**
+     * Take the next step of a playing animation.
+     * @param frameIndex the frame the client wants to show next.
+     * @return an error message if there is one; otherwise an empty string;
+     *
+     * The client asks for the step after the last frame it heard of, which lags behind
+     * on a slow link, so a step from any frame played recently counts as the next step
+     * from the current one. Steps that come late are made up for by skipping frames,
+     * so the animation keeps its pace.
+     */
+    QString playFrame( int frameIndex );
+
     /**
      * Set the animation speed.
      * @param rate a positive rate indicator.
@@ -123,6 +154,10 @@ public:
     static const QString CLASS_NAME;
     static const QString ANIMATIONS;
     static const QString SETTINGS_VISIBLE;
+    static const QString STATISTICS;
+    static const QString FPS_ACHIEVED;
+    static const QString FRAMES_DROPPED;
+    static const QString FRAME_LATENCY;
 
     virtual ~AnimatorType();
 
@@ -149,6 +184,26 @@ private:
 
     QString _makeSelection();
 
+    //Return the frame following the given one when moving in the given direction
+    //(1 or -1), which changes if the animation turns around at the end.
+    int _getFrameNext( int frame, int& direction ) const;
+
+    //Return the direction (1 or -1) in which going from one frame to the other is a
+    //step of the animation, or 0 if it is not.
+    int _getStepDirection( int frameFrom, int frameTo ) const;
+
+    /**
+     * Notification that a view has shown the given frame.
+     * @param frame - the frame along the axis of this animator.
+     *
+     * The time it took since the frame was played, and the frames played before it
+     * that were never shown, go into the playback statistics.
+     */
+    void _frameRepainted( int frame );
+
+    //Publish the playback statistics.
+    void _saveStatistics();
+
     //Set state variables involving the animator
     void _saveState();
 
@@ -158,6 +213,7 @@ private:
     Selection* m_select;
     QString m_type;
     const static QString COMMAND_SET_FRAME;
+    const static QString COMMAND_PLAY_FRAME;
     const static QString END_BEHAVIOR;
     const static QString END_BEHAVIOR_WRAP;
     const static QString END_BEHAVIOR_JUMP;
@@ -167,6 +223,46 @@ private:
 
     bool m_visible;
     bool m_removed;
+
+    //The last frame, and which way the animation went to get from it to the current
+    //one (0 if it was not a step of the animation).
+    int m_frameLast;
+    int m_direction;
+
+    //When the last step was played, the part of a step that was due but not taken
+    //yet, and which way the client asked to go.
+    QElapsedTimer m_playClock;
+    qint64 m_playTime;
+    double m_playCredit;
+    int m_playDirectionRequested;
+
+    //The frame being played and the direction to carry on in after it.
+    int m_playFrame;
+    int m_playDirection;
+
+    //The frames played recently, with the time they were played; the first
+    //m_playShownCount of them have been shown or dropped.
+    std::deque<std::pair<int,qint64> > m_playLog;
+    int m_playShownCount;
+
+    //Playback statistics: when the recent frames were shown, the average time it
+    //took from playing a frame to showing it (negative if there is none yet), and
+    //the number of frames that were not shown.
+    std::deque<qint64> m_repaintTimes;
+    double m_latency;
+    int m_framesDropped;
+    qint64 m_statisticsTime;
+
+    //Separate state for the playback statistics since they get updated rapidly
+    //while playing and not everyone wants to listen to them.
+    Carta::State::StateInterface m_stateStatistics;
+
+    const static int RENDER_AHEAD_TIME;
+    const static int RENDER_AHEAD_FRAMES_MAX;
+    const static int PLAY_GAP_MAX;
+    const static int PLAY_LOG_MAX;
+    const static int STATISTICS_INTERVAL;
+    const static int FPS_TIME;
     AnimatorType( const AnimatorType& other);
     AnimatorType& operator=( const AnimatorType& other );
 };
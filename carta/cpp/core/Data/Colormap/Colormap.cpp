@@ -137,17 +137,17 @@ void Colormap::_calculateColorStops(){
 
             std::shared_ptr<Carta::Lib::PixelPipeline::CustomizablePixelPipeline> pipe = dSource->_getPipeline();
             if ( pipe ){
+                const int STOP_COUNT = 100;
+                float vals[STOP_COUNT];
+                for ( int i = 0; i < STOP_COUNT; i++ ){
+                    vals[i] = i / 100.0f;
+                }
+                QRgb colors[STOP_COUNT];
+                pipe->convertq( vals, STOP_COUNT, colors, QColor( Qt::black ).rgb() );
                 QStringList buff;
-                for ( int i = 0; i < 100; i++ ){
-                    float val = i / 100.0f;
-                    Carta::Lib::PixelPipeline::NormRgb normRgb;
-                    pipe->convert( val, normRgb );
-                    QColor mapColor;
-                    if ( normRgb[0] >= 0 && normRgb[1] >= 0 && normRgb[2] >= 0 ){
-                        mapColor = QColor::fromRgbF( normRgb[0], normRgb[1], normRgb[2] );
-                    }
-                    QString hexStr = mapColor.name();
-                    if ( i < 99 ){
+                for ( int i = 0; i < STOP_COUNT; i++ ){
+                    QString hexStr = QColor( colors[i] ).name();
+                    if ( i < STOP_COUNT - 1 ){
                         hexStr = hexStr + ",";
                     }
                     buff.append( hexStr );
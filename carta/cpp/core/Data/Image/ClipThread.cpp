@@ -0,0 +1,114 @@
+#include "ClipThread.h"
+#include "CartaLib/IImage.h"
+#include "CartaLib/BitMask.h"
+#include "../../Algorithms/quantileAlgorithms.h"
+#include <QDebug>
+#include <cmath>
+
+namespace Carta
+{
+namespace Data
+{
+
+//Number of steps in which the frame is processed, which is also the granularity
+//of progress reports and cancellation.
+static const int BAND_COUNT = 20;
+
+ClipThread::ClipThread( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+        std::shared_ptr<Carta::Lib::NdArray::BitMask> mask,
+        double minPercentile, double maxPercentile, int quantileIndex, QObject* parent ):
+    QThread( parent ),
+    m_mask( mask ),
+    m_percentiles( { minPercentile, maxPercentile } ),
+    m_quantileIndex( quantileIndex ),
+    m_canceled( false ){
+    //The view may be in use by the render service, so we read our own copy.
+    if ( view ){
+        m_view.reset( view->clone() );
+    }
+}
+
+void ClipThread::cancel(){
+    m_canceled = true;
+}
+
+bool ClipThread::isCanceled() const {
+    return m_canceled;
+}
+
+std::vector<double> ClipThread::getPercentiles() const {
+    return m_percentiles;
+}
+
+int ClipThread::getQuantileIndex() const {
+    return m_quantileIndex;
+}
+
+std::vector<double> ClipThread::getResult() const {
+    return m_result;
+}
+
+
+void ClipThread::run(){
+    m_result.clear();
+    if ( !m_view ){
+        return;
+    }
+    const std::vector<int>& dims = m_view->dims();
+    int64_t width = dims.size() > 0 ? dims[0] : 1;
+    int height = dims.size() > 1 ? dims[1] : 1;
+    if ( width * height == 0 ){
+        return;
+    }
+    int64_t pixelCount = 1;
+    for ( int dim : dims ){
+        pixelCount = pixelCount * dim;
+    }
+    //Masked pixels do not count, as long as the mask matches the view.
+    if ( m_mask && m_mask->dims() != dims ){
+        m_mask.reset();
+    }
+    std::vector<double> allValues;
+    allValues.reserve( m_mask ? m_mask->countValid() : pixelCount );
+
+    //Read the frame in bands of rows, so that we can report progress and stop
+    //when we are no longer needed. Bands only make sense for a single plane.
+    int bandHeight = height;
+    if ( pixelCount == width * height ){
+        bandHeight = std::max( 1, int( std::ceil( double( height ) / BAND_COUNT ) ) );
+    }
+    for ( int y = 0; y < height; y = y + bandHeight ){
+        if ( m_canceled ){
+            m_result.clear();
+            return;
+        }
+        int yEnd = std::min( y + bandHeight, height );
+        SliceND bandSlice;
+        bandSlice.next().start( y ).end( yEnd );
+        std::unique_ptr<Carta::Lib::NdArray::RawViewInterface> band( m_view->getView( bandSlice ) );
+        Carta::Lib::NdArray::Double bandView( band.get(), false );
+        //The rows are contiguous in the mask, so the band starts at row y of the frame.
+        Carta::Core::Algorithms::forEachUnmasked( bandView, m_mask.get(),
+                [&allValues] ( const double* vals, int64_t count ) {
+            for ( int64_t i = 0; i < count; i++ ){
+                if ( !std::isnan( vals[i] ) ){
+                    allValues.push_back( vals[i] );
+                }
+            }
+        }, y * width );
+        emit progress( double( yEnd ) / height );
+    }
+
+    std::vector<double> clips = Carta::Core::Algorithms::selectQuantiles( allValues, m_percentiles );
+    if ( clips.size() >= 2 && !std::isnan( clips[0] ) && !std::isnan( clips[1] ) ){
+        m_result = clips;
+    }
+}
+
+
+ClipThread::~ClipThread(){
+    cancel();
+    wait();
+}
+}
+}
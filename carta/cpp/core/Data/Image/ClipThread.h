@@ -0,0 +1,105 @@
+/**
+ * A thread that computes the clip values (intensities at the given percentiles) of
+ * an image frame in the background, so that opening a large image or moving to a new
+ * frame does not block the user interface.
+ **/
+
+#pragma once
+
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Carta {
+namespace Lib {
+    namespace NdArray {
+        class RawViewInterface;
+        class BitMask;
+    }
+}
+
+namespace Data{
+
+class ClipThread : public QThread {
+
+    Q_OBJECT;
+
+public:
+
+    /**
+     * Constructor.
+     * @param view - the frame to compute the clips for; the thread reads its own copy.
+     * @param mask - the mask of the frame, or nullptr if there is none.
+     * @param minPercentile - the percentile of the lower clip.
+     * @param maxPercentile - the percentile of the upper clip.
+     * @param quantileIndex - an identifier of the frame in the clip cache.
+     * @param parent - the parent object.
+     */
+    ClipThread( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+            std::shared_ptr<Carta::Lib::NdArray::BitMask> mask,
+            double minPercentile, double maxPercentile, int quantileIndex,
+            QObject* parent = nullptr );
+
+    /**
+     * Ask the thread to stop as soon as possible; the result will be empty.
+     */
+    void cancel();
+
+    /**
+     * Returns true if the computation was canceled.
+     * @return - true if the computation was canceled; false otherwise.
+     */
+    bool isCanceled() const;
+
+    /**
+     * Returns the percentiles the clips are computed for.
+     * @return - the lower and upper percentile.
+     */
+    std::vector<double> getPercentiles() const;
+
+    /**
+     * Returns the identifier of the frame in the clip cache.
+     * @return - the index of the frame in the clip cache.
+     */
+    int getQuantileIndex() const;
+
+    /**
+     * Returns the computed clips.
+     * @return - the lower and upper clip, or an empty list if the computation
+     *      was canceled or there were no valid pixels.
+     */
+    std::vector<double> getResult() const;
+
+    /**
+     * Run the thread.
+     */
+    void run();
+
+    /**
+     * Destructor.
+     */
+    ~ClipThread();
+
+signals:
+
+    /**
+     * Reports the fraction of the frame processed so far.
+     * @param fraction - a number between 0 and 1.
+     */
+    void progress( double fraction );
+
+private:
+
+    std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> m_view;
+    std::shared_ptr<Carta::Lib::NdArray::BitMask> m_mask;
+    std::vector<double> m_percentiles;
+    int m_quantileIndex;
+    std::vector<double> m_result;
+    std::atomic<bool> m_canceled;
+
+    ClipThread( const ClipThread& other);
+    ClipThread& operator=( const ClipThread& other );
+};
+}
+}
@@ -4,6 +4,7 @@
 #include "Data/Image/DataFactory.h"
 #include "Data/Image/Stack.h"
 #include "Data/Image/DataSource.h"
+#include "Data/Image/LoadThread.h"
 #include "Data/Image/Grid/AxisMapper.h"
 #include "Data/Image/Grid/DataGrid.h"
 #include "Data/Image/Grid/GridControls.h"
@@ -43,6 +44,7 @@ public:
     }
 };
 
+const QString Controller::CANCEL_LOAD = "cancelLoad";
 const QString Controller::CLIP_VALUE_MIN = "clipValueMin";
 const QString Controller::CLIP_VALUE_MAX = "clipValueMax";
 const QString Controller::CLOSE_IMAGE = "closeImage";
@@ -52,6 +54,7 @@ const QString Controller::DATA_PATH = "dataPath";
 const QString Controller::CURSOR = "formattedCursorCoordinates";
 const QString Controller::CENTER = "center";
 const QString Controller::IMAGE = "image";
+const QString Controller::LOADING = "loading";
 const QString Controller::PAN_ZOOM_ALL = "panZoomAll";
 const QString Controller::ZOOM = "zoom";
 
@@ -70,7 +73,9 @@ using Carta::Lib::AxisInfo;
 
 Controller::Controller( const QString& path, const QString& id ) :
         CartaObject( CLASS_NAME, path, id),
-        m_stateMouse(UtilState::getLookup(path, Util::VIEW)){
+        m_stateMouse(UtilState::getLookup(path, Util::VIEW)),
+        m_loadViewQueued( false ),
+        m_loadThread( nullptr ){
 
      _initializeState();
 
@@ -84,6 +89,8 @@ Controller::Controller( const QString& path, const QString& id ) :
      connect( m_stack.get(), SIGNAL( frameChanged(Carta::Lib::AxisInfo::KnownType)),
              this, SLOT(_notifyFrameChange( Carta::Lib::AxisInfo::KnownType)));
      connect( m_stack.get(), SIGNAL( viewLoad()), this, SLOT(_loadViewQueued()));
+     connect( m_stack.get(), SIGNAL( frameRepainted(const std::vector<int>&)),
+             this, SLOT(_notifyFrameRepainted(const std::vector<int>&)));
      connect( m_stack.get(), SIGNAL(contourSetAdded(Layer*,const QString&)),
                      this, SLOT(_contourSetAdded(Layer*, const QString&)));
      connect( m_stack.get(), SIGNAL(contourSetRemoved(const QString&)),
@@ -121,6 +128,27 @@ QString Controller::addData(const QString& fileName, bool* success) {
 }
 
 
+void Controller::addDataAsync( const QString& fileName ){
+    cancelLoad();
+    //Regions are parsed quickly and are added to the images already there.
+    QFileInfo fileInfo( fileName );
+    if ( fileInfo.isFile() && DataFactory::_isRegion( fileName ) ){
+        bool success = false;
+        QString result = addData( fileName, &success );
+        if ( !success ){
+            Util::commandPostProcess( result );
+        }
+        return;
+    }
+    m_loadThread = new LoadThread( fileName );
+    connect( m_loadThread, SIGNAL(finished()), this, SLOT(_loadFinished()));
+    connect( m_loadThread, SIGNAL(finished()), m_loadThread, SLOT(deleteLater()));
+    m_state.setValue<QString>( LOADING, fileName );
+    m_state.flushState();
+    m_loadThread->start();
+}
+
+
 QString Controller::_addDataImage(const QString& fileName, bool* success ) {
     QString result = m_stack->_addDataImage( fileName, success );
     if ( *success ){
@@ -185,6 +213,16 @@ QString Controller::applyClips( double minIntensityPercentile, double maxIntensi
 }
 
 
+void Controller::cancelLoad(){
+    if ( m_loadThread ){
+        m_loadThread->cancel();
+        m_loadThread = nullptr;
+        m_state.setValue<QString>( LOADING, "" );
+        m_state.flushState();
+    }
+}
+
+
 void Controller::clear(){
     unregisterView();
 }
@@ -582,6 +620,12 @@ void Controller::_initializeCallbacks(){
 
     });
 
+    addCommandCallback( CANCEL_LOAD, [=] (const QString & /*cmd*/,
+                    const QString & /*params*/, const QString & /*sessionId*/) ->QString {
+        cancelLoad();
+        return "";
+    });
+
     addCommandCallback( CLOSE_IMAGE, [=] (const QString & /*cmd*/,
                     const QString & params, const QString & /*sessionId*/) ->QString {
         std::set<QString> keys = {IMAGE};
@@ -842,6 +886,7 @@ void Controller::_initializeState(){
     m_state.insertValue<bool>( STACK_SELECT_AUTO, true );
     m_state.insertValue<double>( CLIP_VALUE_MIN, 0.025 );
     m_state.insertValue<double>( CLIP_VALUE_MAX, 0.975 );
+    m_state.insertValue<QString>( LOADING, "" );
     //Default Tab
     m_state.insertValue<int>( Util::TAB_INDEX, 0 );
     m_state.flushState();
@@ -860,10 +905,16 @@ bool Controller::isStackSelectAuto() const {
 
 
 void Controller::_loadViewQueued( ){
-    QMetaObject::invokeMethod( this, "_loadView", Qt::QueuedConnection );
+    //Changes that come in before the view is loaded, like the frames of a fast
+    //animation, are picked up by the same load.
+    if ( !m_loadViewQueued ){
+        m_loadViewQueued = true;
+        QMetaObject::invokeMethod( this, "_loadView", Qt::QueuedConnection );
+    }
 }
 
 void Controller::_loadView(){
+    m_loadViewQueued = false;
     //Load the image.
     bool autoClip = m_state.getValue<bool>(AUTO_CLIP);
     double clipValueMin = m_state.getValue<double>(CLIP_VALUE_MIN);
@@ -871,6 +922,38 @@ void Controller::_loadView(){
     m_stack->_load( autoClip, clipValueMin, clipValueMax );
 }
 
+void Controller::_loadFinished(){
+    //A load we have canceled meanwhile has nothing to say.
+    LoadThread* thread = qobject_cast<LoadThread*>( sender() );
+    if ( thread == nullptr || thread != m_loadThread || thread->isCanceled() ){
+        return;
+    }
+    m_loadThread = nullptr;
+    m_state.setValue<QString>( LOADING, "" );
+    m_state.flushState();
+    QString result = thread->getError();
+    if ( result.isEmpty() ){
+        //The thread holds the image until it is deleted, so adding it picks up the
+        //opened image: the axes, grid and animator are set up from its metadata,
+        //while the clips and pyramids are computed in their own threads.
+        bool success = false;
+        result = _addDataImage( thread->getFileName(), &success );
+        if ( success ){
+            result = "";
+        }
+    }
+    Util::commandPostProcess( result );
+}
+
+void Controller::_renderAhead( const std::vector<int>& frameIndices,
+        Carta::Lib::AxisInfo::KnownType axisType ){
+    //The frames are clipped the same way they will be when they are loaded.
+    bool autoClip = m_state.getValue<bool>(AUTO_CLIP);
+    double clipValueMin = m_state.getValue<double>(CLIP_VALUE_MIN);
+    double clipValueMax = m_state.getValue<double>(CLIP_VALUE_MAX);
+    m_stack->_renderAhead( frameIndices, axisType, autoClip, clipValueMin, clipValueMax );
+}
+
 QString Controller::moveSelectedLayers( bool moveDown ){
     QString result = m_stack->_moveSelectedLayers( moveDown );
     return result;
@@ -881,6 +964,10 @@ void Controller::_notifyFrameChange( Carta::Lib::AxisInfo::KnownType axis ){
     emit frameChanged( this, axis );
 }
 
+void Controller::_notifyFrameRepainted( const std::vector<int>& frames ){
+    emit frameRepainted( this, frames );
+}
+
 void Controller::removeContourSet( std::shared_ptr<DataContours> contourSet ){
     m_stack->_removeContourSet( contourSet );
 }
@@ -895,6 +982,9 @@ void Controller::resetState( const QString& state ){
 
     QString prefStr = restoredState.getValue<QString>(Util::PREFERENCES);
     m_state.setState( prefStr );
+    //What is being loaded is not a preference.
+    QString loading = m_loadThread ? m_loadThread->getFileName() : "";
+    m_state.setValue<QString>( LOADING, loading );
     m_state.flushState();
 }
 
@@ -1250,6 +1340,7 @@ void Controller::updatePan( double centerX , double centerY){
 
 
 Controller::~Controller(){
+    cancelLoad();
     //unregisterView();
     clear();
 }
@@ -35,6 +35,7 @@ namespace Data {
 class ColorState;
 class Layer;
 class LayerData;
+class LoadThread;
 class Stack;
 class DataSource;
 class DisplayControls;
@@ -77,6 +78,15 @@ public:
      */
     QString addData(const QString& fileName, bool* success);
 
+    /**
+     * Add data to this controller without waiting for it to be opened.
+     * Images are opened in a LoadThread, and added once their metadata is available;
+     * the state shows the file being opened as "loading" until then. Errors are
+     * reported to the error manager. Region files are added right away.
+     * @param fileName - the absolute path of the data.
+     */
+    void addDataAsync( const QString& fileName );
+
     /**
      * Apply the indicated clips to managed images.
      * @param minIntensityPercentile the minimum clip percentile [0,1].
@@ -93,6 +103,11 @@ public:
      */
     void centerOnPixel( double imgX , double imgY);
 
+    /**
+     * Drop the image being opened in the background, if any.
+     */
+    void cancelLoad();
+
     /**
      * Close the given image.
      * @param id - a stack id for the image to close.
@@ -525,6 +540,13 @@ signals:
       */
     void frameChanged( Controller* controller, Carta::Lib::AxisInfo::KnownType axis);
 
+    /**
+     * Notification that the client has shown the image of the given frames.
+     * @param controller this Controller.
+     * @param frames - the frames that were shown, one for each axis.
+     */
+    void frameRepainted( Controller* controller, const std::vector<int>& frames );
+
     /**
      * Notification that the image clip values have changed.
      * @param minPercentile - the new minimum clip percentile.
@@ -573,7 +595,9 @@ private slots:
     //Refresh the view based on the latest data selection information.
     void _loadView(  );
     void _loadViewQueued( );
+    void _loadFinished();
     void _notifyFrameChange( Carta::Lib::AxisInfo::KnownType axis );
+    void _notifyFrameRepainted( const std::vector<int>& frames );
 
 
     // Asynchronous result from saveFullImage().
@@ -620,6 +644,15 @@ private:
     void _setFrameAxis(int frameIndex, Carta::Lib::AxisInfo::KnownType axisType );
     QString _setLayersSelected( const QStringList indices);
 
+    /**
+     * Render the upcoming frames of an animation in the background.
+     * @param frameIndices - the upcoming frames of the animated axis, in order; an
+     *      empty list drops the frames that have not been rendered yet.
+     * @param axisType - the animated axis.
+     */
+    void _renderAhead( const std::vector<int>& frameIndices,
+            Carta::Lib::AxisInfo::KnownType axisType );
+
 
     void _updateCursor( int mouseX, int mouseY );
     void _updateCursorText(bool notifyClients );
@@ -627,6 +660,7 @@ private:
 
     static bool m_registered;
 
+    static const QString CANCEL_LOAD;
     static const QString CLIP_VALUE_MIN;
     static const QString CLIP_VALUE_MAX;
     static const QString CLOSE_IMAGE;
@@ -634,6 +668,7 @@ private:
     static const QString DATA;
     static const QString DATA_PATH;
     static const QString IMAGE;
+    static const QString LOADING;
     static const QString PAN_ZOOM_ALL;
     static const QString CENTER;
     static const QString STACK_SELECT_AUTO;
@@ -652,6 +687,13 @@ private:
     //everyone wants to listen to them.
     Carta::State::StateInterface m_stateMouse;
 
+    //Whether a load of the view is waiting in the event queue.
+    bool m_loadViewQueued;
+
+    //The image being opened in the background, if any; the thread deletes itself
+    //when it is finished.
+    LoadThread* m_loadThread;
+
     Controller(const Controller& other);
     Controller& operator=(const Controller& other);
 
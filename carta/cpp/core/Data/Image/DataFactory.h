@@ -16,6 +16,7 @@ class Region;
 
 class DataFactory {
 
+    friend class Controller;
 
 public:
     /**
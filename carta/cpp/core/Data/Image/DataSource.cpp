@@ -1,17 +1,21 @@
 #include "DataSource.h"
+#include "ClipThread.h"
+#include "PyramidThread.h"
 #include "CoordinateSystems.h"
 #include "Data/Colormap/Colormaps.h"
-#include "Globals.h"
-#include "PluginManager.h"
 #include "GrayColormap.h"
+#include "ImagePyramid.h"
+#include "ImageRegistry.h"
 #include "CartaLib/IImage.h"
 #include "Data/Util.h"
 #include "Data/Colormap/TransformsData.h"
-#include "CartaLib/Hooks/LoadAstroImage.h"
 #include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
+#include "CartaLib/Hooks/GetImageRenderService.h"
+#include "Globals.h"
 #include "../../ImageRenderService.h"
 #include "../../Algorithms/quantileAlgorithms.h"
 #include <QDebug>
+#include <algorithm>
 
 using Carta::Lib::AxisInfo;
 using Carta::Lib::AxisDisplayInfo;
@@ -24,11 +28,25 @@ const QString DataSource::DATA_PATH = "file";
 const QString DataSource::CLASS_NAME = "DataSource";
 const double DataSource::ZOOM_DEFAULT = 1.0;
 
+//Frames larger than this (in pixels) have their clips computed in the background,
+//the clips are estimated from a subsample of about this size in the meantime.
+static const int CLIP_PREVIEW_PIXELS = 512 * 512;
+
+//At most this many clip threads work on the frames rendered ahead, each one holds
+//a copy of its frame.
+static const int AHEAD_CLIP_THREADS_MAX = 4;
+
 CoordinateSystems* DataSource::m_coords = nullptr;
 
 DataSource::DataSource() :
     m_image( nullptr ),
     m_permuteImage( nullptr),
+    m_quantileIndexCurrent( -1 ),
+    m_clipThread( nullptr ),
+    m_pyramidThread( nullptr ),
+    m_aheadAutoClip( false ),
+    m_aheadClipMinPercentile( 0 ),
+    m_aheadClipMaxPercentile( 1 ),
     m_axisIndexX( 0 ),
     m_axisIndexY( 1 ){
         m_cmapUseCaching = true;
@@ -37,8 +55,15 @@ DataSource::DataSource() :
 
         _initializeSingletons();
 
-        //Initialize the rendering service
-        m_renderService.reset( new Carta::Core::ImageRenderService::Service() );
+        //Initialize the rendering service, plugins get the first chance to provide one
+        auto res = Globals::instance()-> pluginManager()
+                       -> prepare < Carta::Lib::Hooks::GetImageRenderService > ().first();
+        if ( ! res.isNull() && res.val() ){
+            m_renderService = res.val();
+        }
+        else {
+            m_renderService.reset( new Carta::Core::ImageRenderService::Service() );
+        }
 
         // assign a default colormap to the view
         auto rawCmap = std::make_shared < Carta::Core::GrayColormap > ();
@@ -326,7 +351,7 @@ std::shared_ptr<Carta::Lib::PixelPipeline::CustomizablePixelPipeline> DataSource
     return m_pixelPipeline;
 }
 
-std::shared_ptr<Carta::Core::ImageRenderService::Service> DataSource::_getRenderer() const {
+std::shared_ptr<Carta::Lib::IImageRenderService> DataSource::_getRenderer() const {
     return m_renderService;
 }
 
@@ -337,19 +362,62 @@ bool DataSource::_getIntensity( int frameLow, int frameHigh, double percentile,
     Carta::Lib::NdArray::RawViewInterface* rawData = _getRawData( frameLow, frameHigh, spectralIndex );
     if ( rawData != nullptr ){
         Carta::Lib::NdArray::TypedView<double> view( rawData, false );
+        std::unique_ptr<Carta::Lib::NdArray::BitMask> mask( _getRawMask( frameLow, frameHigh, spectralIndex ) );
+        // the spectral index of a pixel is its index divided by the size of a plane
+        int divisor = 1;
+        std::vector<int> dims = m_image->dims();
+        for ( int i = 0; i < spectralIndex; i++ ){
+            divisor = divisor * dims[i];
+        }
+        int64_t pixelCount = 1;
+        for ( int dim : view.dims() ){
+            pixelCount = pixelCount * dim;
+        }
+
         // read in all values from the view into an array
         // we need our own copy because we'll do quickselect on it...
-        int index = 0;
         std::vector < int > allIndices;
         std::vector < double > allValues;
-        view.forEach( [& allValues, &allIndices, &index] ( const double  val ) {
-            if ( std::isfinite( val ) ) {
-                allValues.push_back( val );
-                allIndices.push_back( index );
+        auto addValues = [& allValues, &allIndices] ( const double * vals, int64_t count, int64_t firstIndex ) {
+            for ( int64_t i = 0; i < count; i++ ){
+                if ( std::isfinite( vals[i] ) ) {
+                    allValues.push_back( vals[i] );
+                    allIndices.push_back( firstIndex + i );
+                }
             }
-            index++;
+        };
+
+        //Within a single plane the positions don't matter, so the view can pick the
+        //fastest traversal.
+        bool singlePlane = pixelCount <= divisor;
+        if ( singlePlane ){
+            Carta::Core::Algorithms::forEachUnmasked( view, mask.get(),
+                    [&] ( const double * vals, int64_t count ) {
+                for ( int64_t i = 0; i < count; i++ ){
+                    if ( std::isfinite( vals[i] ) ) {
+                        allValues.push_back( vals[i] );
+                    }
+                }
+            });
+        }
+        else {
+            int64_t blockStart = 0;
+            view.forEach( Carta::Core::Algorithms::BulkBlockSize,
+                    [&] ( const double * vals, int64_t count ) {
+                if ( !mask ){
+                    addValues( vals, count, blockStart );
+                }
+                else {
+                    //Skip the masked pixels.
+                    mask->forEachRun( blockStart, count, [&] ( int64_t first, int64_t n, bool valid ){
+                        if ( valid ){
+                            addValues( vals + ( first - blockStart ), n, first );
+                        }
+                    });
+                }
+                blockStart += count;
+            });
         }
-        );
 
         // indicate bad clip if no finite numbers were found
         if ( allValues.size() > 0 ) {
@@ -359,12 +427,7 @@ bool DataSource::_getIntensity( int frameLow, int frameHigh, double percentile,
             }
             std::nth_element( allValues.begin(), allValues.begin()+locationIndex, allValues.end() );
             *intensity = allValues[locationIndex];
-            int divisor = 1;
-            std::vector<int> dims = m_image->dims();
-            for ( int i = 0; i < spectralIndex; i++ ){
-                divisor = divisor * dims[i];
-            }
-            int specIndex = allIndices[locationIndex ]/divisor;
+            int specIndex = singlePlane ? 0 : allIndices[locationIndex ]/divisor;
             *intensityIndex = specIndex;
             intensityFound = true;
         }
@@ -385,15 +448,18 @@ double DataSource::_getPercentile( int frameLow, int frameHigh, double intensity
         u_int64_t totalCount = 0;
         u_int64_t countBelow = 0;
         Carta::Lib::NdArray::TypedView<double> view( rawData, false );
-        view.forEach([&](const double& val) {
-            if( Q_UNLIKELY( std::isnan(val))){
-                return;
-            }
-            totalCount ++;
-            if( val <= intensity){
-                countBelow++;
+        std::unique_ptr<Carta::Lib::NdArray::BitMask> mask( _getRawMask( frameLow, frameHigh, spectralIndex ) );
+        Carta::Core::Algorithms::forEachUnmasked( view, mask.get(),
+                [&]( const double* vals, int64_t count ) {
+            for ( int64_t i = 0; i < count; i++ ){
+                if( Q_UNLIKELY( std::isnan(vals[i]))){
+                    continue;
+                }
+                totalCount ++;
+                if( vals[i] <= intensity){
+                    countBelow++;
+                }
             }
-            return;
         });
 
         if ( totalCount > 0 ){
@@ -423,9 +489,24 @@ QString DataSource::_getPixelUnits() const {
 
 Carta::Lib::NdArray::RawViewInterface* DataSource::_getRawData( int frameStart, int frameEnd, int axisIndex ) const {
     Carta::Lib::NdArray::RawViewInterface* rawData = nullptr;
+    if ( m_image ){
+        rawData = m_image->getDataSlice( _getFrameSlice( frameStart, frameEnd, axisIndex ) );
+    }
+    return rawData;
+}
+
+Carta::Lib::NdArray::BitMask* DataSource::_getRawMask( int frameStart, int frameEnd, int axisIndex ) const {
+    Carta::Lib::NdArray::BitMask* mask = nullptr;
+    if ( m_image && m_image->hasMask() ){
+        mask = m_image->getMaskSlice( _getFrameSlice( frameStart, frameEnd, axisIndex ) );
+    }
+    return mask;
+}
+
+SliceND DataSource::_getFrameSlice( int frameStart, int frameEnd, int axisIndex ) const {
+    SliceND frameSlice = SliceND().next();
     if ( m_image ){
         int imageDim =m_image->dims().size();
-        SliceND frameSlice = SliceND().next();
         for ( int i = 0; i < imageDim; i++ ){
             if ( i != m_axisIndexX && i != m_axisIndexY ){
                 int sliceSize = m_image->dims()[i];
@@ -451,9 +532,8 @@ Carta::Lib::NdArray::RawViewInterface* DataSource::_getRawData( int frameStart,
                 slice.step( 1 );
             }
         }
-        rawData = m_image->getDataSlice( frameSlice );
     }
-    return rawData;
+    return frameSlice;
 }
 
 
@@ -494,17 +574,33 @@ std::shared_ptr<Carta::Lib::Image::ImageInterface> DataSource::_getPermutedImage
                 vectorIndex++;
             }
         }
-        permuteImage = m_image->getPermuted( indices );
+        permuteImage = m_registeredImage ? m_registeredImage->permuted( indices ) :
+                m_image->getPermuted( indices );
     }
     return permuteImage;
 }
 
 Carta::Lib::NdArray::RawViewInterface* DataSource::_getRawData( const std::vector<int> frames ) const {
     Carta::Lib::NdArray::RawViewInterface* rawData = nullptr;
+    if ( m_permuteImage ){
+        rawData = m_permuteImage->getDataSlice( _getFrameSlice( frames ) );
+    }
+    return rawData;
+}
+
+Carta::Lib::NdArray::BitMask* DataSource::_getRawMask( const std::vector<int> frames ) const {
+    Carta::Lib::NdArray::BitMask* mask = nullptr;
+    if ( m_permuteImage && m_permuteImage->hasMask() ){
+        mask = m_permuteImage->getMaskSlice( _getFrameSlice( frames ) );
+    }
+    return mask;
+}
+
+SliceND DataSource::_getFrameSlice( const std::vector<int> frames ) const {
+    SliceND nextSlice = SliceND();
     std::vector<int> mFrames = _fitFramesToImage( frames );
     if ( m_permuteImage ){
         int imageDim =m_permuteImage->dims().size();
-        SliceND nextSlice = SliceND();
         SliceND& slice = nextSlice;
         for ( int i = 0; i < imageDim; i++ ){
             //Since the image has been permuted the first two indices represent
@@ -524,9 +620,8 @@ Carta::Lib::NdArray::RawViewInterface* DataSource::_getRawData( const std::vecto
                 slice.next();
             }
         }
-        rawData = m_permuteImage->getDataSlice( nextSlice );
     }
-    return rawData;
+    return nextSlice;
 }
 
 
@@ -600,9 +695,150 @@ void DataSource::_load(std::vector<int> frames, bool recomputeClipsOnNewFrame,
     m_renderService-> setPixelPipeline( m_pixelPipeline, m_pixelPipeline-> cacheId());
 
     QString renderId = _getViewIdCurrent( mFrames );
+    Carta::Lib::NdArray::BitMask::SharedPtr mask( _getRawMask( mFrames ) );
     m_renderService-> setInputView( view, renderId );
+    m_renderService-> setInputMask( mask );
+    _updatePyramid( view, mask, renderId );
+}
+
+
+void DataSource::_renderAhead( const std::vector<std::vector<int> >& frames,
+        bool recomputeClipsOnNewFrame, double minClipPercentile, double maxClipPercentile ){
+    m_aheadFrames.clear();
+    for ( const std::vector<int>& frame : frames ){
+        m_aheadFrames.push_back( _fitFramesToImage( frame ) );
+    }
+    m_aheadAutoClip = recomputeClipsOnNewFrame;
+    m_aheadClipMinPercentile = minClipPercentile;
+    m_aheadClipMaxPercentile = maxClipPercentile;
+    _renderAheadUpdate();
+}
+
+void DataSource::_renderAheadUpdate(){
+    //Only the default render service can render ahead.
+    auto service = std::dynamic_pointer_cast<Carta::Core::ImageRenderService::Service>( m_renderService );
+    if ( !service || !m_permuteImage ){
+        return;
+    }
+    double clipMin = 0;
+    double clipMax = 1;
+    m_pixelPipeline->getClips( clipMin, clipMax );
+    std::vector<Carta::Core::ImageRenderService::Service::AheadFrame> aheadFrames;
+    std::vector<int> clipsMissing;
+    for ( int i = 0; i < static_cast<int>( m_aheadFrames.size() ); i++ ){
+        const std::vector<int>& frames = m_aheadFrames[i];
+        if ( m_aheadAutoClip && !_getClipsCached( _getQuantileCacheIndex( frames ),
+                m_aheadClipMinPercentile, m_aheadClipMaxPercentile, clipMin, clipMax ) ){
+            clipsMissing.push_back( i );
+            continue;
+        }
+        Carta::Core::ImageRenderService::Service::AheadFrame aheadFrame;
+        aheadFrame.view.reset( _getRawData( frames ) );
+        if ( !aheadFrame.view ){
+            continue;
+        }
+        aheadFrame.mask.reset( _getRawMask( frames ) );
+        aheadFrame.viewCacheId = _getViewIdCurrent( frames );
+        //Pyramids of frames that have been shown before are used, missing ones are
+        //not worth computing just to render ahead.
+        int64_t pixelCount = 1;
+        for ( int dim : aheadFrame.view->dims() ){
+            pixelCount = pixelCount * dim;
+        }
+        if ( m_registeredImage && pixelCount > Carta::Core::ImagePyramid::MinFramePixels ){
+            aheadFrame.pyramid = *m_registeredImage->derived<Carta::Core::ImagePyramid::SharedPtr>(
+                    "pyramid/" + aheadFrame.viewCacheId );
+        }
+        aheadFrame.clipMin = clipMin;
+        aheadFrame.clipMax = clipMax;
+        aheadFrame.pixelPipelineCacheId = m_pixelPipeline->cacheId( clipMin, clipMax );
+        aheadFrames.push_back( aheadFrame );
+    }
+    service->renderAhead( aheadFrames );
+
+    //Stop computing clips that are not needed anymore.
+    const double ERROR_MARGIN = 0.000001;
+    std::vector<int> quantileIndices;
+    for ( int i : clipsMissing ){
+        quantileIndices.push_back( _getQuantileCacheIndex( m_aheadFrames[i] ) );
+    }
+    for ( auto it = m_aheadClipThreads.begin(); it != m_aheadClipThreads.end(); ){
+        std::vector<double> percentiles = (*it)->getPercentiles();
+        bool needed = std::find( quantileIndices.begin(), quantileIndices.end(),
+                (*it)->getQuantileIndex() ) != quantileIndices.end() &&
+                qAbs( percentiles[0] - m_aheadClipMinPercentile ) < ERROR_MARGIN &&
+                qAbs( percentiles[1] - m_aheadClipMaxPercentile ) < ERROR_MARGIN;
+        if ( needed ){
+            ++it;
+        }
+        else {
+            (*it)->cancel();
+            it = m_aheadClipThreads.erase( it );
+        }
+    }
+
+    //Start computing the missing ones, the nearest frames first.
+    int threadsMax = std::min( AHEAD_CLIP_THREADS_MAX, std::max( 1, QThread::idealThreadCount() ) );
+    for ( int i = 0; i < static_cast<int>( clipsMissing.size() ); i++ ){
+        if ( static_cast<int>( m_aheadClipThreads.size() ) >= threadsMax ){
+            break;
+        }
+        int quantileIndex = quantileIndices[i];
+        bool computing = m_clipThread && !m_clipThread->isCanceled() &&
+                m_clipThread->getQuantileIndex() == quantileIndex;
+        for ( const std::unique_ptr<ClipThread>& thread : m_aheadClipThreads ){
+            computing = computing || thread->getQuantileIndex() == quantileIndex;
+        }
+        if ( computing ){
+            continue;
+        }
+        const std::vector<int>& frames = m_aheadFrames[clipsMissing[i]];
+        std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view( _getRawData( frames ) );
+        if ( !view ){
+            continue;
+        }
+        std::shared_ptr<Carta::Lib::NdArray::BitMask> mask( _getRawMask( frames ) );
+        if ( mask && mask->dims() != view->dims() ){
+            mask.reset();
+        }
+        m_aheadClipThreads.emplace_back( new ClipThread( view, mask, m_aheadClipMinPercentile,
+                m_aheadClipMaxPercentile, quantileIndex ) );
+        connect( m_aheadClipThreads.back().get(), SIGNAL(finished()), this, SLOT(_aheadClipsFinished()));
+        m_aheadClipThreads.back()->start( QThread::LowPriority );
+    }
 }
 
+void DataSource::_cancelAheadClips(){
+    for ( const std::unique_ptr<ClipThread>& thread : m_aheadClipThreads ){
+        thread->cancel();
+    }
+    m_aheadClipThreads.clear();
+}
+
+void DataSource::_aheadClipsFinished(){
+    //Threads we have canceled meanwhile have nothing to say.
+    QObject* source = sender();
+    auto it = std::find_if( m_aheadClipThreads.begin(), m_aheadClipThreads.end(),
+            [source]( const std::unique_ptr<ClipThread>& thread ){ return thread.get() == source; } );
+    if ( source == nullptr || it == m_aheadClipThreads.end() ||
+            !(*it)->isFinished() || (*it)->isCanceled() ){
+        return;
+    }
+    std::vector<double> percentiles = (*it)->getPercentiles();
+    int quantileIndex = (*it)->getQuantileIndex();
+    bool cached = _setClipsCached( quantileIndex, percentiles[0], percentiles[1],
+            (*it)->getResult() );
+    //We are in a slot connected to the thread, so leave deleting it to the event loop.
+    it->release()->deleteLater();
+    m_aheadClipThreads.erase( it );
+
+    //The animation may have caught up with the frame, which is then shown with
+    //estimated clips.
+    if ( cached && quantileIndex == m_quantileIndexCurrent ){
+        emit clipsChanged();
+    }
+    _renderAheadUpdate();
+}
 
 void DataSource::_resetZoom(){
     m_renderService-> setZoom( ZOOM_DEFAULT );
@@ -617,15 +853,31 @@ void DataSource::_resetPan(){
 }
 
 void DataSource::_resizeQuantileCache(){
-    m_quantileCache.resize(0);
-    int nf = 1;
+    //Whatever is being computed refers to the old cache layout.
+    _cancelClips();
+    _cancelAheadClips();
+    m_aheadFrames.clear();
+    m_quantileIndexCurrent = -1;
+    size_t nf = 1;
     int imageSize = m_image->dims().size();
     for ( int i = 0; i < imageSize; i++ ){
         if ( i != m_axisIndexX && i != m_axisIndexY ){
             nf = nf * m_image->dims()[i];
         }
     }
-    m_quantileCache.resize( nf);
+    //Clips only depend on the image and the display axes, so they can be shared.
+    if ( m_registeredImage ){
+        QString cacheKey = "quantiles/" + QString::number( m_axisIndexX ) + "," +
+                QString::number( m_axisIndexY );
+        m_quantileCache = m_registeredImage->derived< std::vector< std::vector<double> > >( cacheKey );
+    }
+    else {
+        m_quantileCache = std::make_shared< std::vector< std::vector<double> > >();
+    }
+    if ( m_quantileCache->size() != nf ){
+        m_quantileCache->clear();
+        m_quantileCache->resize( nf );
+    }
 }
 
 QString DataSource::_setFileName( const QString& fileName, bool* success ){
@@ -635,11 +887,14 @@ QString DataSource::_setFileName( const QString& fileName, bool* success ){
     if (file.length() > 0) {
         if ( file != m_fileName ){
             try {
-                auto res = Globals::instance()-> pluginManager()
-                                      -> prepare <Carta::Lib::Hooks::LoadAstroImage>( file )
-                                      .first();
-                if (!res.isNull()){
-                    m_image = res.val();
+                //Images are shared with other views of the same file, and are usually
+                //already opened by a LoadThread. Opening only reads the metadata, the
+                //pixels are left to the render service and to the clip threads started later.
+                Carta::Core::RegisteredImage::SharedPtr registered =
+                        Carta::Core::ImageRegistry::instance().open( file );
+                if ( registered ){
+                    m_registeredImage = registered;
+                    m_image = registered->image();
                     m_permuteImage = m_image;
                     // reset zoom/pan
                     _resetZoom();
@@ -783,31 +1038,151 @@ void DataSource::_updateClips( std::shared_ptr<Carta::Lib::NdArray::RawViewInter
         double minClipPercentile, double maxClipPercentile, const std::vector<int>& frames ){
     std::vector<int> mFrames = _fitFramesToImage( frames );
     int quantileIndex = _getQuantileCacheIndex( mFrames );
-    std::vector<double> clips = m_quantileCache[ quantileIndex];
-    Carta::Lib::NdArray::Double doubleView( view.get(), false );
-    std::vector<double> newClips = Carta::Core::Algorithms::quantiles2pixels(
-            doubleView, {minClipPercentile, maxClipPercentile });
-    bool clipsChanged = false;
-    int clipSize = newClips.size();
-    if ( clipSize >= 2 ){
-        if ( clips.size() >= 2 ){
-            double ERROR_MARGIN = 0.000001;
-            if ( qAbs( newClips[0] - clips[0]) > ERROR_MARGIN ||
-                qAbs( newClips[1] - clips[1]) > ERROR_MARGIN ){
-                clipsChanged = true;
-            }
+    m_quantileIndexCurrent = quantileIndex;
+
+    //Use the cached clips if they were computed for the same percentiles.
+    double clipMin = 0;
+    double clipMax = 1;
+    if ( _getClipsCached( quantileIndex, minClipPercentile, maxClipPercentile, clipMin, clipMax ) ){
+        m_pixelPipeline-> setMinMax( clipMin, clipMax );
+        return;
+    }
+
+    //Nothing to do if the clips of this frame are already being computed.
+    const double ERROR_MARGIN = 0.000001;
+    if ( m_clipThread && !m_clipThread->isFinished() ){
+        std::vector<double> percentiles = m_clipThread->getPercentiles();
+        if ( m_clipThread->getQuantileIndex() == quantileIndex &&
+                qAbs( percentiles[0] - minClipPercentile ) < ERROR_MARGIN &&
+                qAbs( percentiles[1] - maxClipPercentile ) < ERROR_MARGIN ){
+            return;
         }
-        else {
-            clipsChanged = true;
+    }
+    _cancelClips();
+
+    //The frame may be rendered ahead, in which case an estimate will do until its
+    //clips are done (see _aheadClipsFinished()).
+    for ( const std::unique_ptr<ClipThread>& thread : m_aheadClipThreads ){
+        std::vector<double> percentiles = thread->getPercentiles();
+        if ( thread->getQuantileIndex() == quantileIndex &&
+                qAbs( percentiles[0] - minClipPercentile ) < ERROR_MARGIN &&
+                qAbs( percentiles[1] - maxClipPercentile ) < ERROR_MARGIN ){
+            _updateClipsPreview( mFrames, minClipPercentile, maxClipPercentile );
+            return;
         }
     }
 
-    if ( clipsChanged ){
-        if ( newClips.size() >= 2 && newClips[0] != newClips[1] ){
-            m_quantileCache[ quantileIndex ] = newClips;
+    //Masked pixels do not count, as long as the mask matches the view.
+    std::shared_ptr<Carta::Lib::NdArray::BitMask> mask( _getRawMask( mFrames ) );
+    if ( mask && mask->dims() != view->dims() ){
+        mask.reset();
+    }
+    int64_t pixelCount = 1;
+    for ( int dim : view->dims() ){
+        pixelCount = pixelCount * dim;
+    }
+    if ( pixelCount <= CLIP_PREVIEW_PIXELS ){
+        Carta::Lib::NdArray::Double doubleView( view.get(), false );
+        std::vector<double> newClips = Carta::Core::Algorithms::quantiles2pixels(
+                doubleView, {minClipPercentile, maxClipPercentile }, mask.get() );
+        if ( _setClipsCached( quantileIndex, minClipPercentile, maxClipPercentile, newClips ) ){
             m_pixelPipeline-> setMinMax( newClips[0], newClips[1] );
         }
     }
+    else {
+        //Render right away with an estimate, and refine it in the background.
+        _updateClipsPreview( mFrames, minClipPercentile, maxClipPercentile );
+        m_clipThread.reset( new ClipThread( view, mask, minClipPercentile, maxClipPercentile,
+                quantileIndex ) );
+        connect( m_clipThread.get(), SIGNAL(progress(double)), this, SIGNAL(loadProgress(double)));
+        connect( m_clipThread.get(), SIGNAL(finished()), this, SLOT(_clipsFinished()));
+        emit loadProgress( 0 );
+        m_clipThread->start();
+    }
+}
+
+void DataSource::_updateClipsPreview( const std::vector<int>& frames,
+        double minClipPercentile, double maxClipPercentile ){
+    std::vector<int> dims = m_permuteImage->dims();
+    double framePixels = double( dims[0] ) * dims[1];
+    int step = std::max( 1, int( std::ceil( std::sqrt( framePixels / CLIP_PREVIEW_PIXELS ) ) ) );
+    SliceND previewSlice = _getFrameSlice( frames );
+    previewSlice.slice( 0 ).step( step );
+    previewSlice.slice( 1 ).step( step );
+    std::unique_ptr<Carta::Lib::NdArray::RawViewInterface> preview(
+            m_permuteImage->getDataSlice( previewSlice ) );
+    if ( !preview ){
+        return;
+    }
+    std::unique_ptr<Carta::Lib::NdArray::BitMask> mask;
+    if ( m_permuteImage->hasMask() ){
+        mask.reset( m_permuteImage->getMaskSlice( previewSlice ) );
+        if ( mask && mask->dims() != preview->dims() ){
+            mask.reset();
+        }
+    }
+    Carta::Lib::NdArray::Double doubleView( preview.get(), false );
+    std::vector<double> clips = Carta::Core::Algorithms::quantiles2pixels(
+            doubleView, {minClipPercentile, maxClipPercentile }, mask.get() );
+    //The estimate is not cached, the exact clips will replace it.
+    if ( clips.size() >= 2 && clips[0] < clips[1] ){
+        m_pixelPipeline-> setMinMax( clips[0], clips[1] );
+    }
+}
+
+bool DataSource::_getClipsCached( int quantileIndex, double minClipPercentile,
+        double maxClipPercentile, double& clipMin, double& clipMax ) const {
+    const double ERROR_MARGIN = 0.000001;
+    bool cached = false;
+    if ( m_quantileCache && 0 <= quantileIndex &&
+            quantileIndex < static_cast<int>( m_quantileCache->size() ) ){
+        const std::vector<double>& clips = (*m_quantileCache)[ quantileIndex ];
+        if ( clips.size() >= 4 && qAbs( clips[2] - minClipPercentile ) < ERROR_MARGIN &&
+                qAbs( clips[3] - maxClipPercentile ) < ERROR_MARGIN ){
+            clipMin = clips[0];
+            clipMax = clips[1];
+            cached = true;
+        }
+    }
+    return cached;
+}
+
+bool DataSource::_setClipsCached( int quantileIndex, double minClipPercentile,
+        double maxClipPercentile, const std::vector<double>& clips ){
+    bool valid = false;
+    if ( clips.size() >= 2 && clips[0] != clips[1] &&
+            0 <= quantileIndex && quantileIndex < static_cast<int>( m_quantileCache->size() ) ){
+        (*m_quantileCache)[ quantileIndex ] = { clips[0], clips[1], minClipPercentile, maxClipPercentile };
+        valid = true;
+    }
+    return valid;
+}
+
+void DataSource::_cancelClips(){
+    //The thread stops at the next band of rows, so this does not block for long.
+    if ( m_clipThread ){
+        m_clipThread->cancel();
+        m_clipThread.reset();
+        emit loadProgress( 1 );
+    }
+}
+
+void DataSource::_clipsFinished(){
+    //A thread we have canceled meanwhile has nothing to say.
+    if ( sender() == nullptr || sender() != m_clipThread.get() ||
+            !m_clipThread->isFinished() || m_clipThread->isCanceled() ){
+        return;
+    }
+    std::vector<double> percentiles = m_clipThread->getPercentiles();
+    int quantileIndex = m_clipThread->getQuantileIndex();
+    bool cached = _setClipsCached( quantileIndex, percentiles[0], percentiles[1],
+            m_clipThread->getResult() );
+    //We are in a slot connected to the thread, so leave deleting it to the event loop.
+    m_clipThread.release()->deleteLater();
+    emit loadProgress( 1 );
+    if ( cached && quantileIndex == m_quantileIndexCurrent ){
+        emit clipsChanged();
+    }
 }
 
 std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> DataSource::_updateRenderedView( const std::vector<int>& frames ){
@@ -815,17 +1190,100 @@ std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> DataSource::_updateRender
     std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view( _getRawData( frames ) );
     // tell the render service to render this job
     QString renderId = _getViewIdCurrent( frames );
+    Carta::Lib::NdArray::BitMask::SharedPtr mask( _getRawMask( frames ) );
     m_renderService-> setInputView( view, renderId/*, m_axisIndexX, m_axisIndexY*/ );
+    m_renderService-> setInputMask( mask );
+    _updatePyramid( view, mask, renderId );
     return view;
 }
 
+void DataSource::_updatePyramid( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+        std::shared_ptr<Carta::Lib::NdArray::BitMask> mask, const QString& viewId ){
+    if ( !view || !m_registeredImage ){
+        return;
+    }
+    //Only the default render service uses pyramids.
+    if ( !std::dynamic_pointer_cast<Carta::Core::ImageRenderService::Service>( m_renderService ) ){
+        return;
+    }
+    //Small frames are rendered fast enough without one.
+    int64_t pixelCount = 1;
+    for ( int dim : view->dims() ){
+        pixelCount = pixelCount * dim;
+    }
+    if ( pixelCount <= Carta::Core::ImagePyramid::MinFramePixels ){
+        _cancelPyramid();
+        return;
+    }
+
+    //The pyramids are kept with the image, so that everybody displaying the same
+    //frame can use them.
+    std::shared_ptr<Carta::Core::ImagePyramid::SharedPtr> cached =
+            m_registeredImage->derived<Carta::Core::ImagePyramid::SharedPtr>( "pyramid/" + viewId );
+    if ( *cached ){
+        _setRenderPyramid( *cached );
+        return;
+    }
+
+    //Nothing to do if it is already being computed.
+    if ( m_pyramidThread && !m_pyramidThread->isFinished() &&
+            m_pyramidThread->getViewId() == viewId ){
+        return;
+    }
+    _cancelPyramid();
+    m_pyramidThread.reset( new PyramidThread( view, mask, viewId ) );
+    connect( m_pyramidThread.get(), SIGNAL(finished()), this, SLOT(_pyramidFinished()));
+    m_pyramidThread->start( QThread::LowPriority );
+}
+
+void DataSource::_setRenderPyramid( std::shared_ptr<Carta::Core::ImagePyramid> pyramid ){
+    auto service = std::dynamic_pointer_cast<Carta::Core::ImageRenderService::Service>( m_renderService );
+    if ( service ){
+        service->setInputPyramid( pyramid );
+    }
+}
+
+void DataSource::_cancelPyramid(){
+    //The thread stops at the next row of the pyramid, so this does not block for long.
+    if ( m_pyramidThread ){
+        m_pyramidThread->cancel();
+        m_pyramidThread.reset();
+    }
+}
+
+void DataSource::_pyramidFinished(){
+    //A thread we have canceled meanwhile has nothing to say.
+    if ( sender() == nullptr || sender() != m_pyramidThread.get() ||
+            !m_pyramidThread->isFinished() || m_pyramidThread->isCanceled() ){
+        return;
+    }
+    QString viewId = m_pyramidThread->getViewId();
+    Carta::Core::ImagePyramid::SharedPtr pyramid = m_pyramidThread->getResult();
+    //We are in a slot connected to the thread, so leave deleting it to the event loop.
+    m_pyramidThread.release()->deleteLater();
+    if ( !pyramid || !m_registeredImage ){
+        return;
+    }
+    *m_registeredImage->derived<Carta::Core::ImagePyramid::SharedPtr>( "pyramid/" + viewId ) = pyramid;
+
+    //The thread is canceled when another frame is loaded, so this is still the current one.
+    _setRenderPyramid( pyramid );
+    emit pyramidChanged();
+}
+
 void DataSource::_viewResize( const QSize& newSize ){
     m_renderService-> setOutputSize( newSize );
 }
 
 
 DataSource::~DataSource() {
-
+    //Wait for the background work to stop, there is nobody to notify anymore.
+    if ( m_clipThread ){
+        m_clipThread->cancel();
+        m_clipThread.reset();
+    }
+    _cancelAheadClips();
+    _cancelPyramid();
 }
 }
 }
@@ -10,12 +10,14 @@
 #include "CartaLib/AxisInfo.h"
 
 #include <memory>
+#include <vector>
 
 class CoordinateFormatterInterface;
 class SliceND;
 
 namespace Carta {
 namespace Lib {
+    class IImageRenderService;
     namespace PixelPipeline {
         class CustomizablePixelPipeline;
     }
@@ -24,20 +26,22 @@ namespace Lib {
     }
     namespace NdArray {
         class RawViewInterface;
+        class BitMask;
     }
 }
 
 
 
 namespace Core {
-    namespace ImageRenderService {
-        class Service;
-    }
+    class ImagePyramid;
+    class RegisteredImage;
 }
 
 namespace Data {
 
+class ClipThread;
 class CoordinateSystems;
+class PyramidThread;
 
 class DataSource : public QObject {
 
@@ -58,9 +62,54 @@ public:
 
     virtual ~DataSource();
 
+signals:
+
+    /**
+     * Notification that clip values computed in the background are available
+     * for the current frame, so the image should be rendered again.
+     */
+    void clipsChanged();
+
+    /**
+     * Reports the progress of pixel dependent work done in the background.
+     * @param fraction - a number between 0 and 1; 1 means the work is finished.
+     */
+    void loadProgress( double fraction );
+
+    /**
+     * Notification that the pyramid of the current frame has been computed in the
+     * background, so the image should be rendered again.
+     */
+    void pyramidChanged();
+
+private slots:
+
+    //Notification from the clip thread that it is done.
+    void _clipsFinished();
+
+    //Notification from the pyramid thread that it is done.
+    void _pyramidFinished();
+
+    //Notification from a clip thread of a frame rendered ahead that it is done.
+    void _aheadClipsFinished();
 
 private:
 
+    /**
+     * Stop computing clips in the background.
+     */
+    void _cancelClips();
+
+    /**
+     * Stop computing the pyramid in the background.
+     */
+    void _cancelPyramid();
+
+    /**
+     * Stop computing the clips of frames rendered ahead.
+     */
+    void _cancelAheadClips();
+
     /**
      * Resizes the frame indices to fit the current image.
      * @param sourceFrames - a list of current image frames.
@@ -219,7 +268,7 @@ private:
      */
     std::shared_ptr<Carta::Lib::PixelPipeline::CustomizablePixelPipeline> _getPipeline() const;
 
-    std::shared_ptr<Carta::Core::ImageRenderService::Service> _getRenderer() const;
+    std::shared_ptr<Carta::Lib::IImageRenderService> _getRenderer() const;
 
     /**
      * Return the zoom factor for this image.
@@ -289,6 +338,23 @@ private:
      */
     Carta::Lib::NdArray::RawViewInterface* _getRawData( const std::vector<int> frames ) const;
 
+    /**
+     * Returns the mask matching _getRawData( frameLow, frameHigh, axisIndex ).
+     * @return the mask or nullptr if the image is not masked.
+     */
+    Carta::Lib::NdArray::BitMask* _getRawMask( int frameLow, int frameHigh, int axisIndex ) const;
+
+    /**
+     * Returns the mask matching _getRawData( frames ).
+     * @param frames - a list of current image frames.
+     * @return the mask or nullptr if the image is not masked.
+     */
+    Carta::Lib::NdArray::BitMask* _getRawMask( const std::vector<int> frames ) const;
+
+    //Returns the slices used by _getRawData and _getRawMask.
+    SliceND _getFrameSlice( int frameLow, int frameHigh, int axisIndex ) const;
+    SliceND _getFrameSlice( const std::vector<int> frames ) const;
+
     std::shared_ptr<Carta::Lib::Image::ImageInterface> _getPermutedImage() const;
 
     //Returns an identifier for the current image slice being rendered.
@@ -309,6 +375,28 @@ private:
     void _load( std::vector<int> frames, bool recomputeClipsOnNewFrame,
             double clipMinPercentile, double clipMaxPercentile );
 
+    /**
+     * Render the given frames ahead into the frame cache of the render service, so that
+     * an animation can show them without waiting.
+     * @param frames - the upcoming frames in the order they will be shown, each one a list
+     *      of frames, one for each axis; an empty list stops rendering ahead.
+     * @param recomputeClipsOnNewFrame - true if each frame has its own clips; false if
+     *      the current clips should be used for all of them.
+     * @param minClipPercentile the minimum clip value.
+     * @param maxClipPercentile the maximum clip value.
+     *
+     * With per frame clips, frames are rendered once their clips are cached; the missing
+     * clips are computed in the background.
+     */
+    void _renderAhead( const std::vector<std::vector<int> >& frames, bool recomputeClipsOnNewFrame,
+            double minClipPercentile, double maxClipPercentile );
+
+    /**
+     * Hand the frames to render ahead whose clips are known to the render service, and
+     * compute the missing clips, the nearest frames first.
+     */
+    void _renderAheadUpdate();
+
     /**
      * Center the image.
      */
@@ -403,6 +491,15 @@ private:
 
     /**
      * Attempts to load an image file.
+     *
+     * The image is opened through the image registry on the calling thread. Views
+     * loading files interactively open them first in a LoadThread (see
+     * Controller::addDataAsync()), which keeps the image in the registry, so that
+     * here it is only picked up. Only the metadata is read, the loaders parse the
+     * headers and read the pixels lazily, so the axes, grid and animator can be set up
+     * right away. The work that needs the pixels (clip values of large frames) is done
+     * by a ClipThread afterwards, which is canceled when the file or the frame changes,
+     * and whose progress LayerData publishes in the state as "loadProgress".
      * @param fileName an identifier for the location of a data source.
      * @param success - set to true if the image file is successfully loaded; otherwise,
      *      set to false.
@@ -431,9 +528,69 @@ private:
     void _viewResize( const QSize& newSize );
 
 
+    /**
+     * Update the clip values of the pixel pipeline for the given frame.
+     * @param view - the frame.
+     * @param minClipPercentile - the percentile of the lower clip.
+     * @param maxClipPercentile - the percentile of the upper clip.
+     * @param frames - a list of current image frames.
+     *
+     * Clips are cached per frame. Small frames are handled right away; for large
+     * frames the clips are estimated from a subsample of the frame and the exact values
+     * are computed in the background (see clipsChanged()).
+     */
     void _updateClips( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface>& view,
             double minClipPercentile, double maxClipPercentile, const std::vector<int>& frames );
 
+    /**
+     * Estimate the clips of the frame from a subsample of its pixels.
+     * @param frames - a list of current image frames.
+     * @param minClipPercentile - the percentile of the lower clip.
+     * @param maxClipPercentile - the percentile of the upper clip.
+     */
+    void _updateClipsPreview( const std::vector<int>& frames,
+            double minClipPercentile, double maxClipPercentile );
+
+    /**
+     * Give the render service the pyramid of the frame, if the frame is large enough
+     * to need one. Pyramids are cached with the image; a missing one is computed in the
+     * background (see pyramidChanged()).
+     * @param view - the frame.
+     * @param mask - the mask of the frame, or nullptr if there is none.
+     * @param viewId - an identifier of the frame.
+     */
+    void _updatePyramid( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+            std::shared_ptr<Carta::Lib::NdArray::BitMask> mask, const QString& viewId );
+
+    /**
+     * Hand the pyramid to the render service, if it is one that can use it.
+     * @param pyramid - the pyramid of the current frame.
+     */
+    void _setRenderPyramid( std::shared_ptr<Carta::Core::ImagePyramid> pyramid );
+
+    /**
+     * Look up clips in the cache.
+     * @param quantileIndex - the index of the frame in the clip cache.
+     * @param minClipPercentile - the percentile of the lower clip.
+     * @param maxClipPercentile - the percentile of the upper clip.
+     * @param clipMin - set to the lower clip value, if it is cached.
+     * @param clipMax - set to the upper clip value, if it is cached.
+     * @return - true if the clips were cached for these percentiles; false otherwise.
+     */
+    bool _getClipsCached( int quantileIndex, double minClipPercentile, double maxClipPercentile,
+            double& clipMin, double& clipMax ) const;
+
+    /**
+     * Store clips in the cache.
+     * @param quantileIndex - the index of the frame in the clip cache.
+     * @param minClipPercentile - the percentile of the lower clip.
+     * @param maxClipPercentile - the percentile of the upper clip.
+     * @param clips - the lower and upper clip values.
+     * @return - true if the clips were usable; false otherwise.
+     */
+    bool _setClipsCached( int quantileIndex, double minClipPercentile, double maxClipPercentile,
+            const std::vector<double>& clips );
+
     /**
      *  Constructor.
      */
@@ -447,6 +604,9 @@ private:
     //Used pointer to coordinate systems.
     static CoordinateSystems* m_coords;
 
+    //Handle to the image, shared with everybody else who opened the same file.
+    std::shared_ptr<Carta::Core::RegisteredImage> m_registeredImage;
+
     //Pointer to image interface.
     std::shared_ptr<Carta::Lib::Image::ImageInterface> m_image;
     std::shared_ptr<Carta::Lib::Image::ImageInterface> m_permuteImage;
@@ -454,11 +614,31 @@ private:
     /// coordinate formatter
     std::shared_ptr<CoordinateFormatterInterface> m_coordinateFormatter;
 
-    /// clip cache, hard-coded to single quantile
-    std::vector< std::vector<double> > m_quantileCache;
+    /// clip cache, hard-coded to single quantile; each entry holds the
+    /// clip values followed by the percentiles they were computed for. The cache
+    /// is shared by all data sources displaying the same image with the same axes.
+    std::shared_ptr< std::vector< std::vector<double> > > m_quantileCache;
+
+    /// index in the clip cache of the frame that was loaded last
+    int m_quantileIndexCurrent;
+
+    /// computes the clips of large frames in the background
+    std::unique_ptr<ClipThread> m_clipThread;
+
+    /// computes the pyramid of large frames in the background
+    std::unique_ptr<PyramidThread> m_pyramidThread;
+
+    /// frames to render ahead, and how to clip them (see _renderAhead())
+    std::vector<std::vector<int> > m_aheadFrames;
+    bool m_aheadAutoClip;
+    double m_aheadClipMinPercentile;
+    double m_aheadClipMaxPercentile;
+
+    /// compute the clips of frames to render ahead in the background
+    std::vector<std::unique_ptr<ClipThread> > m_aheadClipThreads;
 
-    /// the rendering service
-    std::shared_ptr<Carta::Core::ImageRenderService::Service> m_renderService;
+    /// the rendering service, provided by a plugin or the default one
+    std::shared_ptr<Carta::Lib::IImageRenderService> m_renderService;
 
     ///pixel pipeline
     std::shared_ptr<Carta::Lib::PixelPipeline::CustomizablePixelPipeline> m_pixelPipeline;
@@ -16,6 +16,7 @@ DrawStackSynchronizer::DrawStackSynchronizer( Carta::Lib::LayeredRemoteVGView* v
     m_selectIndex = -1;
     m_view.reset( view );
     connect( m_view.get(), SIGNAL(sizeChanged()), this, SIGNAL( viewResize() ) );
+    connect( m_view.get(), SIGNAL(repainted(qint64)), this, SLOT( _repainted(qint64) ) );
 }
 
 QSize DrawStackSynchronizer::getClientSize() const {
@@ -24,13 +25,39 @@ QSize DrawStackSynchronizer::getClientSize() const {
 
 
 void DrawStackSynchronizer::_repaintFrameNow(){
-    m_view->scheduleRepaint();
+    //Keep track of which frames the repaint shows, in case the client never tells us.
+    const int REPAINTS_MAX = 64;
+    qint64 id = m_view->scheduleRepaint();
+    m_repaintFrames[id] = m_framesDrawn;
+    while ( m_repaintFrames.size() > REPAINTS_MAX ){
+        m_repaintFrames.erase( m_repaintFrames.begin() );
+    }
+}
+
+void DrawStackSynchronizer::_repainted( qint64 id ){
+    //The client shows the latest repaint it got, the ones before it may never
+    //have made it there.
+    auto repainted = m_repaintFrames.upperBound( id );
+    if ( repainted == m_repaintFrames.begin() ){
+        return;
+    }
+    --repainted;
+    std::vector<int> frames = repainted.value();
+    while ( m_repaintFrames.begin() != repainted ){
+        m_repaintFrames.erase( m_repaintFrames.begin() );
+    }
+    m_repaintFrames.erase( repainted );
+    emit frameRepainted( frames );
 }
 
 
 void DrawStackSynchronizer::_render( QList<std::shared_ptr<Layer> >& datas,
         const std::shared_ptr<RenderRequest>& request ){
+    //Draw the newest request once we are done; there is no point in drawing the
+    //ones that come before it.
     if ( m_repaintFrameQueued ){
+        m_pendingLayers = datas;
+        m_pendingRequest = request;
         return;
     }
     QSize clientSize = getClientSize();
@@ -39,6 +66,7 @@ void DrawStackSynchronizer::_render( QList<std::shared_ptr<Layer> >& datas,
         return;
     }
     m_repaintFrameQueued = true;
+    m_frames = request->getFrames();
     int dataCount = datas.size();
     m_images.clear();
     m_layers = datas;
@@ -65,6 +93,7 @@ void DrawStackSynchronizer::_render( QList<std::shared_ptr<Layer> >& datas,
     if ( dataCount == 0 ){
         m_view->resetLayers();
         m_repaintFrameQueued = false;
+        m_framesDrawn = m_frames;
         QMetaObject::invokeMethod( this, "_repaintFrameNow", Qt::QueuedConnection );
     }
 }
@@ -107,10 +136,18 @@ void DrawStackSynchronizer::_scheduleFrameRepaint( const std::shared_ptr<RenderR
         }
     }
     m_repaintFrameQueued = false;
+    m_framesDrawn = m_frames;
     QMetaObject::invokeMethod( this, "_repaintFrameNow", Qt::QueuedConnection );
     for ( int i = 0; i < dataCount; i++ ){
         m_layers[i]->_renderDone();
     }
+    if ( m_pendingRequest ){
+        QList<std::shared_ptr<Layer> > layers = m_pendingLayers;
+        std::shared_ptr<RenderRequest> request = m_pendingRequest;
+        m_pendingLayers.clear();
+        m_pendingRequest.reset();
+        _render( layers, request );
+    }
 }
 
 
@@ -14,6 +14,7 @@
 #include <QObject>
 
 #include <memory>
+#include <vector>
 
 namespace Carta {
     namespace Lib {
@@ -56,6 +57,12 @@ signals:
      */
     void viewResize();
 
+    /**
+     * The client has shown the stack drawn for the given frames.
+     * @param frames - the frames of the stack, one for each axis.
+     */
+    void frameRepainted( const std::vector<int>& frames );
+
 private slots:
 
     /**
@@ -63,6 +70,12 @@ private slots:
      */
     void _repaintFrameNow();
 
+    /**
+     * Notification from the view that the client has shown a repaint.
+     * @param id - the id of the repaint.
+     */
+    void _repainted( qint64 id );
+
     /**
     * Notification that a stack layer has changed its image or vector graphics.
     */
@@ -79,6 +92,17 @@ private:
     QMap<QString, std::shared_ptr<RenderResponse> > m_images;
     bool m_repaintFrameQueued;
 
+    //The newest request that came in while drawing; the ones it replaced are
+    //never drawn.
+    QList< std::shared_ptr<Layer> > m_pendingLayers;
+    std::shared_ptr<RenderRequest> m_pendingRequest;
+
+    //Frames of the stack being drawn, of the one drawn last, and of the repaints
+    //the client has not shown yet.
+    std::vector<int> m_frames;
+    std::vector<int> m_framesDrawn;
+    QMap<qint64, std::vector<int> > m_repaintFrames;
+
     int m_renderCount;
     int m_redrawCount;
     int m_selectIndex;
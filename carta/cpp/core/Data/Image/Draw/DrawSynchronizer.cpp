@@ -1,5 +1,5 @@
 #include "DrawSynchronizer.h"
-#include "ImageRenderService.h"
+#include "CartaLib/IImageRenderService.h"
 #include "CartaLib/IWcsGridRenderService.h"
 #include "CartaLib/IContourGeneratorService.h"
 #include "DefaultContourGeneratorService.h"
@@ -10,7 +10,7 @@ namespace Carta {
 
 namespace Data {
 
-DrawSynchronizer::DrawSynchronizer( std::shared_ptr<Carta::Core::ImageRenderService::Service> imageRendererService,
+DrawSynchronizer::DrawSynchronizer( std::shared_ptr<Carta::Lib::IImageRenderService> imageRendererService,
             std::shared_ptr<Carta::Lib::IWcsGridRenderService> gridRendererService,
             QObject* parent)
         : QObject( parent ),
@@ -23,7 +23,7 @@ DrawSynchronizer::DrawSynchronizer( std::shared_ptr<Carta::Core::ImageRenderServ
           m_grs( nullptr ),
           m_cec( new Carta::Core::DefaultContourGeneratorService( this ) ){
 
-    if ( ! connect( imageRendererService.get(), & Carta::Core::ImageRenderService::Service::done,
+    if ( ! connect( imageRendererService.get(), & Carta::Lib::IImageRenderService::done,
             this, & DrawSynchronizer::_irsDone ) ) {
         qCritical() << "Could not connect imageRenderService done slot";
     }
@@ -9,6 +9,7 @@
 
 namespace Carta {
 namespace Lib {
+    class IImageRenderService;
     class IWcsGridRenderService;
     class IContourGeneratorService;
     class ContourSet;
@@ -20,12 +21,6 @@ namespace Lib {
     }
 }
 
-namespace Core {
-    namespace ImageRenderService {
-        class Service;
-    }
-}
-
 namespace Data {
 
 class DataContours;
@@ -35,7 +30,7 @@ class DrawSynchronizer : public QObject {
     Q_OBJECT
 
 public:
-    DrawSynchronizer( std::shared_ptr<Carta::Core::ImageRenderService::Service> imageRendererService,
+    DrawSynchronizer( std::shared_ptr<Carta::Lib::IImageRenderService> imageRendererService,
             std::shared_ptr<Carta::Lib::IWcsGridRenderService> gridRendererService,
             QObject* parent = nullptr);
 
@@ -94,7 +89,7 @@ private:
     Carta::Lib::VectorGraphics::VGList m_grsVGList;
     Carta::Lib::VectorGraphics::VGList m_cecVGList;
 
-    std::shared_ptr<Carta::Core::ImageRenderService::Service> m_irs;
+    std::shared_ptr<Carta::Lib::IImageRenderService> m_irs;
     std::shared_ptr<Carta::Lib::IWcsGridRenderService> m_grs;
     std::shared_ptr<Carta::Lib::IContourGeneratorService> m_cec;
     std::vector<QPen> m_pens;
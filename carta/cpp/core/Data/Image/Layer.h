@@ -418,6 +418,18 @@ protected:
      */
     void _render( const std::shared_ptr<RenderRequest>& request );
 
+    /**
+     * Render frames in the background before they are loaded, e.g. the next frames
+     * of an animation.
+     * @param frames - the frames in the order they will be loaded, each a list of
+     *      frames, one for each of the known axis types.
+     * @param autoClip true if clips should be automatically generated; false otherwise.
+     * @param clipMinPercentile the minimum clip value.
+     * @param clipMaxPercentile the maximum clip value.
+     */
+    virtual void _renderAhead( const std::vector<std::vector<int> >& frames, bool autoClip,
+            double clipMinPercentile, double clipMaxPercentile ) = 0;
+
     /**
      * Finish the render.
      */
@@ -29,6 +29,7 @@ const QString LayerData::CLASS_NAME = "LayerData";
 const QString LayerData::MASK = "mask";
 const QString LayerData::LAYER_COLOR="colorSupport";
 const QString LayerData::LAYER_ALPHA="alphaSupport";
+const QString LayerData::LOAD_PROGRESS="loadProgress";
 
 
 class LayerData::Factory : public Carta::State::CartaObjectFactory {
@@ -55,6 +56,12 @@ LayerData::LayerData(const QString& path, const QString& id) :
 
         _initializeState();
 
+        //Pixel dependent work on large images is done in the background, re-render
+        //when it is finished.
+        connect( m_dataSource.get(), SIGNAL(clipsChanged()), this, SIGNAL(colorStateChanged()));
+        connect( m_dataSource.get(), SIGNAL(pyramidChanged()), this, SIGNAL(colorStateChanged()));
+        connect( m_dataSource.get(), SIGNAL(loadProgress(double)), this, SLOT(_loadProgress(double)));
+
         Carta::State::ObjectManager* objMan = Carta::State::ObjectManager::objectManager();
         ColorState* colorObj = objMan->createObject<ColorState>();
         m_stateColor.reset( colorObj );
@@ -67,7 +74,7 @@ LayerData::LayerData(const QString& path, const QString& id) :
         _colorChanged();
 
         std::shared_ptr<Carta::Lib::IWcsGridRenderService> gridService = m_dataGrid->_getRenderer();
-        std::shared_ptr<Carta::Core::ImageRenderService::Service> imageService = m_dataSource->_getRenderer();
+        std::shared_ptr<Carta::Lib::IImageRenderService> imageService = m_dataSource->_getRenderer();
 
         // create the synchronizer
         m_drawSync.reset( new DrawSynchronizer( imageService, gridService, this ) );
@@ -457,6 +464,8 @@ void LayerData::_gridChanged( const Carta::State::StateInterface& state ){
 
 
 void LayerData::_initializeState() {
+    m_state.insertValue<double>( LOAD_PROGRESS, 1 );
+
     //Color mix
     m_state.insertObject( MASK );
     QString redKey = Carta::State::UtilState::getLookup( MASK, Util::RED );
@@ -505,6 +514,15 @@ void LayerData::_load(std::vector<int> frames, bool recomputeClipsOnNewFrame,
 
 
 
+void LayerData::_loadProgress( double fraction ){
+    double oldFraction = m_state.getValue<double>( LOAD_PROGRESS );
+    if ( fraction != oldFraction ){
+        m_state.setValue<double>( LOAD_PROGRESS, fraction );
+        m_state.flushState();
+    }
+}
+
+
 void LayerData::_removeContourSet( std::shared_ptr<DataContours> contourSet ){
     if ( contourSet ){
         QString targetName = contourSet->getName();
@@ -519,6 +537,18 @@ void LayerData::_removeContourSet( std::shared_ptr<DataContours> contourSet ){
 }
 
 
+void LayerData::_renderAhead( const std::vector<std::vector<int> >& frames, bool autoClip,
+        double clipMinPercentile, double clipMaxPercentile ){
+    if ( m_dataSource ){
+        //Hidden layers are not drawn, so there is no point in having their frames ready.
+        std::vector<std::vector<int> > framesAhead;
+        if ( _isVisible() ){
+            framesAhead = frames;
+        }
+        m_dataSource->_renderAhead( framesAhead, autoClip, clipMinPercentile, clipMaxPercentile );
+    }
+}
+
 void LayerData::_renderingDone(
         QImage image,
         Carta::Lib::VectorGraphics::VGList gridVG,
@@ -580,7 +610,7 @@ void LayerData::_renderStart(){
     QSize outputSize = request->getOutputSize();
 
     std::shared_ptr<Carta::Lib::IWcsGridRenderService> gridService = m_dataGrid->_getRenderer();
-    std::shared_ptr<Carta::Core::ImageRenderService::Service> imageService = m_dataSource->_getRenderer();
+    std::shared_ptr<Carta::Lib::IImageRenderService> imageService = m_dataSource->_getRenderer();
 
     QSize renderSize = m_viewSize;
     if ( !outputSize.isNull() && !outputSize.isEmpty() &&
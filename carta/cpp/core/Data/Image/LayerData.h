@@ -274,6 +274,18 @@ protected:
     virtual void _load( std::vector<int> frames, bool autoClip, double clipMinPercentile,
                 double clipMaxPercentile ) Q_DECL_OVERRIDE;
 
+    /**
+     * Render frames in the background before they are loaded, e.g. the next frames
+     * of an animation.
+     * @param frames - the frames in the order they will be loaded, each a list of
+     *      frames, one for each of the known axis types.
+     * @param autoClip true if clips should be automatically generated; false otherwise.
+     * @param clipMinPercentile the minimum clip value.
+     * @param clipMaxPercentile the maximum clip value.
+     */
+    virtual void _renderAhead( const std::vector<std::vector<int> >& frames, bool autoClip,
+            double clipMinPercentile, double clipMaxPercentile ) Q_DECL_OVERRIDE;
+
 
     /**
      * Center the image.
@@ -424,6 +436,10 @@ protected slots:
 
 private slots:
 
+    //Notification from the data source about the progress of pixel dependent
+    //work done in the background.
+    void _loadProgress( double fraction );
+
     //Notification from the rendering service that a new image and assiciated vector
     //graphics have been produced.
     void _renderingDone(  QImage image,
@@ -455,6 +471,7 @@ private:
 
     static const QString LAYER_COLOR;
     static const QString LAYER_ALPHA;
+    static const QString LOAD_PROGRESS;
     static const QString MASK;
 
 
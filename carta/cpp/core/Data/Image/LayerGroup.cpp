@@ -690,6 +690,14 @@ void LayerGroup::_load(std::vector<int> frames, bool recomputeClipsOnNewFrame,
     }
 }
 
+void LayerGroup::_renderAhead( const std::vector<std::vector<int> >& frames, bool autoClip,
+        double clipMinPercentile, double clipMaxPercentile ){
+    int childCount = m_children.size();
+    for ( int i = 0; i < childCount; i++ ){
+        m_children[i]->_renderAhead( frames, autoClip, clipMinPercentile, clipMaxPercentile );
+    }
+}
+
 void LayerGroup::_removeData( int index ){
     int childCount = m_children.size();
     if ( 0 <= index && index < childCount ){
@@ -343,6 +343,18 @@ protected:
     virtual void _load( std::vector<int> frames, bool autoClip, double clipMinPercentile,
                double clipMaxPercentile ) Q_DECL_OVERRIDE;
 
+    /**
+     * Render frames in the background before they are loaded, e.g. the next frames
+     * of an animation.
+     * @param frames - the frames in the order they will be loaded, each a list of
+     *      frames, one for each of the known axis types.
+     * @param autoClip true if clips should be automatically generated; false otherwise.
+     * @param clipMinPercentile the minimum clip value.
+     * @param clipMaxPercentile the maximum clip value.
+     */
+    virtual void _renderAhead( const std::vector<std::vector<int> >& frames, bool autoClip,
+            double clipMinPercentile, double clipMaxPercentile ) Q_DECL_OVERRIDE;
+
     /**
      * Remove the contour set from this layer.
      * @param contourSet - the contour set to remove from the layer.
@@ -0,0 +1,64 @@
+#include "LoadThread.h"
+#include "ImageRegistry.h"
+#include <QDebug>
+
+namespace Carta
+{
+namespace Data
+{
+
+LoadThread::LoadThread( const QString& fileName, QObject* parent ):
+    QThread( parent ),
+    m_fileName( fileName ),
+    m_canceled( false ){
+}
+
+void LoadThread::cancel(){
+    m_canceled = true;
+}
+
+bool LoadThread::isCanceled() const {
+    return m_canceled;
+}
+
+QString LoadThread::getFileName() const {
+    return m_fileName;
+}
+
+QString LoadThread::getError() const {
+    return m_error;
+}
+
+std::shared_ptr<Carta::Core::RegisteredImage> LoadThread::getResult() const {
+    return m_result;
+}
+
+
+void LoadThread::run(){
+    m_result.reset();
+    m_error = "";
+    //The loaders cannot be interrupted, so a canceled load still runs to the end,
+    //but nobody waits for it and the image is dropped right away.
+    try {
+        Carta::Core::RegisteredImage::SharedPtr registered =
+                Carta::Core::ImageRegistry::instance().open( m_fileName );
+        if ( !registered ){
+            m_error = "Could not find any plugin to load image";
+        }
+        else if ( !m_canceled ){
+            m_result = registered;
+        }
+    }
+    catch( ... ){
+        m_error = "Failed to load image "+m_fileName;
+        qDebug() << m_error;
+    }
+}
+
+
+LoadThread::~LoadThread(){
+    cancel();
+    wait();
+}
+}
+}
@@ -0,0 +1,87 @@
+/**
+ * A thread that opens an image file in the background, so that a slow file does not
+ * block the user interface. Only the image itself (headers and coordinates) is opened;
+ * the work that needs the pixels is started once the image has been added to a view.
+ **/
+
+#pragma once
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+namespace Carta {
+namespace Core {
+    class RegisteredImage;
+}
+
+namespace Data{
+
+class LoadThread : public QThread {
+
+    Q_OBJECT;
+
+public:
+
+    /**
+     * Constructor.
+     * @param fileName - the absolute path of the image file to open.
+     * @param parent - the parent object.
+     */
+    LoadThread( const QString& fileName, QObject* parent = nullptr );
+
+    /**
+     * Ask the thread to discard the image; the file is closed again when the
+     * thread is finished, unless somebody else is using it.
+     */
+    void cancel();
+
+    /**
+     * Returns true if the load was canceled.
+     * @return - true if the load was canceled; false otherwise.
+     */
+    bool isCanceled() const;
+
+    /**
+     * Returns the path of the image file.
+     * @return - the path of the image file.
+     */
+    QString getFileName() const;
+
+    /**
+     * Returns the reason the image could not be opened.
+     * @return - an error message, or an empty string if the image was opened.
+     */
+    QString getError() const;
+
+    /**
+     * Returns the opened image.
+     * @return - the image, or nullptr if it could not be opened or the load was
+     *      canceled. The image stays in the image registry as long as it is held,
+     *      so that opening the same file again is immediate.
+     */
+    std::shared_ptr<Carta::Core::RegisteredImage> getResult() const;
+
+    /**
+     * Run the thread.
+     */
+    void run();
+
+    /**
+     * Destructor.
+     */
+    ~LoadThread();
+
+private:
+
+    QString m_fileName;
+    QString m_error;
+    std::shared_ptr<Carta::Core::RegisteredImage> m_result;
+    std::atomic<bool> m_canceled;
+
+    LoadThread( const LoadThread& other);
+    LoadThread& operator=( const LoadThread& other );
+};
+}
+}
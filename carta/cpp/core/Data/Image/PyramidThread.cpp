@@ -0,0 +1,60 @@
+#include "PyramidThread.h"
+#include "ImagePyramid.h"
+#include "CartaLib/IImage.h"
+#include "CartaLib/BitMask.h"
+
+namespace Carta
+{
+namespace Data
+{
+
+PyramidThread::PyramidThread( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+        std::shared_ptr<Carta::Lib::NdArray::BitMask> mask,
+        const QString& viewId, QObject* parent ):
+    QThread( parent ),
+    m_mask( mask ),
+    m_viewId( viewId ),
+    m_canceled( false ){
+    //The view may be in use by the render service, so we read our own copy.
+    if ( view ){
+        m_view.reset( view->clone() );
+    }
+}
+
+void PyramidThread::cancel(){
+    m_canceled = true;
+}
+
+bool PyramidThread::isCanceled() const {
+    return m_canceled;
+}
+
+QString PyramidThread::getViewId() const {
+    return m_viewId;
+}
+
+std::shared_ptr<Carta::Core::ImagePyramid> PyramidThread::getResult() const {
+    return m_result;
+}
+
+void PyramidThread::run(){
+    m_result = nullptr;
+    if ( !m_view ){
+        return;
+    }
+    //Masked pixels do not count, as long as the mask matches the view.
+    if ( m_mask && m_mask->dims() != m_view->dims() ){
+        m_mask.reset();
+    }
+    auto pyramid = std::make_shared<Carta::Core::ImagePyramid>();
+    if ( pyramid->build( m_view.get(), m_mask.get(), [this] () { return bool( m_canceled ); } ) ){
+        m_result = pyramid;
+    }
+}
+
+PyramidThread::~PyramidThread(){
+    cancel();
+    wait();
+}
+}
+}
@@ -0,0 +1,89 @@
+/**
+ * A thread that computes the pyramid (lower resolution levels) of a large image frame
+ * in the background, so that it can be rendered quickly when zoomed out.
+ **/
+
+#pragma once
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include <memory>
+
+namespace Carta {
+namespace Lib {
+    namespace NdArray {
+        class RawViewInterface;
+        class BitMask;
+    }
+}
+
+namespace Core {
+    class ImagePyramid;
+}
+
+namespace Data{
+
+class PyramidThread : public QThread {
+
+    Q_OBJECT;
+
+public:
+
+    /**
+     * Constructor.
+     * @param view - the frame to compute the pyramid for; the thread reads its own copy.
+     * @param mask - the mask of the frame, or nullptr if there is none.
+     * @param viewId - an identifier of the frame.
+     * @param parent - the parent object.
+     */
+    PyramidThread( std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> view,
+            std::shared_ptr<Carta::Lib::NdArray::BitMask> mask,
+            const QString& viewId, QObject* parent = nullptr );
+
+    /**
+     * Ask the thread to stop as soon as possible; the result will be empty.
+     */
+    void cancel();
+
+    /**
+     * Returns true if the computation was canceled.
+     * @return - true if the computation was canceled; false otherwise.
+     */
+    bool isCanceled() const;
+
+    /**
+     * Returns the identifier of the frame.
+     * @return - the identifier of the frame the pyramid is computed for.
+     */
+    QString getViewId() const;
+
+    /**
+     * Returns the computed pyramid.
+     * @return - the pyramid, or nullptr if the computation was canceled.
+     */
+    std::shared_ptr<Carta::Core::ImagePyramid> getResult() const;
+
+    /**
+     * Run the thread.
+     */
+    void run();
+
+    /**
+     * Destructor.
+     */
+    ~PyramidThread();
+
+private:
+
+    std::shared_ptr<Carta::Lib::NdArray::RawViewInterface> m_view;
+    std::shared_ptr<Carta::Lib::NdArray::BitMask> m_mask;
+    QString m_viewId;
+    std::shared_ptr<Carta::Core::ImagePyramid> m_result;
+    std::atomic<bool> m_canceled;
+
+    PyramidThread( const PyramidThread& other);
+    PyramidThread& operator=( const PyramidThread& other );
+};
+}
+}
@@ -395,6 +395,21 @@ void Stack::_load( bool recomputeClipsOnNewFrame,
     _renderAll();
 }
 
+void Stack::_renderAhead( const std::vector<int>& frameIndices, AxisInfo::KnownType axisType,
+        bool autoClip, double clipMinPercentile, double clipMaxPercentile ){
+    //The other axes stay where they are.
+    std::vector<std::vector<int> > frames;
+    int axisIndex = static_cast<int>( axisType );
+    std::vector<int> current = _getFrameIndices();
+    if ( 0 <= axisIndex && axisIndex < static_cast<int>( current.size() ) ){
+        for ( int frameIndex : frameIndices ){
+            frames.push_back( current );
+            frames.back()[axisIndex] = frameIndex;
+        }
+    }
+    LayerGroup::_renderAhead( frames, autoClip, clipMinPercentile, clipMaxPercentile );
+}
+
 QString Stack::_moveSelectedLayers( bool moveDown ){
     QString result;
     QList<int> selectIndices;
@@ -767,6 +782,8 @@ bool Stack::_setSelected( QStringList& names){
 void Stack::_setViewName( const QString& viewName ){
     m_stackDraw.reset( new DrawStackSynchronizer(makeRemoteView( viewName)));
     connect( m_stackDraw.get(), SIGNAL(viewResize()), this, SLOT(_viewResize()));
+    connect( m_stackDraw.get(), SIGNAL(frameRepainted(const std::vector<int>&)),
+            this, SIGNAL(frameRepainted(const std::vector<int>&)));
 }
 
 bool Stack::_setVisible( const QString& id, bool visible ){
@@ -42,6 +42,9 @@ signals:
     /// and a save attempt made.
     void saveImageResult( bool result );
 
+    /// The client has shown the image of the given frames, one for each axis.
+    void frameRepainted( const std::vector<int>& frames );
+
 protected:
 
     virtual bool _addGroup( /*const QString& state*/ ) Q_DECL_OVERRIDE;
@@ -120,6 +123,18 @@ private:
      */
     void _load( bool autoClip, double clipMinPercentile, double clipMaxPercentile );
 
+    /**
+     * Render the upcoming frames of an animation in the background.
+     * @param frameIndices - the upcoming frames of the animated axis, in order.
+     * @param axisType - the animated axis.
+     * @param autoClip true if clips should be automatically generated; false otherwise.
+     * @param clipMinPercentile the minimum clip value.
+     * @param clipMaxPercentile the maximum clip value.
+     */
+    void _renderAhead( const std::vector<int>& frameIndices,
+            Carta::Lib::AxisInfo::KnownType axisType, bool autoClip,
+            double clipMinPercentile, double clipMaxPercentile );
+
 
     QString _moveSelectedLayers( bool moveDown );
     void _render(QList<std::shared_ptr<Layer> > datas, int gridIndex);
@@ -86,6 +86,16 @@ public:
      */
     QString loadFile( const QString& objectId, const QString& fileName, bool* success);
 
+    /**
+     * Start loading the file into the controller with the given id, without waiting
+     * for it to be opened; see Controller::addDataAsync().
+     * @param objectId the unique server side id of the controller which is
+     * responsible for displaying the file.
+     * @param fileName a locater for the data to load.
+     * @return - an error message if there is no such controller; an empty string otherwise.
+     */
+    QString loadFileAsync( const QString& objectId, const QString& fileName );
+
 
     /**
      * Replace the destination plug-in identified by its type and index with the source
@@ -0,0 +1,217 @@
+/**
+ *
+ **/
+
+#include "ImagePyramid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace Carta
+{
+namespace Core
+{
+namespace NdArray = Carta::Lib::NdArray;
+
+/// number of pixels we request from the views at a time
+static constexpr int64_t BulkBlockSize = 4096;
+
+/// NaN-aware accumulator of a block of pixels
+class BlockAccumulator
+{
+public:
+
+    explicit
+    BlockAccumulator( ImagePyramid::Reduction reduction ) : m_reduction( reduction ) { }
+
+    void
+    add( double val )
+    {
+        if ( std::isnan( val ) ) {
+            return;
+        }
+        if ( m_reduction == ImagePyramid::Reduction::Mean ) {
+            m_value += val;
+        }
+        else if ( m_count == 0 || val > m_value ) {
+            m_value = val;
+        }
+        m_count++;
+    }
+
+    float
+    result() const
+    {
+        if ( m_count == 0 ) {
+            return std::numeric_limits < float >::quiet_NaN();
+        }
+        if ( m_reduction == ImagePyramid::Reduction::Mean ) {
+            return m_value / m_count;
+        }
+        return m_value;
+    }
+
+private:
+
+    ImagePyramid::Reduction m_reduction;
+    double m_value = 0;
+    int64_t m_count = 0;
+};
+
+ImagePyramid::ImagePyramid( Reduction reduction )
+    : m_reduction( reduction )
+{ }
+
+bool
+ImagePyramid::build( NdArray::RawViewInterface * view,
+                     const NdArray::BitMask * mask,
+                     std::function < bool () > canceled )
+{
+    CARTA_ASSERT( view );
+    m_levels.clear();
+    const auto & dims = view-> dims();
+    const int64_t width = dims.size() > 0 ? dims[0] : 1;
+    const int height = dims.size() > 1 ? dims[1] : 1;
+    if ( width * height <= MinFramePixels ) {
+        return true;
+    }
+    if ( mask && mask-> size() != width * height ) {
+        mask = nullptr;
+    }
+
+    // the finest level is reduced straight from the frame, by a factor large enough to
+    // keep it within the budget
+    Level first;
+    first.factor = 2;
+    auto reducedSize = [&] ( int64_t size ) {
+        return int ( ( size + first.factor - 1 ) / first.factor );
+    };
+    while ( int64_t( reducedSize( width ) ) * reducedSize( height ) > MaxLevelPixels ) {
+        first.factor *= 2;
+    }
+    first.width = reducedSize( width );
+    first.height = reducedSize( height );
+    first.data.resize( int64_t( first.width ) * first.height );
+
+    // each row of the level is computed from a band of 'factor' rows of the frame
+    std::vector < BlockAccumulator > blocks;
+    for ( int ly = 0 ; ly < first.height ; ++ly ) {
+        if ( canceled && canceled() ) {
+            return false;
+        }
+        int y1 = ly * first.factor;
+        int y2 = std::min( y1 + first.factor, height );
+        blocks.assign( first.width, BlockAccumulator( m_reduction ) );
+
+        SliceND bandSlice;
+        bandSlice.next().start( y1 ).end( y2 );
+        std::unique_ptr < NdArray::RawViewInterface > bandView( view-> getView( bandSlice ) );
+        NdArray::TypedView < double > typedView( bandView.get(), false );
+
+        int64_t index = y1 * width;
+        int64_t col = 0;
+        auto addRun = [&] ( const double * vals, int64_t count, bool valid ) {
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                if ( valid ) {
+                    blocks[col / first.factor].add( vals[i] );
+                }
+                if ( ++col == width ) {
+                    col = 0;
+                }
+            }
+        };
+        typedView.forEach( BulkBlockSize, [&] ( const double * vals, int64_t count ) {
+                               if ( ! mask ) {
+                                   addRun( vals, count, true );
+                               }
+                               else {
+                                   mask-> forEachRun( index, count,
+                                                      [&] ( int64_t start, int64_t n, bool valid ) {
+                                                          addRun( vals + ( start - index ), n, valid );
+                                                      } );
+                               }
+                               index += count;
+                           } );
+
+        float * out = first.data.data() + int64_t( ly ) * first.width;
+        for ( int lx = 0 ; lx < first.width ; ++lx ) {
+            out[lx] = blocks[lx].result();
+        }
+    }
+    m_levels.push_back( std::move( first ) );
+
+    // the coarser levels are reduced from the previous one
+    while ( std::max( m_levels.back().width, m_levels.back().height ) > MinLevelSize ) {
+        if ( canceled && canceled() ) {
+            m_levels.clear();
+            return false;
+        }
+        Level next = reduce( m_levels.back(), m_reduction );
+        m_levels.push_back( std::move( next ) );
+    }
+    return true;
+} // build
+
+const ImagePyramid::Level &
+ImagePyramid::level( int index ) const
+{
+    CARTA_ASSERT( index >= 0 && index < levelCount() );
+    return m_levels[index];
+}
+
+int
+ImagePyramid::levelForStep( int step ) const
+{
+    int result = - 1;
+    for ( int i = 0 ; i < levelCount() ; ++i ) {
+        if ( m_levels[i].factor <= step ) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+int64_t
+ImagePyramid::byteSize() const
+{
+    int64_t size = 0;
+    for ( const Level & level : m_levels ) {
+        size += level.data.size() * sizeof( float );
+    }
+    return size;
+}
+
+ImagePyramid::Level
+ImagePyramid::reduce( const Level & level, Reduction reduction )
+{
+    Level result;
+    result.factor = level.factor * 2;
+    result.width = ( level.width + 1 ) / 2;
+    result.height = ( level.height + 1 ) / 2;
+    result.data.resize( int64_t( result.width ) * result.height );
+    for ( int y = 0 ; y < result.height ; ++y ) {
+        const float * row1 = level.row( 2 * y );
+        const float * row2 = 2 * y + 1 < level.height ? level.row( 2 * y + 1 ) : nullptr;
+        float * out = result.data.data() + int64_t( y ) * result.width;
+        for ( int x = 0 ; x < result.width ; ++x ) {
+            // the last row/column may be missing
+            BlockAccumulator block( reduction );
+            bool haveRight = 2 * x + 1 < level.width;
+            block.add( row1[2 * x] );
+            if ( haveRight ) {
+                block.add( row1[2 * x + 1] );
+            }
+            if ( row2 ) {
+                block.add( row2[2 * x] );
+                if ( haveRight ) {
+                    block.add( row2[2 * x + 1] );
+                }
+            }
+            out[x] = block.result();
+        }
+    }
+    return result;
+} // reduce
+}
+}
@@ -0,0 +1,111 @@
+/**
+ * Multi-resolution pyramid (mipmaps) of a 2D frame.
+ *
+ * Rendering a large frame zoomed out only needs one value per screen pixel, but
+ * sampling the full resolution data to get it still reads all of the pixels from disk,
+ * and picking every n-th pixel aliases badly. The pyramid holds block-reduced copies of
+ * the frame, each level half the size of the previous one, so the renderer can sample
+ * the level that matches the zoom instead.
+ *
+ * The finest level is already reduced by enough to keep its memory footprint bounded
+ * (a few million pixels), the levels stop when they get smaller than a screen.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include "CartaLib/BitMask.h"
+#include <functional>
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+class ImagePyramid
+{
+    CLASS_BOILERPLATE( ImagePyramid );
+
+public:
+
+    /// how a block of pixels is reduced to a single value, in both cases NaNs (and
+    /// masked pixels) are ignored, and blocks without valid pixels become NaN
+    enum class Reduction
+    {
+        Mean, ///< average of the valid pixels
+        Max   ///< largest valid pixel, keeps point sources visible
+    };
+
+    /// one level of the pyramid
+    struct Level
+    {
+        int width = 0;
+        int height = 0;
+
+        /// number of frame pixels (in each direction) covered by one pixel of this level
+        int factor = 1;
+
+        /// the pixels, in the same order as the frame (x fastest, starting at the bottom)
+        std::vector < float > data;
+
+        const float *
+        row( int y ) const { return data.data() + int64_t( y ) * width; }
+    };
+
+    /// frames with at most this many pixels don't need a pyramid
+    static constexpr int64_t MinFramePixels = 2048 * 2048;
+
+    /// max. number of pixels of the finest level
+    static constexpr int64_t MaxLevelPixels = 2048 * 2048;
+
+    /// the reduction stops once both sides of a level are at most this long
+    static constexpr int MinLevelSize = 256;
+
+    explicit
+    ImagePyramid( Reduction reduction = Reduction::Mean );
+
+    /// \brief compute the levels of a frame
+    /// \param view the frame, with dimensions [width, height, 1, ...]
+    /// \param mask optional mask with the same dimensions, masked pixels are ignored
+    /// \param canceled optional callback, checked every now and then; if it returns true
+    /// the computation stops and the pyramid stays empty
+    /// \return false if the computation was canceled
+    bool
+    build( Carta::Lib::NdArray::RawViewInterface * view,
+           const Carta::Lib::NdArray::BitMask * mask = nullptr,
+           std::function < bool () > canceled = nullptr );
+
+    /// how the blocks are reduced
+    Reduction
+    reduction() const { return m_reduction; }
+
+    /// number of levels, 0 if the pyramid was not built
+    int
+    levelCount() const { return m_levels.size(); }
+
+    /// levels in the order of increasing factor
+    const Level &
+    level( int index ) const;
+
+    /// \brief find the level to sample when rendering every step-th frame pixel
+    /// \return index of the coarsest level with factor <= step, or -1 if the frame
+    /// itself should be sampled
+    int
+    levelForStep( int step ) const;
+
+    /// memory footprint of the levels (in bytes)
+    int64_t
+    byteSize() const;
+
+    /// reduce a level by 2x2 blocks
+    static Level
+    reduce( const Level & level, Reduction reduction );
+
+private:
+
+    Reduction m_reduction;
+    std::vector < Level > m_levels;
+};
+}
+}
@@ -0,0 +1,179 @@
+/**
+ *
+ **/
+
+#include "ImageRegistry.h"
+#include "Globals.h"
+#include "MainConfig.h"
+#include "PluginManager.h"
+#include "CartaLib/Hooks/LoadAstroImage.h"
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace Carta
+{
+namespace Core
+{
+/// default budget for idle images
+static const int64_t DefaultIdleBudget = int64_t( 1024 ) * 1024 * 1024;
+
+RegisteredImage::RegisteredImage( Carta::Lib::Image::ImageInterface::SharedPtr image,
+                                  const QString & key )
+    : m_image( image )
+      , m_key( key )
+{
+    CARTA_ASSERT( image );
+    m_pixelDataSize = Carta::Lib::Image::pixelType2size( image-> pixelType() );
+    for ( auto dim : image-> dims() ) {
+        m_pixelDataSize *= dim;
+    }
+}
+
+Carta::Lib::Image::ImageInterface::SharedPtr
+RegisteredImage::permuted( const std::vector < int > & indices )
+{
+    std::unique_lock < std::mutex > lock( m_mutex );
+    auto & result = m_permuted[indices];
+    if ( ! result ) {
+        result = m_image-> getPermuted( indices );
+    }
+    return result;
+}
+
+ImageRegistry &
+ImageRegistry::instance()
+{
+    // never destroyed, handles may outlive static destructors
+    static ImageRegistry * registry = nullptr;
+    if ( ! registry ) {
+        registry = new ImageRegistry;
+        const MainConfig::ParsedInfo * config = Globals::instance()-> mainConfig();
+        if ( config && config-> getIdleImagePixelDataSize() >= 0 ) {
+            registry-> setIdleBudget(
+                int64_t( config-> getIdleImagePixelDataSize() ) * 1024 * 1024 );
+        }
+    }
+    return * registry;
+}
+
+ImageRegistry::ImageRegistry()
+    : m_idleBudget( DefaultIdleBudget )
+{
+    m_loader = [] ( const QString & path ) {
+        auto res = Globals::instance()-> pluginManager()
+                       -> prepare < Carta::Lib::Hooks::LoadAstroImage > ( path ).first();
+        return res.isNull() ? nullptr : res.val();
+    };
+}
+
+RegisteredImage::SharedPtr
+ImageRegistry::open( const QString & path )
+{
+    QString key = _key( path );
+    std::unique_lock < std::mutex > lock( m_mutex );
+
+    // somebody else may be loading the same file, in which case we wait for them
+    while ( m_loading.count( key ) ) {
+        m_loadFinished.wait( lock );
+    }
+    RegisteredImage::SharedPtr entry;
+    auto it = m_entries.find( key );
+    if ( it != m_entries.end() ) {
+        entry = it-> second;
+    }
+    else {
+        // load without the lock, other images can be opened and released meanwhile
+        m_loading.insert( key );
+        Loader loader = m_loader;
+        lock.unlock();
+        Carta::Lib::Image::ImageInterface::SharedPtr image;
+        try {
+            image = loader( path );
+        }
+        catch ( ... ) {
+            lock.lock();
+            m_loading.erase( key );
+            m_loadFinished.notify_all();
+            throw;
+        }
+        lock.lock();
+        m_loading.erase( key );
+        m_loadFinished.notify_all();
+        if ( ! image ) {
+            return nullptr;
+        }
+        entry = std::make_shared < RegisteredImage > ( image, key );
+        m_entries[key] = entry;
+    }
+    if ( entry-> m_users == 0 ) {
+        m_idle.remove( key );
+    }
+    entry-> m_users++;
+
+    // the handle shares ownership of the entry, and tells us when the last one is gone
+    return RegisteredImage::SharedPtr( entry.get(), [this, entry] ( RegisteredImage * ) {
+                                           _release( entry );
+                                       } );
+} // open
+
+void
+ImageRegistry::setIdleBudget( int64_t bytes )
+{
+    std::unique_lock < std::mutex > lock( m_mutex );
+    m_idleBudget = bytes;
+    _trim();
+}
+
+void
+ImageRegistry::setLoader( ImageRegistry::Loader loader )
+{
+    std::unique_lock < std::mutex > lock( m_mutex );
+    m_loader = loader;
+}
+
+int
+ImageRegistry::size() const
+{
+    std::unique_lock < std::mutex > lock( m_mutex );
+    return m_entries.size();
+}
+
+QString
+ImageRegistry::_key( const QString & path )
+{
+    QFileInfo info( path );
+    if ( ! info.exists() ) {
+        return path;
+    }
+    return info.canonicalFilePath() + "@" +
+           QString::number( info.lastModified().toMSecsSinceEpoch() );
+}
+
+void
+ImageRegistry::_release( RegisteredImage::SharedPtr entry )
+{
+    std::unique_lock < std::mutex > lock( m_mutex );
+    CARTA_ASSERT( entry-> m_users > 0 );
+    entry-> m_users--;
+    if ( entry-> m_users == 0 ) {
+        m_idle.push_back( entry-> key() );
+        _trim();
+    }
+}
+
+void
+ImageRegistry::_trim()
+{
+    int64_t idleSize = 0;
+    for ( const QString & key : m_idle ) {
+        idleSize += m_entries[key]-> pixelDataSize();
+    }
+    while ( ! m_idle.empty() && idleSize > m_idleBudget ) {
+        QString key = m_idle.front();
+        m_idle.pop_front();
+        idleSize -= m_entries[key]-> pixelDataSize();
+        m_entries.erase( key );
+    }
+}
+}
+}
@@ -0,0 +1,163 @@
+/**
+ * Process-wide registry of opened images.
+ *
+ * Every consumer of an image file (image views, statistics, histograms, profiles...)
+ * opens it through the registry, which keeps one ImageInterface per file (identified by
+ * the canonical path and the modification time), together with data derived from it that
+ * is worth sharing, e.g. permuted images or clip caches.
+ *
+ * Handles returned by open() are reference counted. When the last handle to an image is
+ * released the image is not closed right away, but kept around as idle, in case somebody
+ * opens it again (e.g. when a layer is reloaded or another view is linked). Idle images
+ * are closed in least recently used order when the total size of their pixel data exceeds
+ * the budget, which can be set in the main config file as "idleImagePixelDataMB". Most
+ * loaders read pixels lazily, so this is a limit on how much data the idle images could
+ * bring into memory, not on how much they currently hold.
+ *
+ * Images are loaded without holding the registry's lock, so a slow file does not hold up
+ * everybody else. Concurrent open() calls for the same file wait for the first one to
+ * finish loading it, and then share the result.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "CartaLib/IImage.h"
+#include <QString>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace Carta
+{
+namespace Core
+{
+/// an opened image and the data derived from it
+class RegisteredImage
+{
+    CLASS_BOILERPLATE( RegisteredImage );
+
+public:
+
+    RegisteredImage( Carta::Lib::Image::ImageInterface::SharedPtr image, const QString & key );
+
+    /// the image
+    Carta::Lib::Image::ImageInterface::SharedPtr
+    image() const { return m_image; }
+
+    /// the image with permuted axes, see ImageInterface::getPermuted()
+    Carta::Lib::Image::ImageInterface::SharedPtr
+    permuted( const std::vector < int > & indices );
+
+    /// \brief data derived from the image, shared among all users of the image
+    /// \param key identifies the data, e.g. "quantiles/0,1,2"
+    /// \return the data, default constructed the first time it's requested
+    /// \note the same key must always be used with the same type
+    template < typename T >
+    std::shared_ptr < T >
+    derived( const QString & key )
+    {
+        std::unique_lock < std::mutex > lock( m_mutex );
+        std::shared_ptr < void > & data = m_derived[key];
+        if ( ! data ) {
+            data = std::make_shared < T > ();
+        }
+        return std::static_pointer_cast < T > ( data );
+    }
+
+    /// identifier of the image (canonical path and modification time)
+    const QString &
+    key() const { return m_key; }
+
+    /// size of the image's pixel data (in bytes), whether it's been read in or not
+    int64_t
+    pixelDataSize() const { return m_pixelDataSize; }
+
+private:
+
+    Carta::Lib::Image::ImageInterface::SharedPtr m_image;
+    QString m_key;
+    int64_t m_pixelDataSize = 0;
+    std::mutex m_mutex;
+    std::map < std::vector < int >, Carta::Lib::Image::ImageInterface::SharedPtr > m_permuted;
+    std::map < QString, std::shared_ptr < void > > m_derived;
+
+    /// number of handles given out by the registry
+    int m_users = 0;
+
+    friend class ImageRegistry;
+};
+
+/// the registry of opened images, see the description at the top of this file
+class ImageRegistry
+{
+    CLASS_BOILERPLATE( ImageRegistry );
+
+public:
+
+    /// loads an image, returns nullptr if it cannot be loaded
+    typedef std::function < Carta::Lib::Image::ImageInterface::SharedPtr (const QString &) >
+        Loader;
+
+    /// the registry used by the whole process
+    static ImageRegistry &
+    instance();
+
+    /// \brief open an image, or share the already opened one
+    /// \param path path to the image file
+    /// \return handle to the image, or nullptr if it could not be loaded; the image
+    /// stays open (at least) as long as there are handles to it
+    /// \note exceptions thrown by the loader are passed on
+    RegisteredImage::SharedPtr
+    open( const QString & path );
+
+    /// set the max. total pixel data size of idle images (in bytes)
+    void
+    setIdleBudget( int64_t bytes );
+
+    /// replace the loader (by default the LoadAstroImage hook of the plugins)
+    void
+    setLoader( Loader loader );
+
+    /// number of opened images (with or without users)
+    int
+    size() const;
+
+    ImageRegistry();
+
+private:
+
+    /// identifier of the file
+    static QString
+    _key( const QString & path );
+
+    /// a handle to the entry was released
+    void
+    _release( RegisteredImage::SharedPtr entry );
+
+    /// close idle images over the budget, the caller must hold the lock
+    void
+    _trim();
+
+    mutable std::mutex m_mutex;
+
+    /// signalled whenever a load finishes
+    std::condition_variable m_loadFinished;
+    Loader m_loader;
+    int64_t m_idleBudget;
+
+    /// all opened images
+    std::map < QString, RegisteredImage::SharedPtr > m_entries;
+
+    /// keys of images that are being loaded right now
+    std::set < QString > m_loading;
+
+    /// keys of idle images, most recently released last
+    std::list < QString > m_idle;
+};
+}
+}
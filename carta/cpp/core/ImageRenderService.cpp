@@ -5,107 +5,1030 @@
 #include "ImageRenderService.h"
 #include "CartaLib/LinearMap.h"
 #include <QColor>
+#include <QMutex>
 #include <QPainter>
+#include <QThread>
+#include <QWaitCondition>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace NdArray = Carta::Lib::NdArray;
+typedef Carta::Lib::TemplatedPixelPipeline::FusedPipeline FusedPipeline;
 
 // most optimal Qt format seems to be Format_ARGB32_Premultiplied
 static constexpr QImage::Format OptimalQImageFormat = QImage::Format_ARGB32_Premultiplied;
 
-// however!!!! there seems to be a bug in QT's rendering of premultiplied images...
-// there goes significant chunk of my life!!!!!!!!!!!!!!! GRRRRRRRRR!!!!!!!!!
-// QPainter::drawImage( QRectF ....) will really mess up with high zoom (scaling)
-// if source & destination are both ARGB32_Premultiplied
-/// \todo check if the bug is still there in Qt5.4+, it definitely is there in Qt5.3
-static constexpr bool QtPremultipliedBugStillExists = true;
+// number of pixels we request from the views at a time
+static constexpr int64_t BulkBlockSize = 4096;
 
-/// internal algorithm for converting an instance of image interface to qimage
+// margin (in screen pixels) rendered around the visible part of the frame
+static constexpr double ViewportMargin = 64;
+
+// number of pixels in one band of rows converted by a single thread at a time
+static constexpr int64_t BandPixels = 256 * 1024;
+
+// max. number of pixels read for the frame window when the output pixels are averaged
+static constexpr int64_t MaxAveragedFramePixels = 4096 * 4096;
+
+// how far (in screen pixels) a pan can be from a whole number of screen pixels, for the
+// last output to be shifted instead of rendered again
+static constexpr double MaxShiftError = 1e-3;
+
+// max. bytes of output images rendered ahead at a time, a part of the frame cache
+static constexpr int64_t RenderAheadMaxCost = 256 * 1024 * 1024;
+
+/// returns true once the job being rendered has been superseded (or is no longer needed)
+typedef std::function < bool () > CancelFunc;
+
+/// part of the input view that is converted to the frame image: pixels [x1,x2) x [y1,y2)
+/// of the view, of which only every step-th pixel in each direction is sampled
+struct FrameWindow
+{
+    int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    int step = 1;
+
+    /// size of the frame image
+    int
+    cols() const { return ( x2 - x1 + step - 1 ) / step; }
+
+    int
+    rows() const { return ( y2 - y1 + step - 1 ) / step; }
+};
+
+/// target of the conversions: the values of the pixels of the frame window, masked
+/// pixels are NaN
+/// \note rows are counted from the top, like in QImage, but they are stored bottom-up
+/// (like the pyramid levels), which is what the Resampler wants
+class ValueFrame
+{
+public:
+
+    typedef float Pixel;
+
+    ValueFrame( std::vector < float > & data, QSize size ) : m_data( data ), m_size( size )
+    {
+        m_data.resize( int64_t( size.width() ) * size.height() );
+    }
+
+    QSize
+    size() const { return m_size; }
+
+    Pixel *
+    scanLine( int y )
+    {
+        return m_data.data() + int64_t( m_size.height() - 1 - y ) * m_size.width();
+    }
+
+private:
+
+    std::vector < float > & m_data;
+    QSize m_size;
+};
+
+/// 'pipeline' that leaves the values alone, the colors are applied after resampling
+class ValueCopy
+{
+public:
+
+    template < typename T >
+    void
+    convertq( const T * vals, int64_t count, float * out, float ) const
+    {
+        std::copy( vals, vals + count, out );
+    }
+};
+
+/// convert rows [r1, r2) of the frame (counted from the bottom) to the
+/// corresponding scanlines of the frame image, the view is read as Scalar
+template < class Scalar, class Pipeline, class Frame >
+static void
+iViewBand2frame( NdArray::RawViewInterface * rawView, const FrameWindow & window,
+                 int r1, int r2, Pipeline & pipe,
+                 Frame & frame, typename Frame::Pixel nanValue, const NdArray::BitMask * mask )
+{
+    typedef typename Frame::Pixel Pixel;
+    const int64_t viewWidth = rawView-> dims()[0];
+    const int step = window.step;
+    const int width = window.cols();
+    const int height = window.rows();
+
+    // get our own view of the band, so that the threads don't share any cursors
+    SliceND bandSlice;
+    bandSlice.start( window.x1 ).end( window.x2 ).step( step )
+        .next().start( window.y1 + r1 * step ).end( window.y1 + ( r2 - 1 ) * step + 1 )
+        .step( step );
+    std::unique_ptr < NdArray::RawViewInterface > bandView( rawView-> getView( bandSlice ) );
+    NdArray::TypedView < Scalar > typedView( bandView.get(), false );
+
+    // we are building the image bottom-up, row r of the frame is scanline height-1-r
+    Pixel * outPtr = frame.scanLine( height - 1 - r1 );
+    int row = r1;
+    int col = 0;
+
+    auto convertRun = [&] ( const Scalar * vals, int64_t count, bool valid )
+    {
+        if ( Q_LIKELY( valid ) ) {
+            pipe.convertq( vals, count, outPtr, nanValue );
+        }
+        else {
+            std::fill( outPtr, outPtr + count, nanValue );
+        }
+        outPtr += count;
+    };
+
+    // we use the bulk accessor, so that the lambda is inlined into the per-pixel loop
+    // and the conversion to Scalar is done a block at a time
+    auto lambda = [&] ( const Scalar * vals, int64_t count )
+    {
+        while ( count > 0 ) {
+            // the blocks are not aligned with the rows, and the mask is indexed by the
+            // pixels of the whole view, so work one row segment at a time
+            int64_t n = std::min < int64_t > ( count, width - col );
+            if ( ! mask ) {
+                convertRun( vals, n, true );
+            }
+            else {
+                int64_t maskIndex = ( window.y1 + int64_t( row ) * step ) * viewWidth
+                                    + window.x1 + int64_t( col ) * step;
+                if ( step == 1 ) {
+                    // the mask is scanned a word at a time, we only see runs of
+                    // valid/masked pixels
+                    mask-> forEachRun( maskIndex, n,
+                                       [&] ( int64_t first, int64_t runLength, bool valid ) {
+                        convertRun( vals + ( first - maskIndex ), runLength, valid );
+                    } );
+                }
+                else {
+                    for ( int64_t i = 0 ; i < n ; ++i ) {
+                        convertRun( vals + i, 1, mask-> isValid( maskIndex + i * step ) );
+                    }
+                }
+            }
+            vals += n;
+            count -= n;
+            col += n;
+            if ( col == width ) {
+                col = 0;
+                row++;
+                if ( row < r2 ) {
+                    outPtr = frame.scanLine( height - 1 - row );
+                }
+            }
+        }
+    };
+    typedView.forEach( BulkBlockSize, lambda );
+    CARTA_ASSERT( row == r2 && col == 0 );
+} // iViewBand2frame
+
+/// split the rows of a frame image into bands and invoke func( r1, r2 ) for each band
+/// of rows [r1, r2), using a pool of threads
+/// \param canceled checked before each band, once it returns true the remaining bands
+/// are skipped; it is called from all the threads
+template < class Func >
+static void
+forEachBand( QSize size, const CancelFunc & canceled, Func func )
+{
+    if ( size.isEmpty() ) {
+        return;
+    }
+
+    // figure out how many threads are worth it
+    const int height = size.height();
+    const int bandRows = std::max < int64_t > ( 1, BandPixels / size.width() );
+    const int nBands = ( height + bandRows - 1 ) / bandRows;
+    int nThreads = Carta::Lib::clamp < int > ( std::thread::hardware_concurrency(), 1, nBands );
+
+    // the threads pick up the bands one at a time, so a slow band does not hold up
+    // the others
+    std::atomic < int > nextBand( 0 );
+    auto worker = [&] () {
+        for ( int band = nextBand++ ; band < nBands && ! canceled() ; band = nextBand++ ) {
+            int r1 = band * bandRows;
+            int r2 = std::min( r1 + bandRows, height );
+            func( r1, r2 );
+        }
+    };
+    std::vector < std::thread > threads;
+    for ( int i = 1 ; i < nThreads ; ++i ) {
+        threads.emplace_back( worker );
+    }
+    worker();
+    for ( auto & thread : threads ) {
+        thread.join();
+    }
+} // forEachBand
+
+/// internal algorithm for converting an instance of image interface to a frame image
 /// using the pixel pipeline
 ///
+/// Only the given window of the view is converted, the result has one pixel per sampled
+/// view pixel. The window is split into bands of rows, which are converted by a pool of
+/// threads. Each band is read through its own view and written directly into its
+/// scanlines.
+///
+/// \tparam Scalar type the view is read as
 /// \tparam Pipeline
 /// \param m_rawView
+/// \param window the part of the view to convert
 /// \param pipe
-/// \param m_qImage
-template < class Pipeline >
+/// \param frame the output, of the size of the window
+/// \param mask optional mask for the whole view, masked pixels are set to nanValue
+/// \param canceled see forEachBand()
+template < class Scalar, class Pipeline, class Frame >
 static void
-iView2qImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage,
-        QRgb nanColor)
+iView2frame( NdArray::RawViewInterface * rawView, const FrameWindow & window,
+             Pipeline & pipe, Frame & frame,
+        typename Frame::Pixel nanValue, const NdArray::BitMask * mask,
+        const CancelFunc & canceled )
 {
     //qDebug() << "rv2qi2" << rawView-> dims();
-    typedef double Scalar;
+    CARTA_ASSERT( frame.size() == QSize( window.cols(), window.rows() ) );
+    CARTA_ASSERT( ! mask || mask-> size() == int64_t( rawView-> dims()[0] ) * rawView-> dims()[1] );
+    CARTA_ASSERT( window.x1 >= 0 && window.x2 <= rawView-> dims()[0] &&
+                  window.y1 >= 0 && window.y2 <= rawView-> dims()[1] );
+
+    forEachBand( frame.size(), canceled, [&] ( int r1, int r2 ) {
+        iViewBand2frame < Scalar > ( rawView, window, r1, r2, pipe, frame, nanValue, mask );
+    } );
+} // iView2frame
+
+/// pipelines that can convert the pixel types of the views as they are, rather than
+/// as doubles
+template < class Pipeline >
+struct NativeInput : std::false_type { };
+
+template <>
+struct NativeInput < ValueCopy > : std::true_type { };
+
+/// iView2frame() with the view read as doubles
+template < class Pipeline, class Frame >
+static void
+iView2frameNative( NdArray::RawViewInterface * rawView, const FrameWindow & window,
+                   Pipeline & pipe, Frame & frame, typename Frame::Pixel nanValue,
+                   const NdArray::BitMask * mask, const CancelFunc & canceled, std::false_type )
+{
+    iView2frame < double > ( rawView, window, pipe, frame, nanValue, mask, canceled );
+}
+
+/// iView2frame() with the view read in its own pixel type, if the pipeline has a kernel
+/// for it
+template < class Pipeline, class Frame >
+static void
+iView2frameNative( NdArray::RawViewInterface * rawView, const FrameWindow & window,
+                   Pipeline & pipe, Frame & frame, typename Frame::Pixel nanValue,
+                   const NdArray::BitMask * mask, const CancelFunc & canceled, std::true_type )
+{
+    switch ( rawView-> pixelType() )
+    {
+    case Carta::Lib::Image::PixelType::Real32 :
+        iView2frame < float > ( rawView, window, pipe, frame, nanValue, mask, canceled );
+        break;
+
+    case Carta::Lib::Image::PixelType::Int16 :
+        iView2frame < int16_t > ( rawView, window, pipe, frame, nanValue, mask, canceled );
+        break;
+
+    default:
+        iView2frame < double > ( rawView, window, pipe, frame, nanValue, mask, canceled );
+    }
+}
+
+/// same as iView2frame(), but samples a level of a pyramid, the window is in the
+/// pixels of the level
+template < class Pipeline, class Frame >
+static void
+level2frame( const Carta::Core::ImagePyramid::Level & level, const FrameWindow & window,
+             Pipeline & pipe, Frame & frame, typename Frame::Pixel nanValue,
+             const CancelFunc & canceled )
+{
+    QSize size = frame.size();
+    CARTA_ASSERT( size == QSize( window.cols(), window.rows() ) );
+    CARTA_ASSERT( window.x1 >= 0 && window.x2 <= level.width &&
+                  window.y1 >= 0 && window.y2 <= level.height );
+
+    forEachBand( size, canceled, [&] ( int r1, int r2 ) {
+        std::vector < float > rowBuffer;
+        for ( int r = r1 ; r < r2 ; ++r ) {
+            // the level is in memory, so we just pick the pixels, gathering them into
+            // a buffer if we skip some
+            const float * src = level.row( window.y1 + r * window.step ) + window.x1;
+            if ( window.step != 1 ) {
+                rowBuffer.resize( size.width() );
+                for ( int c = 0 ; c < size.width() ; ++c ) {
+                    rowBuffer[c] = src[int64_t( c ) * window.step];
+                }
+                src = rowBuffer.data();
+            }
+            pipe.convertq( src, size.width(), frame.scanLine( size.height() - 1 - r ), nanValue );
+        }
+    } );
+} // level2frame
+
+/// render the window of the frame, from the pyramid level if there is one, otherwise
+/// from the view
+template < class Pipeline, class Frame >
+static void
+renderWindow( NdArray::RawViewInterface * rawView, const NdArray::BitMask * mask,
+              const Carta::Core::ImagePyramid::Level * level, const FrameWindow & window,
+              Pipeline & pipe, Frame & frame, typename Frame::Pixel nanValue,
+              const CancelFunc & canceled )
+{
+    if ( level ) {
+        level2frame( * level, window, pipe, frame, nanValue, canceled );
+    }
+    else {
+        iView2frameNative( rawView, window, pipe, frame, nanValue, mask, canceled,
+                           NativeInput < typename std::remove_const < Pipeline >::type > () );
+    }
+}
+
+/// the parts of rect not covered by kept, which is a part of rect touching at least two
+/// of its sides (i.e. what is left of it after shifting), as up to two rectangles
+static std::vector < QRect >
+exposedRects( const QRect & rect, const QRect & kept )
+{
+    std::vector < QRect > result;
+    if ( kept.isEmpty() ) {
+        result.push_back( rect );
+        return result;
+    }
+
+    // full width band above or below what was kept...
+    if ( kept.top() > rect.top() ) {
+        result.push_back( QRect( rect.left(), rect.top(), rect.width(), kept.top() - rect.top() ) );
+    }
+    else if ( kept.bottom() < rect.bottom() ) {
+        result.push_back( QRect( rect.left(), kept.bottom() + 1,
+                                 rect.width(), rect.bottom() - kept.bottom() ) );
+    }
 
-    QSize size( rawView->dims()[0], rawView->dims()[1] );
+    // ...and the rest of the rows, left or right of it
+    if ( kept.left() > rect.left() ) {
+        result.push_back( QRect( rect.left(), kept.top(), kept.left() - rect.left(), kept.height() ) );
+    }
+    else if ( kept.right() < rect.right() ) {
+        result.push_back( QRect( kept.right() + 1, kept.top(),
+                                 rect.right() - kept.right(), kept.height() ) );
+    }
+    return result;
+} // exposedRects
+
+/// image -> screen coordinates for the given pan/zoom, see Service::img2screen()
+static QPointF
+img2screen( QPointF pan, double zoom, QSize outputSize, const QPointF & p )
+{
+    double icx = pan.x();
+    double scx = outputSize.width() / 2.0;
+    double icy = pan.y();
+    double scy = outputSize.height() / 2.0;
+
+    /// \todo cache xmap/ymap, update with zoom/pan/resize
+    Carta::Lib::LinearMap1D xmap( scx, scx + zoom, icx, icx + 1 );
+    Carta::Lib::LinearMap1D ymap( scy, scy + zoom, icy, icy - 1 );
+    QPointF res;
+    res.rx() = xmap.inv( p.x() );
+    res.ry() = ymap.inv( p.y() );
+    return res;
+}
+
+/// the inverse of img2screen()
+static QPointF
+screen2img( QPointF pan, double zoom, QSize outputSize, const QPointF & p )
+{
+    double icx = pan.x();
+    double scx = outputSize.width() / 2.0;
+    double icy = pan.y();
+    double scy = outputSize.height() / 2.0;
+
+    /// \todo cache xmap/ymap, update with zoom/pan/resize
+
+    Carta::Lib::LinearMap1D xmap( scx, scx + zoom, icx, icx + 1 );
+    Carta::Lib::LinearMap1D ymap( scy, scy + zoom, icy, icy - 1 );
+    QPointF res;
+    res.rx() = xmap.apply( p.x() );
+    res.ry() = ymap.apply( p.y() );
+    return res;
+}
+
+namespace Carta
+{
+namespace Core
+{
+namespace ImageRenderService
+{
+/// everything needed to render one frame, captured when the job is submitted, so that
+/// the service can be reconfigured while the job is being rendered
+struct RenderJob
+{
+    JobId jobId = - 1;
+
+    /// position of the job in the order of submission, see RenderThread::isStale()
+    int64_t serial = 0;
+
+    /// id of the result in the frame cache
+    QString cacheId;
+
+    NdArray::RawViewInterface::SharedPtr view = nullptr;
+    NdArray::BitMask::SharedPtr mask = nullptr;
+    ImagePyramid::SharedPtr pyramid = nullptr;
+
+    /// changes whenever the view, mask or pyramid change
+    int64_t inputGeneration = 0;
 
-    QImage::Format desiredFormat = OptimalQImageFormat;
-    if ( QtPremultipliedBugStillExists ) {
-        desiredFormat = QImage::Format_ARGB32;
+    QSize outputSize;
+    QPointF pan;
+    double zoom = 1.0;
+
+    QRgb nanColor = 0;
+
+    /// the colors, set up for the clips of the frame
+    std::shared_ptr < const FusedPipeline > colors = nullptr;
+
+    /// how the frame is resampled to the output
+    Resampler::Kernel resampling = Resampler::Kernel::Nearest;
+
+    QPointF
+    img2screen( const QPointF & p ) const
+    {
+        return ::img2screen( pan, zoom, outputSize, p );
     }
 
-    // QImage::Format desiredFormat = QImage::Format_ARGB32;
-    if ( qImage.format() != desiredFormat ||
-         qImage.size() != size ) {
-        qImage = QImage( size, desiredFormat );
+    QPointF
+    screen2img( const QPointF & p ) const
+    {
+        return ::screen2img( pan, zoom, outputSize, p );
     }
-    auto bytesPerLine = qImage.bytesPerLine();
-    CARTA_ASSERT( bytesPerLine == size.width() * 4 );
-    Q_UNUSED( bytesPerLine );
+};
 
-    // start with a pointer to the beginning of last row (we are constructing image
-    // bottom-up)
-    QRgb * outPtr = reinterpret_cast < QRgb * > (
-        qImage.bits() + size.width() * ( size.height() - 1 ) * 4 );
+/// the thread rendering the jobs of a service, one at a time
+///
+/// Only the latest job matters: a new job replaces the one waiting to be rendered (if
+/// any), and makes the one being rendered stale, which is then abandoned before its next
+/// band of rows. The rendered part of the frame and the frame cache live here, and are
+/// only used by this thread.
+///
+/// When there is no job to render, the thread renders the frames queued by renderAhead()
+/// into the frame cache. A job interrupts the frame being rendered ahead (which is queued
+/// again), unless it is for that very frame, in which case it will find it in the cache.
+/// The frames rendered ahead keep their values and output apart from those of the jobs,
+/// so the next job can still reuse what the last one left.
+class RenderThread : public QThread
+{
+public:
 
-    if( 0) {
-        CARTA_ASSERT( qImage.bits() + size.width() * (size.height() - 1) * 4 == qImage.scanLine( size.height() - 1));
-        // sanity check
-        for( int y = 0 ; y < size.height() ; y ++ ) {
-            CARTA_ASSERT( qImage.bits() + size.width() * 4 * y == qImage.scanLine(y) );
+    explicit
+    RenderThread( Service * service ) : m_service( service )
+    {
+        m_frameCache.setMaxCost( 1 * 1024 * 1024 * 1024 ); // 1 gig
+    }
+
+    ~RenderThread()
+    {
+        {
+            QMutexLocker locker( & m_mutex );
+            m_quit = true;
+            m_serial++;
+            m_aheadDropped = true;
         }
+        m_jobAvailable.wakeAll();
+        wait();
     }
 
-    // make a double view
-    NdArray::TypedView < Scalar > typedView( rawView, false );
+    /// make the job being rendered stale, e.g. because a new one is on its way
+    void
+    cancel()
+    {
+        m_serial++;
+    }
 
-    /// @todo for more efficiency, instead of forEach() we should switch to one of the
-    /// higher performance APIs and maybe even sprinkle it with some openmp/cilk magic :)
-    int64_t counter = 0;
+    /// submit a new job, all previous ones become stale
+    void
+    submit( RenderJob job )
+    {
+        QMutexLocker locker( & m_mutex );
+        job.serial = ++m_serial;
+        if ( m_aheadRunning && job.cacheId != m_aheadCacheId ) {
+            m_aheadInterrupted = true;
+        }
+        m_job = job;
+        m_hasJob = true;
+        m_jobAvailable.wakeOne();
+    }
 
+    /// replace the frames to render ahead, the one being rendered is dropped unless
+    /// it is among them
+    void
+    renderAhead( const std::vector < RenderJob > & jobs )
+    {
+        QMutexLocker locker( & m_mutex );
+        m_aheadJobs.clear();
+        bool keep = false;
+        for ( const RenderJob & job : jobs ) {
+            if ( m_aheadRunning && job.cacheId == m_aheadCacheId ) {
+                keep = true;
+            }
+            else {
+                m_aheadJobs.push_back( job );
+            }
+        }
+        if ( m_aheadRunning && ! keep ) {
+            m_aheadDropped = true;
+        }
+        m_jobAvailable.wakeOne();
+    }
 
-    auto lambda = [&] ( const Scalar & ival )
+    /// take the result of the last finished job
+    /// \return false if there is none, or if it has become stale since
+    bool
+    takeResult( QImage & image, JobId & jobId )
     {
-        if ( Q_LIKELY( ! std::isnan( ival ) ) ) {
-            pipe.convertq( ival, * outPtr );
+        QMutexLocker locker( & m_mutex );
+        bool valid = m_hasResult && m_resultSerial == m_serial;
+        m_hasResult = false;
+        if ( valid ) {
+            image = m_result;
+            jobId = m_resultJobId;
         }
-        else {
-            * outPtr = nanColor;
+        m_result = QImage();
+        return valid;
+    }
+
+protected:
+
+    virtual void
+    run() override
+    {
+        while ( true ) {
+            RenderJob job;
+            {
+                QMutexLocker locker( & m_mutex );
+                while ( ! m_hasJob && m_aheadJobs.empty() && ! m_quit ) {
+                    m_jobAvailable.wait( & m_mutex );
+                }
+                if ( m_quit ) {
+                    return;
+                }
+                if ( ! m_hasJob ) {
+                    job = m_aheadJobs.front();
+                    m_aheadJobs.pop_front();
+                    m_aheadCacheId = job.cacheId;
+                    m_aheadRunning = true;
+                    m_aheadInterrupted = false;
+                    m_aheadDropped = false;
+                }
+                else {
+                    job = m_job;
+                    m_job = RenderJob();
+                    m_hasJob = false;
+                }
+            }
+
+            if ( m_aheadRunning ) {
+                renderAheadJob( job );
+                continue;
+            }
+
+            QImage image;
+            if ( ! renderJob( job, [this, & job] () { return isStale( job ); }, m_current,
+                              image ) ) {
+                continue;
+            }
+            {
+                QMutexLocker locker( & m_mutex );
+                m_result = image;
+                m_resultJobId = job.jobId;
+                m_resultSerial = job.serial;
+                m_hasResult = true;
+            }
+
+            // the result is reported from the thread of the service
+            QMetaObject::invokeMethod( m_service, "internalDoneSlot", Qt::QueuedConnection );
         }
-        outPtr++;
-        counter++;
+    }
+
+private:
+
+    /// what is kept from one job to the next, so that the next one has less to do
+    struct FrameState
+    {
+        /// here we store the values of the rendered part of the frame (masked pixels are
+        /// NaN), it is essentially a cache to make pan/zoom to work faster, and since the
+        /// colors are applied after resampling to the output, changing the colormap,
+        /// gamma, clips etc. does not need the data again
+        std::vector < float > values;
+
+        /// size of values
+        QSize size;
+
+        /// pixels of the input view covered by values
+        QRect rect;
+
+        /// sampling step used for values, i.e. each of its pixels represents
+        /// step x step data pixels
+        int step = 1;
+
+        /// input generation the values were rendered for
+        int64_t inputGeneration = std::numeric_limits < int64_t >::min();
+
+        /// the last output, and the pan/zoom, colors and resampling it was rendered with,
+        /// so that when only the pan changes, it can be shifted instead of rendered again
+        QImage output;
+        QPointF outputPan;
+        double outputZoom = 0;
+        std::shared_ptr < const FusedPipeline > outputColors = nullptr;
+        Resampler::Kernel outputResampling = Resampler::Kernel::Nearest;
+    };
+
+    /// a job is stale if another one was submitted (or canceled) after it
+    bool
+    isStale( const RenderJob & job ) const
+    {
+        return job.serial != m_serial;
+    }
+
+    /// render the job, reusing what the last job left in the given state
+    /// \return false if the job was canceled before it was finished
+    bool
+    renderJob( const RenderJob & job, const CancelFunc & canceled, FrameState & state,
+               QImage & result );
+
+    /// render a frame ahead into the frame cache, or queue it again if a job interrupted it
+    void
+    renderAheadJob( const RenderJob & job );
+
+    /// figure out whether the job's output is the last output shifted by a whole number
+    /// of screen pixels, i.e. only the pan changed (and not by too much)
+    bool
+    outputShift( const RenderJob & job, const FrameState & state, QPoint & shift ) const;
+
+    /// paint the given area of the job's output from the frame values of the state
+    /// \return false if the job was canceled before it was finished
+    bool
+    paintOutput( const RenderJob & job, const CancelFunc & canceled, const FrameState & state,
+                 const QRect & area, QImage & img );
+
+    Service * m_service;
 
-        // build the image bottom-up
-        if ( counter % size.width() == 0 ) {
-            outPtr -= size.width() * 2;
+    QMutex m_mutex;
+    QWaitCondition m_jobAvailable;
+
+    // the following are protected by m_mutex
+
+    /// job waiting to be rendered
+    RenderJob m_job;
+    bool m_hasJob = false;
+    bool m_quit = false;
+
+    /// result of the last finished job
+    QImage m_result;
+    JobId m_resultJobId = - 1;
+    int64_t m_resultSerial = - 1;
+    bool m_hasResult = false;
+
+    /// frames to render ahead, in the order they are needed
+    std::deque < RenderJob > m_aheadJobs;
+
+    /// whether a frame is being rendered ahead, and which one
+    bool m_aheadRunning = false;
+    QString m_aheadCacheId;
+
+    /// serial of the latest job, incremented by submit() and cancel()
+    std::atomic < int64_t > m_serial { 0 };
+
+    /// set when the frame being rendered ahead has to make way for a job, or is no
+    /// longer needed
+    std::atomic < bool > m_aheadInterrupted { false };
+    std::atomic < bool > m_aheadDropped { false };
+
+    // the following are only used by the render thread
+
+    /// the frame values and the last output of the jobs, and separately those of the
+    /// frames rendered ahead, so that these do not throw away what the next job can reuse
+    FrameState m_current;
+    FrameState m_ahead;
+
+    /// cache for individual frames (to make movie playing little bit faster)
+    QCache < QString, QImage > m_frameCache;
+};
+
+bool
+RenderThread::renderJob( const RenderJob & job, const CancelFunc & canceled, FrameState & state,
+                         QImage & result )
+{
+//    qDebug() << "renderJob... cache size: "
+//             << m_frameCache.totalCost() * 100.0 / m_frameCache.maxCost() << "% "
+//             << m_frameCache.size() << "entries";
+//    qDebug() << "id:" << job.cacheId;
+    auto cachedImage = m_frameCache.object( job.cacheId );
+    if ( cachedImage ) {
+        //qDebug() << "frame cache hit";
+        result = * cachedImage;
+        return true;
+    }
+    //qDebug() << "frame cache miss";
+
+    // a different input means a different frame
+    if ( state.inputGeneration != job.inputGeneration ) {
+        state.inputGeneration = job.inputGeneration;
+        state.rect = QRect();
+        state.output = QImage();
+    }
+
+    // only the visible part of the frame (plus a margin, so that small pans can reuse
+    // it) is rendered; when zoomed out, several data pixels fall onto one screen pixel,
+    // so we only sample every step-th of them
+    const int viewWidth = job.view-> dims()[0];
+    const int viewHeight = job.view-> dims()[1];
+    int step = std::max( 1, int ( std::floor( 1.0 / job.zoom ) ) );
+
+    // if there is a pyramid level with at most that many pixels per block, we sample it
+    // instead, which is less work and does not alias
+    const ImagePyramid::Level * level = nullptr;
+    if ( job.pyramid ) {
+        int levelIndex = job.pyramid-> levelForStep( step );
+        if ( levelIndex >= 0 ) {
+            level = & job.pyramid-> level( levelIndex );
+            step = step / level-> factor * level-> factor;
         }
+    }
+    auto visibleRect = [&] ( double margin, int align ) -> QRect {
+        QPointF p1 = job.screen2img( QPointF( - margin, - margin ) );
+        QPointF p2 = job.screen2img( QPointF( job.outputSize.width() + margin,
+                                              job.outputSize.height() + margin ) );
+
+        // pixel i covers [i-1/2, i+1/2)
+        auto first = [] ( double v, int size ) {
+            return int ( Carta::Lib::clamp < double > ( std::floor( v + 0.5 ), 0, size ) );
+        };
+        auto last = [] ( double v, int size ) {
+            return int ( Carta::Lib::clamp < double > ( std::floor( v + 0.5 ) + 1, 0, size ) );
+        };
+        int x1 = first( std::min( p1.x(), p2.x() ), viewWidth );
+        int x2 = last( std::max( p1.x(), p2.x() ), viewWidth );
+        int y1 = first( std::min( p1.y(), p2.y() ), viewHeight );
+        int y2 = last( std::max( p1.y(), p2.y() ), viewHeight );
+
+        // sample the same pixels regardless of the pan
+        x1 -= x1 % align;
+        y1 -= y1 % align;
+        return QRect( x1, y1, std::max( 0, x2 - x1 ), std::max( 0, y2 - y1 ) );
     };
-    typedView.forEach( lambda );
 
-    CARTA_ASSERT( counter == size.width() * size.height());
+    // when the output pixels are averaged, we need all the pixels of the view (or of the
+    // level), unless there are too many of them
+    if ( job.resampling != Resampler::Kernel::Nearest && step > 1 ) {
+        QRect all = visibleRect( ViewportMargin, 1 );
+        int64_t pixels = int64_t( all.width() ) * all.height();
+        int fine = level ? level-> factor : 1;
+        while ( fine < step && pixels / ( int64_t( fine ) * fine ) > MaxAveragedFramePixels ) {
+            fine *= 2;
+        }
+        step = std::min( fine, step );
+    }
+    QRect visible = visibleRect( 0, step );
 
-} // rawView2QImage
+    // a new window has to be rendered from scratch
+    if ( state.step != step || ! state.rect.contains( visible ) ) {
+        state.rect = visibleRect( ViewportMargin, step );
+        state.step = step;
+        state.values.clear();
+    }
+    FrameWindow window;
+    window.x1 = state.rect.x();
+    window.y1 = state.rect.y();
+    window.x2 = state.rect.x() + state.rect.width();
+    window.y2 = state.rect.y() + state.rect.height();
+    window.step = step;
+    if ( level ) {
+        // the window starts at a multiple of the step, and so of the factor
+        int factor = level-> factor;
+        window.x1 /= factor;
+        window.y1 /= factor;
+        window.x2 = std::min( level-> width, ( window.x2 + factor - 1 ) / factor );
+        window.y2 = std::min( level-> height, ( window.y2 + factor - 1 ) / factor );
+        window.step /= factor;
+    }
+    state.size = QSize( window.cols(), window.rows() );
+
+    // the data is only read when the window changes, a stale job leaves behind whatever
+    // it did not finish, so that the next job does it again
+    if ( state.values.empty() ) {
+        ValueFrame frame( state.values, state.size );
+        ValueCopy copy;
+        ::renderWindow( job.view.get(), job.mask.get(), level, window,
+                copy, frame, std::numeric_limits < float >::quiet_NaN(), canceled );
+        if ( canceled() ) {
+            state.values.clear();
+            return false;
+        }
+    }
 
-namespace Carta
+    // prepare output
+    QImage img( job.outputSize, OptimalQImageFormat );
+    if ( job.outputSize.width() > 0 && job.outputSize.height() > 0 ){
+        // if only the pan changed since the last output, most of it is still good, just
+        // in a different place, so we only render the parts that came into view
+        std::vector < QRect > dirty;
+        QPoint shift;
+        if ( outputShift( job, state, shift ) ) {
+            QRect kept = img.rect().intersected( img.rect().translated( shift ) );
+            for ( int y = kept.top() ; y <= kept.bottom() ; ++y ) {
+                std::memcpy( img.scanLine( y ) + kept.left() * 4,
+                             state.output.constScanLine( y - shift.y() )
+                             + ( kept.left() - shift.x() ) * 4,
+                             kept.width() * 4 );
+            }
+            dirty = ::exposedRects( img.rect(), kept );
+        }
+        else {
+            dirty.push_back( img.rect() );
+        }
+
+        for ( const QRect & area : dirty ) {
+            if ( ! paintOutput( job, canceled, state, area, img ) ) {
+                return false;
+            }
+        }
+    }
+    state.output = img;
+    state.outputPan = job.pan;
+    state.outputZoom = job.zoom;
+    state.outputColors = job.colors;
+    state.outputResampling = job.resampling;
+
+    // insert this image into frame cache
+    QImage * cached = new QImage( img );
+
+    // debuggin: put a yellow stamp on the cached image, so that next time it's recalled
+    // it'll have 'cached' stamped on it
+    if ( CARTA_RUNTIME_CHECKS && ! cached-> isNull() ) {
+        QPainter p( cached );
+        p.setPen( QColor( "yellow" ) );
+        p.drawText( cached-> rect(), Qt::AlignRight | Qt::AlignBottom, "Cached" );
+    }
+    m_frameCache.insert( job.cacheId, cached, img.byteCount() );
+
+    result = img;
+    return true;
+} // renderJob
+
+void
+RenderThread::renderAheadJob( const RenderJob & job )
 {
-namespace Core
+    CancelFunc canceled = [this] () {
+        return m_aheadInterrupted || m_aheadDropped;
+    };
+    QImage image;
+    bool finished = renderJob( job, canceled, m_ahead, image );
+
+    QMutexLocker locker( & m_mutex );
+    m_aheadRunning = false;
+    if ( ! finished && m_aheadInterrupted && ! m_aheadDropped ) {
+        m_aheadJobs.push_front( job );
+    }
+} // renderAheadJob
+
+bool
+RenderThread::outputShift( const RenderJob & job, const FrameState & state, QPoint & shift ) const
 {
-namespace ImageRenderService
+    if ( state.output.isNull() || state.output.size() != job.outputSize ||
+         state.outputZoom != job.zoom || state.outputColors != job.colors ||
+         state.outputResampling != job.resampling ) {
+        return false;
+    }
+
+    // where any point of the image was on the last output, and where it is now
+    QPointF before = ::img2screen( state.outputPan, state.outputZoom, job.outputSize,
+                                   QPointF( 0, 0 ) );
+    QPointF after = job.img2screen( QPointF( 0, 0 ) );
+    double dx = after.x() - before.x();
+    double dy = after.y() - before.y();
+    if ( std::abs( dx ) >= job.outputSize.width() || std::abs( dy ) >= job.outputSize.height() ) {
+        return false;
+    }
+    shift = QPoint( std::round( dx ), std::round( dy ) );
+    return std::abs( dx - shift.x() ) < MaxShiftError && std::abs( dy - shift.y() ) < MaxShiftError;
+}
+
+bool
+RenderThread::paintOutput( const RenderJob & job, const CancelFunc & canceled,
+                           const FrameState & state, const QRect & area, QImage & img )
 {
+    const QRgb background = qRgb( 50, 50, 50 );
+
+    // grid coordinates of the centers of the output pixels, grid pixel g covers
+    // step x step data pixels, starting at the bottom left corner of the window,
+    // i.e. g * step + [x1 - 1/2, x1 - 1/2 + step)
+    const int width = state.size.width();
+    const int height = state.size.height();
+    const double du = 1.0 / ( job.zoom * state.step );
+    QPointF p0 = job.screen2img( QPointF( area.left() + 0.5, area.top() + 0.5 ) );
+    const double u0 = ( p0.x() - state.rect.x() + 0.5 ) / state.step - 0.5;
+    const double v0 = ( p0.y() - state.rect.y() + 0.5 ) / state.step - 0.5;
+
+    // the columns and rows of the area whose centers fall onto the frame, the grid
+    // covers [-1/2, width-1/2) x [-1/2, height-1/2)
+    int c1 = 0, c2 = 0, r1 = 0, r2 = 0;
+    if ( ! state.values.empty() ) {
+        auto clampArea = [] ( double x, int size ) {
+            return int ( Carta::Lib::clamp < double > ( x, 0, size ) );
+        };
+        c1 = clampArea( std::ceil( ( - 0.5 - u0 ) / du ), area.width() );
+        c2 = clampArea( std::ceil( ( width - 0.5 - u0 ) / du ), area.width() );
+        r1 = clampArea( std::floor( ( v0 - height + 0.5 ) / du ) + 1, area.height() );
+        r2 = clampArea( std::floor( ( v0 + 0.5 ) / du ) + 1, area.height() );
+    }
+
+    // each row is resampled straight into the output, and then converted to colors
+    forEachBand( area.size(), canceled, [&] ( int b1, int b2 ) {
+        std::unique_ptr < Resampler > resampler;
+        std::vector < float > vals;
+        if ( c1 < c2 ) {
+            resampler.reset( new Resampler( job.resampling, state.values.data(), width, height,
+                                            u0 + c1 * du, du, c2 - c1 ) );
+            vals.resize( c2 - c1 );
+        }
+        for ( int r = b1 ; r < b2 ; ++r ) {
+            QRgb * out = reinterpret_cast < QRgb * > ( img.scanLine( area.top() + r ) ) + area.left();
+            if ( r < r1 || r >= r2 || c1 >= c2 ) {
+                std::fill( out, out + area.width(), background );
+                continue;
+            }
+            std::fill( out, out + c1, background );
+            std::fill( out + c2, out + area.width(), background );
+            resampler-> row( v0 - r * du, du, vals.data() );
+            job.colors-> convertq( vals.data(), vals.size(), out + c1, job.nanColor );
+        }
+    } );
+    if ( canceled() ) {
+        return false;
+    }
+
+    // more debugging - draw pixel grid, only the lines crossing the area
+    if ( true && job.zoom > 5 ) {
+        QPainter p( & img );
+        p.setClipRect( area );
+        p.setRenderHint( QPainter::Antialiasing, true );
+        double alpha = Carta::Lib::linMap( job.zoom, 5, 32, 0.01, 0.2 );
+        //qDebug() << "alpha="<<alpha;
+        alpha = Carta::Lib::clamp( alpha, 0.0, 1.0 );
+        p.setPen( QPen( QColor( 255, 255, 255, 255 ), alpha ) );
+        QPointF tl = job.screen2img( QPointF( area.left(), area.top() ) );
+        QPointF br = job.screen2img( QPointF( area.right() + 1, area.bottom() + 1 ) );
+        int x1 = std::floor( tl.x() );
+        int x2 = std::ceil( br.x() );
+        //qDebug() << "x1="<<x1<<" x2="<<x2;
+        for ( double x = x1 ; x <= x2 ; ++x ) {
+            QPointF pt = job.img2screen( QPointF( x - 0.5, 0 ) );
+            p.drawLine( QPointF( pt.x(), 0 ), QPointF( pt.x(), job.outputSize.height() ) );
+        }
+        int y1 = std::ceil( tl.y() );
+        int y2 = std::floor( br.y() );
+        std::swap( y1, y2 );
+        for ( double y = y1 ; y <= y2 ; ++y ) {
+            QPointF pt = job.img2screen( QPointF( 0, y - 0.5 ) );
+            p.drawLine( QPointF( 0, pt.y() ), QPointF( job.outputSize.width(), pt.y() ) );
+        }
+    }
+    return true;
+} // paintOutput
+
 void
 Service::setInputView( NdArray::RawViewInterface::SharedPtr view, QString cacheId )
 {
     m_inputView = view;
+    m_inputMask = nullptr;
+    m_inputPyramid = nullptr;
 
     m_inputViewCacheId = cacheId;
-    m_frameImage = QImage(); // indicate a need to recompute
+    m_inputGeneration++; // indicate a need to recompute
+}
+
+void
+Service::setInputMask( NdArray::BitMask::SharedPtr mask )
+{
+    m_inputMask = mask;
+    m_inputGeneration++; // indicate a need to recompute
+}
+
+void
+Service::setInputPyramid( ImagePyramid::SharedPtr pyramid )
+{
+    if ( pyramid && pyramid-> levelCount() == 0 ) {
+        pyramid = nullptr;
+    }
+    if ( pyramid != m_inputPyramid ) {
+        m_inputPyramid = pyramid;
+        m_inputGeneration++; // indicate a need to recompute
+    }
 }
 
 void
@@ -120,6 +1043,18 @@ Service::outputSize() const
     return m_outputSize;
 }
 
+void
+Service::setResampling( Resampler::Kernel kernel )
+{
+    m_resampling = kernel;
+}
+
+Resampler::Kernel
+Service::resampling() const
+{
+    return m_resampling;
+}
+
 void Service::setNanColor( QColor color ){
     if ( m_nanColor != color ){
         m_nanColor = color;
@@ -174,12 +1109,8 @@ Service::setPixelPipeline( IClippedPixelPipeline::SharedPtr pixelPipeline,
     m_pixelPipelineRaw = pixelPipeline;
     m_pixelPipelineCacheId = cacheId;
 
-    // invalidate frame cache
-    m_frameImage = QImage();
-
-    // invalidate pixel pipeline cache
-    m_cachedPP = nullptr;
-    m_cachedPPinterp = nullptr;
+    // invalidate frame colors
+    m_colors = nullptr;
 }
 
 void
@@ -187,12 +1118,8 @@ Service::setPixelPipelineCacheSettings( const PixelPipelineCacheSettings & param
 {
     m_pixelPipelineCacheSettings = params;
 
-    // invalidate frame cache
-    m_frameImage = QImage();
-
-    // invalidate pixel pipeline cache
-    m_cachedPP = nullptr;
-    m_cachedPPinterp = nullptr;
+    // invalidate frame colors
+    m_colors = nullptr;
 }
 
 const Service::PixelPipelineCacheSettings &
@@ -210,6 +1137,9 @@ Service::render( JobId jobId )
     else {
         m_lastSubmittedJobId = jobId;
     }
+
+    // whatever is being rendered now is outdated
+    m_renderThread-> cancel();
     if ( ! m_renderTimer.isActive() ) {
         m_renderTimer.start();
     }
@@ -230,58 +1160,31 @@ Service::Service( QObject * parent ) : Carta::Lib::IImageRenderService( parent )
     m_renderTimer.setInterval( 1 );
     connect( & m_renderTimer, & QTimer::timeout, this, & Me::internalRenderSlot );
 
-    m_frameCache.setMaxCost( 1 * 1024 * 1024 * 1024 ); // 1 gig
+    m_renderThread.reset( new RenderThread( this ) );
+    m_renderThread-> start();
 }
 
 Service::~Service()
-{ }
+{
+    // stop the thread before anything it might still report to goes away
+    m_renderThread.reset();
+}
 
 QPointF
 Service::img2screen( const QPointF & p )
 {
-    double icx = m_pan.x();
-    double scx = m_outputSize.width() / 2.0;
-    double icy = m_pan.y();
-    double scy = m_outputSize.height() / 2.0;
-
-    /// \todo cache xmap/ymap, update with zoom/pan/resize
-    Carta::Lib::LinearMap1D xmap( scx, scx + m_zoom, icx, icx + 1 );
-    Carta::Lib::LinearMap1D ymap( scy, scy + m_zoom, icy, icy - 1 );
-    QPointF res;
-    res.rx() = xmap.inv( p.x() );
-    res.ry() = ymap.inv( p.y() );
-    return res;
+    return ::img2screen( m_pan, m_zoom, m_outputSize, p );
 }
 
 QPointF
 Service::screen2img( const QPointF & p )
 {
-    double icx = m_pan.x();
-    double scx = m_outputSize.width() / 2.0;
-    double icy = m_pan.y();
-    double scy = m_outputSize.height() / 2.0;
-
-    /// \todo cache xmap/ymap, update with zoom/pan/resize
-
-    Carta::Lib::LinearMap1D xmap( scx, scx + m_zoom, icx, icx + 1 );
-    Carta::Lib::LinearMap1D ymap( scy, scy + m_zoom, icy, icy - 1 );
-    QPointF res;
-    res.rx() = xmap.apply( p.x() );
-    res.ry() = ymap.apply( p.y() );
-    return res;
+    return ::screen2img( m_pan, m_zoom, m_outputSize, p );
 }
 
 void
-Service::internalRenderSlot()
+Service::prepareColors()
 {
-    //static int renderCount = 0;
-    //qDebug() << "Image render" << renderCount++ << "xyz";
-
-    // raw double to base64 converter
-    auto d2hex = [] (double x) -> QString {
-        return QByteArray( (char *) ( & x ), sizeof( x ) ).toBase64();
-    };
-
     double clipMin, clipMax;
     m_pixelPipelineRaw-> getClips( clipMin, clipMax );
 
@@ -290,6 +1193,39 @@ Service::internalRenderSlot()
         m_pixelPipelineRaw->convertq( clipMin, nanColor );
     }
 
+    // the pixel pipeline may change while the job is rendered, so the render thread
+    // gets its own fused version of it, which only depends on the clips through setClips()
+    bool clipsChanged = m_colorsClipMin != clipMin || m_colorsClipMax != clipMax;
+    m_colorsClipMin = clipMin;
+    m_colorsClipMax = clipMax;
+    m_colorsNanColor = nanColor;
+    if ( ! m_colors ) {
+        // without the cache the colormap is used for every pixel, i.e. the colors are exact
+        const PixelPipelineCacheSettings & settings = pixelPipelineCacheSettings();
+        FusedPipeline::Colors mode = FusedPipeline::Colors::Exact;
+        if ( settings.enabled ) {
+            mode = settings.interpolated ? FusedPipeline::Colors::InterpolatedTable
+                                         : FusedPipeline::Colors::Table;
+        }
+        auto colors = std::make_shared < FusedPipeline > ();
+        colors-> setup( * m_pixelPipelineRaw, mode, settings.size );
+        m_colors = colors;
+    }
+    else if ( clipsChanged ) {
+        auto colors = std::make_shared < FusedPipeline > ( * m_colors );
+        colors-> setClips( clipMin, clipMax );
+        m_colors = colors;
+    }
+} // prepareColors
+
+RenderJob
+Service::makeJob( const AheadFrame & input, int64_t inputGeneration )
+{
+    // raw double to base64 converter
+    auto d2hex = [] (double x) -> QString {
+        return QByteArray( (char *) ( & x ), sizeof( x ) ).toBase64();
+    };
+
     // cache id will be concatenation of:
     // view id
     // pipeline id
@@ -297,17 +1233,21 @@ Service::internalRenderSlot()
     // pan
     // zoom
     // nan
+    // whether we have a pyramid
+    // resampling
     // pixel pipeline cache settings
     // Floats are binary-encoded (base64)
     QString cacheId = QString( "%1/%2/%3x%4/%5,%6/%7/%8" )
-                          .arg( m_inputViewCacheId )
-                          .arg( m_pixelPipelineCacheId )
+                          .arg( input.viewCacheId )
+                          .arg( input.pixelPipelineCacheId )
                           .arg( m_outputSize.width() )
                           .arg( m_outputSize.height() )
                           .arg( d2hex( m_pan.x() ) )
                           .arg( d2hex( m_pan.y() ) )
                           .arg( d2hex( m_zoom ) )
-                          .arg( QString::number(nanColor) );
+                          .arg( QString::number(m_colorsNanColor) );
+    cacheId += input.pyramid ? "/p" : "/-";
+    cacheId += QString( "/r%1" ).arg( int (m_resampling) );
 
 
     if ( m_pixelPipelineCacheSettings.enabled ) {
@@ -319,21 +1259,36 @@ Service::internalRenderSlot()
         cacheId += "/0";
     }
 
-//    qDebug() << "internalRenderSlot... cache size: "
-//             << m_frameCache.totalCost() * 100.0 / m_frameCache.maxCost() << "% "
-//             << m_frameCache.size() << "entries";
-//    qDebug() << "id:" << cacheId;
-    struct Scope {
-        ~Scope() { /*qDebug() << "internalRenderSlot done";*/ } }
-    debugScopeGuard;
-
-    auto cachedImage = m_frameCache.object( cacheId );
-    if ( cachedImage ) {
-        //qDebug() << "frame cache hit";
-        emit done( * cachedImage, m_lastSubmittedJobId );
-        return;
+    RenderJob job;
+    job.cacheId = cacheId;
+    job.view = input.view;
+    job.mask = input.mask;
+    job.pyramid = input.pyramid;
+    job.inputGeneration = inputGeneration;
+    job.outputSize = m_outputSize;
+    job.pan = m_pan;
+    job.zoom = m_zoom;
+    job.nanColor = m_colorsNanColor;
+    job.resampling = m_resampling;
+
+    // the colors only depend on where the values are between the clips, so the frames
+    // rendered ahead with their own clips get a copy of the pipeline with those
+    job.colors = m_colors;
+    double clipMin, clipMax;
+    m_colors-> getClips( clipMin, clipMax );
+    if ( clipMin != input.clipMin || clipMax != input.clipMax ) {
+        auto colors = std::make_shared < FusedPipeline > ( * m_colors );
+        colors-> setClips( input.clipMin, input.clipMax );
+        job.colors = colors;
     }
-    //qDebug() << "frame cache miss";
+    return job;
+} // makeJob
+
+void
+Service::internalRenderSlot()
+{
+    //static int renderCount = 0;
+    //qDebug() << "Image render" << renderCount++ << "xyz";
 
     if ( ! m_inputView ) {
         qCritical() << "input view not set";
@@ -346,110 +1301,59 @@ Service::internalRenderSlot()
         return;
     }
 
+    prepareColors();
+    AheadFrame input;
+    input.view = m_inputView;
+    input.mask = m_inputMask;
+    input.pyramid = m_inputPyramid;
+    input.viewCacheId = m_inputViewCacheId;
+    input.clipMin = m_colorsClipMin;
+    input.clipMax = m_colorsClipMax;
+    input.pixelPipelineCacheId = m_pixelPipelineCacheId;
+    RenderJob job = makeJob( input, m_inputGeneration );
+    job.jobId = m_lastSubmittedJobId;
+
+    m_renderThread-> submit( job );
+} // internalRenderSlot
 
-
-    // render the frame if needed
-    if ( m_frameImage.isNull() ) {
-
-        if ( pixelPipelineCacheSettings().enabled ) {
-            if ( pixelPipelineCacheSettings().interpolated ) {
-                if ( ! m_cachedPPinterp ) {
-                    m_cachedPPinterp.reset( new Lib::PixelPipeline::CachedPipeline < true > () );
-                    m_cachedPPinterp-> cache( * m_pixelPipelineRaw,
-                            pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPPinterp, m_frameImage, nanColor );
-            }
-            else {
-                if ( ! m_cachedPP ) {
-                    m_cachedPP.reset( new Lib::PixelPipeline::CachedPipeline < false > () );
-                    m_cachedPP-> cache( * m_pixelPipelineRaw,
-                            pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPP, m_frameImage, nanColor );
+void
+Service::renderAhead( const std::vector < AheadFrame > & frames )
+{
+    std::vector < RenderJob > jobs;
+    if ( m_pixelPipelineRaw && ! m_outputSize.isEmpty() ) {
+        prepareColors();
+
+        // the frames stay in the cache until they are needed, so we only render as many
+        // as fit into a part of it
+        int64_t frameCost = int64_t( m_outputSize.width() ) * m_outputSize.height() * 4;
+        size_t maxFrames = std::max < int64_t > ( 1, RenderAheadMaxCost / frameCost );
+        for ( const AheadFrame & frame : frames ) {
+            if ( jobs.size() >= maxFrames ) {
+                break;
             }
-        }
-        else {
-            ::iView2qImage( m_inputView.get(), * m_pixelPipelineRaw, m_frameImage, nanColor );
-        }
-    }
-
-    // prepare output
-    QImage img( m_outputSize, OptimalQImageFormat );
-    if ( m_outputSize.width() > 0 && m_outputSize.height() > 0 ){
-
-        //    img.fill( QColor( "blue" ) );
-        img.fill( QColor( 50, 50, 50 ) );
-        QPainter p( & img );
 
-        // draw the frame image to satisfy zoom/pan
-        //    QPointF p1 = img2screen( QPointF( -0.5, -0.5 ) );
-        //    QPointF p2 = img2screen( QPointF( m_frameImage.width()-0.5, m_frameImage.height()-0.5));
-
-        int imageHeight = m_frameImage.height();
-        QPointF p1 = img2screen( QPointF( - 0.5, imageHeight - 0.5 ) );
-        QPointF p2 = img2screen( QPointF( m_frameImage.width() - 0.5, - 0.5 ) );
-
-        QRectF rectf( p1, p2 );
-        p.setRenderHint( QPainter::SmoothPixmapTransform, false );
-
-        //    rectf = rectf.normalized();
-        p.drawImage( rectf, m_frameImage );
-
-        //    qDebug() << "m_frameImage" << m_frameImage.size();
-        //    qDebug() << "m_frameImage" << zoom() << rectf.width() / m_frameImage.width()
-        //             << rectf.height() / m_frameImage.height();
-
-        // debugging rectangle
-        if ( 0 ) {
-            p.setPen( QPen( QColor( "yellow" ), 3 ) );
-            p.setBrush( Qt::NoBrush );
-            p.drawRect( rectf );
-        }
-
-        // more debugging - draw pixel grid
-        // \todo need to add clipping if we want to expose this as a functionality
-        if ( true && zoom() > 5 ) {
-            p.setRenderHint( QPainter::Antialiasing, true );
-            double alpha = Carta::Lib::linMap( zoom(), 5, 32, 0.01, 0.2 );
-            //qDebug() << "alpha="<<alpha;
-            alpha = Carta::Lib::clamp( alpha, 0.0, 1.0 );
-            p.setPen( QPen( QColor( 255, 255, 255, 255 ), alpha ) );
-            QPointF tl = screen2img( QPointF( 0, 0 ) );
-            QPointF br = screen2img( QPointF( outputSize().width(), outputSize().height() ) );
-            int x1 = std::floor( tl.x() );
-            int x2 = std::ceil( br.x() );
-            //qDebug() << "x1="<<x1<<" x2="<<x2;
-            for ( double x = x1 ; x <= x2 ; ++x ) {
-                QPointF pt = img2screen( QPointF( x - 0.5, 0 ) );
-                p.drawLine( QPointF( pt.x(), 0 ), QPointF( pt.x(), outputSize().height() ) );
-            }
-            int y1 = std::ceil( tl.y() );
-            int y2 = std::floor( br.y() );
-            std::swap( y1, y2 );
-            for ( double y = y1 ; y <= y2 ; ++y ) {
-                QPointF pt = img2screen( QPointF( 0, y - 0.5 ) );
-                p.drawLine( QPointF( 0, pt.y() ), QPointF( outputSize().width(), pt.y() ) );
+            // without an id the frame could not be found in the cache
+            if ( ! frame.view || frame.viewCacheId.isEmpty() ) {
+                continue;
             }
-        }
-        // debuggin: put a yellow stamp on the image, so that next time it's recalled
-        // it'll have 'cached' stamped on it
-        if ( CARTA_RUNTIME_CHECKS ) {
-            p.setPen( QColor( "yellow" ) );
-            p.drawText( img.rect(), Qt::AlignRight | Qt::AlignBottom, "Cached" );
+
+            // each frame is a different input for the render thread
+            jobs.push_back( makeJob( frame, --m_aheadGeneration ) );
         }
     }
+    m_renderThread-> renderAhead( jobs );
+} // renderAhead
 
-    // report result
-    emit done( img, m_lastSubmittedJobId );
-
-
-
-    // insert this image into frame cache
-    m_frameCache.insert( cacheId, new QImage( img ), img.byteCount() );
-
-} // internalRenderSlot
-
+void
+Service::internalDoneSlot()
+{
+    QImage image;
+    JobId jobId;
+    if ( m_renderThread-> takeResult( image, jobId ) ) {
+        // report result
+        emit done( image, jobId );
+    }
+}
 }
 }
 }
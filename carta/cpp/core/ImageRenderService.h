@@ -13,12 +13,22 @@
  *
  *
  * caching considerations (internal notes)
- *   eg. when zooming/panning there is no need to re-apply colormap
+ *   eg. when panning there is no need to re-read the data
+ *   and when changing the colormap there is no need to re-read the data either (the
+ *   visible part of the frame is cached as values, the colors are applied to the output)
  *   or when switching between frames, maybe we can cache some frames to make this faster
- *   or when looking at really large 2d data, we could use mipmaps (future optimization)
+ *   when playing an animation, the next frames can be rendered ahead into the frame cache
+ *   while the thread has nothing else to do
+ *   only the visible part of the frame is rendered, at no more than screen resolution
+ *   (unless the output pixels are averaged), and resampled straight to the output
+ *   when only the pan changes (by whole screen pixels), the last output is shifted and only
+ *   the parts that came into view are painted
+ *   when looking at really large 2d data zoomed out, a pyramid (mipmaps) of the frame
+ *   can be supplied, and the level matching the zoom is rendered instead of the frame
  *
  * asynchronous result reporting
- *   the render service might possibly live in a separate thread
+ *   the frames are rendered in a thread of the service, one job at a time, and a job
+ *   that has been superseded by a newer one is abandoned half way through
  *
  * Note that the rendering service does not have any convenience APIs for manipulating
  * colormaps/pixel pipelines. It is up to the caller to set this up. The reason is to keep
@@ -31,14 +41,19 @@
 
 #include "CartaLib/IImage.h"
 #include "CartaLib/PixelPipeline/IPixelPipeline.h"
+#include "CartaLib/TPixelPipeline/FusedPipeline.h"
 #include "CartaLib/Nullable.h"
 #include "CartaLib/IImageRenderService.h"
+#include "ImagePyramid.h"
+#include "Resampler.h"
 #include <QImage>
 #include <QObject>
 #include <QColor>
 #include <QStringList>
 #include <QCache>
 #include <QTimer>
+#include <memory>
+#include <vector>
 
 namespace Carta
 {
@@ -54,6 +69,10 @@ typedef Lib::PixelPipeline::IClippedPixelPipeline IClippedPixelPipeline;
 /// job id
 typedef int64_t JobId;
 
+/// the thread doing the actual rendering, see ImageRenderService.cpp
+class RenderThread;
+struct RenderJob;
+
 /// Implementation of the rendering service
 /// \warning this object could potentially live it a separate thread, so make all connections
 /// to it as explicitly queued
@@ -73,6 +92,21 @@ public:
 
     typedef Carta::Lib::IImageRenderService::PixelPipelineCacheSettings PixelPipelineCacheSettings;
 
+    /// a frame to render ahead, see renderAhead()
+    struct AheadFrame
+    {
+        Carta::Lib::NdArray::RawViewInterface::SharedPtr view = nullptr;
+        Carta::Lib::NdArray::BitMask::SharedPtr mask = nullptr;
+        ImagePyramid::SharedPtr pyramid = nullptr;
+
+        /// the id setInputView() will get for the view
+        QString viewCacheId;
+
+        /// the clips of the frame, and the id the pixel pipeline will have with them
+        double clipMin = 0, clipMax = 1;
+        QString pixelPipelineCacheId;
+    };
+
     /// constructor
     explicit
     Service( QObject * parent = 0 );
@@ -113,19 +147,53 @@ public:
     virtual QSize
     outputSize() const override;
 
+    /// \brief set the mask for the current input view, masked pixels are rendered
+    /// with the nan color
+    /// \param mask packed mask with the dimensions of the input view, or nullptr for no mask
+    /// \note setInputView() clears the mask, so this needs to be called after it
+    virtual void
+    setInputMask( Carta::Lib::NdArray::BitMask::SharedPtr mask ) override;
+
+    /// \brief set the pyramid of the current input view, used when zoomed out
+    /// \param pyramid lower resolution levels of the input view, or nullptr for none
+    /// \note setInputView() clears the pyramid, so this needs to be called after it
+    void
+    setInputPyramid( ImagePyramid::SharedPtr pyramid );
+
+    /// \brief set how the frame is resampled to the output
+    /// \param kernel Nearest shows the pixels as they are (and samples them sparsely when
+    /// zoomed out), Bilinear interpolates them when zoomed in, and both Bilinear and
+    /// BlockAverage average them when zoomed out
+    void
+    setResampling( Resampler::Kernel kernel );
+
+    /// get the current resampling kernel, see setResampling()
+    Resampler::Kernel
+    resampling() const;
+
+    /// \brief render frames ahead of time into the frame cache, so that they are there
+    /// once they become the input (e.g. the next frames of an animation)
+    /// \param frames the frames in the order they will be needed, they are rendered with
+    /// the current settings when there is nothing else to render, as many as fit into
+    /// the part of the frame cache reserved for them
+    /// \note this replaces the frames from the previous call, the ones not rendered yet
+    /// are dropped unless they are among the new ones
+    void
+    renderAhead( const std::vector < AheadFrame > & frames );
+
     //Set the color to use for nan values.
     //Note: this color will be ignored if we are using a default nan value from
     //the bottom of the color map.
-    void
-    setNanColor( QColor color );
+    virtual void
+    setNanColor( QColor color ) override;
 
     //Return the color that will be used to draw nan values.
-    QColor
-    getNanColor() const;
+    virtual QColor
+    getNanColor() const override;
 
     //Set whether or not to use the default nan value (bottom of the color map).
-    void
-    setDefaultNan( bool useDefaultNan );
+    virtual void
+    setDefaultNan( bool useDefaultNan ) override;
 
     /// set coordinates of the data pixel to be centered in the generated
     /// image, in zero-based image coordinates, e.g. (0,0) is bottom left corner of pixel
@@ -200,10 +268,27 @@ protected slots:
     void
     internalRenderSlot();
 
+private slots:
+
+    /// internal helper, reports the result of the render thread, if it is still current
+    void
+    internalDoneSlot();
+
 private:
 
+    /// prepare the colors for the current pixel pipeline, see m_colors
+    void
+    prepareColors();
+
+    /// a job for rendering the input with the current settings, the colors have to be
+    /// prepared first
+    RenderJob
+    makeJob( const AheadFrame & input, int64_t inputGeneration );
+
     // the following are rendering parameters
     Carta::Lib::NdArray::RawViewInterface::SharedPtr m_inputView = nullptr;
+    Carta::Lib::NdArray::BitMask::SharedPtr m_inputMask = nullptr;
+    ImagePyramid::SharedPtr m_inputPyramid = nullptr;
     QString m_inputViewCacheId;
     QString m_pixelPipelineCacheId;
     QSize m_outputSize = QSize( 10, 10 );
@@ -217,21 +302,29 @@ private:
     /// current pan (coordinates of the image pixel that is to be centered on the screen)
     QPointF m_pan = QPointF( 0, 0 );
 
-    // cached pipelines
-    Lib::PixelPipeline::CachedPipeline < true >::UniquePtr m_cachedPPinterp = nullptr;
-    Lib::PixelPipeline::CachedPipeline < false >::UniquePtr m_cachedPP = nullptr;
     PixelPipelineCacheSettings m_pixelPipelineCacheSettings;
 
-    /// here we store the whole frame rendered, it is essentially a cache to make
-    /// pan/zoom to work faster
-    QImage m_frameImage;
+    /// fused version of the pixel pipeline for the current clips, which the render thread
+    /// converts the values with; the cache settings pick its table, or exact colors when
+    /// the cache is disabled
+    std::shared_ptr < const Lib::TemplatedPixelPipeline::FusedPipeline > m_colors = nullptr;
 
-    /// cache for individual frames (to make movie playing little bit faster)
-    QCache < QString, QImage > m_frameCache;
+    /// clips and nan color the above were made for
+    double m_colorsClipMin = 0, m_colorsClipMax = 0;
+    QRgb m_colorsNanColor = 0;
+
+    /// incremented whenever the view, mask or pyramid change
+    int64_t m_inputGeneration = 0;
+
+    /// decremented for each frame rendered ahead, so they don't mix with the input
+    int64_t m_aheadGeneration = 0;
 
     /// last requested job id
     JobId m_lastSubmittedJobId = - 1;
 
+    /// how the frame is resampled to the output
+    Resampler::Kernel m_resampling = Resampler::Kernel::BlockAverage;
+
     /// Whether or not to use the default nan value (bottom of color map).
     bool m_defaultNan;
     /// User-settable color for nan values when the default nan value is not used.
@@ -241,6 +334,8 @@ private:
     /// are submitted
     QTimer m_renderTimer;
 
+    /// the thread rendering our jobs
+    std::unique_ptr < RenderThread > m_renderThread;
 };
 }
 }
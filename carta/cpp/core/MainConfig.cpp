@@ -90,6 +90,7 @@ ParsedInfo parse(const QString & filePath)
 
     _storePositiveInt( json["histogramBinCountMax"], &info.m_histogramBinCountMax, "histogram bin count max");
     _storePositiveInt( json["contourLevelCountMax"], &info.m_contourLevelCountMax, "contour level count max");
+    _storePositiveInt( json["idleImagePixelDataMB"], &info.m_idleImagePixelDataSize, "idle image pixel data size");
 
     return info;
 }
@@ -118,6 +119,10 @@ int ParsedInfo::getContourLevelCountMax() const {
     return m_contourLevelCountMax;
 }
 
+int ParsedInfo::getIdleImagePixelDataSize() const {
+    return m_idleImagePixelDataSize;
+}
+
 int ParsedInfo::getHistogramBinCountMax() const {
     return m_histogramBinCountMax;
 }
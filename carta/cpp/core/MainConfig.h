@@ -40,6 +40,15 @@ public:
      */
     int getContourLevelCountMax() const;
 
+    /**
+     * Returns any valid user set limit (in MB) on the total pixel data size of images
+     * that are no longer in use but kept open, or -1 if no valid user supplied value
+     * has been provided.
+     * @return the pixel data budget for idle images or -1 if no valid value has been
+     *   specified.
+     */
+    int getIdleImagePixelDataSize() const;
+
     /// whether hacks are enabled or not
     bool hacksEnabled() const;
 
@@ -88,6 +97,7 @@ protected:
     bool m_developerLayout = false;
     int m_histogramBinCountMax = -1;
     int m_contourLevelCountMax = -1;
+    int m_idleImagePixelDataSize = -1;
 
     QJsonObject m_json;
 
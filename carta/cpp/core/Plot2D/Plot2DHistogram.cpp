@@ -3,6 +3,7 @@
 #include <qwt_painter.h>
 #include "CartaLib/PixelPipeline/CustomizablePixelPipeline.h"
 #include <QDebug>
+#include <algorithm>
 
 namespace Carta {
 namespace Plot2D {
@@ -34,13 +35,16 @@ void Plot2DHistogram::drawColumn (QPainter * painter, const QwtColumnRect & rect
     }
     else {
         QColor sampleColor(m_defaultColor);
-        if ( m_pipeline ){
-            QwtInterval xRange = sample.interval;
-            double midPt = (xRange.minValue() + xRange.maxValue()) / 2;
-            std::array<double,3> normRGB;
-            m_pipeline->convert( midPt, normRGB );
-            if ( normRGB[0] >= 0 && normRGB[1] >= 0 && normRGB[2] >= 0 ){
-                sampleColor.setRgbF(normRGB[0], normRGB[1], normRGB[2]);
+        if ( m_colors.size() > 0 ){
+            //The samples are sorted, so we can find the color computed for this one
+            double minValue = sample.interval.minValue();
+            auto it = std::lower_bound( m_data.begin(), m_data.end(), minValue,
+                    []( const QwtIntervalSample& s, double val ){
+                return s.interval.minValue() < val;
+            });
+            int index = it - m_data.begin();
+            if ( index < static_cast<int>( m_colors.size() ) ){
+                sampleColor = QColor( m_colors[index] );
             }
         }
         painter->setPen( sampleColor );
@@ -101,6 +105,20 @@ void Plot2DHistogram::drawSeries( QPainter *painter, const QwtScaleMap &xMap,
     }
     m_lastY = rect.bottom();
     m_lastX = rect.left();
+
+    //Compute the colors of all the columns at once, rather than one at a time
+    //in drawColumn.
+    m_colors.clear();
+    if ( m_colored && m_pipeline ){
+        int dataCount = m_data.size();
+        std::vector<double> midPts( dataCount );
+        for ( int i = 0; i < dataCount; i++ ){
+            QwtInterval xRange = m_data[i].interval;
+            midPts[i] = (xRange.minValue() + xRange.maxValue()) / 2;
+        }
+        m_colors.resize( dataCount );
+        m_pipeline->convertq( midPts.data(), dataCount, m_colors.data(), m_defaultColor.rgb() );
+    }
     drawColumns( painter, xMap, yMap, from, to );
     if ( m_drawStyle == Carta::Data::PlotStyles::PLOT_STYLE_OUTLINE ){
         QwtPainter::drawLine( painter, m_lastX, m_lastY, m_lastX, rect.bottom());
@@ -6,9 +6,11 @@
 #include <qwt_interval.h>
 #include <qwt_plot_histogram.h>
 #include <QRectF>
+#include <QRgb>
 #include <QString>
 #include <qwt_scale_map.h>
 #include <memory>
+#include <vector>
 
 namespace Carta {
     namespace Lib {
@@ -69,6 +71,8 @@ protected:
 private:
 
     QVector< QwtIntervalSample > m_data;
+    //Colors of the columns in m_data, computed in drawSeries.
+    mutable std::vector<QRgb> m_colors;
     mutable double m_lastY;
     mutable double m_lastX;
     Plot2DHistogram( const Plot2DHistogram& other);
@@ -9,6 +9,7 @@
 
 #include <QTime>
 #include <QTimer>
+#include <memory>
 
 namespace Profiles
 {
@@ -248,6 +249,18 @@ public slots:
         m_axis = pa.axis();
         m_currPos[m_axis] = 0;
 
+        // the profile is a 1D view into the data, which we read in bulk, so that the
+        // image can serve it with as few requests as it can (e.g. from a spectral-major
+        // copy of the cube, or at least one slab request instead of one per pixel)
+        SliceND slice;
+        for ( size_t i = 0 ; i < m_currPos.size() ; ++i ) {
+            if ( int ( i ) != m_axis ) {
+                slice.slice( i ).start( m_currPos[i] ).end( m_currPos[i] + 1 );
+            }
+        }
+        m_lineView.reset( m_rv-> getView( slice ) );
+        m_buffer.clear();
+
         // figure out pixel size
         m_pixelSize = Carta::Lib::Image::pixelType2size( m_rv-> pixelType() );
 
@@ -300,35 +313,16 @@ private slots:
     void
     workTimerCB()
     {
-        //qDebug() << "profile workTimerCB()";
-
         // note that from here we ca safely emit directly, since this is executed
         // as a callback of the work timer...
-        QTime t;
-        t.restart();
-
-//        while ( t.elapsed() < 100 ) {
-        while ( true ) {
-            // if we are done, stop timer, report result
-            //qDebug() << "profile cmp" << m_currPos[m_axis] << "to" << m_rv->dims()[m_axis];
-            if ( m_currPos[m_axis] >= m_rv-> dims()[m_axis] ) {
-                //qDebug() << "profile stop timer";
-                m_workTimer.stop();
-                break;
-            }
-
-            //qDebug() << "profile pos" << m_currPos;
-
-            // get the element at the current position
-            const char * data = m_rv->get( m_currPos );
-            m_buffer.append( data, m_pixelSize );
-
-            m_currPos[m_axis]++;
-
-            // only do little bit of work
-            if ( t.elapsed() >= 10 ) {
-                break;
-            }
+        m_workTimer.stop();
+        if ( m_lineView ) {
+            m_lineView-> forEach(
+                BufferSize,
+                [this] ( const char * data, int64_t count ) {
+                    m_buffer.append( data, count * m_pixelSize );
+                } );
+            m_lineView.reset();
         }
 
         // report result
@@ -337,8 +331,12 @@ private slots:
 
 private:
 
+    /// size of the buffer for reading the profile (in bytes)
+    static const int BufferSize = 1024 * 1024;
+
     VI m_currPos;
     int m_axis = - 1;
+    std::unique_ptr < Carta::Lib::NdArray::RawViewInterface > m_lineView;
     QTimer m_workTimer;
     Carta::Lib::NdArray::RawViewInterface * m_rv = nullptr;
     QByteArray m_buffer;
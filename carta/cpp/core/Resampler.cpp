@@ -0,0 +1,195 @@
+/**
+ *
+ **/
+
+#include "Resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of x86-64, so unlike the batch pixel pipeline kernels there is no need to
+// check for it at runtime
+#if defined( __SSE2__ )
+#define CARTA_RESAMPLER_SSE2 1
+#include <emmintrin.h>
+#else
+#define CARTA_RESAMPLER_SSE2 0
+#endif
+
+namespace Carta
+{
+namespace Core
+{
+/// clamp a coordinate to [0, n], before it is converted to int
+static int
+clampIndex( double x, int n )
+{
+    return int ( Carta::Lib::clamp < double > ( x, 0, n ) );
+}
+
+/// index of the grid pixel covering c, clamped to the grid of n pixels
+static int
+nearest( double c, int n )
+{
+    return clampIndex( std::floor( c + 0.5 ), n - 1 );
+}
+
+/// pixels [first, last) of a grid of n pixels, whose centers fall into
+/// [c - size/2, c + size/2), or the nearest one if there are none
+static void
+blockRange( double c, double size, int n, int & first, int & last )
+{
+    first = clampIndex( std::ceil( c - size / 2 ), n );
+    last = clampIndex( std::ceil( c + size / 2 ), n );
+    if ( first >= last ) {
+        first = nearest( c, n );
+        last = first + 1;
+    }
+}
+
+/// add the valid values to the sums, and count them
+static void
+accumulate( const float * vals, int64_t count, float * sums, float * counts )
+{
+    int64_t i = 0;
+#if CARTA_RESAMPLER_SSE2
+    // NaNs are the only values not ordered with themselves, the comparison gives us a
+    // mask of the valid ones
+    const __m128 one = _mm_set1_ps( 1.0f );
+    for ( ; i + 4 <= count ; i += 4 ) {
+        __m128 v = _mm_loadu_ps( vals + i );
+        __m128 valid = _mm_cmpord_ps( v, v );
+        _mm_storeu_ps( sums + i, _mm_add_ps( _mm_loadu_ps( sums + i ), _mm_and_ps( valid, v ) ) );
+        _mm_storeu_ps( counts + i,
+                       _mm_add_ps( _mm_loadu_ps( counts + i ), _mm_and_ps( valid, one ) ) );
+    }
+#endif
+    for ( ; i < count ; ++i ) {
+        if ( ! std::isnan( vals[i] ) ) {
+            sums[i] += vals[i];
+            counts[i] += 1;
+        }
+    }
+}
+
+Resampler::Resampler( Kernel kernel, const float * data, int width, int height,
+                      double u0, double du, int count )
+    : m_kernel( kernel )
+      , m_data( data )
+      , m_width( width )
+      , m_height( height )
+      , m_count( std::max( count, 0 ) )
+{
+    CARTA_ASSERT( data && width > 0 && height > 0 && du > 0 );
+    if ( m_kernel == Kernel::Bilinear && du > 1 ) {
+        m_kernel = Kernel::BlockAverage;
+    }
+
+    // the columns are the same for all the rows, so we figure them out once
+    m_x1.resize( m_count );
+    m_x2.resize( m_count );
+    if ( m_kernel == Kernel::Bilinear ) {
+        m_fx.resize( m_count );
+    }
+    for ( int c = 0 ; c < m_count ; ++c ) {
+        double u = u0 + c * du;
+        switch ( m_kernel )
+        {
+        case Kernel::Nearest :
+            m_x1[c] = nearest( u, m_width );
+            m_x2[c] = m_x1[c] + 1;
+            break;
+
+        case Kernel::Bilinear : {
+            double g = std::floor( u );
+            m_fx[c] = u - g;
+            m_x1[c] = clampIndex( g, m_width - 1 );
+            m_x2[c] = clampIndex( g + 1, m_width - 1 );
+            break;
+        }
+
+        case Kernel::BlockAverage :
+            blockRange( u, du, m_width, m_x1[c], m_x2[c] );
+            break;
+        }
+    }
+
+    // the column sums cover all the columns of the row
+    if ( m_kernel == Kernel::BlockAverage && m_count > 0 ) {
+        m_first = * std::min_element( m_x1.begin(), m_x1.end() );
+        int last = * std::max_element( m_x2.begin(), m_x2.end() );
+        m_sums.resize( last - m_first );
+        m_counts.resize( last - m_first );
+    }
+}
+
+void
+Resampler::row( double v, double dv, float * out )
+{
+    const float nan = std::numeric_limits < float >::quiet_NaN();
+    if ( m_count == 0 ) {
+        return;
+    }
+
+    switch ( m_kernel )
+    {
+    case Kernel::Nearest : {
+        const float * src = gridRow( nearest( v, m_height ) );
+        for ( int c = 0 ; c < m_count ; ++c ) {
+            out[c] = src[m_x1[c]];
+        }
+        return;
+    }
+
+    case Kernel::Bilinear : {
+        double g = std::floor( v );
+        const float fy = v - g;
+        const float * row1 = gridRow( clampIndex( g, m_height - 1 ) );
+        const float * row2 = gridRow( clampIndex( g + 1, m_height - 1 ) );
+        for ( int c = 0 ; c < m_count ; ++c ) {
+            const float fx = m_fx[c];
+            const float vals[4] = {
+                row1[m_x1[c]], row1[m_x2[c]], row2[m_x1[c]], row2[m_x2[c]]
+            };
+            const float weights[4] = {
+                ( 1 - fx ) * ( 1 - fy ), fx * ( 1 - fy ), ( 1 - fx ) * fy, fx * fy
+            };
+
+            // NaNs are left out, the rest is weighted as if they were not there
+            float sum = 0, weight = 0;
+            for ( int i = 0 ; i < 4 ; ++i ) {
+                if ( ! std::isnan( vals[i] ) ) {
+                    sum += vals[i] * weights[i];
+                    weight += weights[i];
+                }
+            }
+            out[c] = weight > 0 ? sum / weight : nan;
+        }
+        return;
+    }
+
+    case Kernel::BlockAverage : {
+        // sum up the columns of the rows in the block, then the columns of each pixel
+        int y1, y2;
+        blockRange( v, std::abs( dv ), m_height, y1, y2 );
+        const int first = m_first;
+        const int64_t n = m_sums.size();
+        std::fill( m_sums.begin(), m_sums.end(), 0.0f );
+        std::fill( m_counts.begin(), m_counts.end(), 0.0f );
+        for ( int y = y1 ; y < y2 ; ++y ) {
+            accumulate( gridRow( y ) + first, n, m_sums.data(), m_counts.data() );
+        }
+        for ( int c = 0 ; c < m_count ; ++c ) {
+            float sum = 0, count = 0;
+            for ( int x = m_x1[c] ; x < m_x2[c] ; ++x ) {
+                sum += m_sums[x - first];
+                count += m_counts[x - first];
+            }
+            out[c] = count > 0 ? sum / count : nan;
+        }
+        return;
+    }
+    }
+} // row
+}
+}
@@ -0,0 +1,84 @@
+/**
+ * Resampling of a grid of data values to the pixels of an output image.
+ *
+ * The render service reads the visible part of a frame into a grid of values, and
+ * resamples that straight to the output, one output row at a time, before the values
+ * are converted to colors. Doing it on the values (rather than scaling an image of
+ * colors) means each output pixel is converted exactly once, and zoomed out pixels can
+ * be averaged properly instead of being picked from a sparse sample.
+ *
+ * Grid pixel g covers [g-1/2, g+1/2) in grid coordinates, the same convention as the
+ * image pixels.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include <vector>
+
+namespace Carta
+{
+namespace Core
+{
+class Resampler
+{
+    CLASS_BOILERPLATE( Resampler );
+
+public:
+
+    /// how the output pixels are computed from the grid
+    enum class Kernel
+    {
+        /// value of the grid pixel under the center of the output pixel
+        Nearest,
+
+        /// interpolated from the 4 grid pixels around the center, ignoring NaNs; when
+        /// zoomed out this would sample just as sparsely as Nearest, so the output pixels
+        /// are averaged like with BlockAverage instead
+        Bilinear,
+
+        /// mean of the grid pixels whose centers fall into the output pixel, ignoring
+        /// NaNs (NaN if all of them are), Nearest if there are none
+        BlockAverage
+    };
+
+    /// \brief set up the resampling of output rows
+    /// \param kernel how to compute the output pixels
+    /// \param data grid of width x height values, x fastest, row 0 at the bottom
+    /// \param u0 grid x coordinate of the center of the first output pixel of each row
+    /// \param du width of the output pixels in grid pixels
+    /// \param count number of output pixels in each row
+    Resampler( Kernel kernel, const float * data, int width, int height,
+               double u0, double du, int count );
+
+    /// \brief resample one output row
+    /// \param v grid y coordinate of the center of the row
+    /// \param dv height of the output pixels in grid pixels
+    /// \param out where to put the count output values
+    /// \note not thread safe, each thread needs its own resampler
+    void
+    row( double v, double dv, float * out );
+
+private:
+
+    const float *
+    gridRow( int y ) const { return m_data + int64_t( y ) * m_width; }
+
+    Kernel m_kernel;
+    const float * m_data;
+    int m_width, m_height;
+    int m_count;
+
+    /// per output pixel: the nearest grid column (Nearest), the two columns to interpolate
+    /// (Bilinear), or the range of columns [x1, x2) to average (BlockAverage)
+    std::vector < int > m_x1, m_x2;
+
+    /// per output pixel: the weight of m_x2 (Bilinear)
+    std::vector < float > m_fx;
+
+    /// column sums and counts of valid pixels, starting with column m_first (BlockAverage)
+    std::vector < float > m_sums, m_counts;
+    int m_first = 0;
+};
+}
+}
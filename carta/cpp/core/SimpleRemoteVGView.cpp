@@ -77,10 +77,19 @@ SimpleRemoteVGView::scheduleRepaint( qint64 id )
     painter.end();
 
     if ( id == - 1 ) {
-        id = m_lastRepaintId++;
+        id = m_lastRepaintId + 1;
     }
     m_lastRepaintId = id;
-    m_connector-> refreshView( this);
+
+    // remember which refresh of the connector carries this repaint, so that we can
+    // tell when it has reached the client
+    qint64 refreshId = m_connector-> refreshView( this);
+    if ( refreshId >= 0 ) {
+        m_pendingRepaints.push_back( std::make_pair( refreshId, id ) );
+        if ( m_pendingRepaints.size() > MaxPendingRepaints ) {
+            m_pendingRepaints.pop_front();
+        }
+    }
     return id;
 }
 
@@ -147,7 +156,16 @@ SimpleRemoteVGView::handleKeyEvent( const QKeyEvent & /*event*/ )
 
 void SimpleRemoteVGView::viewRefreshed(qint64 id)
 {
-    Q_UNUSED( id);
+    // connectors send the refreshes in order, merging the ones that come too fast,
+    // so everything up to this refresh has been delivered
+    qint64 repaintId = - 1;
+    while ( ! m_pendingRepaints.empty() && m_pendingRepaints.front().first <= id ) {
+        repaintId = m_pendingRepaints.front().second;
+        m_pendingRepaints.pop_front();
+    }
+    if ( repaintId != - 1 ) {
+        emit repainted( repaintId );
+    }
 }
 
 QString SimpleRemoteVGView::inputEventCB(const QString & cmd, const QString & params, const QString & sessionId)
@@ -11,6 +11,8 @@
 #include <QString>
 #include <QColor>
 #include <QImage>
+#include <deque>
+#include <utility>
 
 class ServerConnector;
 class DesktopConnector;
@@ -77,6 +79,14 @@ private:
     VGList m_vgList;
     qint64 m_lastRepaintId = - 1;
 
+    /// refresh ids of the connector and the repaint ids they carry, for the repaints
+    /// the client has not acknowledged yet
+    std::deque < std::pair < qint64, qint64 > > m_pendingRepaints;
+
+    /// how many unacknowledged repaints we keep track of, in case the client
+    /// never acknowledges them
+    static constexpr size_t MaxPendingRepaints = 64;
+
     // IView interface
 
     virtual void
@@ -113,9 +113,8 @@ Viewer::start()
 
     if ( fname.length() > 0 ) {
         QString controlId = m_viewManager->getObjectId( Carta::Data::Controller::PLUGIN_NAME, 0);
-        bool successfulLoad = false;
-        QString result = m_viewManager->loadFile( controlId, fname, &successfulLoad );
-        if ( !successfulLoad ){
+        QString result = m_viewManager->loadFileAsync( controlId, fname );
+        if ( !result.isEmpty() ){
             qDebug() << result;
         }
     }
@@ -59,6 +59,9 @@ HEADERS += \
     Data/Image/Contour/DataContours.h \
     Data/Image/Contour/GeneratorState.h \
     Data/Image/CoordinateSystems.h \
+    Data/Image/ClipThread.h \
+    Data/Image/PyramidThread.h \
+    Data/Image/LoadThread.h \
     Data/Image/DataSource.h \
     Data/Image/Draw/DrawGroupSynchronizer.h \
     Data/Image/Draw/DrawSynchronizer.h \
@@ -112,6 +115,9 @@ HEADERS += \
     Data/ViewPlugins.h \
     GrayColormap.h \
     ImageRenderService.h \
+    ImageRegistry.h \
+    ImagePyramid.h \
+    Resampler.h \
     ImageSaveService.h \
     Plot2D/Plot.h \
     Plot2D/Plot2DGenerator.h \
@@ -181,6 +187,9 @@ SOURCES += \
     Data/Image/Contour/DataContours.cpp \
     Data/Image/Contour/GeneratorState.cpp \
     Data/Image/CoordinateSystems.cpp \
+    Data/Image/ClipThread.cpp \
+    Data/Image/PyramidThread.cpp \
+    Data/Image/LoadThread.cpp \
     Data/Image/DataSource.cpp \
     Data/Image/Grid/AxisMapper.cpp \
     Data/Image/Grid/DataGrid.cpp \
@@ -251,6 +260,9 @@ SOURCES += \
     ScriptedClient/ScriptedCommandListener.cpp \
     ScriptedClient/ScriptFacade.cpp \
     ImageRenderService.cpp \
+    ImageRegistry.cpp \
+    ImagePyramid.cpp \
+    Resampler.cpp \
     ImageSaveService.cpp \
     Algorithms/quantileAlgorithms.cpp \
     ScriptedClient/Listener.cpp \
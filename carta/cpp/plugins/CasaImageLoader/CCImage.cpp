@@ -4,12 +4,64 @@
 
 #include <QDebug>
 #include "CCImage.h"
+#include "CasaImageLoader.h"
+#include <map>
 
-casa::ImageInterface < casa::Float > *
-cartaII2casaII_float( std::shared_ptr < Carta::Lib::Image::ImageInterface > ii )
+namespace
+{
+/// casacore image opened for an image loaded by another plugin
+struct Companion
+{
+    std::weak_ptr < Carta::Lib::Image::ImageInterface > image;
+    CCImageBase::SharedPtr casaImage = nullptr;
+};
+
+/// companions of the images that are still alive, by image
+std::mutex companionsMutex;
+std::map < Carta::Lib::Image::ImageInterface *, Companion > companions;
+}
+
+CCImageBase *
+cartaII2ccImageBase( std::shared_ptr < Carta::Lib::Image::ImageInterface > ii )
 {
     // first we convert to base, this seems to work on all platforms
     CCImageBase * base = dynamic_cast<CCImageBase*>( ii.get());
+    if ( base || ! ii || ii-> fileName().isEmpty() ) {
+        return base;
+    }
+
+    // forget the images that are gone, so that a new image at the same address does
+    // not get their companion
+    std::unique_lock < std::mutex > lock( companionsMutex );
+    for ( auto it = companions.begin() ; it != companions.end() ; ) {
+        if ( it-> second.image.expired() ) {
+            it = companions.erase( it );
+        }
+        else {
+            ++it;
+        }
+    }
+
+    // casacore is not thread safe anyway, so the file is opened under the lock
+    auto it = companions.find( ii.get() );
+    if ( it == companions.end() ) {
+        Companion companion;
+        companion.image = ii;
+        companion.casaImage = std::dynamic_pointer_cast < CCImageBase > (
+            CasaImageLoader::loadImage( ii-> fileName() ) );
+        if ( companion.casaImage && companion.casaImage-> dims() != ii-> dims() ) {
+            qWarning() << "Casacore opened" << ii-> fileName() << "with different dimensions";
+            companion.casaImage = nullptr;
+        }
+        it = companions.insert( std::make_pair( ii.get(), companion ) ).first;
+    }
+    return it-> second.casaImage.get();
+} // cartaII2ccImageBase
+
+casa::ImageInterface < casa::Float > *
+cartaII2casaII_float( std::shared_ptr < Carta::Lib::Image::ImageInterface > ii )
+{
+    CCImageBase * base = cartaII2ccImageBase( ii );
     if( ! base) {
         return nullptr;
     }
@@ -23,3 +75,14 @@ cartaII2casaII_float( std::shared_ptr < Carta::Lib::Image::ImageInterface > ii )
 //    qWarning() << "ciif" << ciif;
 //    return ciif;
 }
+
+casa::ImageInterface < casa::Float > *
+cartaII2spectralCasaII_float( std::shared_ptr < Carta::Lib::Image::ImageInterface > ii )
+{
+    CCImage < casa::Float > * image = dynamic_cast < CCImage < casa::Float > * > (
+        cartaII2ccImageBase( ii ) );
+    if ( image && image-> spectralCasaImage() ) {
+        return image-> spectralCasaImage();
+    }
+    return cartaII2casaII_float( ii );
+}
@@ -7,14 +7,20 @@
 #include "CartaLib/CartaLib.h"
 #include "CartaLib/IImage.h"
 #include "CartaLib/AxisInfo.h"
+#include "CartaLib/PermutedImage.h"
 #include "CCRawView.h"
 #include "CCMetaDataInterface.h"
+#include "CCSpectralCache.h"
+#include "CCTileCache.h"
 #include "casacore/images/Images/ImageInterface.h"
 #include "casacore/images/Images/ImageUtilities.h"
 #include "casacore/images/Images/TempImage.h"
+#include "casacore/casa/Arrays/Slicer.h"
 
 #include <QDebug>
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <set>
 
 /// helper base class so that we can easily determine if this is a an image
@@ -68,51 +74,13 @@ public:
     }
 
 
+    /// the returned image is a lazy wrapper, the image is not copied, but views whose
+    /// pixel order changes are read and reordered in bounded bands, see
+    /// Carta::Lib::Image::PermutedImage
     virtual std::shared_ptr<Carta::Lib::Image::ImageInterface>
-    getPermuted(const std::vector<int> & indices ) override{
-
-        //Make sure the passed in indices make sense for this image.
-        std::vector<int> imageVect = dims();
-        int axisCount = imageVect.size();
-        int indexCount = indices.size();
-        CARTA_ASSERT( axisCount == indexCount );
-        std::set<int> usedIndices;
-        for ( int i = 0; i < indexCount; i++ ){
-            if ( 0 <= indices[i] && indices[i] < indexCount ){
-                int usedCount = usedIndices.count( indices[i] );
-                CARTA_ASSERT( usedCount == 0 );
-                usedIndices.insert( indices[i]);
-            }
-        }
-
-        //Convert to a CASA data type.
-        casa::Vector<int> newOrder( indexCount );
-        for ( int i = 0; i < indexCount; i++ ){
-            newOrder[i] = indices[i];
-        }
-        //Change the order of the axes in the coordinate system
-        casa::CoordinateSystem coordSys = m_casaII->coordinates();
-        coordSys.transpose( newOrder, newOrder );
-        casa::IPosition oldShape = m_casaII->shape();
-        casa::IPosition newShape( indexCount );
-        for ( int i = 0; i < indexCount; i++ ){
-            newShape[i] = oldShape[newOrder[i]];
-        }
-
-        //Make a new image and copy the data into it.
-        casa::ImageInterface<PType>* newImage = new casa::TempImage<PType>(casa::TiledShape( newShape), coordSys);
-        casa::Array<PType> dataCopy = m_casaII->get();
-        newImage->put( reorderArray( dataCopy, newOrder ));
-        if ( m_casaII->hasPixelMask()){
-            std::unique_ptr<casa::Lattice<casa::Bool> > maskLattice( m_casaII->pixelMask().clone());
-            casa::Array<casa::Bool> maskCopy = maskLattice->get();
-            dynamic_cast< casa::TempImage<PType> *>(newImage)->attachMask( casa::ArrayLattice<casa::Bool>(reorderArray( maskCopy, newOrder )));
-        }
-
-        //Finish the copy and create a CARTA image with permuted axes.
-        casa::ImageUtilities::copyMiscellaneous( *newImage, *m_casaII );
-        std::shared_ptr<Carta::Lib::Image::ImageInterface> permuteImage =  create( newImage);
-        return permuteImage;
+    getPermuted(const std::vector<int> & indices ) override
+    {
+        return Carta::Lib::Image::PermutedImage::permute( this-> shared_from_this(), indices );
     }
 
     virtual const std::vector < int > &
@@ -124,7 +92,7 @@ public:
     virtual bool
     hasMask() const override
     {
-        return false;
+        return m_casaII-> isMasked();
     }
 
     virtual bool
@@ -147,19 +115,59 @@ public:
         qFatal( "not implemented" );
     }
 
+    /// the returned view shares the ownership of this image
     virtual Carta::Lib::NdArray::RawViewInterface *
     getDataSlice( const SliceND & sliceInfo ) override
     {
-        return new CCRawView < PType > ( this, sliceInfo );
+        return new CCRawView < PType > ( this-> shared_from_this(), sliceInfo );
     }
 
-    /// \todo implement this
-    virtual Carta::Lib::NdArray::Byte *
+    /// the mask is read from casacore and packed into bits, in slabs along the last
+    /// axis so that the temporary array of casacore booleans stays small
+    virtual Carta::Lib::NdArray::BitMask *
     getMaskSlice( const SliceND & sliceInfo) override
     {
-        Q_UNUSED( sliceInfo );
-        qFatal( "not implemented" );
-    }
+        if ( ! hasMask() ) {
+            return nullptr;
+        }
+        SliceND::ApplyResult ar = sliceInfo.apply( m_dims );
+        if ( ar.isError() || ar.dims().empty() ) {
+            return nullptr;
+        }
+
+        // translate the slice to casacore, the mask has the same shape as the data view
+        const auto & slices = ar.dims();
+        size_t ndim = slices.size();
+        std::vector < int > maskDims( ndim );
+        casa::IPosition start( ndim ), length( ndim ), stride( ndim );
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            maskDims[i] = std::max( slices[i].count, 1 );
+            start( i ) = slices[i].start;
+            length( i ) = maskDims[i];
+            stride( i ) = slices[i].step;
+        }
+        auto mask = new Carta::Lib::NdArray::BitMask( maskDims, false );
+
+        int64_t planeSize = mask-> size() / maskDims[ndim - 1];
+        int64_t slabLength = std::max < int64_t > ( 1, MaxMaskSlabPixels / planeSize );
+        casa::Array < casa::Bool > buff;
+        int64_t filled = 0;
+        for ( int64_t k = 0 ; k < maskDims[ndim - 1] ; k += slabLength ) {
+            start( ndim - 1 ) = slices[ndim - 1].start + k * slices[ndim - 1].step;
+            length( ndim - 1 ) = std::min < int64_t > ( slabLength, maskDims[ndim - 1] - k );
+            {
+                std::lock_guard < std::mutex > lock( m_casaMutex );
+                m_casaII-> getMaskSlice( buff, casa::Slicer( start, length, stride ) );
+            }
+            casa::Bool deleteIt;
+            const casa::Bool * src = buff.getStorage( deleteIt );
+            mask-> setFromBools( filled, buff.nelements(), src );
+            filled += buff.nelements();
+            buff.freeStorage( src, deleteIt );
+        }
+        CARTA_ASSERT( filled == mask-> size() );
+        return mask;
+    } // getMaskSlice
 
     /// \todo implement this
     virtual Carta::Lib::NdArray::RawViewInterface *
@@ -188,6 +196,7 @@ public:
         img-> m_dims      = casaImage-> shape().asStdVector();
         img-> m_casaII    = casaImage;
         img-> m_unit      = Carta::Lib::Unit( casaImage-> units().getName().c_str() );
+        img-> m_tileCache.reset( new CCTileCache( casaImage, sizeof( PType ) ) );
 
         // get title and escape html characters in case there are any
         QString htmlTitle = casaImage->imageInfo().objectName().c_str();
@@ -213,6 +222,21 @@ public:
                return m_casaII->imageInfo();
            }
 
+    /// start writing a spectral-major copy of this image in the background, if
+    /// enabled (see CCSpectralCache)
+    void
+    startSpectralCache()
+    {
+        m_spectralCache = CCSpectralCache::start( m_casaII, m_casaMutex );
+    }
+
+    /// the spectral-major copy of this image, or nullptr if there is none (yet)
+    casa::ImageInterface < casa::Float > *
+    spectralCasaImage() const
+    {
+        return m_spectralCache ? m_spectralCache-> image() : nullptr;
+    }
+
     virtual
     ~CCImage() { }
 
@@ -222,6 +246,9 @@ public:
     CCImage() { }
 
 protected:
+    /// max. number of booleans getMaskSlice() reads from casacore at once
+    static constexpr int64_t MaxMaskSlabPixels = 4 * 1024 * 1024;
+
     /// type of the image data
     Carta::Lib::Image::PixelType m_pixelType;
 
@@ -231,17 +258,40 @@ protected:
     /// pointer to the actual casa::ImageInterface
     casa::ImageInterface < PType > * m_casaII;
 
+    /// casacore tables cannot be accessed by different threads at the same time,
+    /// so every access to m_casaII from the views is serialized through this
+    std::mutex m_casaMutex;
+
     /// cached unit
     Carta::Lib::Unit m_unit;
 
     /// meta data pointer
     CCMetaDataInterface::SharedPtr m_meta;
 
+    /// sizes casacore's tile cache for the reads done by the views, guarded by m_casaMutex
+    CCTileCache::UniquePtr m_tileCache;
+
+    /// spectral-major copy of the image, declared last so that it's destroyed (and its
+    /// background job stopped) before anything it uses
+    CCSpectralCache::UniquePtr m_spectralCache;
+
     /// we want CCRawView to access our internals...
     /// \todo maybe we just need a public accessor, no? I don't like friends :) (Pavol)
     friend class CCRawView < PType >;
 };
 
+/// helper to get the casacore image behind carta's image; images loaded by other
+/// plugins (e.g. the FITS loader) are opened again by this plugin from their file, once,
+/// and the result lives as long as the image does
+/// \return nullptr if there is no such image
+CCImageBase *
+cartaII2ccImageBase( std::shared_ptr<Carta::Lib::Image::ImageInterface> ii) ;
+
 /// helper to convert carta's image to casacore image interface
 casa::ImageInterface<casa::Float> *
 cartaII2casaII_float( std::shared_ptr<Carta::Lib::Image::ImageInterface> ii) ;
+
+/// same as cartaII2casaII_float(), but returns the spectral-major copy of the image
+/// if it's available, which is much faster for spectral profiles
+casa::ImageInterface<casa::Float> *
+cartaII2spectralCasaII_float( std::shared_ptr<Carta::Lib::Image::ImageInterface> ii) ;
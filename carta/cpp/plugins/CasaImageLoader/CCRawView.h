@@ -5,15 +5,30 @@
 #pragma once
 
 #include "CartaLib/IImage.h"
+#include "CartaLib/StridedIterator.h"
+#include "CCTileCache.h"
 #include <casacore/lattices/Lattices/LatticeStepper.h>
 #include <casacore/lattices/Lattices/LatticeIterator.h>
+#include <casacore/lattices/Lattices/TileStepper.h>
 #include <casacore/casa/Arrays/IPosition.h>
+#include <casacore/casa/Arrays/Slicer.h>
+#include <casacore/casa/Utilities/COWPtr.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 template < typename PType >
 class CCImage;
 
 /// CasaImageLoader plugin's implementation of the raw view
 ///
+/// The view keeps the image alive (shared ownership). Casacore tables cannot be accessed
+/// by different threads at the same time, so all access to the casacore image is
+/// serialized through the image's mutex. Conversion/processing of the data done by the
+/// callbacks happens outside of the lock, so multiple views (one per thread) can be
+/// used concurrently.
+///
 /// \warning We are not handling negative step
 /// \warning We are not handling 'index' slices, i.e. axis removal
 ///
@@ -25,11 +40,12 @@ class CCRawView
 {
 public:
 
+    typedef std::shared_ptr < CCImage < PType > > CCImagePtr;
+
     /// construct a view on an image from provided slice information
-    /// \param ccimage pointer to CCImage which we keep on using, but we don't assume ownership.
-    /// It has to remain valid for the duration of existance of this instance.
+    /// \param ccimage the image, we share its ownership
     /// \param sliceInfo for which part of the ccimage to create view
-    CCRawView( CCImage < PType > * ccimage, const SliceND & sliceInfo );
+    CCRawView( CCImagePtr ccimage, const SliceND & sliceInfo );
 
     virtual PixelType
     pixelType() override
@@ -52,6 +68,10 @@ public:
     virtual const VI &
     currentPos() override;
 
+    /// available only for images that casacore keeps in memory (e.g. TempImage)
+    virtual Nullable < StridedSpan >
+    stridedSpan() override;
+
     virtual RawViewInterface *
     getView(const SliceND & sliceInfo) override
     {
@@ -65,60 +85,49 @@ public:
         return new CCRawView( m_ccimage, newAr);
     }
 
-    virtual int64_t
-    read( int64_t buffSize, char * buff,
-          Traversal traversal = Traversal::Sequential ) override
+    virtual RawViewInterface *
+    clone() override
     {
-        Q_UNUSED( buffSize);
-        Q_UNUSED( buff);
-        Q_UNUSED( traversal);
-        qFatal( "not implemented");
+        // new view of the same slice, with its own traversal state
+        return new CCRawView( m_ccimage, m_appliedSlice );
     }
 
+    /// read in the next buffSize bytes (rounded down to whole pixels) starting
+    /// at the position set by seek(), and advance the position
+    virtual int64_t
+    read( int64_t buffSize, char * buff,
+          Traversal traversal = Traversal::Sequential ) override;
+
+    /// set the position (in bytes) for the next read()
     virtual void
-    seek(int64_t ind) override
-    {
-        Q_UNUSED( ind);
-        qFatal( "not implemented");
-    }
+    seek( int64_t ind = 0 ) override;
 
     /// another high performance accessor to data
     /// motivated by unix read() but stateless (i.e. one needs to supply the
     /// chunk number)
     virtual int64_t
     read( int64_t chunk, int64_t buffSize, char * buff,
-          Traversal traversal = Traversal::Sequential ) override
-    {
-        Q_UNUSED( chunk );
-        Q_UNUSED( buffSize );
-        Q_UNUSED( buff );
-        Q_UNUSED( traversal );
-        qFatal( "not implemented" );
-    }
+          Traversal traversal = Traversal::Sequential ) override;
 
     /// yet another high performance accessor... similar to forEach above,
     /// but this time the supplied function gets called with whatever number
     /// elements that fit into the buffer
+    ///
+    /// \note if buff is nullptr the function is called directly with casacore's
+    /// cursor storage, i.e. no extra copy is made
     virtual void
     forEach(
         int64_t buffSize,
         std::function < void (const char *, int64_t count) > func,
         char * buff = nullptr,
-        Traversal traversal = Traversal::Sequential ) override
-    {
-        Q_UNUSED( buffSize );
-        Q_UNUSED( func );
-        Q_UNUSED( buff );
-        Q_UNUSED( traversal );
-        qFatal( "not implemented" );
-    }
+        Traversal traversal = Traversal::Sequential ) override;
 
 protected:
 
     /// construct a view directly from applied slice
-    CCRawView( CCImage < PType > * ccimage, const SliceND::ApplyResult & applyResult );
+    CCRawView( CCImagePtr ccimage, const SliceND::ApplyResult & applyResult );
 
-    CCImage < PType > * m_ccimage = nullptr; // we don't own this!
+    CCImagePtr m_ccimage = nullptr;
     VI m_currPosImage, m_currPosView;
     SliceND::ApplyResult m_appliedSlice;
     VI m_viewDims;
@@ -128,11 +137,46 @@ protected:
 
     // minicache to make get() a little bit faster
     VI m_destPos;
+
+    // position (in pixels) for the next stateful read()
+    int64_t m_readPos = 0;
+
+    // reference to the in-memory array, for stridedSpan() and the fast paths
+    casa::COWPtr < casa::Array < PType > > m_arrayRef;
+
+    // 0 = not yet checked, 1 = m_arrayRef is valid, -1 = image is not in memory
+    int m_arrayRefState = 0;
+
+    // strides of the view into m_arrayRef
+    Carta::Lib::NdArray::StridedLayout m_memLayout;
+
+    /// try to reference the whole array in memory (only tried once), on success
+    /// m_arrayRef and m_memLayout are valid
+    bool
+    referenceArray();
+
+    /// total number of pixels in this view
+    int64_t
+    nPixels() const;
+
+    /// copy pixels [first, first+count) of the view (in sequential order) into dst
+    void
+    readRange( int64_t first, int64_t count, PType * dst );
+
+    /// walk the view cursor by cursor, calling func( cursor, cursorPos ) where
+    /// cursorPos is the view position of the first pixel in the cursor
+    /// \param traversal sequential uses cursors of at most maxPixels, in c-order,
+    /// optimal walks the image tile by tile
+    /// \param maxPixels upper limit on sequential cursor size
+    /// \param func callback
+    template < typename Func >
+    void
+    iterateCursors( Traversal traversal, int64_t maxPixels, Func func );
 };
 
 // public constructor
 template < typename PType >
-CCRawView < PType >::CCRawView( CCImage < PType > * ccimage, const SliceND & sliceInfo )
+CCRawView < PType >::CCRawView( CCImagePtr ccimage, const SliceND & sliceInfo )
 {
     // remember the pointer to the carta image
     m_ccimage = ccimage;
@@ -151,7 +195,7 @@ CCRawView < PType >::CCRawView( CCImage < PType > * ccimage, const SliceND & sli
 
 // protected constructor
 template < typename PType >
-CCRawView < PType >::CCRawView( CCImage < PType > * ccimage, const SliceND::ApplyResult & applyResult )
+CCRawView < PType >::CCRawView( CCImagePtr ccimage, const SliceND::ApplyResult & applyResult )
 {
     /// \todo refactor common code between the two constructors into some
     /// sort of 'init' method?
@@ -198,6 +242,7 @@ CCRawView < PType >::get( const Carta::Lib::NdArray::RawViewInterface::VI & pos
     // casa::ImageInterface::operator() returns the result by value
     // so in order to return reference (to satisfy our API) we need to store this
     // in a buffer first...
+    std::lock_guard < std::mutex > lock( m_ccimage-> m_casaMutex );
     m_buff = m_ccimage-> m_casaII->
                  operator() ( m_destPos );
 
@@ -205,58 +250,372 @@ CCRawView < PType >::get( const Carta::Lib::NdArray::RawViewInterface::VI & pos
 } // get
 
 template < typename PType >
+template < typename Func >
 void
-CCRawView < PType >::forEach(
-    std::function < void (const char *) > func,
-    Carta::Lib::NdArray::RawViewInterface::Traversal traversal )
+CCRawView < PType >::iterateCursors(
+    Carta::Lib::NdArray::RawViewInterface::Traversal traversal,
+    int64_t maxPixels,
+    Func func )
 {
-    if ( traversal != Carta::Lib::NdArray::RawViewInterface::Traversal::Sequential ) {
-        qFatal( "sorry, not implemented yet" );
-    }
-    auto casaII     = m_ccimage-> m_casaII;
-    int imgDims     = casaII-> ndim();
-    auto imageShape = casaII-> shape();
-
-//    qDebug() << "CCRawView::forEach=" << m_appliedSlice.toStr()  ;
-
-    /// \todo I guessed wrong as to what the cursor shape meant when using subSection()
-    /// \todo the shape refers to the shape within the subsection... so there is no need
-    /// \todo to specify cursor shape to be the whole image, it should instead be
-    /// \todo the shape of the subsection... e.g. [3:7:2,5:6] only needs a cursor
-    /// of size 2x1(x1x1x1....x1) regardless of the image size...
-    auto cursorShape = imageShape;
-    casa::LatticeStepper stepper( imageShape, cursorShape, casa::LatticeStepper::RESIZE );
-    casa::IPosition blc( imgDims, 0 );
-    auto trc = blc;
-    auto inc = blc;
-    for ( size_t i = 0 ; i < imgDims ; i++ ) {
+    auto casaII = m_ccimage-> m_casaII;
+    const size_t ndim = m_viewDims.size();
+
+    // we hold the lock whenever casacore is touched, but release it while func runs
+    std::unique_lock < std::mutex > lock( m_ccimage-> m_casaMutex );
+
+    casa::IPosition blc( ndim ), trc( ndim ), inc( ndim );
+    for ( size_t i = 0 ; i < ndim ; ++i ) {
         const auto & slice1d = m_appliedSlice.dims()[i];
         blc( i ) = slice1d.start;
         trc( i ) = slice1d.end();
         inc( i ) = slice1d.step;
     }
-    stepper.subSection( blc, trc, inc );
-    casa::RO_LatticeIterator < PType > iterator( * casaII, stepper );
 
-    bool first = true;
-    for ( iterator.reset() ; ! iterator.atEnd() ; iterator++ ) {
-        if ( ! first ) {
-            // sanity check for now, to make sure I understand casa cursors
-            // if this works, the outer loop is not necessary...
-            qFatal( "something went wrong" );
+    // the region we are going to walk, in image pixels
+    casa::IPosition length = trc - blc + 1;
+
+    std::unique_ptr < casa::LatticeNavigator > navigator;
+    if ( traversal == Carta::Lib::NdArray::RawViewInterface::Traversal::Optimal ) {
+        // walk the image in its native tile order, so that every tile is read
+        // from disk only once
+        casa::IPosition tileShape = casaII-> niceCursorShape();
+        m_ccimage-> m_tileCache-> prepare( tileShape, blc, length, CCTileCache::naturalPath( ndim ) );
+        navigator.reset( new casa::TileStepper( casaII-> shape(), tileShape ) );
+    }
+    else {
+        // the cursor shape is relative to the subsection: we fill up whole axes
+        // (starting with the fastest one) for as long as they fit into maxPixels,
+        // which keeps the concatenated cursors in sequential order
+        casa::IPosition cursorShape( ndim, 1 );
+        int64_t inner = 1;
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            int64_t n = std::min < int64_t > ( m_viewDims[i], maxPixels / inner );
+            cursorShape( i ) = std::max < int64_t > ( n, 1 );
+            if ( n < m_viewDims[i] ) {
+                break;
+            }
+            inner *= n;
         }
-        const auto & cursor = iterator.cursor();
-        for ( const auto & val : cursor ) {
-            func( reinterpret_cast < const char * > ( & val ) );
+
+        // the cursors advance in the same order as the pixels
+        casa::IPosition cursorExtent( ndim );
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            cursorExtent( i ) = ( cursorShape( i ) - 1 ) * inc( i ) + 1;
+        }
+        m_ccimage-> m_tileCache-> prepare( cursorExtent, blc, length,
+                                           CCTileCache::naturalPath( ndim ) );
+        navigator.reset( new casa::LatticeStepper( casaII-> shape(), cursorShape,
+                                                   casa::LatticeStepper::RESIZE ) );
+    }
+    navigator-> subSection( blc, trc, inc );
+
+    casa::RO_LatticeIterator < PType > iterator( * casaII, * navigator );
+    VI cursorPos( ndim );
+    for ( iterator.reset() ; ! iterator.atEnd() ; iterator++ ) {
+        // convert the cursor position to view coordinates
+        const casa::IPosition & pos = iterator.position();
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            cursorPos[i] = ( pos( i ) - blc( i ) ) / inc( i );
         }
-        first = false;
+
+        // the cursor is read in while locked, it's our own copy after that
+        const casa::Array < PType > & cursor = iterator.cursor();
+        lock.unlock();
+        func( cursor, cursorPos );
+        lock.lock();
+    }
+} // iterateCursors
+
+template < typename PType >
+void
+CCRawView < PType >::forEach(
+    std::function < void (const char *) > func,
+    Carta::Lib::NdArray::RawViewInterface::Traversal traversal )
+{
+    if ( nPixels() <= 0 ) {
+        return;
     }
+    const size_t ndim = m_viewDims.size();
+    m_currPosView.resize( ndim );
+    int64_t maxPixels;
+    {
+        std::lock_guard < std::mutex > lock( m_ccimage-> m_casaMutex );
+        maxPixels = m_ccimage-> m_casaII-> advisedMaxPixels();
+    }
+
+    auto cursorFunc = [&] ( const casa::Array < PType > & cursor, const VI & cursorPos ) {
+        const casa::IPosition & shape = cursor.shape();
+        casa::Bool deleteIt;
+        const PType * src = cursor.getStorage( deleteIt );
+        int64_t n = cursor.nelements();
+
+        // keep m_currPosView up to date, it's an odometer within the cursor
+        m_currPosView = cursorPos;
+        for ( int64_t k = 0 ; k < n ; ++k ) {
+            func( reinterpret_cast < const char * > ( src + k ) );
+            for ( size_t i = 0 ; i < ndim ; ++i ) {
+                if ( ++m_currPosView[i] < cursorPos[i] + shape( i ) ) {
+                    break;
+                }
+                m_currPosView[i] = cursorPos[i];
+            }
+        }
+        cursor.freeStorage( src, deleteIt );
+    };
+    iterateCursors( traversal, maxPixels, cursorFunc );
 } // forEach
 
 template < typename PType >
 const Carta::Lib::NdArray::RawViewInterface::VI &
 CCRawView < PType >::currentPos()
 {
-    qFatal( "Not implemented yet");
     return m_currPosView;
 }
+
+template < typename PType >
+Nullable < Carta::Lib::NdArray::RawViewInterface::StridedSpan >
+CCRawView < PType >::stridedSpan()
+{
+    if ( ! referenceArray() ) {
+        return Nullable < StridedSpan > ();
+    }
+    const casa::Array < PType > & arr = * m_arrayRef;
+
+    // casacore arrays are in fortran order, so we can compute the strides from the shape
+    const auto & slices = m_appliedSlice.dims();
+    const casa::IPosition & shape = arr.shape();
+    StridedSpan span;
+    span.pixelType = pixelType();
+    span.strides.resize( m_viewDims.size() );
+    int64_t offset = 0;
+    int64_t fstride = 1;
+    for ( size_t i = 0 ; i < m_viewDims.size() ; ++i ) {
+        offset += slices[i].start * fstride;
+        span.strides[i] = slices[i].step * fstride * int64_t( sizeof( PType ) );
+        fstride *= shape( i );
+    }
+    span.data = reinterpret_cast < const char * > ( arr.data() + offset );
+    return span;
+} // stridedSpan
+
+template < typename PType >
+bool
+CCRawView < PType >::referenceArray()
+{
+    if ( m_arrayRefState == 0 ) {
+        std::lock_guard < std::mutex > lock( m_ccimage-> m_casaMutex );
+        auto casaII = m_ccimage-> m_casaII;
+
+        // get a reference to the whole array, this only works for in-memory lattices,
+        // for anything else casacore would make a copy
+        m_arrayRefState = -1;
+        if ( casaII-> canReferenceArray() ) {
+            casa::COWPtr < casa::Array < PType > > ref;
+            if ( casaII-> get( ref ) && ref-> contiguousStorage() ) {
+                m_arrayRef = ref;
+                m_arrayRefState = 1;
+
+                // precompute the strides of our slice into the array
+                const casa::IPosition & shape = ref-> shape();
+                VI arrayDims( shape.size() );
+                for ( size_t i = 0 ; i < shape.size() ; ++i ) {
+                    arrayDims[i] = shape( i );
+                }
+                m_memLayout = Carta::Lib::NdArray::StridedLayout( m_appliedSlice, arrayDims );
+            }
+        }
+    }
+    return m_arrayRefState > 0;
+} // referenceArray
+
+template < typename PType >
+int64_t
+CCRawView < PType >::nPixels() const
+{
+    int64_t n = 1;
+    for ( auto d : m_viewDims ) {
+        n *= d;
+    }
+    return n;
+}
+
+template < typename PType >
+void
+CCRawView < PType >::readRange( int64_t first, int64_t count, PType * dst )
+{
+    // in-memory images don't need to go through casacore at all
+    if ( referenceArray() ) {
+        Carta::Lib::NdArray::gather( m_arrayRef-> data(), m_memLayout, first, count, dst );
+        return;
+    }
+
+    auto casaII = m_ccimage-> m_casaII;
+    const size_t ndim = m_viewDims.size();
+    const auto & slices = m_appliedSlice.dims();
+
+    // convert the linear index of the first pixel to a position in the view
+    VI pos( ndim, 0 );
+    int64_t rest = first;
+    for ( size_t i = 0 ; i < ndim ; ++i ) {
+        pos[i] = rest % m_viewDims[i];
+        rest /= m_viewDims[i];
+    }
+
+    // tell the tile cache what's coming: blocks of (at most) this shape, walking
+    // our region in sequential order
+    {
+        casa::IPosition blockExtent( ndim, 1 ), blc( ndim ), extent( ndim );
+        int64_t inner = 1;
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            blc( i ) = slices[i].start;
+            extent( i ) = ( m_viewDims[i] - 1 ) * slices[i].step + 1;
+        }
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            int64_t n = std::min < int64_t > ( m_viewDims[i], std::max < int64_t > ( 1, count / inner ) );
+            blockExtent( i ) = ( n - 1 ) * slices[i].step + 1;
+            if ( n < m_viewDims[i] ) {
+                break;
+            }
+            inner *= n;
+        }
+        std::lock_guard < std::mutex > lock( m_ccimage-> m_casaMutex );
+        m_ccimage-> m_tileCache-> prepare( blockExtent, blc, extent, CCTileCache::naturalPath( ndim ) );
+    }
+
+    casa::IPosition start( ndim ), length( ndim ), stride( ndim );
+    casa::Array < PType > block;
+    while ( count > 0 ) {
+        // find the biggest hyper-rectangular block starting at pos that fits into
+        // the remaining count, i.e. full axes 0..d-1 and a partial axis d
+        size_t d = 0;
+        int64_t inner = 1;
+        while ( d + 1 < ndim && pos[d] == 0 && inner * m_viewDims[d] <= count ) {
+            inner *= m_viewDims[d];
+            d++;
+        }
+        int64_t m = std::min < int64_t > ( m_viewDims[d] - pos[d], count / inner );
+
+        // translate the block to image coordinates
+        for ( size_t i = 0 ; i < ndim ; ++i ) {
+            start( i ) = slices[i].start + pos[i] * slices[i].step;
+            stride( i ) = slices[i].step;
+            if ( i < d ) {
+                length( i ) = m_viewDims[i];
+            }
+            else if ( i == d ) {
+                length( i ) = m;
+            }
+            else {
+                length( i ) = 1;
+            }
+        }
+        {
+            std::lock_guard < std::mutex > lock( m_ccimage-> m_casaMutex );
+            casaII-> getSlice( block, casa::Slicer( start, length, stride ) );
+        }
+
+        // copy the block out, casacore arrays are stored in the same (fortran) order
+        casa::Bool deleteIt;
+        const PType * src = block.getStorage( deleteIt );
+        int64_t n = m * inner;
+        std::copy( src, src + n, dst );
+        block.freeStorage( src, deleteIt );
+        dst += n;
+        count -= n;
+
+        // advance the position, carrying over into higher axes
+        pos[d] += m;
+        for ( size_t i = d ; i + 1 < ndim && pos[i] >= m_viewDims[i] ; ++i ) {
+            pos[i] = 0;
+            pos[i + 1]++;
+        }
+    }
+} // readRange
+
+template < typename PType >
+int64_t
+CCRawView < PType >::read( int64_t buffSize, char * buff,
+                           Carta::Lib::NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t count = std::min < int64_t > ( buffSize / sizeof( PType ), nPixels() - m_readPos );
+    if ( count <= 0 ) {
+        return 0;
+    }
+    readRange( m_readPos, count, reinterpret_cast < PType * > ( buff ) );
+    m_readPos += count;
+    return count * sizeof( PType );
+}
+
+template < typename PType >
+void
+CCRawView < PType >::seek( int64_t ind )
+{
+    m_readPos = Carta::Lib::clamp < int64_t > ( ind / sizeof( PType ), 0, nPixels() );
+}
+
+template < typename PType >
+int64_t
+CCRawView < PType >::read( int64_t chunk, int64_t buffSize, char * buff,
+                           Carta::Lib::NdArray::RawViewInterface::Traversal traversal )
+{
+    Q_UNUSED( traversal );
+    int64_t chunkPixels = buffSize / sizeof( PType );
+    if ( chunkPixels <= 0 || chunk < 0 ) {
+        return 0;
+    }
+    int64_t first = chunk * chunkPixels;
+    int64_t count = std::min < int64_t > ( chunkPixels, nPixels() - first );
+    if ( count <= 0 ) {
+        return 0;
+    }
+    readRange( first, count, reinterpret_cast < PType * > ( buff ) );
+    return count * sizeof( PType );
+}
+
+template < typename PType >
+void
+CCRawView < PType >::forEach(
+    int64_t buffSize,
+    std::function < void (const char *, int64_t) > func,
+    char * buff,
+    Carta::Lib::NdArray::RawViewInterface::Traversal traversal )
+{
+    CARTA_ASSERT( buff == nullptr || buffSize >= int64_t( sizeof( PType ) ) );
+    if ( nPixels() <= 0 ) {
+        return;
+    }
+    int64_t maxPixels = std::max < int64_t > ( 1, buffSize / sizeof( PType ) );
+
+    // in-memory images are walked directly, in sequential order (which is also optimal)
+    if ( referenceArray() ) {
+        Carta::Lib::NdArray::forEachBlock(
+            m_arrayRef-> data(), m_memLayout, maxPixels, reinterpret_cast < PType * > ( buff ),
+            [&] ( const PType * data, int64_t count ) {
+                func( reinterpret_cast < const char * > ( data ), count );
+            }
+            );
+        return;
+    }
+
+    auto cursorFunc = [&] ( const casa::Array < PType > & cursor, const VI & ) {
+        casa::Bool deleteIt;
+        const PType * src = cursor.getStorage( deleteIt );
+        int64_t n = cursor.nelements();
+
+        // sequential cursors always fit, but tiles may need to be split up,
+        // with or without a buffer func must never see more than maxPixels
+        for ( int64_t off = 0 ; off < n ; off += maxPixels ) {
+            int64_t count = std::min( maxPixels, n - off );
+            if ( ! buff ) {
+                func( reinterpret_cast < const char * > ( src + off ), count );
+            }
+            else {
+                std::copy( src + off, src + off + count, reinterpret_cast < PType * > ( buff ) );
+                func( buff, count );
+            }
+        }
+        cursor.freeStorage( src, deleteIt );
+    };
+    iterateCursors( traversal, maxPixels, cursorFunc );
+} // forEach
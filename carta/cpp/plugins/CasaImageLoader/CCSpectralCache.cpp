@@ -0,0 +1,192 @@
+/**
+ *
+ **/
+
+#include "CCSpectralCache.h"
+#include "casacore/casa/Arrays/ArrayUtil.h"
+#include "casacore/casa/Arrays/Slicer.h"
+#include "casacore/casa/Exceptions/Error.h"
+#include "casacore/images/Images/ImageUtilities.h"
+
+#include <QDebug>
+#include <QDir>
+#include <algorithm>
+#include <cmath>
+#include <unistd.h>
+
+/// max. number of channels in one tile of the copy
+static const int MaxTileChannels = 4096;
+
+/// approximate number of pixels in one tile of the copy
+static const int TilePixels = 64 * 1024;
+
+CCSpectralCache::Config &
+CCSpectralCache::config()
+{
+    static Config cfg;
+    return cfg;
+}
+
+CCSpectralCache::UniquePtr
+CCSpectralCache::start( casa::ImageInterface < casa::Float > * source, std::mutex & sourceMutex )
+{
+    const Config & cfg = config();
+    if ( ! cfg.enabled || ! source ) {
+        return nullptr;
+    }
+
+    // only cubes with a spectral axis, which are not already spectral-major, qualify
+    casa::IPosition shape = source-> shape();
+    int spectralAxis = source-> coordinates().spectralAxisNumber();
+    if ( shape.size() < 3 || spectralAxis <= 0 || shape( spectralAxis ) < 2 ) {
+        return nullptr;
+    }
+    qint64 bytes = qint64( shape.product() ) * sizeof( casa::Float );
+    if ( bytes > cfg.maxBytes ) {
+        return nullptr;
+    }
+
+    // unique name for the copy
+    static std::atomic < int > counter { 0 };
+    QString dir = cfg.scratchDir.isEmpty()
+                  ? QDir::tempPath() + "/carta-spectral-cache" : cfg.scratchDir;
+    if ( ! QDir().mkpath( dir ) ) {
+        qWarning() << "Spectral cache: cannot create" << dir;
+        return nullptr;
+    }
+    QString path = QString( "%1/cube-%2-%3.image" ).arg( dir ).arg( getpid() ).arg( counter++ );
+
+    return UniquePtr( new CCSpectralCache( source, sourceMutex, path ) );
+} // start
+
+CCSpectralCache::CCSpectralCache( casa::ImageInterface < casa::Float > * source,
+                                  std::mutex & sourceMutex,
+                                  const QString & path )
+    : m_source( source )
+      , m_sourceMutex( sourceMutex )
+      , m_path( path )
+{
+    m_thread = std::thread( & CCSpectralCache::run, this );
+}
+
+CCSpectralCache::~CCSpectralCache()
+{
+    m_cancel = true;
+    if ( m_thread.joinable() ) {
+        m_thread.join();
+    }
+
+    // the table was marked for deletion, so this removes it from the disk
+    m_image.reset();
+}
+
+void
+CCSpectralCache::run()
+{
+    try {
+        casa::IPosition srcShape;
+        casa::CoordinateSystem coordSys;
+        int spectralAxis = 0;
+        bool masked = false;
+        {
+            std::lock_guard < std::mutex > lock( m_sourceMutex );
+            srcShape = m_source-> shape();
+            coordSys = m_source-> coordinates();
+            spectralAxis = coordSys.spectralAxisNumber();
+            masked = m_source-> hasPixelMask();
+        }
+        const int ndim = srcShape.size();
+
+        // the spectral axis goes first, the others keep their order
+        casa::IPosition newOrder( ndim );
+        newOrder( 0 ) = spectralAxis;
+        for ( int i = 0, k = 1 ; i < ndim ; ++i ) {
+            if ( i != spectralAxis ) {
+                newOrder( k++ ) = i;
+            }
+        }
+        casa::Vector < casa::Int > order( newOrder.asVector() );
+        coordSys.transpose( order, order );
+        casa::IPosition newShape( ndim );
+        for ( int i = 0 ; i < ndim ; ++i ) {
+            newShape( i ) = srcShape( newOrder( i ) );
+        }
+
+        // we copy the cube in slabs along its slowest non-degenerate axis (other than the
+        // spectral one), each slab is read from the original in a single request
+        int slabAxis = - 1;
+        for ( int i = ndim - 1 ; i >= 0 ; --i ) {
+            if ( i != spectralAxis && srcShape( i ) > 1 ) {
+                slabAxis = i;
+                break;
+            }
+        }
+        if ( slabAxis < 0 ) {
+            return;
+        }
+        int slabAxisNew = 0;
+        while ( newOrder( slabAxisNew ) != slabAxis ) {
+            ++slabAxisNew;
+        }
+        qint64 sliceBytes = qint64( srcShape.product() / srcShape( slabAxis ) ) * sizeof( casa::Float );
+        int slabLength = Carta::Lib::clamp < qint64 > ( config().slabBytes / sliceBytes,
+                                                         1, srcShape( slabAxis ) );
+
+        // tiles hold whole spectra (up to a limit) for a small block of the sky
+        casa::IPosition tileShape( ndim, 1 );
+        tileShape( 0 ) = std::min < int > ( newShape( 0 ), MaxTileChannels );
+        int side = std::max( 1, int ( std::sqrt( double ( TilePixels ) / tileShape( 0 ) ) ) );
+        for ( int i = 1, k = 0 ; i < ndim && k < 2 ; ++i ) {
+            if ( newShape( i ) > 1 ) {
+                tileShape( i ) = std::min < int > ( newShape( i ), side );
+                ++k;
+            }
+        }
+        tileShape( slabAxisNew ) = std::min < int > ( tileShape( slabAxisNew ), slabLength );
+
+        m_image.reset( new casa::PagedImage < casa::Float > (
+                           casa::TiledShape( newShape, tileShape ), coordSys,
+                           m_path.toStdString() ) );
+        m_image-> table().markForDelete();
+        {
+            std::lock_guard < std::mutex > lock( m_sourceMutex );
+            casa::ImageUtilities::copyMiscellaneous( * m_image, * m_source );
+        }
+        if ( masked ) {
+            m_image-> makeMask( "mask0", true, true );
+        }
+
+        // copy the slabs
+        casa::Array < casa::Float > data;
+        casa::Array < casa::Bool > mask;
+        for ( int s = 0 ; s < srcShape( slabAxis ) ; s += slabLength ) {
+            if ( m_cancel ) {
+                return;
+            }
+            casa::IPosition start( ndim, 0 ), length( srcShape );
+            start( slabAxis ) = s;
+            length( slabAxis ) = std::min < int > ( slabLength, srcShape( slabAxis ) - s );
+            casa::Slicer slicer( start, length );
+            {
+                std::lock_guard < std::mutex > lock( m_sourceMutex );
+                m_source-> getSlice( data, slicer );
+                if ( masked ) {
+                    m_source-> getMaskSlice( mask, slicer );
+                }
+            }
+            casa::IPosition where( ndim, 0 );
+            where( slabAxisNew ) = s;
+            m_image-> putSlice( casa::reorderArray( data, newOrder ), where );
+            if ( masked ) {
+                m_image-> pixelMask().putSlice( casa::reorderArray( mask, newOrder ), where );
+            }
+        }
+        m_image-> flush();
+        m_ready = true;
+    }
+    catch ( casa::AipsError & error ) {
+        qWarning() << "Spectral cache: could not create" << m_path << ":"
+                   << error.getMesg().c_str();
+        m_image.reset();
+    }
+} // run
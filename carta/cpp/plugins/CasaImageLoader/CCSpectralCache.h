@@ -0,0 +1,99 @@
+/**
+ * Spectral-major copy of a cube, for fast spectral profiles.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "casacore/images/Images/ImageInterface.h"
+#include "casacore/images/Images/PagedImage.h"
+
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// Cubes are usually tiled by image planes, so extracting a spectrum means touching
+/// one tile per channel. This class writes, in a background thread, a copy of the cube
+/// to a scratch directory with the spectral axis moved to the front and tiles that
+/// contain whole spectra for a small block of the sky. Once the copy is finished,
+/// spectral profiles can be computed from it by reading a handful of tiles.
+///
+/// The copy is a casacore PagedImage with the transposed coordinate system, so
+/// anything that works on casacore images (e.g. region based profiles) works on it
+/// unchanged. The table is marked for deletion, so it disappears when the cache is
+/// destroyed.
+class CCSpectralCache
+{
+    CLASS_BOILERPLATE( CCSpectralCache );
+
+public:
+
+    /// settings, normally set from the plugin configuration
+    struct Config
+    {
+        /// is the cache enabled at all?
+        bool enabled = false;
+
+        /// where to put the copies
+        QString scratchDir;
+
+        /// cubes larger than this (in bytes) are not copied
+        qint64 maxBytes = qint64( 4096 ) * 1024 * 1024;
+
+        /// max. size of the slabs read from the original cube at once (in bytes)
+        qint64 slabBytes = qint64( 256 ) * 1024 * 1024;
+    };
+
+    /// global settings
+    static Config &
+    config();
+
+    /// start building the cache for the given cube
+    /// \param source the cube, must outlive the returned cache
+    /// \param sourceMutex mutex serializing access to source (casacore is not thread safe)
+    /// \return the cache, or nullptr if the cache is disabled or does not make sense
+    /// for this image (no spectral axis, too big, ...)
+    static UniquePtr
+    start( casa::ImageInterface < casa::Float > * source, std::mutex & sourceMutex );
+
+    /// only float cubes are cached
+    template < typename T >
+    static UniquePtr
+    start( casa::ImageInterface < T > * source, std::mutex & sourceMutex )
+    {
+        Q_UNUSED( source );
+        Q_UNUSED( sourceMutex );
+        return nullptr;
+    }
+
+    /// cancels the copy if it's still running and deletes the copy
+    ~CCSpectralCache();
+
+    /// is the copy finished?
+    bool
+    isReady() const { return m_ready; }
+
+    /// the spectral-major copy, or nullptr if it's not ready (yet)
+    casa::ImageInterface < casa::Float > *
+    image() const { return m_ready ? m_image.get() : nullptr; }
+
+private:
+
+    CCSpectralCache( casa::ImageInterface < casa::Float > * source,
+                     std::mutex & sourceMutex,
+                     const QString & path );
+
+    /// the background job
+    void
+    run();
+
+    casa::ImageInterface < casa::Float > * m_source;
+    std::mutex & m_sourceMutex;
+    QString m_path;
+    std::unique_ptr < casa::PagedImage < casa::Float > > m_image;
+    std::atomic < bool > m_ready { false };
+    std::atomic < bool > m_cancel { false };
+    std::thread m_thread;
+};
@@ -0,0 +1,130 @@
+/**
+ *
+ **/
+
+#include "CCTileCache.h"
+#include "casacore/casa/Exceptions/Error.h"
+
+#include <QDebug>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+
+/// sum of all counts with the given label in casacore's cache statistics,
+/// which look like "#reads: 12" (there is one set per hypercube)
+static int64_t
+sumStatistic( const QString & text, const QString & label )
+{
+    QRegularExpression re( label + "\\s*:?\\s*(\\d+)" );
+    int64_t sum = 0;
+    auto it = re.globalMatch( text );
+    while ( it.hasNext() ) {
+        sum += it.next().captured( 1 ).toLongLong();
+    }
+    return sum;
+}
+
+CCTileCache::Config &
+CCTileCache::config()
+{
+    static Config cfg;
+    return cfg;
+}
+
+CCTileCache::Counters &
+CCTileCache::totals()
+{
+    static Counters counters;
+    return counters;
+}
+
+CCTileCache::CCTileCache( casa::LatticeBase * lattice, int pixelSize )
+    : m_lattice( lattice )
+      , m_pixelSize( pixelSize )
+{
+    CARTA_ASSERT( lattice && pixelSize > 0 );
+    m_paged = m_lattice-> isPaged();
+    if ( m_paged ) {
+        // casacore's limit is in pixels
+        int64_t maxPixels = config().maxBytes / m_pixelSize;
+        m_lattice-> setMaximumCacheSize( casa::uInt( std::min < int64_t > ( maxPixels, INT32_MAX ) ) );
+    }
+}
+
+casa::IPosition
+CCTileCache::naturalPath( size_t ndim )
+{
+    casa::IPosition path( ndim );
+    for ( size_t i = 0 ; i < ndim ; ++i ) {
+        path( i ) = i;
+    }
+    return path;
+}
+
+void
+CCTileCache::prepare( const casa::IPosition & cursorShape,
+                      const casa::IPosition & blc,
+                      const casa::IPosition & length,
+                      const casa::IPosition & axisPath )
+{
+    if ( ! m_paged ) {
+        return;
+    }
+
+    // nothing to do if the pattern did not change
+    if ( cursorShape.isEqual( m_cursorShape ) && blc.isEqual( m_blc ) &&
+         length.isEqual( m_length ) && axisPath.isEqual( m_axisPath ) ) {
+        return;
+    }
+    updateCounters();
+    m_cursorShape.resize( 0 );
+    m_cursorShape = cursorShape;
+    m_blc.resize( 0 );
+    m_blc = blc;
+    m_length.resize( 0 );
+    m_length = length;
+    m_axisPath.resize( 0 );
+    m_axisPath = axisPath;
+
+    // casacore figures out how many tiles are needed for each tile to be read at most
+    // once, and caps it by the max. cache size
+    try {
+        m_lattice-> setCacheSizeFromPath( cursorShape, blc, length, axisPath );
+        totals().resizes++;
+    }
+    catch ( casa::AipsError & error ) {
+        qWarning() << "Tile cache: could not resize:" << error.getMesg().c_str();
+    }
+
+    // resizing may reset casacore's statistics
+    updateCounters();
+} // prepare
+
+void
+CCTileCache::updateCounters()
+{
+    // parsing casacore's statistics is not free, so only debug builds keep count
+    if ( ! CARTA_RUNTIME_CHECKS ) {
+        return;
+    }
+    std::ostringstream os;
+    m_lattice-> showCacheStatistics( os );
+    QString text = QString::fromStdString( os.str() );
+    int64_t accesses = sumStatistic( text, "#accesses" );
+    int64_t reads = sumStatistic( text, "#reads" );
+
+    // the statistics start from scratch when the cache is recreated
+    if ( accesses < m_lastAccesses || reads < m_lastReads ) {
+        m_lastAccesses = 0;
+        m_lastReads = 0;
+    }
+    int64_t newReads = reads - m_lastReads;
+    int64_t newHits = std::max < int64_t > ( 0, ( accesses - m_lastAccesses ) - newReads );
+    m_hits += newHits;
+    m_misses += newReads;
+    totals().hits += newHits;
+    totals().misses += newReads;
+    m_lastAccesses = accesses;
+    m_lastReads = reads;
+} // updateCounters
@@ -0,0 +1,111 @@
+/**
+ * Access-pattern-aware sizing of casacore's tile cache.
+ **/
+
+#pragma once
+
+#include "CartaLib/CartaLib.h"
+#include "casacore/casa/Arrays/IPosition.h"
+#include "casacore/lattices/Lattices/LatticeBase.h"
+
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+/// Casacore keeps a cache of tiles for every paged image, but its default size only
+/// suits reading the image in its tile order. Rendering a plane, extracting a spectrum
+/// and computing statistics of the whole cube walk the tiles in very different ways,
+/// and with a cache that's too small for the pattern the same tiles are read from disk
+/// over and over (e.g. a profile along the slowest axis of a plane-tiled cube).
+///
+/// Before every bulk read the views describe the read (the shape of one request, the
+/// region they are going to walk and the order of axes they walk it in), and this
+/// class asks casacore to size the cache so that each tile in the region is read at
+/// most once, capped by a configurable budget. The cache is only resized when the
+/// pattern changes.
+///
+/// Casacore counts the tile accesses and reads of each image, the deltas are collected
+/// into per-image and process-wide hit/miss counters.
+///
+/// \note all methods must be called while holding the image's mutex
+class CCTileCache
+{
+    CLASS_BOILERPLATE( CCTileCache );
+
+public:
+
+    /// settings, normally set from the plugin configuration
+    struct Config
+    {
+        /// max. size of the tile cache of a single image (in bytes)
+        int64_t maxBytes = int64_t( 512 ) * 1024 * 1024;
+    };
+
+    /// hit/miss counters, only maintained in builds with runtime checks
+    struct Counters
+    {
+        /// tiles that were found in the cache
+        std::atomic < int64_t > hits { 0 };
+
+        /// tiles that had to be read from disk
+        std::atomic < int64_t > misses { 0 };
+
+        /// number of times the cache was resized for a new access pattern
+        std::atomic < int64_t > resizes { 0 };
+    };
+
+    /// global settings
+    static Config &
+    config();
+
+    /// process-wide counters (sum over all images)
+    static Counters &
+    totals();
+
+    /// \param lattice the image, must outlive this instance
+    /// \param pixelSize size of the image's pixels (in bytes)
+    CCTileCache( casa::LatticeBase * lattice, int pixelSize );
+
+    /// \brief prepare the cache for a bulk read
+    /// \param cursorShape shape of one read request
+    /// \param blc first pixel of the region that will be read
+    /// \param length size of the region
+    /// \param axisPath the order in which the requests move along the axes
+    void
+    prepare( const casa::IPosition & cursorShape,
+             const casa::IPosition & blc,
+             const casa::IPosition & length,
+             const casa::IPosition & axisPath );
+
+    /// tiles of this image found in the cache
+    int64_t
+    hits() const { return m_hits; }
+
+    /// tiles of this image read from disk
+    int64_t
+    misses() const { return m_misses; }
+
+    /// natural axis order, i.e. 0, 1, ..., ndim-1
+    static casa::IPosition
+    naturalPath( size_t ndim );
+
+private:
+
+    /// collect the counts casacore accumulated since the last call
+    void
+    updateCounters();
+
+    casa::LatticeBase * m_lattice;
+    int m_pixelSize;
+
+    /// is there a cache at all?
+    bool m_paged;
+
+    /// the pattern the cache is currently sized for
+    casa::IPosition m_cursorShape, m_blc, m_length, m_axisPath;
+
+    /// casacore's counts at the last update
+    int64_t m_lastAccesses = 0, m_lastReads = 0;
+
+    int64_t m_hits = 0, m_misses = 0;
+};
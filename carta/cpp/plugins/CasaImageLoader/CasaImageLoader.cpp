@@ -3,6 +3,7 @@
 #include "CartaLib/Hooks/Initialize.h"
 #include "CartaLib/Hooks/LoadAstroImage.h"
 #include <QDebug>
+#include <QJsonObject>
 #include <QPainter>
 #include <QTime>
 #include <casacore/casa/Exceptions/Error.h>
@@ -46,6 +47,19 @@ bool CasaImageLoader::handleHook(BaseHook & hookData)
     return false;
 }
 
+void CasaImageLoader::initialize( const IPlugin::InitInfo & initInfo )
+{
+    QJsonObject cacheJson = initInfo.json.value( "spectralCache" ).toObject();
+    CCSpectralCache::Config & cfg = CCSpectralCache::config();
+    cfg.enabled = cacheJson.value( "enabled" ).toBool( false );
+    cfg.scratchDir = cacheJson.value( "scratchDir" ).toString();
+    cfg.maxBytes = qint64( cacheJson.value( "maxSizeMB" ).toDouble( 4096 ) ) * 1024 * 1024;
+
+    QJsonObject tileJson = initInfo.json.value( "tileCache" ).toObject();
+    CCTileCache::Config & tileCfg = CCTileCache::config();
+    tileCfg.maxBytes = int64_t( tileJson.value( "maxSizeMB" ).toDouble( 512 ) ) * 1024 * 1024;
+}
+
 std::vector<HookId> CasaImageLoader::getInitialHookList()
 {
     return {
@@ -62,6 +76,7 @@ static CCImageBase::SharedPtr tryCast( casa::LatticeBase * lat)
     typename CCImage<T>::SharedPtr res = nullptr;
     if( cii) {
         res = CCImage<T>::create( cii);
+        res-> startSpectralCache();
     }
     return res;
 }
@@ -19,9 +19,11 @@ public:
     virtual bool handleHook(BaseHook & hookData) override;
     virtual std::vector<HookId> getInitialHookList() override;
 
-//    void forgot_to_define_this();
+    /// reads the "spectralCache" settings: enabled, scratchDir, maxSizeMB
+    virtual void initialize( const InitInfo & initInfo ) override;
 
-private:
+//    void forgot_to_define_this();
 
-    Carta::Lib::Image::ImageInterface::SharedPtr loadImage(const QString & fname);
+    /// opens the image with casacore, nullptr if it can't
+    static Carta::Lib::Image::ImageInterface::SharedPtr loadImage(const QString & fname);
 };
@@ -12,6 +12,8 @@ SOURCES += \
     CCImage.cpp \
     CCMetaDataInterface.cpp \
     CCRawView.cpp \
+    CCSpectralCache.cpp \
+    CCTileCache.cpp \
     CCCoordinateFormatter.cpp
 
 HEADERS += \
@@ -19,6 +21,8 @@ HEADERS += \
     CCImage.h \
     CCMetaDataInterface.h \
     CCRawView.h \
+    CCSpectralCache.h \
+    CCTileCache.h \
     CCCoordinateFormatter.h
 
 casacoreLIBS += -L$${CASACOREDIR}/lib
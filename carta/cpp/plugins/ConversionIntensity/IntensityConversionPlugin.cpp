@@ -55,7 +55,7 @@ IntensityConversionPlugin::handleHook( BaseHook & hookData ){
             if ( oldUnits.isEmpty() || oldUnits.trimmed().length() == 0 ){
                 return true;
             }
-            CCImageBase * base = dynamic_cast<CCImageBase*>( image.get() );
+            CCImageBase * base = cartaII2ccImageBase( image );
             if ( base ){
                 casa::ImageInfo information = base->getImageInfo();
                 casa::Double beamAngle;
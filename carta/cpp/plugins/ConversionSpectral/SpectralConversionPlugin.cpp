@@ -31,7 +31,7 @@ SpectralConversionPlugin::handleHook( BaseHook & hookData ){
             }
             Converter* converter = Converter::getConverter( oldUnits, newUnits );
             if ( converter ){
-                CCImageBase * base = dynamic_cast<CCImageBase*>( image.get() );
+                CCImageBase * base = cartaII2ccImageBase( image );
                 if ( base ){
                     Carta::Lib::Image::MetaDataInterface::SharedPtr metaPtr = base->metaData();
                     CCMetaDataInterface* metaData = dynamic_cast<CCMetaDataInterface*>(metaPtr.get());
@@ -0,0 +1,140 @@
+/**
+ * Kernels converting raw (big-endian, possibly scaled) FITS pixels to native floats.
+ *
+ * The kernels are plain loops over a run of pixels, so that the compiler can vectorize
+ * the byte swapping and scaling. They are invoked by the views on whole runs at a time,
+ * i.e. the conversion happens lazily, only for the pixels that are actually requested.
+ **/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace FitsConvert
+{
+/// what to do with the raw values (BSCALE, BZERO and BLANK)
+struct Scaling
+{
+    double scale = 1.0;
+    double zero = 0.0;
+    bool hasBlank = false;
+    int64_t blank = 0;
+
+    bool
+    isIdentity() const { return scale == 1.0 && zero == 0.0; }
+};
+
+/// signature of the conversion kernels
+/// \param src address of the first raw pixel
+/// \param count number of pixels to convert
+/// \param stride distance between raw pixels in bytes
+/// \param dst converted values go here
+template < typename Dst >
+struct Kernel
+{
+    typedef void ( * Type )( const char * src, int64_t count, int64_t stride,
+                             Dst * dst, const Scaling & scaling );
+};
+
+namespace Impl
+{
+inline uint8_t
+bswap( uint8_t x ) { return x; }
+
+inline uint16_t
+bswap( uint16_t x ) { return __builtin_bswap16( x ); }
+
+inline uint32_t
+bswap( uint32_t x ) { return __builtin_bswap32( x ); }
+
+inline uint64_t
+bswap( uint64_t x ) { return __builtin_bswap64( x ); }
+
+/// unsigned integer of the same size as Raw
+template < int Size >
+struct UInt;
+
+template < >
+struct UInt < 1 > { typedef uint8_t type; };
+
+template < >
+struct UInt < 2 > { typedef uint16_t type; };
+
+template < >
+struct UInt < 4 > { typedef uint32_t type; };
+
+template < >
+struct UInt < 8 > { typedef uint64_t type; };
+
+/// load a big-endian value from (possibly unaligned) memory
+template < typename Raw >
+inline Raw
+loadBE( const char * ptr )
+{
+    typename UInt < sizeof( Raw ) >::type u;
+    std::memcpy( & u, ptr, sizeof( u ) );
+    u = bswap( u );
+    Raw res;
+    std::memcpy( & res, & u, sizeof( res ) );
+    return res;
+}
+}
+
+/// convert a run of raw pixels of type Raw into Dst
+template < typename Raw, typename Dst >
+void
+convert( const char * src, int64_t count, int64_t stride, Dst * dst, const Scaling & scaling )
+{
+    const Dst nan = std::numeric_limits < Dst >::quiet_NaN();
+    const Dst scale = scaling.scale;
+    const Dst zero = scaling.zero;
+    const bool checkBlank = std::numeric_limits < Raw >::is_integer && scaling.hasBlank;
+    const Raw blank = static_cast < Raw > ( scaling.blank );
+
+    // separate loops for the common cases, so that each of them is branch free
+    if ( ! checkBlank && scaling.isIdentity() ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            dst[i] = static_cast < Dst > ( Impl::loadBE < Raw > ( src + i * stride ) );
+        }
+    }
+    else if ( ! checkBlank ) {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            dst[i] = static_cast < Dst > ( Impl::loadBE < Raw > ( src + i * stride ) ) * scale + zero;
+        }
+    }
+    else {
+        for ( int64_t i = 0 ; i < count ; ++i ) {
+            Raw raw = Impl::loadBE < Raw > ( src + i * stride );
+            Dst val = static_cast < Dst > ( raw ) * scale + zero;
+            dst[i] = raw == blank ? nan : val;
+        }
+    }
+} // convert
+
+/// find the kernel for the given BITPIX
+template < typename Dst >
+typename Kernel < Dst >::Type
+kernelForBitpix( int bitpix )
+{
+    switch ( bitpix )
+    {
+    case 8 :
+        return & convert < uint8_t, Dst >;
+    case 16 :
+        return & convert < int16_t, Dst >;
+    case 32 :
+        return & convert < int32_t, Dst >;
+    case 64 :
+        return & convert < int64_t, Dst >;
+    case - 32 :
+        return & convert < float, Dst >;
+    case - 64 :
+        return & convert < double, Dst >;
+    default :
+        return nullptr;
+    }
+}
+}
@@ -0,0 +1,55 @@
+#include "FitsFile.h"
+#include <QDebug>
+
+FitsFile::SharedPtr
+FitsFile::open( const QString & fname, QString * errorMessage )
+{
+    // c++ does not allow make_shared with a private constructor
+    struct Opener : public FitsFile { };
+    SharedPtr file = std::make_shared < Opener > ();
+
+    file-> m_file.setFileName( fname );
+    if ( ! file-> m_file.open( QFile::ReadOnly ) ) {
+        if ( errorMessage ) {
+            * errorMessage = file-> m_file.errorString();
+        }
+        return nullptr;
+    }
+
+    // map the whole file, this only reserves address space, pages are read on demand
+    qint64 size = file-> m_file.size();
+    if ( size < FitsHeader::BlockSize ) {
+        if ( errorMessage ) {
+            * errorMessage = "file is too small to be FITS";
+        }
+        return nullptr;
+    }
+    file-> m_map = file-> m_file.map( 0, size );
+    if ( ! file-> m_map ) {
+        if ( errorMessage ) {
+            * errorMessage = "could not map file: " + file-> m_file.errorString();
+        }
+        return nullptr;
+    }
+
+    const char * data = reinterpret_cast < const char * > ( file-> m_map );
+    if ( ! file-> m_header.parse( data, size, errorMessage ) ) {
+        return nullptr;
+    }
+    file-> m_pixels = data + file-> m_header.dataOffset;
+
+    const FitsHeader & header = file-> m_header;
+    file-> m_scaling.scale = header.bscale;
+    file-> m_scaling.zero = header.bzero;
+    file-> m_scaling.hasBlank = header.hasBlank;
+    file-> m_scaling.blank = header.blank;
+
+    return file;
+} // open
+
+FitsFile::~FitsFile()
+{
+    if ( m_map ) {
+        m_file.unmap( m_map );
+    }
+}
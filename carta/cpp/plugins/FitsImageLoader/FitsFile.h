@@ -0,0 +1,56 @@
+/**
+ * Memory mapped FITS file.
+ **/
+
+#pragma once
+
+#include "FitsHeader.h"
+#include "FitsConvert.h"
+#include "CartaLib/CartaLib.h"
+#include <QFile>
+#include <QString>
+
+/// A FITS file mapped into memory. Nothing is read up front except for the header,
+/// the pixels are paged in by the OS as the views touch them. The mapping is
+/// read-only, so it can be shared by any number of views and threads.
+class FitsFile
+{
+    CLASS_BOILERPLATE( FitsFile );
+
+public:
+
+    /// map the file and parse its primary header
+    /// \param fname path to the file
+    /// \param errorMessage if not null, receives the reason of failure
+    /// \return the mapped file, or nullptr if this is not a FITS file we can handle
+    static SharedPtr
+    open( const QString & fname, QString * errorMessage = nullptr );
+
+    ~FitsFile();
+
+    /// the parsed primary header
+    const FitsHeader &
+    header() const { return m_header; }
+
+    /// address of the first pixel of the primary HDU
+    const char *
+    pixels() const { return m_pixels; }
+
+    /// BSCALE, BZERO and BLANK as needed by the conversion kernels
+    const FitsConvert::Scaling &
+    scaling() const { return m_scaling; }
+
+    /// name of the file
+    QString
+    fileName() const { return m_file.fileName(); }
+
+private:
+
+    FitsFile() { }
+
+    QFile m_file;
+    uchar * m_map = nullptr;
+    const char * m_pixels = nullptr;
+    FitsHeader m_header;
+    FitsConvert::Scaling m_scaling;
+};
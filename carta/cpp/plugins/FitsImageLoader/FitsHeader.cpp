@@ -0,0 +1,133 @@
+#include "FitsHeader.h"
+
+// parse the value part of a card (everything after "= "), i.e. remove quotes
+// from strings and strip comments
+static QString
+parseValue( const QString & raw )
+{
+    QString s = raw.trimmed();
+    if ( s.startsWith( '\'' ) ) {
+        // string value, '' inside the string is an escaped quote
+        QString res;
+        for ( int i = 1 ; i < s.size() ; ++i ) {
+            if ( s[i] == '\'' ) {
+                if ( i + 1 < s.size() && s[i + 1] == '\'' ) {
+                    res.append( '\'' );
+                    ++i;
+                    continue;
+                }
+                break;
+            }
+            res.append( s[i] );
+        }
+
+        // trailing spaces in FITS strings are not significant
+        while ( res.endsWith( ' ' ) ) {
+            res.chop( 1 );
+        }
+        return res;
+    }
+    int slash = s.indexOf( '/' );
+    if ( slash >= 0 ) {
+        s = s.left( slash );
+    }
+    return s.trimmed();
+} // parseValue
+
+bool
+FitsHeader::parse( const char * data, int64_t size, QString * errorMessage )
+{
+    auto fail = [errorMessage] ( const QString & msg ) {
+        if ( errorMessage ) {
+            * errorMessage = msg;
+        }
+        return false;
+    };
+
+    cards.clear();
+    m_values.clear();
+
+    // read cards until END
+    bool foundEnd = false;
+    int64_t pos = 0;
+    while ( pos + CardSize <= size ) {
+        QString card = QString::fromLatin1( data + pos, CardSize );
+        pos += CardSize;
+        QString key = card.left( 8 ).trimmed();
+        if ( cards.isEmpty() && key != "SIMPLE" ) {
+            return fail( "not a FITS file" );
+        }
+        cards.append( card );
+        if ( key == "END" ) {
+            foundEnd = true;
+            break;
+        }
+        if ( card.mid( 8, 2 ) == "= " && ! m_values.contains( key ) ) {
+            m_values[key] = parseValue( card.mid( 10 ) );
+        }
+    }
+    if ( ! foundEnd ) {
+        return fail( "FITS header is not terminated" );
+    }
+    if ( str( "SIMPLE" ) != "T" ) {
+        return fail( "not a standard FITS file" );
+    }
+
+    // the data starts at the next block boundary
+    dataOffset = ( pos + BlockSize - 1 ) / BlockSize * BlockSize;
+
+    bitpix = num( "BITPIX" );
+    if ( bitpix != 8 && bitpix != 16 && bitpix != 32 && bitpix != 64 &&
+         bitpix != - 32 && bitpix != - 64 ) {
+        return fail( QString( "unsupported BITPIX %1" ).arg( bitpix ) );
+    }
+    int naxis = num( "NAXIS" );
+    if ( naxis < 1 ) {
+        return fail( "primary HDU has no image" );
+    }
+    dims.resize( naxis );
+    for ( int i = 0 ; i < naxis ; ++i ) {
+        dims[i] = num( QString( "NAXIS%1" ).arg( i + 1 ) );
+        if ( dims[i] < 1 ) {
+            return fail( "primary HDU has an empty axis" );
+        }
+    }
+
+    bscale = num( "BSCALE", 1.0 );
+    bzero = num( "BZERO", 0.0 );
+    hasBlank = bitpix > 0 && has( "BLANK" );
+    if ( hasBlank ) {
+        blank = str( "BLANK" ).toLongLong();
+    }
+
+    if ( dataOffset + nPixels() * pixelSize() > size ) {
+        return fail( "FITS file is truncated" );
+    }
+    return true;
+} // parse
+
+int64_t
+FitsHeader::nPixels() const
+{
+    int64_t n = 1;
+    for ( auto d : dims ) {
+        n *= d;
+    }
+    return n;
+}
+
+QString
+FitsHeader::str( const QString & key, const QString & def ) const
+{
+    return m_values.value( key, def );
+}
+
+double
+FitsHeader::num( const QString & key, double def ) const
+{
+    bool ok = false;
+
+    // FITS allows 'D' as the exponent character
+    double val = str( key ).replace( 'D', 'E' ).toDouble( & ok );
+    return ok ? val : def;
+}
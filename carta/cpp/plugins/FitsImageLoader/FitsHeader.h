@@ -0,0 +1,77 @@
+/**
+ * Minimal parser for the primary header of a FITS file.
+ **/
+
+#pragma once
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <vector>
+
+/// the parts of the primary HDU header we need to serve the pixels, plus
+/// all keywords (for metadata)
+class FitsHeader
+{
+public:
+
+    /// size of FITS blocks in bytes
+    static constexpr int64_t BlockSize = 2880;
+
+    /// size of a header card in bytes
+    static constexpr int CardSize = 80;
+
+    /// BITPIX
+    int bitpix = 0;
+
+    /// NAXIS1, NAXIS2, ...
+    std::vector < int > dims;
+
+    /// BSCALE and BZERO
+    double bscale = 1.0;
+    double bzero = 0.0;
+
+    /// BLANK (only meaningful for integer data)
+    bool hasBlank = false;
+    int64_t blank = 0;
+
+    /// offset of the first pixel from the start of the file
+    int64_t dataOffset = 0;
+
+    /// all header cards, as they appear in the file
+    QStringList cards;
+
+    /// parse the header
+    /// \param data the beginning of the file
+    /// \param size size of the file in bytes
+    /// \param errorMessage if not null, receives the reason of failure
+    /// \return true on success
+    bool
+    parse( const char * data, int64_t size, QString * errorMessage = nullptr );
+
+    /// size of a pixel on disk in bytes
+    int
+    pixelSize() const { return bitpix < 0 ? - bitpix / 8 : bitpix / 8; }
+
+    /// total number of pixels
+    int64_t
+    nPixels() const;
+
+    /// is the keyword present?
+    bool
+    has( const QString & key ) const { return m_values.contains( key ); }
+
+    /// value of a keyword as a string (quotes and comments removed)
+    QString
+    str( const QString & key, const QString & def = QString() ) const;
+
+    /// value of a keyword as a number
+    double
+    num( const QString & key, double def = 0.0 ) const;
+
+private:
+
+    /// keyword -> value
+    QMap < QString, QString > m_values;
+};
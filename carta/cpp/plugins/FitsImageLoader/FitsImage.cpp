@@ -0,0 +1,618 @@
+#include "FitsImage.h"
+#include "FitsRawView.h"
+#include <QDebug>
+#include <cmath>
+
+typedef Carta::Lib::HtmlString HtmlString;
+typedef Carta::Lib::AxisInfo AxisInfo;
+
+/// Labels along one axis of a FITS image, at round world (or pixel) values, using the
+/// linear transformation of the coordinate formatter.
+class FitsImageLG : public PlotLabelGeneratorInterface
+{
+public:
+
+    FitsImageLG( CoordinateFormatterInterface::SharedPtr cf )
+        : m_cf( cf )
+    { }
+
+    virtual This &
+    setTextMeasureFunc( TextMeasureFunc fn ) override
+    {
+        m_measure = fn;
+        return * this;
+    }
+
+    virtual std::vector < Label >
+    computeLabels() override
+    {
+        std::vector < Label > labels;
+        if ( m_axis < 0 || m_axis >= m_cf-> nAxes() || m_pixels <= 0 ) {
+            return labels;
+        }
+
+        // the axis covers pixels [-1/2, npix-1/2), we label it in pixel or world
+        // coordinates, going from the densest round spacing to sparser ones until the
+        // labels fit without overlapping
+        bool world = m_mode != Mode::PixelOnly;
+        double first = toLabeled( - 0.5, world );
+        double last = toLabeled( m_pixels - 0.5, world );
+        double range = std::abs( last - first );
+        if ( ! std::isfinite( range ) || range == 0 ) {
+            return labels;
+        }
+        double lo = std::min( first, last );
+        double hi = std::max( first, last );
+        double spacing = niceSpacing( range / 50 );
+        while ( true ) {
+            labels.clear();
+            double needed = 0;
+            for ( double v = std::ceil( lo / spacing ) * spacing ; v <= hi ; v += spacing ) {
+                Label label = makeLabel( std::abs( v ) < spacing * 1e-9 ? 0 : v, world );
+                needed += std::max( measure( label.pixText ), measure( label.wcsText ) ) * 1.5;
+                labels.push_back( label );
+            }
+            if ( needed <= m_pixels || labels.size() <= 2 ) {
+                return labels;
+            }
+            spacing = niceSpacing( spacing * 1.5 );
+        }
+    } // computeLabels
+
+    virtual This &
+    setPixels( double npix ) override
+    {
+        m_pixels = npix;
+        return * this;
+    }
+
+    virtual This &
+    setAxis( int axis ) override
+    {
+        m_axis = axis;
+        return * this;
+    }
+
+    virtual This &
+    setMode( const Mode & mode ) override
+    {
+        m_mode = mode;
+        return * this;
+    }
+
+    virtual This &
+    setTextMode( const TextFormat & format ) override
+    {
+        // the labels are plain numbers, the same in any format
+        Q_UNUSED( format );
+        return * this;
+    }
+
+private:
+
+    /// world or pixel coordinate of the given pixel of the axis
+    double
+    toLabeled( double pixel, bool world ) const
+    {
+        if ( ! world ) {
+            return pixel;
+        }
+        CoordinateFormatterInterface::VD pix( m_cf-> nAxes(), 0.0 ), wcs;
+        pix[m_axis] = pixel;
+        m_cf-> toWorld( pix, wcs );
+        return wcs[m_axis];
+    }
+
+    /// label at the given world or pixel coordinate
+    Label
+    makeLabel( double v, bool world ) const
+    {
+        Label label;
+        label.centerPix = v;
+        if ( world ) {
+            CoordinateFormatterInterface::VD wcs( m_cf-> nAxes(), 0.0 ), pix;
+            CoordinateFormatterInterface::VD zero( m_cf-> nAxes(), 0.0 );
+            m_cf-> toWorld( zero, wcs );
+            wcs[m_axis] = v;
+            m_cf-> toPixel( wcs, pix );
+            label.centerPix = pix[m_axis];
+            label.wcsText = QString::number( v, 'g', 10 );
+        }
+        if ( m_mode != Mode::WCSOnly ) {
+            label.pixText = QString::number( label.centerPix, 'g', 10 );
+        }
+        return label;
+    }
+
+    /// the smallest of 1, 2, 5 times a power of 10 that is at least x
+    static double
+    niceSpacing( double x )
+    {
+        double p = std::pow( 10.0, std::floor( std::log10( x ) ) );
+        for ( double m : { 1.0, 2.0, 5.0, 10.0 } ) {
+            if ( m * p >= x ) {
+                return m * p;
+            }
+        }
+        return 10 * p;
+    }
+
+    /// width of the text, roughly a character per pixel if there is no measure function
+    double
+    measure( const QString & text ) const
+    {
+        return m_measure ? m_measure( text ) : text.size();
+    }
+
+    CoordinateFormatterInterface::SharedPtr m_cf;
+    TextMeasureFunc m_measure = nullptr;
+    double m_pixels = 0;
+    int m_axis = 0;
+    Mode m_mode = Mode::Both;
+};
+
+/// Linear coordinate formatter built from the CTYPEn/CRVALn/CRPIXn/CDELTn/CUNITn
+/// keywords. Projections are not applied, which is good enough for spectral and
+/// stokes axes, and an approximation for small fields of view.
+class FitsImageCF : public CoordinateFormatterInterface
+{
+public:
+
+    /// \param header the primary header
+    /// \param axes for each axis of the image, the corresponding axis in the file
+    FitsImageCF( const FitsHeader & header, const std::vector < int > & axes )
+    {
+        for ( int fileAxis : axes ) {
+            QString n = QString::number( fileAxis + 1 );
+            QString ctype = header.str( "CTYPE" + n ).toUpper();
+            QString name = ctype.section( '-', 0, 0 ).trimmed();
+            if ( name.isEmpty() ) {
+                name = QString( "Axis %1" ).arg( n );
+            }
+
+            m_crval.push_back( header.num( "CRVAL" + n, 0.0 ) );
+            m_crpix.push_back( header.num( "CRPIX" + n, 1.0 ) );
+            m_cdelt.push_back( header.num( "CDELT" + n, 1.0 ) );
+            m_axisInfos.push_back(
+                AxisInfo()
+                    .setKnownType( knownType( name ) )
+                    .setLongLabel( HtmlString::fromPlain( name ) )
+                    .setShortLabel( HtmlString::fromPlain( name ) )
+                    .setUnit( header.str( "CUNIT" + n ) ) );
+            m_precisions.push_back( 6 );
+            m_enabled.push_back( true );
+        }
+
+        QString radesys = header.str( "RADESYS", header.str( "RADECSYS" ) ).toUpper();
+        for ( const AxisInfo & ai : m_axisInfos ) {
+            QString label = ai.shortLabel().plain();
+            if ( label == "GLON" ) {
+                m_skyCS = KnownSkyCS::Galactic;
+            }
+            else if ( label == "ELON" ) {
+                m_skyCS = KnownSkyCS::Ecliptic;
+            }
+            else if ( label == "RA" ) {
+                if ( radesys == "ICRS" ) {
+                    m_skyCS = KnownSkyCS::ICRS;
+                }
+                else if ( radesys == "FK4" ) {
+                    m_skyCS = KnownSkyCS::B1950;
+                }
+                else {
+                    m_skyCS = KnownSkyCS::J2000;
+                }
+            }
+        }
+    }
+
+    virtual CoordinateFormatterInterface *
+    clone() const override
+    {
+        return new FitsImageCF( * this );
+    }
+
+    virtual int
+    nAxes() const override
+    {
+        return m_axisInfos.size();
+    }
+
+    virtual QStringList
+    formatFromPixelCoordinate( const VD & pix ) override
+    {
+        CARTA_ASSERT( int ( pix.size() ) >= nAxes() );
+        VD world;
+        toWorld( pix, world );
+        QStringList res;
+        for ( int i = 0 ; i < nAxes() ; ++i ) {
+            if ( m_enabled[i] ) {
+                res.append( QString::number( world[i], 'g', m_precisions[i] ) );
+            }
+        }
+        return res;
+    }
+
+    /// angular distance on the sky if the image has both sky axes (in degrees, as the
+    /// FITS standard requires), otherwise the distance in pixels
+    virtual QString
+    calculateFormatDistance( const VD & p1, const VD & p2 ) override
+    {
+        int lon = - 1, lat = - 1;
+        for ( int i = 0 ; i < nAxes() ; ++i ) {
+            if ( m_axisInfos[i].knownType() == AxisInfo::KnownType::DIRECTION_LON ) {
+                lon = i;
+            }
+            else if ( m_axisInfos[i].knownType() == AxisInfo::KnownType::DIRECTION_LAT ) {
+                lat = i;
+            }
+        }
+        if ( lon < 0 || lat < 0 ) {
+            double sum = 0;
+            for ( size_t i = 0 ; i < std::min( p1.size(), p2.size() ) ; ++i ) {
+                sum += ( p1[i] - p2[i] ) * ( p1[i] - p2[i] );
+            }
+            return QString( "%1 pix" ).arg( std::sqrt( sum ), 0, 'g', 6 );
+        }
+
+        // haversine formula, which is accurate for small distances too
+        VD w1, w2;
+        toWorld( p1, w1 );
+        toWorld( p2, w2 );
+        const double rad = M_PI / 180;
+        double dlon = ( w2[lon] - w1[lon] ) * rad;
+        double dlat = ( w2[lat] - w1[lat] ) * rad;
+        double h = std::pow( std::sin( dlat / 2 ), 2 ) +
+                   std::cos( w1[lat] * rad ) * std::cos( w2[lat] * rad ) *
+                   std::pow( std::sin( dlon / 2 ), 2 );
+        double dist = 2 * std::asin( std::sqrt( std::min( 1.0, h ) ) ) / rad;
+        if ( dist >= 1 ) {
+            return QString( "%1 deg" ).arg( dist, 0, 'g', 6 );
+        }
+        if ( dist * 60 >= 1 ) {
+            return QString( "%1 arcmin" ).arg( dist * 60, 0, 'g', 6 );
+        }
+        return QString( "%1 arcsec" ).arg( dist * 3600, 0, 'g', 6 );
+    } // calculateFormatDistance
+
+    virtual void
+    setTextOutputFormat( TextFormat fmt ) override
+    {
+        Q_UNUSED( fmt );
+    }
+
+    virtual const Carta::Lib::AxisInfo &
+    axisInfo( int ind ) const override
+    {
+        CARTA_ASSERT( ind >= 0 && ind < nAxes() );
+        return m_axisInfos[ind];
+    }
+
+    virtual Me &
+    disableAxis( int ind ) override
+    {
+        CARTA_ASSERT( ind >= 0 && ind < nAxes() );
+        m_enabled[ind] = false;
+        return * this;
+    }
+
+    virtual Me &
+    enableAxis( int ind ) override
+    {
+        CARTA_ASSERT( ind >= 0 && ind < nAxes() );
+        m_enabled[ind] = true;
+        return * this;
+    }
+
+    virtual KnownSkyCS
+    skyCS() override
+    {
+        return m_skyCS;
+    }
+
+    virtual Me &
+    setSkyCS( const KnownSkyCS & scs ) override
+    {
+        // we can only report the native system, there is no conversion
+        Q_UNUSED( scs );
+        return * this;
+    }
+
+    virtual SkyFormatting
+    skyFormatting() override
+    {
+        return SkyFormatting::Degrees;
+    }
+
+    virtual Me &
+    setSkyFormatting( SkyFormatting format ) override
+    {
+        Q_UNUSED( format );
+        return * this;
+    }
+
+    virtual int
+    axisPrecision( int axis ) override
+    {
+        CARTA_ASSERT( axis >= 0 && axis < nAxes() );
+        return m_precisions[axis];
+    }
+
+    virtual Me &
+    setAxisPrecision( int precision, int axis ) override
+    {
+        if ( axis < 0 ) {
+            std::fill( m_precisions.begin(), m_precisions.end(), precision );
+            return * this;
+        }
+        CARTA_ASSERT( axis < nAxes() );
+        m_precisions[axis] = precision;
+        return * this;
+    }
+
+    virtual bool
+    toWorld( const VD & pixel, VD & world ) const override
+    {
+        // carta pixel coordinates are 0 based, FITS ones are 1 based
+        world.resize( nAxes() );
+        for ( int i = 0 ; i < nAxes() ; ++i ) {
+            double p = i < int ( pixel.size() ) ? pixel[i] : 0.0;
+            world[i] = m_crval[i] + ( p + 1 - m_crpix[i] ) * m_cdelt[i];
+        }
+        return true;
+    }
+
+    virtual bool
+    toPixel( const VD & world, VD & pixel ) const override
+    {
+        pixel.resize( nAxes() );
+        for ( int i = 0 ; i < nAxes() ; ++i ) {
+            if ( m_cdelt[i] == 0.0 ) {
+                return false;
+            }
+            double w = i < int ( world.size() ) ? world[i] : m_crval[i];
+            pixel[i] = ( w - m_crval[i] ) / m_cdelt[i] + m_crpix[i] - 1;
+        }
+        return true;
+    }
+
+private:
+
+    /// guess the axis type from the CTYPE prefix
+    static AxisInfo::KnownType
+    knownType( const QString & name )
+    {
+        if ( name == "RA" || name == "GLON" || name == "ELON" ) {
+            return AxisInfo::KnownType::DIRECTION_LON;
+        }
+        if ( name == "DEC" || name == "GLAT" || name == "ELAT" ) {
+            return AxisInfo::KnownType::DIRECTION_LAT;
+        }
+        if ( name == "FREQ" || name == "VELO" || name == "VRAD" || name == "VOPT" ||
+             name == "WAVE" || name == "FELO" ) {
+            return AxisInfo::KnownType::SPECTRAL;
+        }
+        if ( name == "STOKES" ) {
+            return AxisInfo::KnownType::STOKES;
+        }
+        return AxisInfo::KnownType::OTHER;
+    }
+
+    /// linear transformation per axis
+    std::vector < double > m_crval, m_crpix, m_cdelt;
+
+    /// cached info per axis
+    std::vector < AxisInfo > m_axisInfos;
+
+    /// precisions
+    std::vector < int > m_precisions;
+
+    /// which axes formatFromPixelCoordinate() prints
+    std::vector < bool > m_enabled;
+
+    /// sky system, as declared in the header
+    KnownSkyCS m_skyCS = KnownSkyCS::Unknown;
+};
+
+/// metadata of a FITS image
+class FitsImageMDI : public Carta::Lib::Image::MetaDataInterface
+{
+public:
+
+    FitsImageMDI( const FitsHeader & header, const std::vector < int > & axes )
+    {
+        m_title = HtmlString::fromPlain( header.str( "OBJECT" ) );
+        m_cards = header.cards;
+        m_coordinateFormatter = std::make_shared < FitsImageCF > ( header, axes );
+    }
+
+    virtual Carta::Lib::Image::MetaDataInterface *
+    clone() override
+    {
+        return new FitsImageMDI( * this );
+    }
+
+    virtual CoordinateFormatterInterface::SharedPtr
+    coordinateFormatter() override
+    {
+        return m_coordinateFormatter;
+    }
+
+    virtual PlotLabelGeneratorInterface::SharedPtr
+    plotLabelGenerator() override
+    {
+        return std::make_shared < FitsImageLG > ( m_coordinateFormatter );
+    }
+
+    virtual QString
+    title( TextFormat format ) override
+    {
+        if ( format == TextFormat::Plain ) {
+            return m_title.plain();
+        }
+        else {
+            return m_title.html();
+        }
+    }
+
+    virtual QStringList
+    otherInfo( TextFormat format ) override
+    {
+        Q_UNUSED( format );
+        return m_cards;
+    }
+
+private:
+
+    Carta::Lib::HtmlString m_title;
+    QStringList m_cards;
+    CoordinateFormatterInterface::SharedPtr m_coordinateFormatter = nullptr;
+};
+
+FitsImage::SharedPtr
+FitsImage::load( const QString & fname )
+{
+    QString error;
+    FitsFile::SharedPtr file = FitsFile::open( fname, & error );
+    if ( ! file ) {
+        qDebug() << "FitsImage: cannot load" << fname << ":" << error;
+        return nullptr;
+    }
+
+    // initially the axes are in the file order
+    std::vector < int > axes( file-> header().dims.size() );
+    for ( size_t i = 0 ; i < axes.size() ; ++i ) {
+        axes[i] = i;
+    }
+
+    // c++ does not allow make_shared with a private constructor
+    struct Maker : public FitsImage {
+        Maker( FitsFile::SharedPtr file, const std::vector < int > & axes )
+            : FitsImage( file, axes ) { }
+    };
+    return std::make_shared < Maker > ( file, axes );
+} // load
+
+FitsImage::FitsImage( FitsFile::SharedPtr file, const std::vector < int > & axes )
+{
+    m_file = file;
+    m_axes = axes;
+
+    // strides of the axes in the file (fortran order)
+    const FitsHeader & header = m_file-> header();
+    VI64 fileStrides( header.dims.size() );
+    int64_t stride = 1;
+    for ( size_t i = 0 ; i < header.dims.size() ; ++i ) {
+        fileStrides[i] = stride;
+        stride *= header.dims[i];
+    }
+    for ( int fileAxis : m_axes ) {
+        m_dims.push_back( header.dims[fileAxis] );
+        m_axisStrides.push_back( fileStrides[fileAxis] );
+    }
+
+    m_unit = Carta::Lib::Unit( header.str( "BUNIT" ) );
+    m_mdi = std::make_shared < FitsImageMDI > ( header, m_axes );
+}
+
+const Carta::Lib::Unit &
+FitsImage::getPixelUnit() const
+{
+    return m_unit;
+}
+
+std::shared_ptr < Carta::Lib::Image::ImageInterface >
+FitsImage::getPermuted( const std::vector < int > & indices )
+{
+    CARTA_ASSERT( indices.size() == m_axes.size() );
+
+    // permuting only changes which file axis each of our axes maps to
+    std::vector < int > newAxes( m_axes.size() );
+    for ( size_t i = 0 ; i < indices.size() ; ++i ) {
+        newAxes[i] = m_axes[indices[i]];
+    }
+    struct Maker : public FitsImage {
+        Maker( FitsFile::SharedPtr file, const std::vector < int > & axes )
+            : FitsImage( file, axes ) { }
+    };
+    return std::make_shared < Maker > ( m_file, newAxes );
+}
+
+const FitsImage::VI &
+FitsImage::dims() const
+{
+    return m_dims;
+}
+
+bool
+FitsImage::hasMask() const
+{
+    // blanked pixels are reported as NaNs
+    return false;
+}
+
+bool
+FitsImage::hasErrorsInfo() const
+{
+    return false;
+}
+
+Carta::Lib::Image::PixelType
+FitsImage::pixelType() const
+{
+    // 64 bit data would lose precision as floats
+    int bitpix = m_file-> header().bitpix;
+    if ( bitpix == - 64 || bitpix == 64 ) {
+        return Carta::Lib::Image::PixelType::Real64;
+    }
+    return Carta::Lib::Image::PixelType::Real32;
+}
+
+Carta::Lib::Image::PixelType
+FitsImage::errorType() const
+{
+    // there are no errors (see hasErrorsInfo()), they would have the type of the pixels
+    return pixelType();
+}
+
+Carta::Lib::NdArray::RawViewInterface *
+FitsImage::getDataSlice( const SliceND & sliceInfo )
+{
+    SliceND::ApplyResult ar = sliceInfo.apply( m_dims );
+    if ( pixelType() == Carta::Lib::Image::PixelType::Real64 ) {
+        return new FitsRawView < double > ( m_file, m_dims, m_axisStrides, ar );
+    }
+    return new FitsRawView < float > ( m_file, m_dims, m_axisStrides, ar );
+}
+
+Carta::Lib::NdArray::BitMask *
+FitsImage::getMaskSlice( const SliceND & sliceInfo )
+{
+    Q_UNUSED( sliceInfo );
+    return nullptr;
+}
+
+Carta::Lib::NdArray::RawViewInterface *
+FitsImage::getErrorSlice( const SliceND & sliceInfo )
+{
+    Q_UNUSED( sliceInfo );
+    return nullptr;
+}
+
+Carta::Lib::Image::MetaDataInterface::SharedPtr
+FitsImage::metaData()
+{
+    return m_mdi;
+}
+
+QString
+FitsImage::fileName() const
+{
+    // whoever opens the file gets its axes in the file order
+    for ( size_t i = 0 ; i < m_axes.size() ; ++i ) {
+        if ( m_axes[i] != int ( i ) ) {
+            return QString();
+        }
+    }
+    return m_file-> fileName();
+}
@@ -0,0 +1,87 @@
+/**
+ * ImageInterface implementation for memory mapped FITS files.
+ **/
+
+#pragma once
+
+#include "FitsFile.h"
+#include "CartaLib/IImage.h"
+#include <memory>
+#include <vector>
+
+/// An image backed by a memory mapped FITS file. Only the header is parsed when the
+/// image is loaded, the pixels are converted lazily by the views.
+class FitsImage
+    : public Carta::Lib::Image::ImageInterface
+      , public std::enable_shared_from_this < FitsImage >
+{
+    CLASS_BOILERPLATE( FitsImage );
+
+public:
+
+    typedef std::vector < int64_t > VI64;
+
+    /// map the file and create an image for its primary HDU
+    /// \return the image, or nullptr if the file is not a FITS file we can handle
+    static SharedPtr
+    load( const QString & fname );
+
+    virtual const Carta::Lib::Unit &
+    getPixelUnit() const override;
+
+    /// the returned image shares the mapping with this one, no pixels are copied
+    virtual std::shared_ptr < Carta::Lib::Image::ImageInterface >
+    getPermuted( const std::vector < int > & indices ) override;
+
+    virtual const VI &
+    dims() const override;
+
+    virtual bool
+    hasMask() const override;
+
+    virtual bool
+    hasErrorsInfo() const override;
+
+    virtual Carta::Lib::Image::PixelType
+    pixelType() const override;
+
+    virtual Carta::Lib::Image::PixelType
+    errorType() const override;
+
+    virtual Carta::Lib::NdArray::RawViewInterface *
+    getDataSlice( const SliceND & sliceInfo ) override;
+
+    virtual Carta::Lib::NdArray::BitMask *
+    getMaskSlice( const SliceND & sliceInfo ) override;
+
+    virtual Carta::Lib::NdArray::RawViewInterface *
+    getErrorSlice( const SliceND & sliceInfo ) override;
+
+    virtual Carta::Lib::Image::MetaDataInterface::SharedPtr
+    metaData() override;
+
+    /// the mapped file, unless the axes were permuted
+    virtual QString
+    fileName() const override;
+
+private:
+
+    /// \param file the mapped file
+    /// \param axes for each axis of the image, the corresponding axis in the file
+    FitsImage( FitsFile::SharedPtr file, const std::vector < int > & axes );
+
+    /// the mapped file, shared with all views and permuted images
+    FitsFile::SharedPtr m_file;
+
+    /// for each axis of this image, the corresponding axis in the file
+    std::vector < int > m_axes;
+
+    /// dimensions of this image
+    VI m_dims;
+
+    /// for each axis of this image, distance between pixels in the file (in pixels)
+    VI64 m_axisStrides;
+
+    Carta::Lib::Unit m_unit;
+    Carta::Lib::Image::MetaDataInterface::SharedPtr m_mdi = nullptr;
+};
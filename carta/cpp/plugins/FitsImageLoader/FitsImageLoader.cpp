@@ -0,0 +1,52 @@
+#include "FitsImageLoader.h"
+#include "FitsImage.h"
+#include "CartaLib/Hooks/LoadAstroImage.h"
+#include "CartaLib/Hooks/Initialize.h"
+#include <QDebug>
+
+typedef Carta::Lib::Hooks::LoadAstroImage LoadAstroImage;
+typedef Carta::Lib::Hooks::Initialize Initialize;
+
+static const char * PluginName = "FitsImageLoader:";
+
+FitsImageLoader::FitsImageLoader( QObject * parent ) :
+    QObject( parent )
+{ }
+
+bool
+FitsImageLoader::handleHook( BaseHook & hookData )
+{
+    if ( hookData.is < Initialize > () ) {
+        return true;
+    }
+    else if ( hookData.is < LoadAstroImage > () ) {
+        if ( ! m_enabled ) {
+            return false;
+        }
+        LoadAstroImage & hook = static_cast < LoadAstroImage & > ( hookData );
+        auto fname = hook.paramsPtr-> fileName;
+
+        hook.result = FitsImage::load( fname );
+
+        // return true if result is not null
+        return hook.result != nullptr;
+    }
+
+    qWarning() << PluginName << "Sorry, don't know how to handle this hook";
+    return false;
+} // handleHook
+
+std::vector < HookId >
+FitsImageLoader::getInitialHookList()
+{
+    return {
+               Initialize::staticId,
+               LoadAstroImage::staticId
+    };
+}
+
+void
+FitsImageLoader::initialize( const IPlugin::InitInfo & info )
+{
+    m_enabled = info.json.value( "enabled" ).toBool( false );
+}
@@ -0,0 +1,38 @@
+/// This plugin reads FITS images by mapping them into memory, without casacore.
+///
+/// When it is enabled, it loads the FITS files and CasaImageLoader everything else:
+/// CasaImageLoader depends on this plugin, so this one is loaded first and gets the
+/// LoadAstroImage hook first. The plugins working with casacore images open the files
+/// of these images again with casacore, see cartaII2ccImageBase().
+
+#pragma once
+
+#include "CartaLib/IPlugin.h"
+#include <QObject>
+#include <QString>
+
+class FitsImageLoader : public QObject, public IPlugin
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA( IID "org.cartaviewer.IPlugin" )
+    Q_INTERFACES( IPlugin )
+
+public:
+
+    FitsImageLoader( QObject * parent = 0 );
+
+    virtual bool
+    handleHook( BaseHook & hookData ) override;
+
+    virtual std::vector < HookId >
+    getInitialHookList() override;
+
+    virtual void
+    initialize( const InitInfo & initInfo ) override;
+
+protected:
+
+    /// the loader is opt-in, as the plugins working with casacore images (statistics,
+    /// profiles, regions) have to open these images a second time
+    bool m_enabled = false;
+};
@@ -0,0 +1,39 @@
+! include(../../common.pri) {
+  error( "Could not find the common.pri file!" )
+}
+
+INCLUDEPATH += $$PROJECT_ROOT
+DEPENDPATH += $$PROJECT_ROOT
+
+QT       += core
+LIBS += -L$$OUT_PWD/../../CartaLib/ -lCartaLib
+
+TARGET = plugin
+TEMPLATE = lib
+CONFIG += plugin
+
+SOURCES += \
+    FitsHeader.cpp \
+    FitsFile.cpp \
+    FitsImage.cpp \
+    FitsImageLoader.cpp
+
+HEADERS += \
+    FitsHeader.h \
+    FitsConvert.h \
+    FitsFile.h \
+    FitsRawView.h \
+    FitsImage.h \
+    FitsImageLoader.h
+
+OTHER_FILES += \
+    plugin.json
+
+# copy json to build directory
+MYFILES = plugin.json
+copy_files.name = copy large files
+copy_files.input = MYFILES
+copy_files.output = $${OUT_PWD}/${QMAKE_FILE_BASE}${QMAKE_FILE_EXT}
+copy_files.commands = ${COPY_FILE} ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+copy_files.CONFIG += no_link target_predeps
+QMAKE_EXTRA_COMPILERS += copy_files
@@ -0,0 +1,254 @@
+/**
+ * Implementation of RawViewInterface on top of a memory mapped FITS file.
+ **/
+
+#pragma once
+
+#include "FitsFile.h"
+#include "CartaLib/IImage.h"
+#include "CartaLib/StridedIterator.h"
+#include <algorithm>
+#include <vector>
+
+/// A view serving pixels straight from the mapping. The raw pixels are byte-swapped and
+/// scaled (BSCALE/BZERO/BLANK) on the fly, a run at a time, into Dst.
+///
+/// The view does not care about the order of axes in the file, it only needs to know
+/// the distance between pixels along each axis of the image, which is also how
+/// permuted images are served without copying anything.
+template < typename Dst >
+class FitsRawView
+    : public Carta::Lib::NdArray::RawViewInterface
+{
+public:
+
+    typedef std::vector < int64_t > VI64;
+
+    /// \param file the mapped file
+    /// \param imageDims dimensions of the image (in the image's axis order)
+    /// \param axisStrides for each axis of the image, the distance between two
+    /// consecutive pixels in the file (in pixels)
+    /// \param appliedSlice slice of the image this view represents
+    FitsRawView( FitsFile::SharedPtr file,
+                 const VI & imageDims,
+                 const VI64 & axisStrides,
+                 const SliceND::ApplyResult & appliedSlice )
+    {
+        m_file = file;
+        m_imageDims = imageDims;
+        m_axisStrides = axisStrides;
+        m_appliedSlice = appliedSlice;
+        m_kernel = FitsConvert::kernelForBitpix < Dst > ( file-> header().bitpix );
+        m_rawSize = file-> header().pixelSize();
+        CARTA_ASSERT( m_kernel );
+
+        // precompute where the slice is in the file
+        const auto & slices = m_appliedSlice.dims();
+        VI64 layoutDims;
+        int64_t offset = 0;
+        for ( size_t i = 0 ; i < slices.size() ; ++i ) {
+            int count = std::max( slices[i].count, 1 );
+            m_viewDims.push_back( count );
+            m_viewStrides.push_back( slices[i].step * m_axisStrides[i] );
+            offset += slices[i].start * m_axisStrides[i];
+            layoutDims.push_back( count );
+        }
+        m_offset = offset;
+        m_layout = Carta::Lib::NdArray::StridedLayout( layoutDims, m_viewStrides, offset );
+        m_currPos.resize( m_viewDims.size(), 0 );
+    }
+
+    virtual PixelType
+    pixelType() override
+    {
+        return Carta::Lib::Image::CType2PixelType < Dst >::type;
+    }
+
+    virtual const VI &
+    dims() override
+    {
+        return m_viewDims;
+    }
+
+    virtual const char *
+    get( const VI & pos ) override
+    {
+        int64_t off = m_offset;
+        for ( size_t i = 0 ; i < pos.size() && i < m_viewStrides.size() ; ++i ) {
+            off += pos[i] * m_viewStrides[i];
+        }
+        m_kernel( rawPtr( off ), 1, m_rawSize, & m_getBuff, m_file-> scaling() );
+        return reinterpret_cast < const char * > ( & m_getBuff );
+    }
+
+    virtual void
+    forEach( std::function < void (const char *) > func, Traversal traversal ) override
+    {
+        // the file is in memory, so sequential order is also the optimal order
+        Q_UNUSED( traversal );
+
+        // convert a block at a time, then hand out the pixels one by one
+        const int64_t blockPixels = BlockPixels;
+        std::vector < Dst > buff( blockPixels );
+        std::fill( m_currPos.begin(), m_currPos.end(), 0 );
+        int64_t total = nPixels();
+        for ( int64_t first = 0 ; first < total ; first += blockPixels ) {
+            int64_t count = std::min( blockPixels, total - first );
+            readRange( first, count, buff.data() );
+            for ( int64_t i = 0 ; i < count ; ++i ) {
+                func( reinterpret_cast < const char * > ( & buff[i] ) );
+
+                // advance the position
+                for ( size_t d = 0 ; d < m_currPos.size() ; ++d ) {
+                    if ( ++m_currPos[d] < m_viewDims[d] ) {
+                        break;
+                    }
+                    m_currPos[d] = 0;
+                }
+            }
+        }
+    } // forEach
+
+    virtual const VI &
+    currentPos() override
+    {
+        return m_currPos;
+    }
+
+    virtual Carta::Lib::NdArray::RawViewInterface *
+    getView( const SliceND & sliceInfo ) override
+    {
+        SliceND::ApplyResult ar = sliceInfo.apply( dims() );
+        SliceND::ApplyResult newAr = SliceND::ApplyResult::combine( m_appliedSlice, ar );
+        return new FitsRawView( m_file, m_imageDims, m_axisStrides, newAr );
+    }
+
+    virtual Carta::Lib::NdArray::RawViewInterface *
+    clone() override
+    {
+        // the mapping is read-only, so we only need our own traversal state
+        return new FitsRawView( m_file, m_imageDims, m_axisStrides, m_appliedSlice );
+    }
+
+    virtual int64_t
+    read( int64_t buffSize, char * buff, Traversal traversal ) override
+    {
+        Q_UNUSED( traversal );
+        int64_t count = std::min < int64_t > ( buffSize / sizeof( Dst ), nPixels() - m_readPos );
+        if ( count <= 0 ) {
+            return 0;
+        }
+        readRange( m_readPos, count, reinterpret_cast < Dst * > ( buff ) );
+        m_readPos += count;
+        return count * sizeof( Dst );
+    }
+
+    virtual void
+    seek( int64_t ind ) override
+    {
+        m_readPos = Carta::Lib::clamp < int64_t > ( ind / sizeof( Dst ), 0, nPixels() );
+    }
+
+    virtual int64_t
+    read( int64_t chunk, int64_t buffSize, char * buff, Traversal traversal ) override
+    {
+        Q_UNUSED( traversal );
+        int64_t chunkPixels = buffSize / sizeof( Dst );
+        if ( chunkPixels <= 0 || chunk < 0 ) {
+            return 0;
+        }
+        int64_t first = chunk * chunkPixels;
+        int64_t count = std::min < int64_t > ( chunkPixels, nPixels() - first );
+        if ( count <= 0 ) {
+            return 0;
+        }
+        readRange( first, count, reinterpret_cast < Dst * > ( buff ) );
+        return count * sizeof( Dst );
+    }
+
+    virtual void
+    forEach( int64_t buffSize,
+             std::function < void (const char *, int64_t) > func,
+             char * buff,
+             Traversal traversal ) override
+    {
+        Q_UNUSED( traversal );
+        int64_t chunkPixels = std::max < int64_t > ( 1, buffSize / sizeof( Dst ) );
+
+        // the pixels always need converting, so we always need a buffer
+        std::vector < Dst > ownBuff;
+        if ( ! buff ) {
+            ownBuff.resize( chunkPixels );
+            buff = reinterpret_cast < char * > ( ownBuff.data() );
+        }
+        int64_t total = nPixels();
+        for ( int64_t first = 0 ; first < total ; first += chunkPixels ) {
+            int64_t count = std::min( chunkPixels, total - first );
+            readRange( first, count, reinterpret_cast < Dst * > ( buff ) );
+            func( buff, count );
+        }
+    } // forEach
+
+private:
+
+    /// number of pixels converted at once by the pointwise forEach()
+    static constexpr int64_t BlockPixels = 4096;
+
+    /// address of the raw pixel at the given offset (in pixels)
+    const char *
+    rawPtr( int64_t off ) const
+    {
+        return m_file-> pixels() + off * m_rawSize;
+    }
+
+    /// total number of pixels in the view
+    int64_t
+    nPixels() const
+    {
+        return m_layout.size();
+    }
+
+    /// convert pixels [first, first+count) of the view (in sequential order) into dst,
+    /// one run at a time
+    void
+    readRange( int64_t first, int64_t count, Dst * dst )
+    {
+        const FitsConvert::Scaling & scaling = m_file-> scaling();
+        Carta::Lib::NdArray::forEachRun(
+            m_layout, first, count,
+            [&] ( int64_t off, int64_t n, int64_t stride ) {
+                m_kernel( rawPtr( off ), n, stride * m_rawSize, dst, scaling );
+                dst += n;
+            }
+            );
+    }
+
+    /// the mapped file (shared with the image and other views)
+    FitsFile::SharedPtr m_file;
+
+    /// dimensions and strides of the image this view was made from
+    VI m_imageDims;
+    VI64 m_axisStrides;
+
+    /// the slice of the image we represent
+    SliceND::ApplyResult m_appliedSlice;
+
+    /// dimensions of the view, and strides (in pixels) of the view's axes in the file
+    VI m_viewDims;
+    VI64 m_viewStrides;
+
+    /// offset (in pixels) of the first pixel of the view in the file
+    int64_t m_offset = 0;
+
+    /// precomputed runs of the view
+    Carta::Lib::NdArray::StridedLayout m_layout;
+
+    /// conversion kernel and size of the raw pixels
+    typename FitsConvert::Kernel < Dst >::Type m_kernel = nullptr;
+    int m_rawSize = 0;
+
+    /// traversal state
+    VI m_currPos;
+    Dst m_getBuff;
+    int64_t m_readPos = 0;
+};
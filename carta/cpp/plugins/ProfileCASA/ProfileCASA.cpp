@@ -334,7 +334,9 @@ bool ProfileCASA::handleHook(BaseHook & hookData){
             return false;
         }
 
-        casa::ImageInterface < casa::Float > * casaImage = cartaII2casaII_float( imagePtr );
+        // use the spectral-major copy of the cube if it's ready, the profile is then
+        // read from a few tiles instead of one tile per channel
+        casa::ImageInterface < casa::Float > * casaImage = cartaII2spectralCasaII_float( imagePtr );
         if( ! casaImage) {
             qWarning() << "Profile plugin: not an image created by casaimageloader...";
             return false;
@@ -105,7 +105,7 @@ RegionCASA::_loadRegion( const QString & fname, std::shared_ptr<Carta::Lib::Imag
     std::vector<std::shared_ptr<Carta::Lib::RegionInfo> > regionInfos;
 
     casa::String fileName( fname.toStdString().c_str() );
-    CCImageBase * base = dynamic_cast<CCImageBase*>( imagePtr.get() );
+    CCImageBase * base = cartaII2ccImageBase( imagePtr );
     if ( base ){
         Carta::Lib::Image::MetaDataInterface::SharedPtr metaPtr = base->metaData();
         CCMetaDataInterface* metaData = dynamic_cast<CCMetaDataInterface*>(metaPtr.get());
@@ -43,8 +43,8 @@ FitsHeaderExtractor::getHeader()
 
     QStringList result;
 
-    // was this created using CasaImageLoader plugin?
-    CCImageBase * base = dynamic_cast < CCImageBase * > ( & * m_cartaImage );
+    // was this created using CasaImageLoader plugin (or can it open it)?
+    CCImageBase * base = cartaII2ccImageBase( m_cartaImage );
     if ( base ) {
         casa::LatticeBase * latticeBase = base-> getCasaImage();
         if ( latticeBase ) {
@@ -3,6 +3,7 @@
 #include "CartaLib/Hooks/GetImageRenderService.h"
 #include "CartaLib/Hooks/Initialize.h"
 #include <QDebug>
+#include <QJsonObject>
 #include <memory>
 #include <algorithm>
 #include <vector>
@@ -14,7 +15,6 @@ HpcImageRenderServicePlugin::HpcImageRenderServicePlugin( QObject * parent ) :
 bool
 HpcImageRenderServicePlugin::handleHook( BaseHook & hookData )
 {
-    qDebug() << "HpcImageRenderServicePlugin is handling hook #" << hookData.hookId();
     if ( hookData.is < Carta::Lib::Hooks::Initialize > () ) {
         // insert initialization stuff here that depends on core running
         return true;
@@ -39,6 +39,12 @@ HpcImageRenderServicePlugin::handleHook( BaseHook & hookData )
 std::vector < HookId >
 HpcImageRenderServicePlugin::getInitialHookList()
 {
+    // unless enabled, the core renders the images itself
+    if ( ! m_enabled ) {
+        return {
+                   Carta::Lib::Hooks::Initialize::staticId
+        };
+    }
     return {
                Carta::Lib::Hooks::Initialize::staticId,
                Carta::Lib::Hooks::GetImageRenderService::staticId
@@ -48,10 +54,13 @@ HpcImageRenderServicePlugin::getInitialHookList()
 void
 HpcImageRenderServicePlugin::initialize( const IPlugin::InitInfo & initInfo )
 {
-    // this is a chance to see what needs/needs not be enabled based on initInfo
-
-    // for example, based on initInfo.json, you may are may not decide to handle
-    // some hooks
-    Q_UNUSED( initInfo );
+    // e.g. "hpcImgRender": { "enabled": true, "threads": 8, "tileSize": 256,
+    //                        "tileCacheMB": 256 }
+    m_enabled = initInfo.json.value( "enabled" ).toBool( false );
+    MyImageRenderService::Config & cfg = MyImageRenderService::config();
+    cfg.threads = initInfo.json.value( "threads" ).toInt( cfg.threads );
+    cfg.tileSize = initInfo.json.value( "tileSize" ).toInt( cfg.tileSize );
+    cfg.tileCacheBytes = int64_t( initInfo.json.value( "tileCacheMB" ).toDouble(
+                                      cfg.tileCacheBytes / ( 1024 * 1024 ) ) ) * 1024 * 1024;
 }
 
@@ -1,4 +1,5 @@
-/// This plugin can read image formats that Qt supports.
+/// This plugin provides a tiled, multi-threaded image render service, see
+/// MyImageRenderService. It is only offered to the core if enabled in the configuration.
 
 #pragma once
 
@@ -24,4 +25,9 @@ public:
 
     virtual void
     initialize( const InitInfo & initInfo ) override;
+
+private:
+
+    /// whether to offer the render service to the core
+    bool m_enabled = false;
 };
@@ -1,81 +1,185 @@
 #include "MyImageRenderService.h"
 #include "CartaLib/IImage.h"
 #include "CartaLib/LinearMap.h"
+#include "CartaLib/Slice.h"
 #include <QColor>
 #include <QPainter>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <thread>
 
 namespace NdArray = Carta::Lib::NdArray;
 
 static constexpr QImage::Format OptimalQImageFormatWithNoBugs = QImage::Format_ARGB32;
 
+// number of pixels we request from the views at a time
+static constexpr int64_t BulkBlockSize = 4096;
 
-/// internal algorithm for converting an instance of image interface to qimage
-/// using the pixel pipeline
-///
-/// \tparam Pipeline
-/// \param m_rawView
-/// \param pipe
-/// \param m_qImage
-template < class Pipeline >
-static void
-iView2qImage( NdArray::RawViewInterface * rawView, Pipeline & pipe, QImage & qImage )
-{
-    qDebug() << "rv2qi2" << rawView-> dims();
-    typedef double Scalar;
-    QSize size( rawView->dims()[0], rawView->dims()[1] );
+constexpr int MyImageRenderService::UncachedPipelineSize;
 
-    QImage::Format desiredFormat = OptimalQImageFormatWithNoBugs;
+MyImageRenderService::Config &
+MyImageRenderService::config()
+{
+    static Config config;
+    return config;
+}
 
-    // QImage::Format desiredFormat = QImage::Format_ARGB32;
-    if ( qImage.format() != desiredFormat ||
-         qImage.size() != size ) {
-        qImage = QImage( size, desiredFormat );
-    }
-    auto bytesPerLine = qImage.bytesPerLine();
-    CARTA_ASSERT( bytesPerLine == size.width() * 4 );
-    Q_UNUSED( bytesPerLine );
-
-    // start with a pointer to the beginning of last row (we are constructing image
-    // bottom-up)
-    QRgb * outPtr = reinterpret_cast < QRgb * > (
-        qImage.bits() + size.width() * ( size.height() - 1 ) * 4 );
-
-    // make a double view
-    NdArray::TypedView < Scalar > typedView( rawView, false );
-
-    /// @todo for more efficiency, instead of forEach() we should switch to one of the
-    /// higher performance APIs and maybe even sprinkle it with some openmp/cilk magic :)
-    int64_t counter = 0;
-    QRgb nanColor = qRgb( 255, 0, 0 );
-    auto lambda = [&] ( const Scalar & ival )
+template < typename Scalar, class Pipeline >
+void
+MyImageRenderService::convertTile( Tile & tile, Pipeline & pipe, QRgb nanColor )
+{
+    const int64_t viewWidth = m_inputView-> dims()[0];
+    const int step = tile.step;
+    const int cols = tile.cols();
+    const int rows = tile.rows();
+    const NdArray::BitMask * mask = m_inputMask.get();
+
+    // each tile gets its own view, so that the threads don't share any cursors
+    SliceND slice;
+    slice.start( tile.x1 ).end( tile.x2 ).step( step )
+        .next().start( tile.y1 ).end( tile.y1 + ( rows - 1 ) * step + 1 ).step( step );
+    std::unique_ptr < NdArray::RawViewInterface > view( m_inputView-> getView( slice ) );
+    NdArray::TypedView < Scalar > typedView( view.get(), false );
+
+    // we are building the tile bottom-up, row r of the tile is scanline rows-1-r
+    tile.image = QImage( QSize( cols, rows ), OptimalQImageFormatWithNoBugs );
+    QRgb * outPtr = reinterpret_cast < QRgb * > ( tile.image.scanLine( rows - 1 ) );
+    int row = 0;
+    int col = 0;
+
+    auto lambda = [&] ( const Scalar * vals, int64_t count )
     {
-        if ( Q_LIKELY( ! std::isnan( ival ) ) ) {
-            pipe.convertq( ival, * outPtr );
-            if( drand48() < 0.1) {
-                * outPtr = 0;
+        while ( count > 0 ) {
+            // the blocks are not aligned with the rows
+            int64_t n = std::min < int64_t > ( count, cols - col );
+            pipe.convertq( vals, n, outPtr, nanColor );
+            if ( mask ) {
+                int64_t maskIndex = ( tile.y1 + int64_t( row ) * step ) * viewWidth
+                                    + tile.x1 + int64_t( col ) * step;
+                if ( step == 1 ) {
+                    mask-> forEachRun( maskIndex, n,
+                                       [&] ( int64_t first, int64_t runLength, bool valid ) {
+                        if ( ! valid ) {
+                            std::fill_n( outPtr + ( first - maskIndex ), runLength, nanColor );
+                        }
+                    } );
+                }
+                else {
+                    for ( int64_t i = 0 ; i < n ; ++i ) {
+                        if ( ! mask-> isValid( maskIndex + i * step ) ) {
+                            outPtr[i] = nanColor;
+                        }
+                    }
+                }
+            }
+            outPtr += n;
+            vals += n;
+            count -= n;
+            col += n;
+            if ( col == cols ) {
+                col = 0;
+                row++;
+                if ( row < rows ) {
+                    outPtr = reinterpret_cast < QRgb * > ( tile.image.scanLine( rows - 1 - row ) );
+                }
             }
         }
-        else {
-            * outPtr = nanColor;
-        }
-        outPtr++;
-        counter++;
+    };
+    typedView.forEach( BulkBlockSize, lambda );
+    CARTA_ASSERT( row == rows && col == 0 );
+} // convertTile
 
-        // build the image bottom-up
-        if ( counter % size.width() == 0 ) {
-            outPtr -= size.width() * 2;
+template < class Pipeline >
+void
+MyImageRenderService::convertTiles( const std::vector < Tile * > & tiles, Pipeline & pipe,
+                                    QRgb nanColor )
+{
+    if ( tiles.empty() ) {
+        return;
+    }
+    int nThreads = config().threads;
+    if ( nThreads <= 0 ) {
+        nThreads = std::thread::hardware_concurrency();
+    }
+    nThreads = Carta::Lib::clamp < int > ( nThreads, 1, tiles.size() );
+
+    // the tiles are converted in the pixel type of the view if the pipeline has a kernel
+    // for it, otherwise as doubles
+    bool asFloat = m_inputView-> pixelType() == Carta::Lib::Image::PixelType::Real32;
+
+    // the threads pick up the tiles one at a time, so a slow tile does not hold up
+    // the others
+    std::atomic < size_t > nextTile( 0 );
+    auto worker = [&] () {
+        for ( size_t i = nextTile++ ; i < tiles.size() ; i = nextTile++ ) {
+            if ( asFloat ) {
+                convertTile < float > ( * tiles[i], pipe, nanColor );
+            }
+            else {
+                convertTile < double > ( * tiles[i], pipe, nanColor );
+            }
         }
     };
-    typedView.forEach( lambda );
-} // rawView2QImage
+    std::vector < std::thread > threads;
+    for ( int i = 1 ; i < nThreads ; ++i ) {
+        threads.emplace_back( worker );
+    }
+    worker();
+    for ( auto & thread : threads ) {
+        thread.join();
+    }
+} // convertTiles
+
+QString
+MyImageRenderService::makeUpKey()
+{
+    return "#" + QString::number( m_madeUpKeys++ );
+}
 
 void
 MyImageRenderService::setInputView( NdArray::RawViewInterface::SharedPtr view, QString cacheId )
 {
     m_inputView = view;
-    qDebug() << "xyz setInputView" << m_inputView.get() << this;
-    m_inputViewCacheId = cacheId;
-    m_frameImage = QImage(); // indicate a need to recompute
+    m_inputMask = nullptr;
+    m_viewKey = cacheId.isEmpty() ? makeUpKey() : cacheId;
+}
+
+void
+MyImageRenderService::setInputMask( NdArray::BitMask::SharedPtr mask )
+{
+    m_inputMask = mask;
+
+    // the cache id of the view does not tell us anything about the mask
+    if ( mask ) {
+        m_viewKey = makeUpKey();
+    }
+}
+
+void
+MyImageRenderService::setNanColor( QColor color )
+{
+    m_nanColor = color;
+}
+
+QColor
+MyImageRenderService::getNanColor() const
+{
+    QRgb nanColor = m_nanColor.rgb();
+    if ( m_pixelPipelineRaw && m_defaultNan ) {
+        double clipMin, clipMax;
+        m_pixelPipelineRaw-> getClips( clipMin, clipMax );
+        m_pixelPipelineRaw-> convertq( clipMin, nanColor );
+    }
+    return QColor( nanColor );
+}
+
+void
+MyImageRenderService::setDefaultNan( bool useDefaultNan )
+{
+    m_defaultNan = useDefaultNan;
 }
 
 void
@@ -122,10 +226,7 @@ MyImageRenderService::setPixelPipeline( IClippedPixelPipeline::SharedPtr pixelPi
                            QString cacheId = QString() )
 {
     m_pixelPipelineRaw = pixelPipeline;
-    m_pixelPipelineCacheId = cacheId;
-
-    // invalidate frame cache
-    m_frameImage = QImage();
+    m_pipelineKey = cacheId.isEmpty() ? makeUpKey() : cacheId;
 
     // invalidate pixel pipeline cache
     m_cachedPP = nullptr;
@@ -137,9 +238,6 @@ MyImageRenderService::setPixelPipelineCacheSettings( const PixelPipelineCacheSet
 {
     m_pixelPipelineCacheSettings = params;
 
-    // invalidate frame cache
-    m_frameImage = QImage();
-
     // invalidate pixel pipeline cache
     m_cachedPP = nullptr;
     m_cachedPPinterp = nullptr;
@@ -174,6 +272,10 @@ MyImageRenderService::MyImageRenderService( QObject * parent )
     connect( & m_renderTimer, & QTimer::timeout, this, & Me::internalRenderSlot );
 
     m_frameCache.setMaxCost( 1 * 1024 * 1024 * 1024 ); // 1 gig
+    m_tileCache.setMaxCost( std::min < int64_t > ( config().tileCacheBytes, INT_MAX ) );
+
+    m_viewKey = makeUpKey();
+    m_pipelineKey = makeUpKey();
 }
 
 MyImageRenderService::~MyImageRenderService()
@@ -216,92 +318,171 @@ MyImageRenderService::screen2img( const QPointF & p )
 void
 MyImageRenderService::internalRenderSlot()
 {
-    static int renderCount = 0;
-    qDebug() << "Image render" << renderCount++ << "xyz";
+    if ( ! m_inputView ) {
+        qCritical() << "input view not set";
+        return;
+    }
+
+    if ( ! m_pixelPipelineRaw ) {
+        qCritical() << "pixel pipeline not set";
+        return;
+    }
 
     // raw double to base64 converter
     auto d2hex = [] (double x) -> QString {
         return QByteArray( (char *) ( & x ), sizeof( x ) ).toBase64();
     };
 
+    double clipMin, clipMax;
+    m_pixelPipelineRaw-> getClips( clipMin, clipMax );
+
+    QRgb nanColor = m_nanColor.rgb();
+    if ( m_defaultNan ) {
+        m_pixelPipelineRaw-> convertq( clipMin, nanColor );
+    }
+
+    QString pipelineId = m_pipelineKey;
+    if ( m_pixelPipelineCacheSettings.enabled ) {
+        pipelineId += QString( "/1/%1/%2" )
+                          .arg( int (m_pixelPipelineCacheSettings.interpolated) )
+                          .arg( m_pixelPipelineCacheSettings.size );
+    }
+    else {
+        pipelineId += "/0";
+    }
+    pipelineId += "/" + QString::number( nanColor );
+
     // cache id will be concatenation of:
     // view id
-    // pipeline id
+    // pipeline id (with the cache settings and nan color)
     // output size
     // pan
     // zoom
-    // pixel pipeline cache settings
     // Floats are binary-encoded (base64)
     QString cacheId = QString( "%1/%2/%3x%4/%5,%6/%7" )
-                          .arg( m_inputViewCacheId )
-                          .arg( m_pixelPipelineCacheId )
+                          .arg( m_viewKey )
+                          .arg( pipelineId )
                           .arg( m_outputSize.width() )
                           .arg( m_outputSize.height() )
                           .arg( d2hex( m_pan.x() ) )
                           .arg( d2hex( m_pan.y() ) )
                           .arg( d2hex( m_zoom ) );
 
-    if ( m_pixelPipelineCacheSettings.enabled ) {
-        cacheId += QString( "/1/%1/%2" )
-                       .arg( int (m_pixelPipelineCacheSettings.interpolated) )
-                       .arg( m_pixelPipelineCacheSettings.size );
-    }
-    else {
-        cacheId += "/0";
-    }
-
-//    qDebug() << "internalRenderSlot... cache size: "
-//             << m_frameCache.totalCost() * 100.0 / m_frameCache.maxCost() << "% "
-//             << m_frameCache.size() << "entries";
-//    qDebug() << "id:" << cacheId;
-    struct Scope {
-        ~Scope() { qDebug() << "internalRenderSlot done"; } }
-    debugScopeGuard;
-
     auto cachedImage = m_frameCache.object( cacheId );
     if ( cachedImage ) {
-        qDebug() << "frame cache hit";
         emit done( * cachedImage, m_lastSubmittedJobId );
         return;
     }
-    qDebug() << "frame cache miss";
 
-    if ( ! m_inputView ) {
-        qCritical() << "input view not set";
-        qDebug() << "xyz internal renderslot" << m_inputView.get() << this;
-        return;
+    // the tiles are converted from multiple threads, so they need a cached pipeline
+    // (the raw one may use a colormap that is not thread safe), if caching is disabled
+    // we use a large enough cache instead
+    if ( ! m_cachedPPinterp && pixelPipelineCacheSettings().enabled &&
+         pixelPipelineCacheSettings().interpolated ) {
+        m_cachedPPinterp.reset( new Carta::Lib::PixelPipeline::CachedPipeline < true > () );
+        m_cachedPPinterp-> cache( * m_pixelPipelineRaw,
+                                  pixelPipelineCacheSettings().size, clipMin, clipMax );
     }
-
-    if ( ! m_pixelPipelineRaw ) {
-        qCritical() << "pixel pipeline not set";
-        return;
+    if ( ! m_cachedPP && ! m_cachedPPinterp ) {
+        int size = pixelPipelineCacheSettings().enabled ? pixelPipelineCacheSettings().size
+                   : UncachedPipelineSize;
+        m_cachedPP.reset( new Carta::Lib::PixelPipeline::CachedPipeline < false > () );
+        m_cachedPP-> cache( * m_pixelPipelineRaw, size, clipMin, clipMax );
     }
 
-    double clipMin, clipMax;
-    m_pixelPipelineRaw-> getClips( clipMin, clipMax );
+    // when zoomed out, several data pixels fall onto one screen pixel, so we only sample
+    // every step-th of them
+    const int viewWidth = m_inputView-> dims()[0];
+    const int viewHeight = m_inputView-> dims()[1];
+    const int step = std::max( 1, int ( std::floor( 1.0 / m_zoom ) ) );
+    const int tileSize = std::max( 16, config().tileSize );
+    const int tileSpan = tileSize * step;
+
+    // the visible pixels, pixel i covers [i-1/2, i+1/2)
+    QPointF p1 = screen2img( QPointF( 0, 0 ) );
+    QPointF p2 = screen2img( QPointF( m_outputSize.width(), m_outputSize.height() ) );
+    auto first = [] ( double v, int size ) {
+        return int ( Carta::Lib::clamp < double > ( std::floor( v + 0.5 ), 0, size ) );
+    };
+    auto last = [] ( double v, int size ) {
+        return int ( Carta::Lib::clamp < double > ( std::floor( v + 0.5 ) + 1, 0, size ) );
+    };
+    int x1 = first( std::min( p1.x(), p2.x() ), viewWidth );
+    int x2 = last( std::max( p1.x(), p2.x() ), viewWidth );
+    int y1 = first( std::min( p1.y(), p2.y() ), viewHeight );
+    int y2 = last( std::max( p1.y(), p2.y() ), viewHeight );
+
+    // the tiles covering them
+    int tx1 = x1 / tileSpan;
+    int ty1 = y1 / tileSpan;
+    int tx2 = x1 < x2 ? ( x2 + tileSpan - 1 ) / tileSpan : tx1;
+    int ty2 = y1 < y2 ? ( y2 + tileSpan - 1 ) / tileSpan : ty1;
+    QString tileIdPrefix = QString( "%1/%2/%3/%4/" )
+                               .arg( m_viewKey )
+                               .arg( pipelineId )
+                               .arg( step )
+                               .arg( tileSize );
+    auto tileId = [&] ( const Tile & tile ) {
+        return tileIdPrefix + QString( "%1,%2" ).arg( tile.tx ).arg( tile.ty );
+    };
 
-    // render the frame if needed
-    if ( m_frameImage.isNull() ) {
-        if ( pixelPipelineCacheSettings().enabled ) {
-            if ( pixelPipelineCacheSettings().interpolated ) {
-                if ( ! m_cachedPPinterp ) {
-                    m_cachedPPinterp.reset( new Carta::Lib::PixelPipeline::CachedPipeline < true > () );
-                    m_cachedPPinterp-> cache( * m_pixelPipelineRaw,
-                                              pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPPinterp, m_frameImage );
+    // take what we can from the tile cache, and convert the rest
+    std::vector < Tile > tiles;
+    tiles.reserve( ( tx2 - tx1 ) * ( ty2 - ty1 ) );
+    std::vector < Tile * > missing;
+    for ( int ty = ty1 ; ty < ty2 ; ++ty ) {
+        for ( int tx = tx1 ; tx < tx2 ; ++tx ) {
+            Tile tile;
+            tile.tx = tx;
+            tile.ty = ty;
+            tile.x1 = tx * tileSpan;
+            tile.y1 = ty * tileSpan;
+            tile.x2 = std::min( viewWidth, tile.x1 + tileSpan );
+            tile.y2 = std::min( viewHeight, tile.y1 + tileSpan );
+            tile.step = step;
+            tiles.push_back( tile );
+            QImage * cachedTile = m_tileCache.object( tileId( tile ) );
+            if ( cachedTile ) {
+                tiles.back().image = * cachedTile;
             }
             else {
-                if ( ! m_cachedPP ) {
-                    m_cachedPP.reset( new Carta::Lib::PixelPipeline::CachedPipeline < false > () );
-                    m_cachedPP-> cache( * m_pixelPipelineRaw,
-                                        pixelPipelineCacheSettings().size, clipMin, clipMax );
-                }
-                ::iView2qImage( m_inputView.get(), * m_cachedPP, m_frameImage );
+                missing.push_back( & tiles.back() );
             }
         }
-        else {
-            ::iView2qImage( m_inputView.get(), * m_pixelPipelineRaw, m_frameImage );
+    }
+    if ( m_cachedPPinterp ) {
+        convertTiles( missing, * m_cachedPPinterp, nanColor );
+    }
+    else {
+        convertTiles( missing, * m_cachedPP, nanColor );
+    }
+    for ( Tile * tile : missing ) {
+        m_tileCache.insert( tileId( * tile ), new QImage( tile-> image ),
+                            tile-> image.byteCount() );
+    }
+
+    // put the tiles together, the frame is built bottom-up, just like the tiles
+    int frameCols = 0, frameRows = 0;
+    for ( const Tile & tile : tiles ) {
+        if ( tile.ty == ty1 ) {
+            frameCols += tile.cols();
+        }
+        if ( tile.tx == tx1 ) {
+            frameRows += tile.rows();
+        }
+    }
+    QImage frameImage;
+    if ( frameCols > 0 && frameRows > 0 ) {
+        frameImage = QImage( QSize( frameCols, frameRows ), OptimalQImageFormatWithNoBugs );
+        for ( const Tile & tile : tiles ) {
+            int col = ( tile.tx - tx1 ) * tileSize;
+            int bottomRow = ( tile.ty - ty1 ) * tileSize;
+            int rows = tile.rows();
+            for ( int r = 0 ; r < rows ; ++r ) {
+                std::memcpy( frameImage.scanLine( frameRows - 1 - bottomRow - r ) + col * 4,
+                             tile.image.scanLine( rows - 1 - r ),
+                             tile.cols() * 4 );
+            }
         }
     }
 
@@ -311,29 +492,17 @@ MyImageRenderService::internalRenderSlot()
     img.fill( QColor( 50, 50, 50 ) );
     QPainter p( & img );
 
-    // draw the frame image to satisfy zoom/pan
-//    QPointF p1 = img2screen( QPointF( -0.5, -0.5 ) );
-//    QPointF p2 = img2screen( QPointF( m_frameImage.width()-0.5, m_frameImage.height()-0.5));
-
-    int imageHeight = m_frameImage.height();
-    QPointF p1 = img2screen( QPointF( - 0.5, imageHeight - 0.5 ) );
-    QPointF p2 = img2screen( QPointF( m_frameImage.width() - 0.5, - 0.5 ) );
+    // draw the frame image to satisfy zoom/pan, each of its pixels covers
+    // step x step data pixels, starting at the bottom left corner of the first tile
+    double left = tx1 * tileSpan - 0.5;
+    double bottom = ty1 * tileSpan - 0.5;
+    p1 = img2screen( QPointF( left, bottom + frameRows * step ) );
+    p2 = img2screen( QPointF( left + frameCols * step, bottom ) );
 
     QRectF rectf( p1, p2 );
     p.setRenderHint( QPainter::SmoothPixmapTransform, false );
-
-//    rectf = rectf.normalized();
-    p.drawImage( rectf, m_frameImage );
-
-//    qDebug() << "m_frameImage" << m_frameImage.size();
-//    qDebug() << "m_frameImage" << zoom() << rectf.width() / m_frameImage.width()
-//             << rectf.height() / m_frameImage.height();
-
-    // debugging rectangle
-    if ( 0 ) {
-        p.setPen( QPen( QColor( "yellow" ), 3 ) );
-        p.setBrush( Qt::NoBrush );
-        p.drawRect( rectf );
+    if ( ! frameImage.isNull() ) {
+        p.drawImage( rectf, frameImage );
     }
 
     // more debugging - draw pixel grid
@@ -359,16 +528,10 @@ MyImageRenderService::internalRenderSlot()
             p.drawLine( QPointF( 0, pt.y() ), QPointF( outputSize().width(), pt.y() ) );
         }
     }
+    p.end();
 
     // report result
-    emit done( QImage( img ), m_lastSubmittedJobId );
-
-    // debuggin: put a yellow stamp on the image, so that next time it's recalled
-    // it'll have 'cached' stamped on it
-    if ( CARTA_RUNTIME_CHECKS ) {
-        p.setPen( QColor( "yellow" ) );
-        p.drawText( img.rect(), Qt::AlignRight | Qt::AlignBottom, "Cached" );
-    }
+    emit done( img, m_lastSubmittedJobId );
 
     // insert this image into frame cache
     m_frameCache.insert( cacheId, new QImage( img ), img.byteCount() );
@@ -1,3 +1,17 @@
+/**
+ * High throughput implementation of the image render service.
+ *
+ * The frame is split into square tiles, which are converted to colors by a pool of
+ * threads, through the batch (vectorized) lookup of a cached pixel pipeline. The
+ * converted tiles are kept in a bounded cache, so pans, zooms within the same sampling
+ * step and switching between frames only convert the tiles that were not seen before.
+ * When zoomed out, only every n-th pixel of the view is sampled, so that a tile never
+ * has more pixels than the screen needs.
+ *
+ * It is provided to the core via the GetImageRenderService hook, if enabled in the
+ * configuration of the plugin, see HpcImageRenderServicePlugin::initialize().
+ **/
+
 #pragma once
 
 #include "CartaLib/IImageRenderService.h"
@@ -5,7 +19,7 @@
 
 #include <QCache>
 #include <QTimer>
-
+#include <vector>
 
 class MyImageRenderService : public Carta::Lib::IImageRenderService
 {
@@ -17,6 +31,22 @@ public:
     typedef Carta::Lib::IImageRenderService::PixelPipelineCacheSettings PixelPipelineCacheSettings;
     typedef Carta::Lib::PixelPipeline::IClippedPixelPipeline IClippedPixelPipeline;
 
+    /// settings shared by all instances, set up from the plugin configuration
+    struct Config {
+        /// number of threads converting the tiles, 0 for one per core
+        int threads = 0;
+
+        /// size of the tiles, in sampled pixels
+        int tileSize = 256;
+
+        /// upper limit for the memory used by the cached tiles of each instance
+        int64_t tileCacheBytes = int64_t( 256 ) * 1024 * 1024;
+    };
+
+    /// the settings
+    static Config &
+    config();
+
     /// constructor
     explicit
     MyImageRenderService( QObject * parent = 0 );
@@ -57,6 +87,23 @@ public:
     virtual QSize
     outputSize() const override;
 
+    /// set the mask for the current input view, masked pixels are rendered with the
+    /// nan color
+    virtual void
+    setInputMask( Carta::Lib::NdArray::BitMask::SharedPtr mask ) override;
+
+    /// set the color to use for nan values, unless the default nan color is used
+    virtual void
+    setNanColor( QColor color ) override;
+
+    /// return the color that will be used to draw nan values
+    virtual QColor
+    getNanColor() const override;
+
+    /// set whether or not to use the default nan color (bottom of the color map)
+    virtual void
+    setDefaultNan( bool useDefaultNan ) override;
+
     /// set coordinates of the data pixel to be centered in the generated
     /// image, in zero-based image coordinates, e.g. (0,0) is bottom left corner of pixel
     /// (0,0), while (1,1) is it's right-top corner, and (1/2,1/2) is it's center
@@ -132,10 +179,44 @@ protected slots:
 
 private:
 
+    /// a tile of the frame, in sampled pixels
+    struct Tile {
+        /// position of the tile in the grid of tiles
+        int tx, ty;
+
+        /// pixels of the view covered by the tile: [x1,x2) x [y1,y2), of which every
+        /// step-th pixel in both directions is sampled
+        int x1, y1, x2, y2, step;
+
+        int
+        cols() const { return ( x2 - x1 + step - 1 ) / step; }
+
+        int
+        rows() const { return ( y2 - y1 + step - 1 ) / step; }
+
+        /// the converted tile, built bottom-up like the frame
+        QImage image;
+    };
+
+    /// convert the tiles from the input view, using all the threads
+    /// \note the pipeline is used from multiple threads at once, which is fine for the
+    /// cached pipelines
+    template < class Pipeline >
+    void
+    convertTiles( const std::vector < Tile * > & tiles, Pipeline & pipe, QRgb nanColor );
+
+    /// convert one tile, reading the view as Scalar
+    template < typename Scalar, class Pipeline >
+    void
+    convertTile( Tile & tile, Pipeline & pipe, QRgb nanColor );
+
+    /// make up a key for an input without a cache id
+    QString
+    makeUpKey();
+
     // the following are rendering parameters
     Carta::Lib::NdArray::RawViewInterface::SharedPtr m_inputView = nullptr;
-    QString m_inputViewCacheId;
-    QString m_pixelPipelineCacheId;
+    Carta::Lib::NdArray::BitMask::SharedPtr m_inputMask = nullptr;
     QSize m_outputSize = QSize( 10, 10 );
 
     /// instance of the pixel pipeline (very likely slow)
@@ -152,9 +233,25 @@ private:
     Carta::Lib::PixelPipeline::CachedPipeline < false >::UniquePtr m_cachedPP = nullptr;
     PixelPipelineCacheSettings m_pixelPipelineCacheSettings;
 
-    /// here we store the whole frame rendered, it is essentially a cache to make
-    /// pan/zoom to work faster
-    QImage m_frameImage;
+    /// the pipeline is tabulated with this many entries if caching is disabled, so that
+    /// the tiles can still be converted in parallel
+    static constexpr int UncachedPipelineSize = 65536;
+
+    /// whether or not to use the default nan color (bottom of color map)
+    bool m_defaultNan = true;
+
+    /// user-settable color for nan values when the default nan color is not used
+    QColor m_nanColor = QColor( 255, 0, 0 );
+
+    /// converted tiles, by input view, pipeline, sampling step and position
+    QCache < QString, QImage > m_tileCache;
+
+    /// keys of the input view (with its mask) and of the pixel pipeline in the caches,
+    /// made up if the caller did not supply a cache id
+    QString m_viewKey, m_pipelineKey;
+
+    /// number of keys made up so far
+    int64_t m_madeUpKeys = 0;
 
     /// cache for individual frames (to make movie playing little bit faster)
     QCache < QString, QImage > m_frameCache;
@@ -16,6 +16,7 @@ SUBDIRS += RegionDs9
 SUBDIRS += ProfileCASA
 
 SUBDIRS += qimage
+SUBDIRS += FitsImageLoader
 
 SUBDIRS += python273
 
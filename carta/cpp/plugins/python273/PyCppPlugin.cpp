@@ -6,8 +6,13 @@
 #include <QDebug>
 #include <dlfcn.h>
 #include <csignal>
+#include <mutex>
 
 static struct sigaction oldSigIntAction;
+
+/// the interpreter can only run one thing at a time, but the colormaps are also used
+/// by the render threads
+static std::mutex pythonMutex;
 typedef Carta::Lib::Hooks::LoadPlugin LoadPlugin;
 
 static void mySigintHandler( int sig)
@@ -123,6 +128,7 @@ public:
     }
 
     virtual ~ColormapHelper() {
+        std::lock_guard<std::mutex> lock( pythonMutex);
         Py_XDECREF( m_pyObj);
     }
 
@@ -131,10 +137,12 @@ public:
 
     virtual QString name() override
     {
+        std::lock_guard<std::mutex> lock( pythonMutex);
         return pb_colormapScalarGetName( m_pyObj).c_str();
     }
     virtual void convert(norm_double val, NormRgb & nrgb) override
     {
+        std::lock_guard<std::mutex> lock( pythonMutex);
         pb_colormapScalarConvert( m_pyObj, val, & nrgb[0]);
     }
 };
@@ -160,6 +168,7 @@ bool PyCppPlug::handleHook(BaseHook & hookData)
         p.drawText( hook.paramsPtr->imgPtr->rect(), Qt::AlignLeft | Qt::AlignTop, txt);
 
         QImage & img = * (hook.paramsPtr->imgPtr);
+        std::lock_guard<std::mutex> lock( pythonMutex);
         pb_callPreRenderHook( m_pyModId, img.width(), img.height(),
                               img.bytesPerLine(), img.bits());
 
@@ -1,6 +1,8 @@
 #include "QImagePlugin.h"
 #include "CartaLib/Hooks/LoadAstroImage.h"
 #include "CartaLib/Hooks/Initialize.h"
+#include "CartaLib/StridedIterator.h"
+#include "CartaLib/PermutedImage.h"
 #include <QDebug>
 #include <memory>
 #include <algorithm>
@@ -9,6 +11,8 @@
 typedef Carta::Lib::HtmlString HtmlString;
 typedef Carta::Lib::AxisInfo AxisInfo;
 
+typedef Carta::Lib::NdArray::StridedLayout StridedLayout;
+
 /// shortcut for LoadAstroImage
 typedef Carta::Lib::Hooks::LoadAstroImage LoadAstroImage;
 typedef Carta::Lib::Hooks::Initialize Initialize;
@@ -24,9 +28,9 @@ public:
 
     QImageRawView() = delete;
 
-    // construct a view from raw gray data for the specified slice
+    // construct a view from gray data (already converted to floats) for the specified slice
     // the original data has dimesions 'dims'
-    QImageRawView( std::shared_ptr < std::vector < unsigned char > > data,
+    QImageRawView( std::shared_ptr < std::vector < float > > data,
                    const VI & dims,
                    const SliceND & sliceInfo )
     {
@@ -44,10 +48,13 @@ public:
         for ( auto & x : m_appliedSlice.dims() ) {
             m_viewDims.push_back( x.count );
         }
+
+        // precompute the strides for bulk access
+        m_layout = StridedLayout( m_appliedSlice, m_origDims );
     }
 
     // similar to the first constructor, but the view is for an applied slice
-    QImageRawView( std::shared_ptr < std::vector < unsigned char > > data,
+    QImageRawView( std::shared_ptr < std::vector < float > > data,
                    const VI & dims,
                    const SliceND::ApplyResult & applyResult )
     {
@@ -65,6 +72,9 @@ public:
         for ( auto & x : m_appliedSlice.dims() ) {
             m_viewDims.push_back( x.count );
         }
+
+        // precompute the strides for bulk access
+        m_layout = StridedLayout( m_appliedSlice, m_origDims );
     }
 
     virtual PixelType
@@ -82,29 +92,30 @@ public:
     virtual const char *
     get( const VI & pos ) override
     {
-        int x = pos[0];
-        int y = pos[1];
+        const std::vector < Slice1D::ApplyResult > & dims = m_appliedSlice.dims();
+        int x = dims[0].start + pos[0] * dims[0].step;
+        int y = dims[1].start + pos[1] * dims[1].step;
 
-        m_floatBuff = float (m_rawData[x + y * m_origDims[0]]) / float (255.0);
-        return reinterpret_cast < const char * > ( & m_floatBuff );
+        return reinterpret_cast < const char * > ( & m_rawData[x + y * m_origDims[0]] );
     }
 
     virtual void
     forEach( std::function < void (const char *) > func, Traversal traversal ) override
     {
-        if ( traversal != Carta::Lib::NdArray::RawViewInterface::Traversal::Sequential ) {
-            qFatal( "sorry, not implemented yet" );
-        }
+        // the data is in memory, so sequential order is also the optimal order
+        Q_UNUSED( traversal );
 
         const std::vector < Slice1D::ApplyResult > & dims = m_appliedSlice.dims();
+        m_currPosView.resize( 2 );
 
         int y = dims[1].start;
         for ( int yc = 0 ; yc < dims[1].count ; ++yc ) {
-            unsigned char * row = & m_rawData[m_origDims[0] * y];
+            const float * row = & m_rawData[m_origDims[0] * y];
+            m_currPosView[1] = yc;
             int x = dims[0].start;
             for ( int xc = 0 ; xc < dims[0].count ; ++xc ) {
-                float buff = float (row[x]) / float (255.0);
-                func( reinterpret_cast < const char * > ( & buff ) );
+                m_currPosView[0] = xc;
+                func( reinterpret_cast < const char * > ( & row[x] ) );
 
                 x += dims[0].step;
             }
@@ -115,7 +126,6 @@ public:
     virtual const VI &
     currentPos() override
     {
-        qFatal( "Not implemented yet" );
         return m_currPosView;
     }
 
@@ -132,30 +142,64 @@ public:
         return new QImageRawView( m_data, m_origDims, newAr );
     }
 
+    virtual Nullable < StridedSpan >
+    stridedSpan() override
+    {
+        // the whole image is in memory, so we can always describe it
+        const std::vector < Slice1D::ApplyResult > & dims = m_appliedSlice.dims();
+        StridedSpan span;
+        span.data = reinterpret_cast < const char * > (
+            & m_rawData[dims[0].start + dims[1].start * m_origDims[0]] );
+        int64_t pixelSize = sizeof( float );
+        span.strides = {
+            pixelSize * dims[0].step,
+            pixelSize * dims[1].step * m_origDims[0]
+        };
+        span.pixelType = PixelType::Real32;
+        return span;
+    }
+
+    virtual Carta::Lib::NdArray::RawViewInterface *
+    clone() override
+    {
+        // the pixel data is never modified, so we only need our own traversal state
+        return new QImageRawView( m_data, m_origDims, m_appliedSlice );
+    }
+
     virtual int64_t
     read( int64_t buffSize, char * buff, Traversal traversal ) override
     {
-        Q_UNUSED( buffSize );
-        Q_UNUSED( buff );
         Q_UNUSED( traversal );
-        qFatal( "not implemented" );
+        int64_t count = std::min < int64_t > ( buffSize / sizeof( float ), nPixels() - m_readPos );
+        if ( count <= 0 ) {
+            return 0;
+        }
+        readRange( m_readPos, count, reinterpret_cast < float * > ( buff ) );
+        m_readPos += count;
+        return count * sizeof( float );
     }
 
     virtual void
     seek( int64_t ind ) override
     {
-        Q_UNUSED( ind );
-        qFatal( "not implemented" );
+        m_readPos = Carta::Lib::clamp < int64_t > ( ind / sizeof( float ), 0, nPixels() );
     }
 
     virtual int64_t
     read( int64_t chunk, int64_t buffSize, char * buff, Traversal traversal ) override
     {
-        Q_UNUSED( chunk );
-        Q_UNUSED( buffSize );
-        Q_UNUSED( buff );
         Q_UNUSED( traversal );
-        qFatal( "not implemented" );
+        int64_t chunkPixels = buffSize / sizeof( float );
+        if ( chunkPixels <= 0 || chunk < 0 ) {
+            return 0;
+        }
+        int64_t first = chunk * chunkPixels;
+        int64_t count = std::min < int64_t > ( chunkPixels, nPixels() - first );
+        if ( count <= 0 ) {
+            return 0;
+        }
+        readRange( first, count, reinterpret_cast < float * > ( buff ) );
+        return count * sizeof( float );
     }
 
     virtual void
@@ -164,12 +208,18 @@ public:
              char * buff,
              Traversal traversal ) override
     {
-        Q_UNUSED( buffSize );
-        Q_UNUSED( func );
-        Q_UNUSED( buff );
+        // the data is in memory, so sequential order is also the optimal order
         Q_UNUSED( traversal );
-        qFatal( "not implemented" );
-    }
+        int64_t chunkPixels = std::max < int64_t > ( 1, buffSize / sizeof( float ) );
+
+        // without a buffer, full rows are handed out directly from our data
+        Carta::Lib::NdArray::forEachBlock(
+            m_rawData, m_layout, chunkPixels, reinterpret_cast < float * > ( buff ),
+            [&] ( const float * data, int64_t count ) {
+                func( reinterpret_cast < const char * > ( data ), count );
+            }
+            );
+    } // forEach
 
 private:
 
@@ -180,15 +230,34 @@ private:
     VI m_origDims;
 
     // we remember shared pointer to prevent data from disappearing
-    std::shared_ptr < std::vector < unsigned char > > m_data = nullptr;
+    std::shared_ptr < std::vector < float > > m_data = nullptr;
 
     // we remember raw data pointer for faster access
-    unsigned char * m_rawData = nullptr;
-    float m_floatBuff;
+    const float * m_rawData = nullptr;
     VI m_currPosView;
 
     // the current resolved slice for the data we have
     SliceND::ApplyResult m_appliedSlice;
+
+    // precomputed strides of the view into m_rawData
+    StridedLayout m_layout;
+
+    // position (in pixels) for the next stateful read()
+    int64_t m_readPos = 0;
+
+    // total number of pixels in the view
+    int64_t
+    nPixels() const
+    {
+        return int64_t( m_viewDims[0] ) * m_viewDims[1];
+    }
+
+    // copy pixels [first, first+count) of the view (in sequential order) into dst
+    void
+    readRange( int64_t first, int64_t count, float * dst )
+    {
+        Carta::Lib::NdArray::gather( m_rawData, m_layout, first, count, dst );
+    }
 };
 
 /// we need to implement our own coordinate formatter
@@ -438,9 +507,10 @@ public:
     }
 
     virtual std::shared_ptr<Carta::Lib::Image::ImageInterface>
-            getPermuted(const std::vector<int> & /*indices*/){
-            qFatal( "Not implemented");
-        }
+    getPermuted( const std::vector<int> & indices ) override
+    {
+        return Carta::Lib::Image::PermutedImage::permute( shared_from_this(), indices );
+    }
 
     virtual bool
     hasMask() const override
@@ -473,7 +543,7 @@ public:
         return new QImageRawView( m_data, m_dims, sliceInfo );
     }
 
-    virtual Carta::Lib::NdArray::Byte *
+    virtual Carta::Lib::NdArray::BitMask *
     getMaskSlice( const SliceND & sliceInfo ) override
     {
         Q_UNUSED( sliceInfo );
@@ -528,14 +598,15 @@ private:
         // prepare metadata
         m_mdi = std::make_shared < QImageMDI > ( shared_from_this() );
 
-        // extract the actual pixels and store it in our own data buffer (only one byte
-        // per pixel, gray equivalent to be precise)
-        m_data = std::make_shared < std::vector < unsigned char > > ( m_dims[0] * m_dims[1] );
+        // extract the actual pixels and store it in our own data buffer (gray equivalent
+        // to be precise), we convert to floats right away so that the views can hand
+        // out the data without any conversion
+        m_data = std::make_shared < std::vector < float > > ( m_dims[0] * m_dims[1] );
         unsigned int * src = (unsigned int *) qimg.bits();
         int count = qimg.width() * qimg.height();
-        unsigned char * dst = & m_data-> at( 0 );
+        float * dst = & m_data-> at( 0 );
         for ( int i = 0 ; i < count ; ++i ) {
-            * dst = qGray( * src );
+            * dst = float (qGray( * src )) / float (255.0);
             src++;
             dst++;
         }
@@ -552,7 +623,7 @@ private:
     bool m_valid = false;
 
     // here we'll store the actual gray scale data
-    std::shared_ptr < std::vector < unsigned char > > m_data = nullptr;
+    std::shared_ptr < std::vector < float > > m_data = nullptr;
 };
 
 QImagePlugin::QImagePlugin( QObject * parent ) :
@@ -772,7 +772,12 @@ qx.Class.define("skel.boundWidgets.Animator", {
                 if ( this.m_animId !== null && this.m_animId.length > 0 ){
                     var paramMap = frameIndex;
                     var path = skel.widgets.Path.getInstance();
-                    var setFramePath = this.m_animId  + path.SEP_COMMAND + "setFrame";
+                    //While playing, the server keeps the pace of the animation.
+                    var cmd = "setFrame";
+                    if ( this.m_playButton.getValue() || this.m_revPlayButton.getValue() ){
+                        cmd = "playFrame";
+                    }
+                    var setFramePath = this.m_animId  + path.SEP_COMMAND + cmd;
                     this.m_connector.sendCommand(setFramePath, paramMap, function(val) {});
                 }
             }